@@ -36,7 +36,7 @@ namespace lcp {
         JNIEnv * env = getJNIEnv();
         this->jNetProvider = env->NewGlobalRef(jNetProvider);
         jclass jNetProviderClass = env->GetObjectClass(this->jNetProvider);
-        this->jDownloadMethodId = env->GetMethodID(jNetProviderClass, "download", "(Ljava/lang/String;Ljava/lang/String;JJ)V");
+        this->jDownloadMethodId = env->GetMethodID(jNetProviderClass, "download", "(Ljava/lang/String;Ljava/lang/String;JJJJLjava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
         this->jCancelMethodId = env->GetMethodID(jNetProviderClass, "cancel", "(J)V");
     }
 
@@ -52,14 +52,39 @@ namespace lcp {
         JNIEnv * env = getJNIEnv();
         jstring jUrl = env->NewStringUTF(request->Url().c_str());
 
-        if (!request->HasDestinationPath()) {
-            // TODO: write to STREAM instead!!
-            // request->DestinationStream()
+        // The bytes [rangeStart, rangeEnd) of the resource, rangeEnd being
+        // -1 up to its end
+        jlong rangeStart = 0;
+        jlong rangeEnd = -1;
+        std::string ifRange;
+        IRangeDownloadRequest * rangeRequest = dynamic_cast<IRangeDownloadRequest *>(request);
+        if (rangeRequest != nullptr) {
+            rangeStart = (jlong) rangeRequest->RangeStart();
+            rangeEnd = (jlong) rangeRequest->RangeEnd();
+            ifRange = rangeRequest->IfRange();
+        }
+
+        // Validators of the copy the caller already has
+        std::string ifNoneMatch;
+        std::string ifModifiedSince;
+        IConditionalDownloadRequest * conditionalRequest = dynamic_cast<IConditionalDownloadRequest *>(request);
+        if (conditionalRequest != nullptr) {
+            ifNoneMatch = conditionalRequest->IfNoneMatch();
+            ifModifiedSince = conditionalRequest->IfModifiedSince();
         }
 
         jstring jDstPath = env->NewStringUTF(request->DestinationPath().c_str());
+        jstring jIfRange = env->NewStringUTF(ifRange.c_str());
+        jstring jIfNoneMatch = env->NewStringUTF(ifNoneMatch.c_str());
+        jstring jIfModifiedSince = env->NewStringUTF(ifModifiedSince.c_str());
         env->CallVoidMethod(this->jNetProvider, this->jDownloadMethodId, jUrl, jDstPath,
-                                   (jlong) request, (jlong) callback);
+                                   (jlong) request, (jlong) callback, rangeStart, rangeEnd, jIfRange,
+                                   jIfNoneMatch, jIfModifiedSince);
+        env->DeleteLocalRef(jIfModifiedSince);
+        env->DeleteLocalRef(jIfNoneMatch);
+        env->DeleteLocalRef(jIfRange);
+        env->DeleteLocalRef(jDstPath);
+        env->DeleteLocalRef(jUrl);
     }
 
     void NetProvider::CancelDownloadRequest(
@@ -77,16 +102,61 @@ JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativ
     callback->OnRequestStarted(request);
 }
 
+JNIEXPORT jboolean JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestData(
+        JNIEnv *env, jobject obj, jlong requestPtr, jbyteArray data, jint length) {
+    lcp::IDownloadRequest * request = (lcp::IDownloadRequest *) requestPtr;
+    try {
+        jbyte * bytes = env->GetByteArrayElements(data, nullptr);
+        try {
+            request->DestinationStream()->Write((const unsigned char *) bytes, length);
+        } catch (...) {
+            env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+            throw;
+        }
+        env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+        return JNI_TRUE;
+    } catch (const std::exception &) {
+        return JNI_FALSE;
+    }
+}
+
 JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestEnded(
-        JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr, jstring path) {
+        JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr, jstring path,
+        jlong resourceSize, jstring etag, jstring lastModified, jboolean notModified) {
     lcp::INetProviderCallback * callback = (lcp::INetProviderCallback *) callbackPtr;
     lcp::IDownloadRequest * request = (lcp::IDownloadRequest *) requestPtr;
 
-    // This is a hack, see TODO above in StartDownloadRequest() (Java/JNI NetProvider only supports download-to-file, not memory stream!)
+    // The data went through nativeOnRequestData(), the destination path
+    // only names the download
     lcp::BaseDownloadRequest* request_ = dynamic_cast<lcp::BaseDownloadRequest*>(request);
-    if (request_) {
+    if (request_ && path != nullptr) {
         const char *path_ = env->GetStringUTFChars(path, 0);
         request_->SetSuggestedFileName(std::string(path_));
+        env->ReleaseStringUTFChars(path, path_);
+    }
+
+    // -1 unless the server answered a range request with a 206
+    lcp::IRangeDownloadRequest * rangeRequest = dynamic_cast<lcp::IRangeDownloadRequest *>(request);
+    if (rangeRequest != nullptr) {
+        rangeRequest->SetResourceSize(resourceSize);
+    }
+
+    // A 304 answer leaves the destination untouched
+    lcp::IConditionalDownloadRequest * conditionalRequest = dynamic_cast<lcp::IConditionalDownloadRequest *>(request);
+    if (conditionalRequest != nullptr) {
+        if (etag != nullptr) {
+            const char * etag_ = env->GetStringUTFChars(etag, 0);
+            conditionalRequest->SetETag(std::string(etag_));
+            env->ReleaseStringUTFChars(etag, etag_);
+        }
+        if (lastModified != nullptr) {
+            const char * lastModified_ = env->GetStringUTFChars(lastModified, 0);
+            conditionalRequest->SetLastModified(std::string(lastModified_));
+            env->ReleaseStringUTFChars(lastModified, lastModified_);
+        }
+        if (notModified) {
+            conditionalRequest->SetNotModified(true);
+        }
     }
 
 
@@ -60,8 +60,11 @@ namespace lcp {
 
 JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestStarted(
         JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr);
+JNIEXPORT jboolean JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestData(
+        JNIEnv *env, jobject obj, jlong requestPtr, jbyteArray data, jint length);
 JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestEnded(
-        JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr, jstring path);
+        JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr, jstring path,
+        jlong resourceSize, jstring etag, jstring lastModified, jboolean notModified);
 JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestCanceled(
         JNIEnv *env, jobject obj, jlong callbackPtr, jlong requestPtr);
 JNIEXPORT void JNICALL Java_org_readium_sdkforcare_lcp_NetProviderCallback_nativeOnRequestProgressed(
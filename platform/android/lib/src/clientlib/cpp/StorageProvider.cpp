@@ -26,6 +26,7 @@
 
 #include "StorageProvider.h"
 #include "Util.h"
+#include <BatchStorageAdapter.h>
 
 namespace lcp {
     StorageProvider::StorageProvider(jobject jStorageProvider) {
@@ -35,6 +36,10 @@ namespace lcp {
         this->jGetValueMethodId = env->GetMethodID(jStorageProviderClass, "getValue", "(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
         this->jSetValueMethodId = env->GetMethodID(jStorageProviderClass, "setValue", "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
         this->jGetKeysMethodId = env->GetMethodID(jStorageProviderClass, "getKeys", "(Ljava/lang/String;)[Ljava/lang/String;");
+        this->jGetValuesMethodId = env->GetMethodID(jStorageProviderClass, "getValues", "(Ljava/lang/String;[Ljava/lang/String;)[Ljava/lang/String;");
+        this->jSetValuesMethodId = env->GetMethodID(jStorageProviderClass, "setValues", "(Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;)V");
+        this->jGetEntriesMethodId = env->GetMethodID(jStorageProviderClass, "getEntries", "(Ljava/lang/String;Ljava/lang/String;)[B");
+        env->DeleteLocalRef(jStorageProviderClass);
     }
 
     StorageProvider::~StorageProvider(){
@@ -47,8 +52,14 @@ namespace lcp {
         jstring jVaultId = env->NewStringUTF(vaultId.c_str());
         jstring jKey = env->NewStringUTF(key.c_str());
         jstring value = (jstring) env->CallObjectMethod(this->jStorageProvider, this->jGetValueMethodId, jVaultId, jKey);
+        env->DeleteLocalRef(jVaultId);
+        env->DeleteLocalRef(jKey);
+
         const char *cValue = env->GetStringUTFChars(value, 0);
-        return std::string(cValue);
+        std::string result(cValue);
+        env->ReleaseStringUTFChars(value, cValue);
+        env->DeleteLocalRef(value);
+        return result;
     }
 
     void StorageProvider::SetValue(const std::string &vaultId, const std::string &key,
@@ -58,23 +69,108 @@ namespace lcp {
         jstring jKey = env->NewStringUTF(key.c_str());
         jstring jValue = env->NewStringUTF(value.c_str());
         env->CallVoidMethod(this->jStorageProvider, this->jSetValueMethodId, jVaultId, jKey, jValue);
+        env->DeleteLocalRef(jVaultId);
+        env->DeleteLocalRef(jKey);
+        env->DeleteLocalRef(jValue);
     }
 
     KvStringsIterator * StorageProvider::EnumerateVault(const std::string &vaultId) {
+        return this->EnumerateKeys(vaultId, std::string());
+    }
+
+    KvStringsIterator * StorageProvider::EnumerateVaultWithPrefix(const std::string &vaultId,
+                                                                  const std::string &keyPrefix) {
+        return this->EnumerateKeys(vaultId, keyPrefix);
+    }
+
+    bool StorageProvider::GetValues(const std::string &vaultId, const std::vector<std::string> &keys,
+                                    std::vector<std::string> &values) {
         JNIEnv * env = getJNIEnv();
         jstring jVaultId = env->NewStringUTF(vaultId.c_str());
-        jobjectArray jKeys = (jobjectArray) env->CallObjectMethod(this->jStorageProvider, this->jGetKeysMethodId, jVaultId);
-        jsize count = env->GetArrayLength(jKeys);
-        std::vector<std::string> keys;
-        std::vector<std::string> values;
+        jobjectArray jKeys = this->NewStringArray(env, keys);
+        jobjectArray jValues = (jobjectArray) env->CallObjectMethod(this->jStorageProvider, this->jGetValuesMethodId, jVaultId, jKeys);
+        env->DeleteLocalRef(jVaultId);
+        env->DeleteLocalRef(jKeys);
+        jsize count = env->GetArrayLength(jValues);
 
+        values.clear();
+        values.reserve(count);
         for (int i=0; i<count; i++) {
-            jstring jKey = (jstring) env->GetObjectArrayElement(jKeys, i);
-            std::string key(env->GetStringUTFChars(jKey, 0));
-            keys.push_back(key);
-            values.push_back(this->GetValue(vaultId, key));
+            jstring jValue = (jstring) env->GetObjectArrayElement(jValues, i);
+            const char *cValue = env->GetStringUTFChars(jValue, 0);
+            values.push_back(std::string(cValue));
+            env->ReleaseStringUTFChars(jValue, cValue);
+            env->DeleteLocalRef(jValue);
         }
+        env->DeleteLocalRef(jValues);
+        return true;
+    }
+
+    bool StorageProvider::SetValues(const std::string &vaultId,
+                                    const std::map<std::string, std::string> &values) {
+        std::vector<std::string> keys;
+        std::vector<std::string> valuesList;
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            keys.push_back(it->first);
+            valuesList.push_back(it->second);
+        }
+
+        JNIEnv * env = getJNIEnv();
+        jstring jVaultId = env->NewStringUTF(vaultId.c_str());
+        jobjectArray jKeys = this->NewStringArray(env, keys);
+        jobjectArray jValues = this->NewStringArray(env, valuesList);
+        env->CallVoidMethod(this->jStorageProvider, this->jSetValuesMethodId, jVaultId, jKeys, jValues);
+        env->DeleteLocalRef(jVaultId);
+        env->DeleteLocalRef(jKeys);
+        env->DeleteLocalRef(jValues);
+        return true;
+    }
 
+    bool StorageProvider::EnumerateVaultToBuffer(const std::string &vaultId, const std::string &keyPrefix,
+                                                 std::string &buffer) {
+        JNIEnv * env = getJNIEnv();
+        jstring jVaultId = env->NewStringUTF(vaultId.c_str());
+        jstring jKeyPrefix = env->NewStringUTF(keyPrefix.c_str());
+        jbyteArray jBuffer = (jbyteArray) env->CallObjectMethod(this->jStorageProvider, this->jGetEntriesMethodId, jVaultId, jKeyPrefix);
+        env->DeleteLocalRef(jVaultId);
+        env->DeleteLocalRef(jKeyPrefix);
+        jsize size = env->GetArrayLength(jBuffer);
+
+        buffer.resize(size);
+        if (size > 0) {
+            env->GetByteArrayRegion(jBuffer, 0, size, reinterpret_cast<jbyte *>(&buffer[0]));
+        }
+        env->DeleteLocalRef(jBuffer);
+        return true;
+    }
+
+    KeyChainIterator * StorageProvider::EnumerateKeys(const std::string &vaultId, const std::string &keyPrefix) {
+        // All the matching entries come in a single JNI round trip
+        std::string buffer;
+        StringsMap entries;
+        this->EnumerateVaultToBuffer(vaultId, keyPrefix, buffer);
+        if (!BatchStorageAdapter::ReadBuffer(buffer, entries)) {
+            throw std::runtime_error("Storage buffer is malformed");
+        }
+
+        std::vector<std::string> keys;
+        std::vector<std::string> values;
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            keys.push_back(it->first);
+            values.push_back(it->second);
+        }
         return new KeyChainIterator(keys, values);
     }
+
+    jobjectArray StorageProvider::NewStringArray(JNIEnv * env, const std::vector<std::string> &strings) {
+        jclass jStringClass = env->FindClass("java/lang/String");
+        jobjectArray jStrings = env->NewObjectArray(strings.size(), jStringClass, nullptr);
+        for (size_t i=0; i<strings.size(); i++) {
+            jstring jString = env->NewStringUTF(strings[i].c_str());
+            env->SetObjectArrayElement(jStrings, i, jString);
+            env->DeleteLocalRef(jString);
+        }
+        env->DeleteLocalRef(jStringClass);
+        return jStrings;
+    }
 }
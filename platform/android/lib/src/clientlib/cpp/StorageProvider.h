@@ -28,6 +28,7 @@
 #define LCP_ANDROID_STORAGE_PROVIDER_H
 
 #include <public/IStorageProvider.h>
+#include <map>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -93,6 +94,9 @@ namespace lcp {
         jmethodID jGetValueMethodId;
         jmethodID jSetValueMethodId;
         jmethodID jGetKeysMethodId;
+        jmethodID jGetValuesMethodId;
+        jmethodID jSetValuesMethodId;
+        jmethodID jGetEntriesMethodId;
     public:
         StorageProvider(jobject jStorageProvider);
         ~StorageProvider();
@@ -103,6 +107,23 @@ namespace lcp {
                       const std::string &value);
 
         KvStringsIterator *EnumerateVault(const std::string &vaultId);
+
+        KvStringsIterator *EnumerateVaultWithPrefix(const std::string &vaultId,
+                                                    const std::string &keyPrefix);
+
+        bool GetValues(const std::string &vaultId, const std::vector<std::string> &keys,
+                       std::vector<std::string> &values);
+
+        bool SetValues(const std::string &vaultId,
+                       const std::map<std::string, std::string> &values);
+
+        bool EnumerateVaultToBuffer(const std::string &vaultId, const std::string &keyPrefix,
+                                    std::string &buffer);
+
+    private:
+        KeyChainIterator *EnumerateKeys(const std::string &vaultId, const std::string &keyPrefix);
+
+        jobjectArray NewStringArray(JNIEnv * env, const std::vector<std::string> &strings);
     };
 }
 
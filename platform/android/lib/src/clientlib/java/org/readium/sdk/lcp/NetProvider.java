@@ -38,12 +38,12 @@ import com.koushikdutta.async.http.AsyncHttpRequest;
 import com.koushikdutta.async.http.Headers;
 import com.koushikdutta.ion.Ion;
 import com.koushikdutta.ion.Response;
+import com.koushikdutta.ion.builder.Builders;
 import com.koushikdutta.ion.loader.AsyncHttpRequestFactory;
 
 import org.apache.commons.io.IOUtils;
 
 import java.io.File;
-import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.StringWriter;
@@ -82,21 +82,39 @@ public class NetProvider {
         this.requests = new HashMap<>();
     }
 
+    /**
+     * Downloads the whole resource.
+     */
     public void download(final String url, String dstPath, final long requestPtr, long callbackPtr) {
+        this.download(url, dstPath, requestPtr, callbackPtr, 0, -1, null, null, null);
+    }
+
+    /**
+     * Downloads the bytes [rangeStart, rangeEnd) of the resource, rangeEnd being -1 up to its
+     * end. The data is written through the native request, dstPath only names the download.
+     * ifNoneMatch and ifModifiedSince are the validators of the copy the caller has, a 304
+     * answer ends the request as not modified.
+     */
+    public void download(final String url, String dstPath, final long requestPtr, long callbackPtr,
+                         long rangeStart, long rangeEnd, String ifRange,
+                         String ifNoneMatch, String ifModifiedSince) {
 
         final NetProviderCallback callback = new NetProviderCallback(callbackPtr, requestPtr);
+        final String destPath = (dstPath != null) ? dstPath : "";
 
-        if (dstPath == null || dstPath.isEmpty()) {
-            File outputDir = this.context.getCacheDir();
-            File outputFile = null;
-            try {
-                outputFile = File.createTempFile("readium_TEMP_download", ".tmp", outputDir);
-                dstPath = outputFile.getAbsolutePath();
-            } catch (IOException e) {
-                e.printStackTrace();
+        Builders.Any.B builder = Ion.with(NetProvider.this.context).load("GET", url);
+        if (rangeStart > 0 || rangeEnd != -1) {
+            builder.setHeader("Range", "bytes=" + rangeStart + "-" + (rangeEnd == -1 ? "" : String.valueOf(rangeEnd - 1)));
+            if (ifRange != null && !ifRange.isEmpty()) {
+                builder.setHeader("If-Range", ifRange);
             }
         }
-        final String destPath = dstPath;
+        if (ifNoneMatch != null && !ifNoneMatch.isEmpty()) {
+            builder.setHeader("If-None-Match", ifNoneMatch);
+        }
+        if (ifModifiedSince != null && !ifModifiedSince.isEmpty()) {
+            builder.setHeader("If-Modified-Since", ifModifiedSince);
+        }
 
 //        Timer timer = new Timer();
 //        timer.schedule(new TimerTask() {
@@ -128,8 +146,7 @@ public class NetProvider {
 //            @Override
 //            public void run() {
 
-                Future<Response<InputStream>> request = Ion.with(NetProvider.this.context)
-                        .load("GET", url)
+                Future<Response<InputStream>> request = builder
                         .setLogging("Readium Ion", Log.VERBOSE)
 
                         //.setTimeout(AsyncHttpRequest.DEFAULT_TIMEOUT) //30000
@@ -151,6 +168,21 @@ public class NetProvider {
 
                                 InputStream inputStream = response != null ? response.getResult() : null;
                                 int httpResponseCode = response != null ? response.getHeaders().code() : 0;
+                                if (e == null && httpResponseCode == 304) {
+                                    Headers headers = response.getHeaders().getHeaders();
+                                    callback.setResponse(-1, headers.get("ETag"), headers.get("Last-Modified"));
+                                    callback.setNotModified();
+                                    if (inputStream != null) {
+                                        try {
+                                            inputStream.close();
+                                        } catch (IOException ex) {
+                                            // ignore
+                                        }
+                                    }
+                                    callback.onCompleted(null, new File(destPath));
+                                    return;
+                                }
+
                                 if (e != null || inputStream == null
                                         || httpResponseCode < 200 || httpResponseCode >= 300) {
 
@@ -158,21 +190,30 @@ public class NetProvider {
                                     return;
                                 }
 
-                                File destFile = new File(destPath);
-                                try {
-                                    FileOutputStream outputStream = new FileOutputStream(destFile);
-                                    //inputStream.transferTo(outputStream);
+                                // Content-Range: bytes <first>-<last>/<size>, the body of
+                                // any other answer is the whole resource
+                                Headers headers = response.getHeaders().getHeaders();
+                                long resourceSize = -1;
+                                String contentRange = headers.get("Content-Range");
+                                if (httpResponseCode == 206 && contentRange != null) {
+                                    String size = contentRange.substring(contentRange.indexOf('/') + 1).trim();
+                                    try {
+                                        resourceSize = Long.parseLong(size);
+                                    } catch (NumberFormatException ex) {
+                                        // Unknown size ("*")
+                                    }
+                                }
+                                callback.setResponse(resourceSize, headers.get("ETag"), headers.get("Last-Modified"));
 
+                                try {
                                     byte[] buf = new byte[4096];
                                     int n;
-                                    int total = 0;
                                     while ((n = inputStream.read(buf)) > 0) {
-                                        total += n;
-                                        outputStream.write(buf, 0, n);
+                                        if (!callback.write(buf, n)) {
+                                            throw new IOException("Can not write the downloaded data");
+                                        }
                                     }
-                                    outputStream.close();
-//                                    inputStream.close();
-                                    callback.onCompleted(null, destFile);
+                                    callback.onCompleted(null, new File(destPath));
 
                                 } catch (Exception ex) {
                                     ex.printStackTrace();
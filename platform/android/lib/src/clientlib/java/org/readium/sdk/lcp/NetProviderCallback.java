@@ -51,6 +51,13 @@ public class NetProviderCallback
     private boolean hasStarted = false;
     private boolean hasEnded = false;
 
+    // Reported by the answer, resourceSize is -1 unless it is a 206
+    private long resourceSize = -1;
+    private String etag;
+    private String lastModified;
+    // Set on a 304 answer, nothing was written then
+    private boolean notModified = false;
+
     NetProviderCallback(long nativePtr, long requestPtr) {
         this.nativePtr = nativePtr;
         this.requestPtr = requestPtr;
@@ -63,6 +70,24 @@ public class NetProviderCallback
         }
     }
 
+    void setResponse(long resourceSize, String etag, String lastModified) {
+        this.resourceSize = resourceSize;
+        this.etag = etag;
+        this.lastModified = lastModified;
+    }
+
+    void setNotModified() {
+        this.notModified = true;
+    }
+
+    /**
+     * Writes downloaded data through the native request, false if it failed.
+     */
+    boolean write(byte[] data, int length) {
+        this.checkStart();
+        return this.nativeOnRequestData(this.requestPtr, data, length);
+    }
+
     @Override
     public void onCompleted(Exception e, File result) {
         this.checkStart();
@@ -77,7 +102,8 @@ public class NetProviderCallback
             // Request timeout
             this.nativeOnRequestCanceled(this.nativePtr, this.requestPtr);
         } else if (e == null && result != null) {
-            this.nativeOnRequestEnded(this.nativePtr, this.requestPtr, result.getAbsolutePath());
+            this.nativeOnRequestEnded(this.nativePtr, this.requestPtr, result.getPath(),
+                    this.resourceSize, this.etag, this.lastModified, this.notModified);
         } else {
             // Other errors
             this.nativeOnRequestCanceled(this.nativePtr, this.requestPtr);
@@ -104,6 +130,9 @@ public class NetProviderCallback
     private native void nativeOnRequestStarted(long nativePtr, long requestPtr);
     private native void nativeOnRequestProgressed(long nativePtr, long requestPtr,
                                                   float progress);
-    private native void nativeOnRequestEnded(long nativePtr, long requestPtr, String path);
+    private native boolean nativeOnRequestData(long requestPtr, byte[] data, int length);
+    private native void nativeOnRequestEnded(long nativePtr, long requestPtr, String path,
+                                             long resourceSize, String etag, String lastModified,
+                                             boolean notModified);
     private native void nativeOnRequestCanceled(long nativePtr, long requestPtr);
 }
@@ -29,6 +29,11 @@ package org.readium.sdkforcare.lcp;
 import android.content.SharedPreferences;
 import 	android.content.Context;
 
+import java.io.ByteArrayOutputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.nio.charset.Charset;
+import java.util.Map;
 import java.util.Set;
 
 /**
@@ -36,6 +41,7 @@ import java.util.Set;
  */
 public class StorageProvider {
     private static final String PREFS_NAME_PREFIX = "org.readium.sdkforcare.lcp.";
+    private static final Charset UTF8 = Charset.forName("UTF-8");
     private Context context;
 
     public StorageProvider(Context context) {
@@ -66,4 +72,59 @@ public class StorageProvider {
         Set<String> keySet = prefs.getAll().keySet();
         return keySet.toArray(new String[keySet.size()]);
     }
+
+    public String[] getValues(String vaultId, String[] keys) {
+        SharedPreferences prefs = this.getVault(vaultId);
+        String[] values = new String[keys.length];
+        for (int i = 0; i < keys.length; i++) {
+            values[i] = prefs.getString(keys[i], "");
+        }
+        return values;
+    }
+
+    /**
+     * Set all the values in a single edit, applied atomically
+     * @param vaultId
+     * @param keys
+     * @param values
+     */
+    public void setValues(String vaultId, String[] keys, String[] values) {
+        SharedPreferences.Editor editor = this.getVault(vaultId).edit();
+        for (int i = 0; i < keys.length; i++) {
+            editor.putString(keys[i], values[i]);
+        }
+        editor.apply();
+    }
+
+    /**
+     * Return the entries of vault whose key starts with keyPrefix, as a flat
+     * buffer: each key followed by its value, both preceded by their size
+     * in UTF-8 on 4 bytes, big-endian
+     * @param vaultId
+     * @param keyPrefix
+     * @return
+     */
+    public byte[] getEntries(String vaultId, String keyPrefix) {
+        SharedPreferences prefs = this.getVault(vaultId);
+        ByteArrayOutputStream bytes = new ByteArrayOutputStream();
+        DataOutputStream stream = new DataOutputStream(bytes);
+        try {
+            for (Map.Entry<String, ?> entry : prefs.getAll().entrySet()) {
+                if (entry.getKey().startsWith(keyPrefix) && entry.getValue() instanceof String) {
+                    writeString(stream, entry.getKey());
+                    writeString(stream, (String) entry.getValue());
+                }
+            }
+        } catch (IOException e) {
+            // Not thrown when writing in memory
+            throw new IllegalStateException(e);
+        }
+        return bytes.toByteArray();
+    }
+
+    private static void writeString(DataOutputStream stream, String value) throws IOException {
+        byte[] utf8 = value.getBytes(UTF8);
+        stream.writeInt(utf8.length);
+        stream.write(utf8);
+    }
 }
@@ -33,6 +33,16 @@
 
 using namespace lcp;
 
+static NSString *HeaderValue(NSHTTPURLResponse *response, NSString *name)
+{
+    for (NSString *key in response.allHeaderFields) {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+            return response.allHeaderFields[key];
+        }
+    }
+    return nil;
+}
+
 @interface LCPiOSNetProvider : NSObject <NSURLSessionDataDelegate>
 @property (strong, nonatomic) NSURLSession *session;
 @property (strong, nonatomic) NSMutableDictionary *requests;
@@ -60,7 +70,28 @@ using namespace lcp;
     NSString *urlString = [NSString stringWithUTF8String:request->Url().c_str()];
     NSURL *url = [NSURL URLWithString:urlString];
     if (url) {
-        NSURLSessionDataTask *task = [self.session dataTaskWithURL:url];
+        NSMutableURLRequest *urlRequest = [NSMutableURLRequest requestWithURL:url];
+        IConditionalDownloadRequest *conditional = dynamic_cast<IConditionalDownloadRequest *>(request);
+        if (conditional) {
+            if (!conditional->IfNoneMatch().empty()) {
+                [urlRequest setValue:[NSString stringWithUTF8String:conditional->IfNoneMatch().c_str()] forHTTPHeaderField:@"If-None-Match"];
+            }
+            if (!conditional->IfModifiedSince().empty()) {
+                [urlRequest setValue:[NSString stringWithUTF8String:conditional->IfModifiedSince().c_str()] forHTTPHeaderField:@"If-Modified-Since"];
+            }
+        }
+        IRangeDownloadRequest *range = dynamic_cast<IRangeDownloadRequest *>(request);
+        if (range && (range->RangeStart() > 0 || range->RangeEnd() != -1)) {
+            NSString *bytes = (range->RangeEnd() == -1)
+                ? [NSString stringWithFormat:@"bytes=%lld-", (long long)range->RangeStart()]
+                : [NSString stringWithFormat:@"bytes=%lld-%lld", (long long)range->RangeStart(), (long long)range->RangeEnd() - 1];
+            [urlRequest setValue:bytes forHTTPHeaderField:@"Range"];
+            if (!range->IfRange().empty()) {
+                [urlRequest setValue:[NSString stringWithUTF8String:range->IfRange().c_str()] forHTTPHeaderField:@"If-Range"];
+            }
+        }
+
+        NSURLSessionDataTask *task = [self.session dataTaskWithRequest:urlRequest];
         id identifier = @(task.taskIdentifier);
         self.requests[identifier] = [NSValue valueWithPointer:request];
         self.callbacks[identifier] = [NSValue valueWithPointer:callback];
@@ -81,6 +112,38 @@ using namespace lcp;
     if (filename.length > 0) {
         request->SetSuggestedFileName([filename UTF8String]);
     }
+
+    IConditionalDownloadRequest *conditional = dynamic_cast<IConditionalDownloadRequest *>(request);
+    if (conditional && [response isKindOfClass:[NSHTTPURLResponse class]]) {
+        NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+        NSString *etag = HeaderValue(httpResponse, @"ETag");
+        if (etag) {
+            conditional->SetETag([etag UTF8String]);
+        }
+        NSString *lastModified = HeaderValue(httpResponse, @"Last-Modified");
+        if (lastModified) {
+            conditional->SetLastModified([lastModified UTF8String]);
+        }
+        if (httpResponse.statusCode == 304) {
+            conditional->SetNotModified(true);
+        }
+
+        // bytes <first>-<last>/<size>, the body of any other answer is the
+        // whole resource
+        IRangeDownloadRequest *range = dynamic_cast<IRangeDownloadRequest *>(request);
+        if (range) {
+            int64_t resourceSize = -1;
+            NSString *contentRange = HeaderValue(httpResponse, @"Content-Range");
+            NSRange slash = contentRange ? [contentRange rangeOfString:@"/"] : NSMakeRange(NSNotFound, 0);
+            if (httpResponse.statusCode == 206 && slash.location != NSNotFound) {
+                NSString *size = [contentRange substringFromIndex:slash.location + 1];
+                if (![size isEqualToString:@"*"]) {
+                    resourceSize = [size longLongValue];
+                }
+            }
+            range->SetResourceSize(resourceSize);
+        }
+    }
     
     completionHandler(NSURLSessionResponseAllow);
 }
@@ -38,9 +38,14 @@ namespace lcp
     class iOSKeyChainIterator : public KvStringsIterator
     {
     public:
-        explicit iOSKeyChainIterator(UICKeyChainStore *keyChain) : m_index(0)
+        explicit iOSKeyChainIterator(UICKeyChainStore *keyChain, NSString *keyPrefix = nil) : m_index(0)
         {
             m_keys = [keyChain allKeys];
+            if ([keyPrefix length] > 0) {
+                // Only read the matching items, each one is a Keychain query
+                NSPredicate *predicate = [NSPredicate predicateWithFormat:@"SELF BEGINSWITH %@", keyPrefix];
+                m_keys = [m_keys filteredArrayUsingPredicate:predicate];
+            }
             
             for (NSString *key in m_keys) {
                 NSString* str = [keyChain stringForKey:key];
@@ -130,6 +135,13 @@ namespace lcp
         return keyChain ? new iOSKeyChainIterator(keyChain) : nullptr;
     }
     
+    KvStringsIterator *iOSStorageProvider::EnumerateVaultWithPrefix(const std::string &vaultId, const std::string &keyPrefix)
+    {
+        UICKeyChainStore *keyChain = this->GetKeyChainOfVault(vaultId);
+        NSString *prefix = this->GetStringFromNativeString(keyPrefix);
+        return keyChain ? new iOSKeyChainIterator(keyChain, prefix) : nullptr;
+    }
+    
     void iOSStorageProvider::EraseVault(const std::string &vaultId)
     {
         UICKeyChainStore *keyChain = this->GetKeyChainOfVault(vaultId);
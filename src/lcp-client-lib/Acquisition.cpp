@@ -29,10 +29,16 @@
 
 #include "public/ILicense.h"
 #include "Acquisition.h"
+#include "CryptoppUtils.h"
 #include "DownloadInFileRequest.h"
+#include "HashingWritableStream.h"
 #include "IncludeMacros.h"
 #include "ICryptoProvider.h"
 #include "LcpUtils.h"
+#include "SegmentWritableStream.h"
+#include "Statistics.h"
+#include "TraceSpan.h"
+#include <algorithm>
 #include <memory>
 #include <sstream>
 
@@ -45,13 +51,36 @@ static std::string const LcpLicensePath = "META-INF/license.lcpl";
 namespace lcp
 {
     /*static*/ const char * Acquisition::PublicationType = u8"application/epub+zip";
+    /*static*/ const int64_t Acquisition::DefaultSegmentSize = 4 * 1024 * 1024;
+    /*static*/ const size_t Acquisition::MaxSegmentsInFlight = 4;
+    /*static*/ const char * Acquisition::ProgressMagic = "lcp-acquisition/1";
+    /*static*/ const char * Acquisition::ProgressExtension = ".part";
+    /*static*/ const char * Acquisition::ProgressHashKeyword = "hash";
+
+    Acquisition::Segment::Segment(int64_t start, int64_t end)
+        : start(start)
+        , end(end)
+        , position(start)
+        , inFlight(false)
+    {
+    }
+
+    Acquisition::Segment::~Segment()
+    {
+    }
+
+    bool Acquisition::Segment::Complete() const
+    {
+        return (end != -1 && position >= end);
+    }
 
     Acquisition::Acquisition(
         ILicense * license,
         IFileSystemProvider * fileSystemProvider,
         INetProvider * netProvider,
         ICryptoProvider * cryptoProvider,
-        const std::string & publicationPath
+        const std::string & publicationPath,
+        int64_t segmentSize
         )
         : m_license(license)
         , m_fileSystemProvider(fileSystemProvider)
@@ -59,6 +88,23 @@ namespace lcp
         , m_cryptoProvider(cryptoProvider)
         , m_callback(nullptr)
         , m_publicationPath(publicationPath)
+        , m_segmentSize(segmentSize)
+        , m_destination(nullptr)
+        , m_bandwidthBudget(nullptr)
+        , m_resourceSize(-1)
+        , m_resumable(false)
+        , m_savedHashSize(0)
+        , m_startNotified(false)
+        , m_canceled(false)
+        , m_ended(false)
+        , m_notified(false)
+        , m_result(StatusCode::ErrorCommonSuccess)
+        , m_traceSink(nullptr)
+        , m_statistics(Statistics::Current())
+    {
+    }
+
+    Acquisition::~Acquisition()
     {
     }
 
@@ -69,6 +115,11 @@ namespace lcp
             std::unique_lock<std::mutex> locker(m_sync);
 
             m_callback = callback;
+            m_startTime = std::chrono::steady_clock::now();
+            if (m_traceSink != nullptr)
+            {
+                m_traceSpan.reset(new TraceSpan(m_traceSink, "Acquisition"));
+            }
 
             ILinks * links = m_license->Links();
             if (!links->Has(Publication))
@@ -83,16 +134,60 @@ namespace lcp
                 //return Status(StatusCode::ErrorAcquisitionPublicationWrongType, "ErrorAcquisitionPublicationWrongType");
             }
 
-            m_file.reset(m_fileSystemProvider->GetFile(m_publicationPath));
+            // A previous acquisition of this publication may have left a part
+            // of it to resume from
+            bool resumed = this->LoadProgress();
+            if (!resumed)
+            {
+                m_segments.clear();
+                m_segments.emplace_back(new Segment(0, -1));
+                m_file.reset(m_fileSystemProvider->GetFile(m_publicationPath));
+            }
             if (m_file.get() == nullptr)
             {
                 return Status(StatusCode::ErrorAcquisitionInvalidFilePath, "ErrorAcquisitionInvalidFilePath");
             }
-            m_request.reset(new DownloadInFileRequest(m_publicationLink.href, m_file.get()));
+
+            // The publication is hashed while it is written, sparing a
+            // second pass over the file once downloaded
+            IHashAlgorithm * hashAlgorithm = nullptr;
+            if (!m_publicationLink.hash.empty() && Status::IsSuccess(m_cryptoProvider->CreateFileHashAlgorithm(&hashAlgorithm)))
+            {
+                m_hashingStream.reset(new HashingWritableStream(m_file.get(), hashAlgorithm));
+                m_destination = m_hashingStream.get();
+
+                // Otherwise what was received is hashed again from the start
+                if (resumed && !m_savedHashState.empty())
+                {
+                    m_hashingStream->RestoreState(m_savedHashSize, m_savedHashState);
+                }
+            }
+            else
+            {
+                m_destination = m_file.get();
+            }
+
+            std::vector<IDownloadRequest *> requests = this->StartSegments();
+            if (m_traceSpan)
+            {
+                m_traceSpan->SetAttribute("url", m_publicationLink.href);
+                m_traceSpan->SetAttribute("resumed", resumed ? "true" : "false");
+                m_traceSpan->SetAttribute("segments", static_cast<int64_t>(m_segments.size()));
+            }
+            if (requests.empty())
+            {
+                // Everything was received before the previous acquisition
+                // was interrupted
+                this->Complete();
+                return Status(StatusCode::ErrorCommonSuccess);
+            }
 
             locker.unlock();
             
-            m_netProvider->StartDownloadRequest(m_request.get(), this);
+            for (IDownloadRequest * request : requests)
+            {
+                m_netProvider->StartDownloadRequest(request, this);
+            }
 
             return Status(StatusCode::ErrorCommonSuccess);
         }
@@ -102,17 +197,245 @@ namespace lcp
         }
     }
 
+    std::vector<IDownloadRequest *> Acquisition::StartSegments()
+    {
+        std::vector<IDownloadRequest *> requests;
+        size_t inFlightCount = std::count_if(m_segments.begin(), m_segments.end(),
+            [](const std::unique_ptr<Segment> & segment) { return segment->inFlight; });
+
+        for (auto & segment : m_segments)
+        {
+            if (inFlightCount >= MaxSegmentsInFlight)
+            {
+                break;
+            }
+            if (segment->inFlight || segment->Complete())
+            {
+                continue;
+            }
+
+            // Until the size of the publication is known, the first segment
+            // is also the request telling whether the server honours ranges.
+            // Its stream accepts the whole publication if it does not.
+            int64_t rangeEnd = (segment->end == -1) ? m_segmentSize : segment->end;
+            std::string ifRange = (segment->end == -1) ? std::string() : m_validator;
+
+            segment->stream.reset(new SegmentWritableStream(m_destination, m_fileSync, segment->position, segment->end, m_bandwidthBudget));
+            segment->request.reset(new DownloadInFileRequest(m_publicationLink.href, m_file.get(), segment->stream.get()));
+            segment->request->SetRange(segment->position, rangeEnd, ifRange);
+            segment->inFlight = true;
+            requests.push_back(segment->request.get());
+            ++inFlightCount;
+        }
+        return requests;
+    }
+
+    Acquisition::Segment * Acquisition::FindSegment(INetRequest * request) const
+    {
+        for (auto & segment : m_segments)
+        {
+            if (segment->request.get() == request)
+            {
+                return segment.get();
+            }
+        }
+        return nullptr;
+    }
+
+    void Acquisition::OnSegmentEnded(Segment * segment, IRangeDownloadRequest * request)
+    {
+        if (segment->end == -1)
+        {
+            if (request->ResourceSize() == -1)
+            {
+                // The server sent the whole publication
+                segment->end = segment->position;
+                m_resourceSize = segment->position;
+            }
+            else
+            {
+                m_resourceSize = request->ResourceSize();
+                m_validator = request->ETag().empty() ? request->LastModified() : request->ETag();
+                m_resumable = true;
+                this->SplitInSegments(segment, m_resourceSize);
+            }
+        }
+        else if (request->ResourceSize() != m_resourceSize || segment->stream->Overrun())
+        {
+            // The publication changed since the first segment, or the server
+            // stopped honouring ranges, what was received can not be trusted
+            this->RemoveProgress();
+            m_resumable = false;
+            throw StatusException(Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed: publication changed"));
+        }
+
+        if (!segment->Complete())
+        {
+            throw StatusException(Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed: segment truncated"));
+        }
+
+        if (m_hashingStream)
+        {
+            int64_t prefixEnd = this->ReceivedPrefixEnd();
+            std::unique_lock<std::mutex> fileLocker(m_fileSync);
+            m_hashingStream->CatchUp(m_file.get(), prefixEnd);
+        }
+        this->StoreProgress();
+    }
+
+    void Acquisition::SplitInSegments(Segment * firstSegment, int64_t resourceSize)
+    {
+        firstSegment->end = std::min(m_segmentSize, resourceSize);
+        for (int64_t start = firstSegment->end; start < resourceSize; start += m_segmentSize)
+        {
+            m_segments.emplace_back(new Segment(start, std::min(start + m_segmentSize, resourceSize)));
+        }
+    }
+
+    int64_t Acquisition::ReceivedPrefixEnd() const
+    {
+        for (auto & segment : m_segments)
+        {
+            if (!segment->Complete())
+            {
+                return segment->inFlight ? segment->stream->Position() : segment->position;
+            }
+        }
+        return m_resourceSize;
+    }
+
+    bool Acquisition::AnySegmentInFlight() const
+    {
+        return std::any_of(m_segments.begin(), m_segments.end(),
+            [](const std::unique_ptr<Segment> & segment) { return segment->inFlight; });
+    }
+
+    void Acquisition::CancelSegments()
+    {
+        for (auto & segment : m_segments)
+        {
+            if (segment->inFlight)
+            {
+                segment->request->SetCanceled(true);
+                m_netProvider->CancelDownloadRequest(segment->request.get());
+            }
+        }
+    }
+
+    void Acquisition::NotifyWhenDone()
+    {
+        if (m_notified || this->AnySegmentInFlight())
+        {
+            return;
+        }
+        m_notified = true;
+        if (m_callback == nullptr)
+        {
+            return;
+        }
+        if (m_canceled)
+        {
+            m_callback->OnAcquisitionCanceled(this);
+        }
+        else
+        {
+            m_callback->OnAcquisitionEnded(this, m_result);
+        }
+    }
+
+    void Acquisition::EndAcquisition(Status result)
+    {
+        m_ended = true;
+        m_statistics->AddLatency(StatisticsOperation::Acquisition, std::chrono::steady_clock::now() - m_startTime);
+        this->CancelSegments();
+        this->StoreProgress();
+        this->EndTraceSpan(result);
+        m_result = result;
+        this->NotifyWhenDone();
+    }
+
+    void Acquisition::Complete()
+    {
+        m_ended = true;
+        m_notified = true;
+        m_statistics->AddLatency(StatisticsOperation::Acquisition, std::chrono::steady_clock::now() - m_startTime);
+        try
+        {
+            if (m_hashingStream)
+            {
+                std::unique_lock<std::mutex> fileLocker(m_fileSync);
+                m_hashingStream->CatchUp(m_file.get(), m_resourceSize);
+            }
+
+            Status hashCheckResult = this->CheckPublicationHash(m_publicationLink);
+            if (!Status::IsSuccess(hashCheckResult))
+            {
+                this->RemoveProgress();
+                this->EndTraceSpan(hashCheckResult);
+                if (m_callback != nullptr)
+                {
+                    m_callback->OnAcquisitionEnded(this, hashCheckResult);
+                }
+                return;
+            }
+
+            // Release the epub file to perform zip operations
+            m_destination = nullptr;
+            m_hashingStream.reset();
+            m_file.reset();
+            std::stringstream licenseStream(m_license->OriginalContent());
+            if (!ZipFile::AddFileInPlace(m_publicationPath, licenseStream, LcpLicensePath))
+            {
+                ZipFile::AddFile(m_publicationPath, licenseStream, LcpLicensePath);
+            }
+            this->RemoveProgress();
+
+            Status result(StatusCode::ErrorCommonSuccess);
+            this->EndTraceSpan(result);
+            if (m_callback != nullptr)
+            {
+                m_callback->OnAcquisitionEnded(this, result);
+            }
+        }
+        catch (const std::exception & ex)
+        {
+            Status result(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed" + std::string(ex.what()));
+            this->EndTraceSpan(result);
+            if (m_callback != nullptr)
+            {
+                m_callback->OnAcquisitionEnded(this, result);
+            }
+        }
+    }
+
+    void Acquisition::EndTraceSpan(const Status & result)
+    {
+        if (m_traceSpan)
+        {
+            m_traceSpan->SetAttribute("status", static_cast<int64_t>(result.Code));
+            m_traceSpan->End();
+        }
+    }
+
     Status Acquisition::CheckPublicationHash(const Link & link)
     {
         if (!link.hash.empty())
         {
             std::vector<unsigned char> rawHash;
-            Status res = m_cryptoProvider->CalculateFileHash(m_file.get(), rawHash);
-            if (!Status::IsSuccess(res))
-                return res;
+            if (m_hashingStream && m_hashingStream->IsSequential() && m_hashingStream->HashedSize() == m_file->Size())
+            {
+                rawHash = m_hashingStream->Hash();
+            }
+            else
+            {
+                // Written over, or straight to the destination path
+                Status res = m_cryptoProvider->CalculateFileHash(m_file.get(), rawHash);
+                if (!Status::IsSuccess(res))
+                    return res;
+            }
 
             std::string hexHash;
-            res = m_cryptoProvider->ConvertRawToHex(rawHash, hexHash);
+            Status res = m_cryptoProvider->ConvertRawToHex(rawHash, hexHash);
             if (!Status::IsSuccess(res))
                 return res;
 
@@ -124,11 +447,182 @@ namespace lcp
         return Status(StatusCode::ErrorCommonSuccess);
     }
 
+    //
+    // The progress is stored next to the publication, as text:
+    //   lcp-acquisition/1\n<url>\n<ETag or Last-Modified>\n<size>\n
+    // followed by a "<start> <end> <position>\n" line per segment, position
+    // following the last byte received, and by a "hash <size> <state>\n"
+    // line when the hash of the first bytes received could be saved.
+    //
+    std::string Acquisition::ProgressPath() const
+    {
+        return m_publicationPath + ProgressExtension;
+    }
+
+    bool Acquisition::LoadProgress()
+    {
+        try
+        {
+            std::unique_ptr<IFile> progressFile(m_fileSystemProvider->GetFile(this->ProgressPath(), IFileSystemProvider::ReadOnly));
+            if (progressFile.get() == nullptr || progressFile->Size() == 0)
+            {
+                return false;
+            }
+            std::string content(static_cast<size_t>(progressFile->Size()), '\0');
+            progressFile->Read(reinterpret_cast<unsigned char *>(&content[0]), content.size());
+
+            std::istringstream progress(content);
+            std::string magic;
+            std::string url;
+            std::string validator;
+            int64_t resourceSize = -1;
+            if (!std::getline(progress, magic) || magic != ProgressMagic
+                || !std::getline(progress, url) || url != m_publicationLink.href
+                || !std::getline(progress, validator)
+                || !(progress >> resourceSize) || resourceSize <= 0)
+            {
+                return false;
+            }
+
+            std::vector<std::unique_ptr<Segment>> segments;
+            int64_t received = 0;
+            int64_t start = 0;
+            int64_t end = 0;
+            int64_t position = 0;
+            while (progress >> start >> end >> position)
+            {
+                int64_t expectedStart = segments.empty() ? 0 : segments.back()->end;
+                if (start != expectedStart || end <= start || end > resourceSize || position < start || position > end)
+                {
+                    return false;
+                }
+                segments.emplace_back(new Segment(start, end));
+                segments.back()->position = position;
+                received = std::max(received, position);
+            }
+            if (segments.empty() || segments.back()->end != resourceSize)
+            {
+                return false;
+            }
+
+            int64_t prefixEnd = resourceSize;
+            for (auto & segment : segments)
+            {
+                if (!segment->Complete())
+                {
+                    prefixEnd = segment->position;
+                    break;
+                }
+            }
+            progress.clear();
+            std::string hashKeyword;
+            int64_t hashedSize = 0;
+            std::string hashState;
+            if (progress >> hashKeyword >> hashedSize >> hashState
+                && hashKeyword == ProgressHashKeyword && hashedSize > 0 && hashedSize <= prefixEnd)
+            {
+                m_savedHashSize = hashedSize;
+                m_savedHashState = CryptoppUtils::HexToRaw(hashState);
+            }
+
+            std::unique_ptr<IFile> file(m_fileSystemProvider->GetFile(m_publicationPath, IFileSystemProvider::ReadWrite));
+            if (file.get() == nullptr || file->Size() < received)
+            {
+                return false;
+            }
+
+            m_file = std::move(file);
+            m_segments = std::move(segments);
+            m_resourceSize = resourceSize;
+            m_validator = validator;
+            m_resumable = true;
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    void Acquisition::StoreProgress()
+    {
+        if (!m_resumable)
+        {
+            return;
+        }
+
+        try
+        {
+            std::stringstream progress;
+            progress << ProgressMagic << "\n" << m_publicationLink.href << "\n" << m_validator << "\n" << m_resourceSize << "\n";
+            for (auto & segment : m_segments)
+            {
+                int64_t position = segment->inFlight ? segment->stream->Position() : segment->position;
+                progress << segment->start << " " << segment->end << " " << position << "\n";
+            }
+
+            // The positions above were written before: once flushed, the
+            // publication holds at least what the progress claims
+            Buffer hashState;
+            int64_t hashedSize = 0;
+            if (m_file)
+            {
+                std::unique_lock<std::mutex> fileLocker(m_fileSync);
+                m_file->Flush();
+                if (m_hashingStream)
+                {
+                    hashedSize = m_hashingStream->HashedSize();
+                    hashState = m_hashingStream->SaveState();
+                }
+            }
+            if (!hashState.empty() && hashedSize > 0)
+            {
+                progress << ProgressHashKeyword << " " << hashedSize << " " << CryptoppUtils::RawToHex(hashState) << "\n";
+            }
+
+            std::string content = progress.str();
+            std::unique_ptr<IFile> progressFile(m_fileSystemProvider->GetFile(this->ProgressPath(), IFileSystemProvider::CreateNew));
+            progressFile->Write(reinterpret_cast<const unsigned char *>(content.data()), content.size());
+            progressFile->Flush();
+        }
+        catch (const std::exception &)
+        {
+            // Only resuming the acquisition later is compromised
+        }
+    }
+
+    void Acquisition::RemoveProgress()
+    {
+        try
+        {
+            // Emptied first, LoadProgress() ignores an empty progress left
+            // by the providers which do not remove files
+            std::unique_ptr<IFile> progressFile(m_fileSystemProvider->GetFile(this->ProgressPath(), IFileSystemProvider::CreateNew));
+        }
+        catch (const std::exception &)
+        {
+        }
+        m_fileSystemProvider->RemoveFile(this->ProgressPath());
+    }
+
     Status Acquisition::Cancel()
     {
         std::unique_lock<std::mutex> locker(m_sync);
-        m_request->SetCanceled(true);
-        m_netProvider->CancelDownloadRequest(m_request.get());
+        if (m_canceled || m_ended)
+        {
+            // Storing the progress again could bring back the one of a
+            // completed acquisition
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        m_canceled = true;
+        this->CancelSegments();
+        this->StoreProgress();
+        if (m_traceSpan)
+        {
+            m_traceSpan->SetAttribute("canceled", "true");
+        }
+        this->EndTraceSpan(Status(StatusCode::ErrorCommonSuccess));
+        this->NotifyWhenDone();
         return Status(StatusCode::ErrorCommonSuccess);
     }
 
@@ -140,20 +634,82 @@ namespace lcp
     std::string Acquisition::SuggestedFileName() const
     {
         std::unique_lock<std::mutex> locker(m_sync);
-        return m_request->SuggestedFileName();
+        for (auto & segment : m_segments)
+        {
+            if (segment->request && !segment->request->SuggestedFileName().empty())
+            {
+                return segment->request->SuggestedFileName();
+            }
+        }
+        return std::string();
+    }
+
+    void Acquisition::SetBandwidthBudget(BandwidthBudget * budget)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_bandwidthBudget = budget;
+    }
+
+    void Acquisition::SetTraceSink(ITraceSink * traceSink)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_traceSink = traceSink;
+    }
+
+    bool Acquisition::HasRequestsInFlight() const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        return this->AnySegmentInFlight();
+    }
+
+    void Acquisition::WaitForRequests()
+    {
+        // Requests are released and the acquisition notified under the
+        // lock, the net provider is done once it is free again
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_requestsCondition.wait(locker, [this]() { return !this->AnySegmentInFlight(); });
+    }
+
+    bool Acquisition::Resumable() const
+    {
+        return m_resumable;
     }
 
     void Acquisition::OnRequestStarted(INetRequest * request)
     {
         std::unique_lock<std::mutex> locker(m_sync);
+        if (m_startNotified)
+        {
+            return;
+        }
+        m_startNotified = true;
         if (m_callback != nullptr)
         {
             m_callback->OnAcquisitionStarted(this);
         }
     }
 
+    float Acquisition::Progress(float requestProgress) const
+    {
+        if (m_resourceSize <= 0)
+        {
+            return requestProgress;
+        }
+
+        int64_t received = 0;
+        for (auto & segment : m_segments)
+        {
+            received += (segment->inFlight ? segment->stream->Position() : segment->position) - segment->start;
+        }
+        return static_cast<float>(received) / m_resourceSize;
+    }
+
     void Acquisition::OnRequestProgressed(INetRequest * request, float progress)
     {
+        std::unique_lock<std::mutex> locker(m_sync);
+        progress = this->Progress(progress);
+        locker.unlock();
+
         if (m_callback != nullptr)
         {
             m_callback->OnAcquisitionProgressed(this, progress);
@@ -163,52 +719,84 @@ namespace lcp
     void Acquisition::OnRequestCanceled(INetRequest * request)
     {
         std::unique_lock<std::mutex> locker(m_sync);
-        if (m_callback != nullptr)
+        Segment * segment = this->FindSegment(request);
+        if (segment != nullptr)
         {
-            m_callback->OnAcquisitionCanceled(this);
+            segment->inFlight = false;
+            segment->position = segment->stream->Position();
+            m_requestsCondition.notify_all();
         }
+
+        if (!m_ended && !m_canceled)
+        {
+            // Canceled by the net provider, the other segments follow
+            m_canceled = true;
+            this->CancelSegments();
+            this->StoreProgress();
+            this->EndTraceSpan(Status(StatusCode::ErrorCommonSuccess));
+        }
+        this->NotifyWhenDone();
     }
 
     void Acquisition::OnRequestEnded(INetRequest * request, Status result)
     {
         std::unique_lock<std::mutex> locker(m_sync);
+        std::vector<IDownloadRequest *> requests;
+        float progress = 0;
         try
         {
-            if (!Status::IsSuccess(result))
+            Segment * segment = this->FindSegment(request);
+            if (segment == nullptr || !segment->inFlight)
             {
-                if (m_callback != nullptr)
-                {
-                    m_callback->OnAcquisitionEnded(this, result);
-                }
                 return;
             }
+            segment->inFlight = false;
+            segment->position = segment->stream->Position();
+            m_requestsCondition.notify_all();
 
-            Status hashCheckResult = this->CheckPublicationHash(m_publicationLink);
-            if (!Status::IsSuccess(hashCheckResult))
+            // The progress was stored when canceling or failing
+            if (m_ended || m_canceled)
             {
-                if (m_callback != nullptr)
-                {
-                    m_callback->OnAcquisitionEnded(this, hashCheckResult);
-                }
+                this->NotifyWhenDone();
+                return;
+            }
+            if (!Status::IsSuccess(result))
+            {
+                this->EndAcquisition(result);
                 return;
             }
 
-            // Release the epub file to perform zip operations
-            m_file.reset();
-            std::stringstream licenseStream(m_license->OriginalContent());
-            ZipFile::AddFile(m_publicationPath, licenseStream, LcpLicensePath);
+            this->OnSegmentEnded(segment, segment->request.get());
 
-            if (m_callback != nullptr)
+            bool complete = std::all_of(m_segments.begin(), m_segments.end(),
+                [](const std::unique_ptr<Segment> & segment) { return segment->Complete(); });
+            if (complete)
             {
-                m_callback->OnAcquisitionEnded(this, Status(StatusCode::ErrorCommonSuccess));
+                this->Complete();
+                return;
             }
+            requests = this->StartSegments();
+            progress = this->Progress(0);
+        }
+        catch (const StatusException & ex)
+        {
+            this->EndAcquisition(ex.ResultStatus());
+            return;
         }
         catch (const std::exception & ex)
         {
-            if (m_callback != nullptr)
-            {
-                m_callback->OnAcquisitionEnded(this, Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed" + std::string(ex.what())));
-            }
+            this->EndAcquisition(Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed" + std::string(ex.what())));
+            return;
+        }
+        locker.unlock();
+
+        for (IDownloadRequest * nextRequest : requests)
+        {
+            m_netProvider->StartDownloadRequest(nextRequest, this);
+        }
+        if (m_callback != nullptr)
+        {
+            m_callback->OnAcquisitionProgressed(this, progress);
         }
     }
 }
@@ -30,21 +30,41 @@
 
 #if ENABLE_NET_PROVIDER_ACQUISITION
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <string>
 #include <mutex>
 #include <memory>
+#include <vector>
 #include "public/IAcquistion.h"
 #include "public/IAcquistionCallback.h"
 #include "public/INetProvider.h"
 #include "public/IFileSystemProvider.h"
 #include "public/ILinks.h"
+#include "LcpTypedefs.h"
 #include "NonCopyable.h"
 
 namespace lcp
 {
     class ILicense;
     class ICryptoProvider;
+    class BandwidthBudget;
+    class HashingWritableStream;
+    class SegmentWritableStream;
+    class DownloadInFileRequest;
+    class ITraceSink;
+    class Statistics;
+    class TraceSpan;
 
+    //
+    // Downloads the publication in segments of segmentSize bytes, several
+    // at once, when the net provider supports IRangeDownloadRequest. The
+    // segments received are recorded next to the publication, a later
+    // acquisition of the same publication only downloads what is missing.
+    // The end or the cancellation is notified once the net provider is done
+    // with every request, the publication is not written any more then.
+    //
     class Acquisition : public IAcquisition, public INetProviderCallback, public NonCopyable
     {
     public:
@@ -53,14 +73,48 @@ namespace lcp
             IFileSystemProvider * fileSystemProvider,
             INetProvider * netProvider,
             ICryptoProvider * cryptoProvider,
-            const std::string & publicationPath
+            const std::string & publicationPath,
+            int64_t segmentSize = DefaultSegmentSize
             );
+        ~Acquisition();
 
         virtual Status Start(IAcquisitionCallback * callback);
         virtual Status Cancel();
         virtual std::string PublicationPath() const;
         virtual std::string SuggestedFileName() const;
 
+        //
+        // Shares the given rate with other acquisitions, to be set before
+        // Start().
+        //
+        void SetBandwidthBudget(BandwidthBudget * budget);
+
+        //
+        // Reports the acquisition as a span, from Start() until it ends or
+        // is canceled. To be set before Start().
+        //
+        void SetTraceSink(ITraceSink * traceSink);
+
+        //
+        // Whether the net provider may still call back, once ended or
+        // canceled the acquisition can be destroyed when it returns false.
+        //
+        bool HasRequestsInFlight() const;
+
+        //
+        // Blocks until the net provider is done with the requests of the
+        // acquisition, which must be ended or canceled.
+        //
+        void WaitForRequests();
+
+        //
+        // Whether a canceled acquisition leaves a progress the next
+        // acquisition of the publication resumes from, ie. the server
+        // honours ranges. Does not take the acquisition lock, the progress
+        // is notified when each segment ends, which is when it turns true.
+        //
+        bool Resumable() const;
+
     public:
         // INetProviderCallback
         virtual void OnRequestStarted(INetRequest * request);
@@ -70,22 +124,87 @@ namespace lcp
 
     public:
         static const char * PublicationType;
+        static const int64_t DefaultSegmentSize;
+        static const size_t MaxSegmentsInFlight;
 
     private:
+        struct Segment
+        {
+            Segment(int64_t start, int64_t end);
+            ~Segment();
+            bool Complete() const;
+
+            int64_t start;
+            // -1 as long as the size of the publication is unknown
+            int64_t end;
+            // Following the last byte received, updated when a request ends
+            int64_t position;
+            bool inFlight;
+            std::unique_ptr<SegmentWritableStream> stream;
+            std::unique_ptr<DownloadInFileRequest> request;
+        };
+
+        static const char * ProgressMagic;
+        static const char * ProgressExtension;
+        static const char * ProgressHashKeyword;
+
+    private:
+        std::vector<IDownloadRequest *> StartSegments();
+        Segment * FindSegment(INetRequest * request) const;
+        void OnSegmentEnded(Segment * segment, IRangeDownloadRequest * request);
+        void SplitInSegments(Segment * firstSegment, int64_t resourceSize);
+        int64_t ReceivedPrefixEnd() const;
+        bool AnySegmentInFlight() const;
+        float Progress(float requestProgress) const;
+        void CancelSegments();
+        void NotifyWhenDone();
+        void EndAcquisition(Status result);
+        void Complete();
+        void EndTraceSpan(const Status & result);
         Status CheckPublicationHash(const Link & link);
 
+        std::string ProgressPath() const;
+        bool LoadProgress();
+        void StoreProgress();
+        void RemoveProgress();
+
     private:
         ILicense * m_license;
         IFileSystemProvider * m_fileSystemProvider;
         INetProvider * m_netProvider;
         ICryptoProvider * m_cryptoProvider;
         std::string m_publicationPath;
+        int64_t m_segmentSize;
 
         mutable std::mutex m_sync;
         Link m_publicationLink;
         IAcquisitionCallback * m_callback;
         std::unique_ptr<IFile> m_file;
-        std::unique_ptr<IDownloadRequest> m_request;
+        std::unique_ptr<HashingWritableStream> m_hashingStream;
+        IWritableStream * m_destination;
+        std::mutex m_fileSync;
+        BandwidthBudget * m_bandwidthBudget;
+
+        std::vector<std::unique_ptr<Segment>> m_segments;
+        int64_t m_resourceSize;
+        std::atomic<bool> m_resumable;
+        std::string m_validator;
+        // Hash of the beginning of the publication, saved with the progress
+        int64_t m_savedHashSize;
+        Buffer m_savedHashState;
+        bool m_startNotified;
+        bool m_canceled;
+        bool m_ended;
+        // The end or the cancellation, notified once no request is in flight
+        bool m_notified;
+        Status m_result;
+        std::condition_variable m_requestsCondition;
+        std::chrono::steady_clock::time_point m_startTime;
+        ITraceSink * m_traceSink;
+        std::unique_ptr<TraceSpan> m_traceSpan;
+        // Current when the acquisition is created, since the net provider
+        // calls back on its own threads
+        Statistics * m_statistics;
     };
 }
 
@@ -0,0 +1,503 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#if ENABLE_NET_PROVIDER_ACQUISITION
+
+#include <algorithm>
+#include "AcquisitionManager.h"
+#include "Acquisition.h"
+#include "Statistics.h"
+
+namespace lcp
+{
+    AcquisitionManager::Entry::Entry(AcquisitionManager * manager, ILicense * license, const std::string & path, Priority priority, uint64_t sequence)
+        : manager(manager)
+        , license(license)
+        , path(path)
+        , priority(priority)
+        , sequence(sequence)
+        , state(Queued)
+        , progress(0)
+        , startNotified(false)
+    {
+    }
+
+    void AcquisitionManager::Entry::OnAcquisitionStarted(IAcquisition * acquisition)
+    {
+        manager->OnStarted(this, acquisition);
+    }
+
+    void AcquisitionManager::Entry::OnAcquisitionProgressed(IAcquisition * acquisition, float progress)
+    {
+        manager->OnProgressed(this, acquisition, progress);
+    }
+
+    void AcquisitionManager::Entry::OnAcquisitionCanceled(IAcquisition * acquisition)
+    {
+        manager->OnFinished(this, acquisition, true, Status(StatusCode::ErrorCommonSuccess));
+    }
+
+    void AcquisitionManager::Entry::OnAcquisitionEnded(IAcquisition * acquisition, Status result)
+    {
+        manager->OnFinished(this, acquisition, false, result);
+    }
+
+    AcquisitionManager::AcquisitionManager(
+        IFileSystemProvider * fileSystemProvider,
+        INetProvider * netProvider,
+        ICryptoProvider * cryptoProvider,
+        size_t maxConcurrentAcquisitions,
+        IAcquisitionManagerCallback * callback,
+        ITraceSink * traceSink,
+        int64_t segmentSize
+        )
+        : m_fileSystemProvider(fileSystemProvider)
+        , m_netProvider(netProvider)
+        , m_cryptoProvider(cryptoProvider)
+        , m_maxConcurrentAcquisitions(std::max<size_t>(maxConcurrentAcquisitions, 1))
+        , m_callback(callback)
+        , m_traceSink(traceSink)
+        , m_statistics(Statistics::Current())
+        , m_segmentSize(segmentSize)
+        , m_nextSequence(0)
+        , m_closing(false)
+    {
+    }
+
+    AcquisitionManager::~AcquisitionManager()
+    {
+        // The net provider holds the requests of the acquisitions, which
+        // call back through the entries and the manager: nothing starts any
+        // more, and each acquisition is awaited before being destroyed
+        std::vector<std::shared_ptr<Acquisition>> running;
+        std::vector<Retired> retired;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_closing = true;
+            for (auto & item : m_entries)
+            {
+                if (item.second->state == Running)
+                {
+                    running.push_back(item.second->acquisition);
+                }
+            }
+            retired = m_retired;
+        }
+        for (auto & acquisition : running)
+        {
+            acquisition->Cancel();
+        }
+        for (auto & acquisition : running)
+        {
+            acquisition->WaitForRequests();
+        }
+        for (auto & item : retired)
+        {
+            item.acquisition->WaitForRequests();
+        }
+    }
+
+    Status AcquisitionManager::Enqueue(
+        ILicense * license,
+        const std::string & publicationPath,
+        Priority priority,
+        IAcquisitionCallback * callback
+        )
+    {
+        this->ReleaseRetired();
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            auto found = m_entries.find(publicationPath);
+            if (found != m_entries.end() && found->second->state != Ended)
+            {
+                // Same publication path, the callback joins the acquisition
+                // already queued or running
+                Entry * entry = found->second.get();
+                if (callback != nullptr && std::find(entry->callbacks.begin(), entry->callbacks.end(), callback) == entry->callbacks.end())
+                {
+                    entry->callbacks.push_back(callback);
+                }
+                entry->priority = std::max(entry->priority, priority);
+            }
+            else
+            {
+                std::shared_ptr<Entry> entry = std::make_shared<Entry>(this, license, publicationPath, priority, m_nextSequence++);
+                if (callback != nullptr)
+                {
+                    entry->callbacks.push_back(callback);
+                }
+                entry->acquisition = this->CreateAcquisition(entry.get());
+                m_entries[publicationPath] = entry;
+            }
+        }
+        this->Pump();
+        return Status(StatusCode::ErrorCommonSuccess);
+    }
+
+    Status AcquisitionManager::SetPriority(const std::string & publicationPath, Priority priority)
+    {
+        this->ReleaseRetired();
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            auto found = m_entries.find(publicationPath);
+            if (found == m_entries.end() || found->second->state == Ended)
+            {
+                return Status(StatusCode::ErrorNetworkingRequestNotFound, "ErrorNetworkingRequestNotFound");
+            }
+            found->second->priority = priority;
+        }
+        this->Pump();
+        return Status(StatusCode::ErrorCommonSuccess);
+    }
+
+    Status AcquisitionManager::Cancel(const std::string & publicationPath)
+    {
+        this->ReleaseRetired();
+        std::shared_ptr<Entry> entry;
+        std::shared_ptr<Acquisition> acquisition;
+        State state = Ended;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            auto found = m_entries.find(publicationPath);
+            if (found == m_entries.end() || found->second->state == Ended)
+            {
+                return Status(StatusCode::ErrorNetworkingRequestNotFound, "ErrorNetworkingRequestNotFound");
+            }
+            entry = found->second;
+            acquisition = entry->acquisition;
+            state = entry->state;
+        }
+
+        if (state == Queued)
+        {
+            this->OnFinished(entry.get(), acquisition.get(), true, Status(StatusCode::ErrorCommonSuccess));
+        }
+        else
+        {
+            // Notified when the net provider is done
+            acquisition->Cancel();
+        }
+        return Status(StatusCode::ErrorCommonSuccess);
+    }
+
+    void AcquisitionManager::SetBandwidthBudget(int64_t bytesPerSecond)
+    {
+        m_bandwidthBudget.SetBytesPerSecond(bytesPerSecond);
+    }
+
+    std::shared_ptr<Acquisition> AcquisitionManager::CreateAcquisition(Entry * entry)
+    {
+        Statistics::Scope statisticsScope(m_statistics);
+        std::shared_ptr<Acquisition> acquisition = std::make_shared<Acquisition>(
+            entry->license,
+            m_fileSystemProvider,
+            m_netProvider,
+            m_cryptoProvider,
+            entry->path,
+            m_segmentSize
+            );
+        acquisition->SetBandwidthBudget(&m_bandwidthBudget);
+        acquisition->SetTraceSink(m_traceSink);
+        return acquisition;
+    }
+
+    void AcquisitionManager::Pump()
+    {
+        StartsList starts;
+        std::vector<std::shared_ptr<Acquisition>> pauses;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            while (this->NextDecision(starts, pauses))
+            {
+            }
+        }
+
+        for (auto & acquisition : pauses)
+        {
+            acquisition->Cancel();
+        }
+        for (auto & start : starts)
+        {
+            Status result = start.second->Start(start.first.get());
+            if (!Status::IsSuccess(result))
+            {
+                this->OnFinished(start.first.get(), start.second.get(), false, result);
+            }
+        }
+    }
+
+    bool AcquisitionManager::NextDecision(StartsList & starts, std::vector<std::shared_ptr<Acquisition>> & pauses)
+    {
+        if (m_closing)
+        {
+            return false;
+        }
+
+        std::shared_ptr<Entry> next;
+        std::shared_ptr<Entry> lowest;
+        size_t runningCount = 0;
+        for (auto & item : m_entries)
+        {
+            const std::shared_ptr<Entry> & entry = item.second;
+            if (entry->state == Queued && !entry->paused)
+            {
+                if (!next || entry->priority > next->priority
+                    || (entry->priority == next->priority && entry->sequence < next->sequence))
+                {
+                    next = entry;
+                }
+            }
+            else if (entry->state == Running)
+            {
+                ++runningCount;
+                // Pausing one which can not resume would throw away what
+                // it downloaded
+                if (!entry->acquisition->Resumable())
+                {
+                    continue;
+                }
+                if (!lowest || entry->priority < lowest->priority
+                    || (entry->priority == lowest->priority && entry->sequence > lowest->sequence))
+                {
+                    lowest = entry;
+                }
+            }
+        }
+
+        if (!next)
+        {
+            return false;
+        }
+        if (runningCount >= m_maxConcurrentAcquisitions)
+        {
+            if (!lowest || lowest->priority >= next->priority)
+            {
+                return false;
+            }
+
+            // The paused acquisition stores its progress, the one replacing
+            // it resumes from there once the net provider is done with it
+            pauses.push_back(lowest->acquisition);
+            this->Retire(lowest);
+            lowest->paused = lowest->acquisition;
+            lowest->acquisition = this->CreateAcquisition(lowest.get());
+            lowest->state = Queued;
+        }
+
+        next->state = Running;
+        starts.push_back(std::make_pair(next, next->acquisition));
+        return true;
+    }
+
+    void AcquisitionManager::Retire(const std::shared_ptr<Entry> & entry)
+    {
+        Retired retired = { entry, entry->acquisition };
+        m_retired.push_back(retired);
+    }
+
+    void AcquisitionManager::ReleaseRetired()
+    {
+        std::vector<Retired> retired;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            retired.swap(m_retired);
+        }
+
+        // Asking outside the lock, the acquisitions call back with theirs
+        std::vector<Retired> busy;
+        for (auto & item : retired)
+        {
+            if (item.acquisition->HasRequestsInFlight())
+            {
+                busy.push_back(item);
+            }
+        }
+        retired.clear();
+
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_retired.insert(m_retired.end(), busy.begin(), busy.end());
+    }
+
+    float AcquisitionManager::QueueProgress() const
+    {
+        if (m_entries.empty())
+        {
+            return 1;
+        }
+
+        float progress = 0;
+        for (auto & item : m_entries)
+        {
+            progress += item.second->progress;
+        }
+        return progress / m_entries.size();
+    }
+
+    bool AcquisitionManager::IsIdle() const
+    {
+        return std::none_of(m_entries.begin(), m_entries.end(),
+            [](const std::pair<const std::string, std::shared_ptr<Entry>> & item) { return item.second->state != Ended; });
+    }
+
+    void AcquisitionManager::OnStarted(Entry * entry, IAcquisition * acquisition)
+    {
+        std::vector<IAcquisitionCallback *> callbacks;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            if (entry->acquisition.get() != acquisition || entry->startNotified)
+            {
+                return;
+            }
+            entry->startNotified = true;
+            callbacks = entry->callbacks;
+        }
+
+        for (IAcquisitionCallback * callback : callbacks)
+        {
+            callback->OnAcquisitionStarted(acquisition);
+        }
+    }
+
+    void AcquisitionManager::OnProgressed(Entry * entry, IAcquisition * acquisition, float progress)
+    {
+        std::vector<IAcquisitionCallback *> callbacks;
+        float queueProgress = 0;
+        bool preempted = false;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            if (entry->acquisition.get() != acquisition || entry->state != Running)
+            {
+                return;
+            }
+            entry->progress = progress;
+            queueProgress = this->QueueProgress();
+            callbacks = entry->callbacks;
+
+            // A higher priority waits for this acquisition to become resumable
+            // before pausing it
+            preempted = !m_closing && entry->acquisition->Resumable()
+                && std::any_of(m_entries.begin(), m_entries.end(),
+                    [entry](const std::pair<const std::string, std::shared_ptr<Entry>> & item) {
+                        return item.second->state == Queued && !item.second->paused && item.second->priority > entry->priority;
+                    });
+        }
+
+        for (IAcquisitionCallback * callback : callbacks)
+        {
+            callback->OnAcquisitionProgressed(acquisition, progress);
+        }
+        if (m_callback != nullptr)
+        {
+            m_callback->OnQueueProgressed(this, queueProgress);
+        }
+        if (preempted)
+        {
+            this->Pump();
+        }
+    }
+
+    void AcquisitionManager::OnFinished(Entry * entry, IAcquisition * acquisition, bool canceled, Status result)
+    {
+        std::vector<IAcquisitionCallback *> callbacks;
+        float queueProgress = 0;
+        bool idle = false;
+        bool closing = false;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            closing = m_closing;
+            if (entry->paused.get() == acquisition)
+            {
+                std::shared_ptr<Acquisition> paused;
+                paused.swap(entry->paused);
+                if (canceled || entry->state != Queued)
+                {
+                    // The paused acquisition is done, its entry can start again
+                    locker.unlock();
+                    if (!closing)
+                    {
+                        this->Pump();
+                    }
+                    return;
+                }
+
+                // Ended before the pause reached it, nothing is left to resume
+                entry->acquisition = paused;
+            }
+
+            auto found = m_entries.find(entry->path);
+            if (found == m_entries.end() || found->second.get() != entry
+                || entry->acquisition.get() != acquisition || entry->state == Ended)
+            {
+                // A paused acquisition, or an entry already canceled
+                return;
+            }
+
+            entry->state = Ended;
+            entry->progress = 1;
+            this->Retire(found->second);
+            callbacks = entry->callbacks;
+            queueProgress = this->QueueProgress();
+
+            idle = this->IsIdle();
+            if (idle)
+            {
+                // The next acquisitions start a new batch for the progress
+                m_entries.clear();
+            }
+        }
+
+        for (IAcquisitionCallback * callback : callbacks)
+        {
+            if (canceled)
+            {
+                callback->OnAcquisitionCanceled(acquisition);
+            }
+            else
+            {
+                callback->OnAcquisitionEnded(acquisition, result);
+            }
+        }
+        if (m_callback != nullptr)
+        {
+            m_callback->OnQueueProgressed(this, queueProgress);
+        }
+
+        if (idle)
+        {
+            if (m_callback != nullptr)
+            {
+                m_callback->OnQueueIdle(this);
+            }
+        }
+        else if (!closing)
+        {
+            this->Pump();
+        }
+    }
+}
+
+#endif //ENABLE_NET_PROVIDER_ACQUISITION
@@ -0,0 +1,169 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __LCP_ACQUISITION_MANAGER_H__
+#define __LCP_ACQUISITION_MANAGER_H__
+
+#if ENABLE_NET_PROVIDER_ACQUISITION
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "public/IAcquisitionManager.h"
+#include "public/IAcquistionCallback.h"
+#include "public/IFileSystemProvider.h"
+#include "public/INetProvider.h"
+#include "Acquisition.h"
+#include "BandwidthBudget.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class ICryptoProvider;
+    class ITraceSink;
+    class Statistics;
+
+    //
+    // Decisions are taken under the manager lock, acquisitions are started,
+    // canceled and observed outside of it: they call back with their own
+    // lock held.
+    // Only the acquisitions which can resume are paused for a higher
+    // priority, and their entry waits for the net provider to be done with
+    // them before starting again.
+    // Destroying the manager cancels the running acquisitions and blocks
+    // until the net provider is done with every acquisition.
+    //
+    class AcquisitionManager : public IAcquisitionManager, public NonCopyable
+    {
+    public:
+        AcquisitionManager(
+            IFileSystemProvider * fileSystemProvider,
+            INetProvider * netProvider,
+            ICryptoProvider * cryptoProvider,
+            size_t maxConcurrentAcquisitions,
+            IAcquisitionManagerCallback * callback,
+            ITraceSink * traceSink = nullptr,
+            int64_t segmentSize = Acquisition::DefaultSegmentSize
+            );
+        ~AcquisitionManager();
+
+        virtual Status Enqueue(
+            ILicense * license,
+            const std::string & publicationPath,
+            Priority priority,
+            IAcquisitionCallback * callback
+            );
+        virtual Status SetPriority(const std::string & publicationPath, Priority priority);
+        virtual Status Cancel(const std::string & publicationPath);
+        virtual void SetBandwidthBudget(int64_t bytesPerSecond);
+
+    private:
+        enum State
+        {
+            Queued,
+            Running,
+            Ended,
+        };
+
+        //
+        // A publication path and the callbacks interested in it. Receives
+        // the callbacks of its acquisitions, including the paused ones.
+        //
+        struct Entry : public IAcquisitionCallback
+        {
+            Entry(AcquisitionManager * manager, ILicense * license, const std::string & path, Priority priority, uint64_t sequence);
+
+            virtual void OnAcquisitionStarted(IAcquisition * acquisition);
+            virtual void OnAcquisitionProgressed(IAcquisition * acquisition, float progress);
+            virtual void OnAcquisitionCanceled(IAcquisition * acquisition);
+            virtual void OnAcquisitionEnded(IAcquisition * acquisition, Status result);
+
+            AcquisitionManager * manager;
+            ILicense * license;
+            std::string path;
+            Priority priority;
+            uint64_t sequence;
+            State state;
+            float progress;
+            bool startNotified;
+            std::vector<IAcquisitionCallback *> callbacks;
+            std::shared_ptr<Acquisition> acquisition;
+            // Still writing the publication after a pause
+            std::shared_ptr<Acquisition> paused;
+        };
+
+        //
+        // An acquisition which is not current any more, kept until the net
+        // provider is done with it.
+        //
+        struct Retired
+        {
+            std::shared_ptr<Entry> entry;
+            std::shared_ptr<Acquisition> acquisition;
+        };
+
+        typedef std::vector<std::pair<std::shared_ptr<Entry>, std::shared_ptr<Acquisition>>> StartsList;
+
+    private:
+        std::shared_ptr<Acquisition> CreateAcquisition(Entry * entry);
+        void Pump();
+        bool NextDecision(StartsList & starts, std::vector<std::shared_ptr<Acquisition>> & pauses);
+        void Retire(const std::shared_ptr<Entry> & entry);
+        void ReleaseRetired();
+        float QueueProgress() const;
+        bool IsIdle() const;
+
+        void OnStarted(Entry * entry, IAcquisition * acquisition);
+        void OnProgressed(Entry * entry, IAcquisition * acquisition, float progress);
+        void OnFinished(Entry * entry, IAcquisition * acquisition, bool canceled, Status result);
+
+    private:
+        IFileSystemProvider * m_fileSystemProvider;
+        INetProvider * m_netProvider;
+        ICryptoProvider * m_cryptoProvider;
+        size_t m_maxConcurrentAcquisitions;
+        IAcquisitionManagerCallback * m_callback;
+        ITraceSink * m_traceSink;
+        // Current when the manager is created, for the acquisitions it
+        // creates on the threads of the client and of the net provider
+        Statistics * m_statistics;
+        int64_t m_segmentSize;
+        BandwidthBudget m_bandwidthBudget;
+
+        mutable std::mutex m_sync;
+        std::map<std::string, std::shared_ptr<Entry>> m_entries;
+        std::vector<Retired> m_retired;
+        uint64_t m_nextSequence;
+        bool m_closing;
+    };
+}
+
+#endif //ENABLE_NET_PROVIDER_ACQUISITION
+
+#endif //__LCP_ACQUISITION_MANAGER_H__
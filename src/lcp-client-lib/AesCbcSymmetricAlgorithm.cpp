@@ -26,8 +26,11 @@
 
 #include "AesCbcSymmetricAlgorithm.h"
 #include "AlgorithmNames.h"
+#include "CryptoppEncryptor.h"
 #include "CryptoppUtils.h"
 #include "IDecryptionContext.h"
+#include "SecureBuffer.h"
+#include "Statistics.h"
 #include "public/StreamInterfaces.h"
 
 namespace lcp
@@ -36,11 +39,12 @@ namespace lcp
         const KeyType & key,
         KeySize keySize
         )
-        : m_key(key)
-        , m_keySize(keySize)
+        : m_keySize(keySize)
     {
-        KeyType emptyIv(CryptoPP::AES::BLOCKSIZE);
-        m_decryptor.SetKeyWithIV(&key.at(0), key.size(), &emptyIv.at(0));
+        // The key schedule is kept by the decryptor, each decryption only
+        // resynchronizes it with its IV
+        unsigned char emptyIv[CryptoPP::AES::BLOCKSIZE] = {};
+        m_decryptor.SetKeyWithIV(&key.at(0), key.size(), emptyIv);
     }
 
     std::string AesCbcSymmetricAlgorithm::Name() const
@@ -62,14 +66,14 @@ namespace lcp
         const std::string & encryptedDataBase64
         )
     {
-        CryptoPP::SecByteBlock rawData;
-        CryptoppUtils::Base64ToSecBlock(encryptedDataBase64, rawData);
+        SecureBuffer rawData;
+        CryptoppUtils::Base64ToSecureBuffer(encryptedDataBase64, rawData);
 
-        const unsigned char * cipherData = rawData.data();
-        size_t cipherSize = rawData.size();
+        const unsigned char * cipherData = rawData.Data();
+        size_t cipherSize = rawData.Size();
 
-        KeyType iv = this->BuildIV(rawData.data(), rawData.size(), &cipherData, &cipherSize);
-        m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0));
+        const unsigned char * iv = this->BuildIV(rawData.Data(), rawData.Size(), &cipherData, &cipherSize);
+        m_decryptor.Resynchronize(iv);
 
 
         std::string decryptedDataStr;
@@ -92,17 +96,20 @@ namespace lcp
         size_t decryptedDataLength
         )
     {
-        return this->InnerDecrypt(
+        size_t decryptedSize = this->InnerDecrypt(
             data,
             dataLength,
             decryptedData,
             decryptedDataLength,
             BlockPaddingSchemeDef::W3C_PADDING // Note that handling of W3C padding scheme during decryption also handles PKCS#7 (which is BlockPaddingSchemeDef::PKCS_PADDING in CryptoPP, with AES CBC Block Size > 8 (not PKCS#5))
             );
+        Statistics::Increment(StatisticsCounter::BytesDecryptedAesCbc, decryptedSize);
+        return decryptedSize;
     }
 
     size_t AesCbcSymmetricAlgorithm::PlainTextSize(IReadableStream * stream)
     {
+        Statistics::Increment(StatisticsCounter::PlainTextSizeCalls);
         if (stream->Size() < CryptoPP::AES::BLOCKSIZE + CryptoPP::AES::BLOCKSIZE)
         {
             throw std::out_of_range("Invalid encrypted file, size is out of range");
@@ -110,21 +117,29 @@ namespace lcp
 
         size_t readPosition = static_cast<size_t>(stream->Size()) - (CryptoPP::AES::BLOCKSIZE + CryptoPP::AES::BLOCKSIZE);
         stream->SetReadPosition(readPosition);
-        std::vector<unsigned char> inBuffer(CryptoPP::AES::BLOCKSIZE + CryptoPP::AES::BLOCKSIZE);
-        std::vector<unsigned char> outBuffer(inBuffer.size());
-        stream->Read(&inBuffer.at(0), inBuffer.size());
+        SecureBuffer inBuffer(CryptoPP::AES::BLOCKSIZE + CryptoPP::AES::BLOCKSIZE);
+        SecureBuffer outBuffer(inBuffer.Size());
+        stream->Read(inBuffer.Data(), inBuffer.Size());
 
         size_t outSize = this->InnerDecrypt(
-            &inBuffer.at(0),
-            inBuffer.size(),
-            &outBuffer.at(0),
-            outBuffer.size(),
+            inBuffer.Data(),
+            inBuffer.Size(),
+            outBuffer.Data(),
+            outBuffer.Size(),
             BlockPaddingSchemeDef::W3C_PADDING // Note that handling of W3C padding scheme during decryption also handles PKCS#7 (which is BlockPaddingSchemeDef::PKCS_PADDING in CryptoPP, with AES CBC Block Size > 8 (not PKCS#5))
             );
 
         return static_cast<size_t>(stream->Size())
             - CryptoPP::AES::BLOCKSIZE // minus IV or previous block
-            - (CryptoPP::AES::BLOCKSIZE - outSize) % CryptoPP::AES::BLOCKSIZE; // minus padding part
+            - (CryptoPP::AES::BLOCKSIZE - outSize); // minus padding part, a whole block for aligned plain texts
+    }
+
+    IEncryptor * AesCbcSymmetricAlgorithm::CreateEncryptor(const KeyType & key, IWritableStream * output)
+    {
+        // PKCS #7 padding, as removed by the decryption
+        return new CryptoppEncryptor<CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption, CryptoPP::StreamTransformationFilter>(
+            key, CryptoPP::AES::BLOCKSIZE, output, StatisticsCounter::BytesEncryptedAesCbc
+            );
     }
 
     void AesCbcSymmetricAlgorithm::Decrypt(
@@ -140,6 +155,7 @@ namespace lcp
         {
             throw std::out_of_range("params to decrypt out of range");
         }
+        Statistics::Increment(StatisticsCounter::BytesDecryptedAesCbc, rangeInfo.length);
 
         // Get offset result offset in the block
         size_t blockOffset = rangeInfo.position % CryptoPP::AES::BLOCKSIZE;
@@ -176,30 +192,29 @@ namespace lcp
 
         // Read data from the stream
         stream->SetReadPosition(readPosition);
-        std::vector<unsigned char> inBuffer(blocksCount * CryptoPP::AES::BLOCKSIZE);
-        std::vector<unsigned char> outBuffer(inBuffer.size());
-        if (readPosition + inBuffer.size() > stream->Size())
+        SecureBuffer inBuffer(blocksCount * CryptoPP::AES::BLOCKSIZE);
+        SecureBuffer outBuffer(inBuffer.Size());
+        if (readPosition + inBuffer.Size() > stream->Size())
         {
             throw std::out_of_range("encrypted stream is out of range");
         }
-        stream->Read(&inBuffer.at(0), inBuffer.size());
+        stream->Read(inBuffer.Data(), inBuffer.Size());
 
         // Decrypt and copy necessary data
         size_t outSize = this->InnerDecrypt(
-            &inBuffer.at(0),
-            inBuffer.size(),
-            &outBuffer.at(0),
-            outBuffer.size(),
+            inBuffer.Data(),
+            inBuffer.Size(),
+            outBuffer.Data(),
+            outBuffer.Size(),
             padding
             );
 
-        if (outSize < rangeInfo.length)
+        if (outSize < blockOffset + rangeInfo.length)
         {
             throw std::out_of_range("range length is out of range");
         }
 
-        outBuffer.resize(outSize);
-        memcpy_s(decryptedData, decryptedDataLength, &outBuffer.at(blockOffset), rangeInfo.length);
+        memcpy_s(decryptedData, decryptedDataLength, outBuffer.Data() + blockOffset, rangeInfo.length);
     }
 
     size_t AesCbcSymmetricAlgorithm::InnerDecrypt(
@@ -213,8 +228,8 @@ namespace lcp
         const unsigned char * cipherData = data;
         size_t cipherSize = dataLength;
 
-        KeyType iv = this->BuildIV(data, dataLength, &cipherData, &cipherSize);
-        m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0));
+        const unsigned char * iv = this->BuildIV(data, dataLength, &cipherData, &cipherSize);
+        m_decryptor.Resynchronize(iv);
 
         CryptoPP::StreamTransformationFilter filter(m_decryptor, NULL, padding);
         filter.Put(cipherData, cipherSize);
@@ -231,7 +246,7 @@ namespace lcp
         return resultSize;
     }
 
-    KeyType AesCbcSymmetricAlgorithm::BuildIV(
+    const unsigned char * AesCbcSymmetricAlgorithm::BuildIV(
         const unsigned char * data,
         size_t dataLength,
         const unsigned char ** cipherData,
@@ -240,18 +255,16 @@ namespace lcp
     {
         // Length of block equals to length of IV
         size_t blockAndIvSize = CryptoPP::AES::BLOCKSIZE;
-        KeyType iv;
-        iv.resize(blockAndIvSize);
 
         if (dataLength < blockAndIvSize + blockAndIvSize)
         {
             throw std::invalid_argument("input data to decrypt is too small");
         }
 
-        iv.assign(data, data + blockAndIvSize);
+        // The IV prefixes the cipher text, it is used in place
         *cipherData = data + blockAndIvSize;
         *cipherSize = dataLength - blockAndIvSize;
 
-        return iv;
+        return data;
     }
 }
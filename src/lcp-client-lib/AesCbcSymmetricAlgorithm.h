@@ -79,6 +79,8 @@ namespace lcp
 
         size_t PlainTextSize(IReadableStream * stream);
 
+        virtual IEncryptor * CreateEncryptor(const KeyType & key, IWritableStream * output);
+
     private:
         size_t InnerDecrypt(
             const unsigned char * data,
@@ -88,7 +90,7 @@ namespace lcp
             CryptoPP::BlockPaddingSchemeDef::BlockPaddingScheme padding
             );
 
-        KeyType BuildIV(
+        const unsigned char * BuildIV(
             const unsigned char * data,
             size_t dataLength,
             const unsigned char ** cipherData,
@@ -97,7 +99,6 @@ namespace lcp
 
     private:
         KeySize m_keySize;
-        KeyType m_key;
         CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption m_decryptor;
     };
 }
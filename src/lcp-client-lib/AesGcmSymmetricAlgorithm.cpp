@@ -24,12 +24,83 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 #include "AesGcmSymmetricAlgorithm.h"
 #include "AlgorithmNames.h"
+#include "CryptoppEncryptor.h"
 #include "CryptoppUtils.h"
 #include "IDecryptionContext.h"
+#include "SecureBuffer.h"
+#include "Statistics.h"
 #include "public/StreamInterfaces.h"
 
+namespace
+{
+    using namespace lcp;
+
+    //
+    // Decrypts a GCM message given in chunks: the IV is taken from its
+    // first bytes, the authentication filter holds back the tag at its
+    // end and checks it when the message ends.
+    //
+    class GcmDecryptor : public IDecryptor, public NonCopyable
+    {
+    public:
+        GcmDecryptor(CryptoPP::GCM<CryptoPP::AES>::Decryption & decryption, IWritableStream * output)
+            : m_decryption(decryption)
+            , m_output(output)
+            , m_cipherSize(0)
+        {
+        }
+
+        virtual void Update(const unsigned char * data, size_t dataLength)
+        {
+            if (m_filter == nullptr)
+            {
+                size_t ivSize = m_decryption.IVSize();
+                size_t count = std::min(ivSize - m_iv.size(), dataLength);
+                m_iv.insert(m_iv.end(), data, data + count);
+                data += count;
+                dataLength -= count;
+                if (m_iv.size() < ivSize)
+                {
+                    return;
+                }
+
+                m_decryption.Resynchronize(m_iv.data(), static_cast<int>(ivSize));
+                m_filter.reset(new CryptoPP::AuthenticatedDecryptionFilter(
+                    m_decryption,
+                    new WritableStreamSink(m_output),
+                    CryptoPP::AuthenticatedDecryptionFilter::MAC_AT_END | CryptoPP::AuthenticatedDecryptionFilter::THROW_EXCEPTION,
+                    static_cast<int>(m_decryption.DigestSize())
+                    ));
+            }
+            m_filter->Put(data, dataLength);
+            m_cipherSize += dataLength;
+        }
+
+        virtual void Finish()
+        {
+            if (m_filter == nullptr || m_cipherSize < m_decryption.DigestSize())
+            {
+                throw std::runtime_error("The encrypted data is truncated");
+            }
+            m_filter->MessageEnd();
+            Statistics::Increment(StatisticsCounter::BytesDecryptedAesGcm, m_cipherSize - m_decryption.DigestSize());
+        }
+
+    private:
+        CryptoPP::GCM<CryptoPP::AES>::Decryption & m_decryption;
+        IWritableStream * m_output;
+        std::vector<unsigned char> m_iv;
+        std::unique_ptr<CryptoPP::AuthenticatedDecryptionFilter> m_filter;
+        size_t m_cipherSize;
+    };
+}
+
 namespace lcp
 {
     // https://www.cryptopp.com/wiki/GCM_Mode
@@ -38,11 +109,12 @@ namespace lcp
         const KeyType & key,
         KeySize keySize
         )
-        : m_key(key)
-        , m_keySize(keySize)
+        : m_keySize(keySize)
     {
-        KeyType emptyIv(m_decryptor.IVSize()); // 12
-        m_decryptor.SetKeyWithIV(&key.at(0), key.size(), &emptyIv.at(0), emptyIv.size());
+        // The key schedule is kept by the decryptor, each decryption only
+        // resynchronizes it with its IV
+        unsigned char emptyIv[CryptoPP::AES::BLOCKSIZE] = {};
+        m_decryptor.SetKeyWithIV(&key.at(0), key.size(), emptyIv, m_decryptor.IVSize()); // 12
     }
 
     std::string AesGcmSymmetricAlgorithm::Name() const
@@ -64,14 +136,14 @@ namespace lcp
         const std::string & encryptedDataBase64
         )
     {
-        CryptoPP::SecByteBlock rawData;
-        CryptoppUtils::Base64ToSecBlock(encryptedDataBase64, rawData);
+        SecureBuffer rawData;
+        CryptoppUtils::Base64ToSecureBuffer(encryptedDataBase64, rawData);
 
-        const unsigned char * cipherData = rawData.data();
-        size_t cipherSize = rawData.size();
+        const unsigned char * cipherData = rawData.Data();
+        size_t cipherSize = rawData.Size();
 
-        KeyType iv = this->BuildIV(rawData.data(), rawData.size(), &cipherData, &cipherSize);
-        m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0), iv.size());
+        const unsigned char * iv = this->BuildIV(rawData.Data(), rawData.Size(), &cipherData, &cipherSize);
+        m_decryptor.Resynchronize(iv, static_cast<int>(m_decryptor.IVSize()));
 
 
         std::string decryptedDataStr;
@@ -103,20 +175,23 @@ namespace lcp
         const unsigned char * cipherData = data;
         size_t cipherSize = dataLength;
 
-        KeyType iv = this->BuildIV(data, dataLength, &cipherData, &cipherSize);
-        m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0), iv.size());
+        const unsigned char * iv = this->BuildIV(data, dataLength, &cipherData, &cipherSize);
+        m_decryptor.Resynchronize(iv, static_cast<int>(m_decryptor.IVSize()));
 
-        return this->InnerDecrypt(
+        size_t decryptedSize = this->InnerDecrypt(
                 cipherData,
                 cipherSize,
             decryptedData,
             decryptedDataLength,
             true
             );
+        Statistics::Increment(StatisticsCounter::BytesDecryptedAesGcm, decryptedSize);
+        return decryptedSize;
     }
 
     size_t AesGcmSymmetricAlgorithm::PlainTextSize(IReadableStream * stream)
     {
+        Statistics::Increment(StatisticsCounter::PlainTextSizeCalls);
         return static_cast<size_t>(stream->Size())
             - m_decryptor.IVSize()
             // Nonce-IV (prefix)
@@ -127,6 +202,19 @@ namespace lcp
             // m_decryptor.DigestSize() == 16
     }
 
+    IEncryptor * AesGcmSymmetricAlgorithm::CreateEncryptor(const KeyType & key, IWritableStream * output)
+    {
+        // 12 bytes IV, 16 bytes tag appended to the cipher text
+        return new CryptoppEncryptor<CryptoPP::GCM<CryptoPP::AES>::Encryption, CryptoPP::AuthenticatedEncryptionFilter>(
+            key, m_decryptor.IVSize(), output, StatisticsCounter::BytesEncryptedAesGcm
+            );
+    }
+
+    IDecryptor * AesGcmSymmetricAlgorithm::CreateDecryptor(IWritableStream * output)
+    {
+        return new GcmDecryptor(m_decryptor, output);
+    }
+
     void AesGcmSymmetricAlgorithm::Decrypt(
         IDecryptionContext * context,
         IReadableStream * stream,
@@ -140,6 +228,7 @@ namespace lcp
         {
             throw std::out_of_range("params to decrypt out of range");
         }
+        Statistics::Increment(StatisticsCounter::BytesDecryptedAesGcm, rangeInfo.length);
 
         bool full = false;
         if (rangeInfo.position == 0 && rangeInfo.length == plainTextSize && plainTextSize == decryptedDataLength) {
@@ -150,21 +239,21 @@ namespace lcp
             stream->SetReadPosition(0);
             size_t streamSize = stream->Size();
 
-            std::vector<unsigned char> inBuffer(streamSize);
-            std::vector<unsigned char> outBuffer(streamSize);
+            SecureBuffer inBuffer(streamSize);
+            SecureBuffer outBuffer(streamSize);
 
-            stream->Read(&inBuffer.at(0), streamSize);
+            stream->Read(inBuffer.Data(), streamSize);
 
-            const unsigned char * cipherData = &inBuffer.at(0);
+            const unsigned char * cipherData = inBuffer.Data();
             size_t cipherSize = streamSize;
 
-            KeyType iv = this->BuildIV(&inBuffer.at(0), inBuffer.size(), &cipherData, &cipherSize);
-            m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0), iv.size());
+            const unsigned char * iv = this->BuildIV(inBuffer.Data(), inBuffer.Size(), &cipherData, &cipherSize);
+            m_decryptor.Resynchronize(iv, static_cast<int>(m_decryptor.IVSize()));
 
             size_t outSize = this->InnerDecrypt(
                     cipherData,
                     cipherSize,
-                    &outBuffer.at(0),
+                    outBuffer.Data(),
                     streamSize,
                     full
             );
@@ -174,24 +263,19 @@ namespace lcp
                 throw std::out_of_range("range length is out of range");
             }
 
-            outBuffer.resize(outSize);
-            memcpy_s(decryptedData, decryptedDataLength, &outBuffer.at(0), rangeInfo.length);
+            memcpy_s(decryptedData, decryptedDataLength, outBuffer.Data(), rangeInfo.length);
         } else {
             size_t ivSize = m_decryptor.IVSize();
             stream->SetReadPosition(0);
             size_t streamSize = stream->Size();
 
-            KeyType iv;
-            std::vector<unsigned char> ivBuffer(ivSize);
+            unsigned char ivBuffer[CryptoPP::AES::BLOCKSIZE];
 
             if (true || rangeInfo.position == 0) {
 
-                stream->Read(&ivBuffer.at(0), ivBuffer.size());
-
-                iv.resize(ivBuffer.size());
-                iv.assign(&ivBuffer.at(0), &ivBuffer.at(0) + ivBuffer.size());
+                stream->Read(ivBuffer, ivSize);
 
-                m_decryptor.SetKeyWithIV(&m_key.at(0), m_key.size(), &iv.at(0), iv.size());
+                m_decryptor.Resynchronize(ivBuffer, static_cast<int>(ivSize));
             }
 
 
@@ -236,14 +320,14 @@ namespace lcp
                 throw std::out_of_range("encrypted stream is out of range");
             }
 
-            std::vector<unsigned char> inBuffer(readLength);
-            std::vector<unsigned char> outBuffer(readLength);
+            SecureBuffer inBuffer(readLength);
+            SecureBuffer outBuffer(readLength);
 
             stream->SetReadPosition(readPosition);
 
-            stream->Read(&inBuffer.at(0), readLength);
+            stream->Read(inBuffer.Data(), readLength);
 
-            unsigned char *inBufferStartOffset = &inBuffer.at(0);
+            unsigned char *inBufferStartOffset = inBuffer.Data();
 
             if (rangeInfo.position != 0) {
 
@@ -293,14 +377,14 @@ namespace lcp
             size_t outSize = this->InnerDecrypt(
                     inBufferStartOffset,
                     readLength,
-                    &outBuffer.at(0),
+                    outBuffer.Data(),
                     readLength,
                     full // false
             );
 #else
             const unsigned char * cipherData = inBufferStartOffset;
             size_t cipherSize = readLength;
-            unsigned char * decryptedData_ = &outBuffer.at(0);
+            unsigned char * decryptedData_ = outBuffer.Data();
             size_t decryptedDataLength_ = readLength;
             bool verifyIntegrityAuthenticatedEncryption = full; // false
 
@@ -405,7 +489,7 @@ namespace lcp
         return resultSize;
     }
 
-    KeyType AesGcmSymmetricAlgorithm::BuildIV(
+    const unsigned char * AesGcmSymmetricAlgorithm::BuildIV(
         const unsigned char * data,
         size_t dataLength,
         const unsigned char ** cipherData,
@@ -414,18 +498,16 @@ namespace lcp
     {
         // Length of block equals to length of IV
         size_t blockAndIvSize = m_decryptor.IVSize(); //12
-        KeyType iv;
-        iv.resize(blockAndIvSize);
 
         if (dataLength < blockAndIvSize + CryptoPP::AES::BLOCKSIZE) //blockAndIvSize
         {
             throw std::invalid_argument("input data to decrypt is too small");
         }
 
-        iv.assign(data, data + blockAndIvSize);
+        // The IV prefixes the cipher text, it is used in place
         *cipherData = data + blockAndIvSize;
         *cipherSize = dataLength - blockAndIvSize;
 
-        return iv;
+        return data;
     }
 }
@@ -80,6 +80,10 @@ namespace lcp
 
         size_t PlainTextSize(IReadableStream * stream);
 
+        virtual IEncryptor * CreateEncryptor(const KeyType & key, IWritableStream * output);
+
+        virtual IDecryptor * CreateDecryptor(IWritableStream * output);
+
     private:
         size_t InnerDecrypt(
             const unsigned char * data,
@@ -89,7 +93,7 @@ namespace lcp
             bool verifyIntegrityAuthenticatedEncryption
             );
 
-        KeyType BuildIV(
+        const unsigned char * BuildIV(
             const unsigned char * data,
             size_t dataLength,
             const unsigned char ** cipherData,
@@ -98,7 +102,6 @@ namespace lcp
 
     private:
         KeySize m_keySize;
-        KeyType m_key;
 
         CryptoPP::GCM<CryptoPP::AES>::Decryption m_decryptor;
 
@@ -0,0 +1,78 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <thread>
+#include "BandwidthBudget.h"
+
+namespace lcp
+{
+    BandwidthBudget::BandwidthBudget(int64_t bytesPerSecond)
+        : m_bytesPerSecond(bytesPerSecond)
+        , m_available(static_cast<double>(bytesPerSecond))
+        , m_lastRefill(ClockType::now())
+    {
+    }
+
+    void BandwidthBudget::SetBytesPerSecond(int64_t bytesPerSecond)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_bytesPerSecond = bytesPerSecond;
+        m_available = std::min(m_available, static_cast<double>(bytesPerSecond));
+        m_lastRefill = ClockType::now();
+    }
+
+    int64_t BandwidthBudget::BytesPerSecond() const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        return m_bytesPerSecond;
+    }
+
+    void BandwidthBudget::Consume(int64_t bytes)
+    {
+        std::chrono::duration<double> debt;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            if (m_bytesPerSecond <= 0)
+            {
+                return;
+            }
+
+            ClockType::time_point now = ClockType::now();
+            std::chrono::duration<double> elapsed = now - m_lastRefill;
+            m_lastRefill = now;
+            m_available = std::min(m_available + elapsed.count() * m_bytesPerSecond, static_cast<double>(m_bytesPerSecond));
+            m_available -= bytes;
+            if (m_available >= 0)
+            {
+                return;
+            }
+            debt = std::chrono::duration<double>(-m_available / m_bytesPerSecond);
+        }
+        std::this_thread::sleep_for(debt);
+    }
+}
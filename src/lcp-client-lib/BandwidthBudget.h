@@ -24,83 +24,43 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-#ifndef __THREAD_TIMER_H__
-#define __THREAD_TIMER_H__
 
-#if !DISABLE_CRL
-
-#if !DISABLE_CRL_BACKGROUND_POLL
+#ifndef __BANDWIDTH_BUDGET_H__
+#define __BANDWIDTH_BUDGET_H__
 
 #include <chrono>
-#include <thread>
+#include <cstdint>
 #include <mutex>
-#include <condition_variable>
-#include <functional>
 #include "NonCopyable.h"
 
 namespace lcp
 {
-    class ThreadTimer : public NonCopyable
+    //
+    // Rate shared by several downloads, as a token bucket holding at most
+    // one second of budget. Consume() reserves the bytes right away and
+    // sleeps off the debt outside the lock, so concurrent writers share the
+    // rate instead of racing for it. A rate of 0 means no limit.
+    // Writers blocked in Consume() slow down the net provider feeding them.
+    //
+    class BandwidthBudget : public NonCopyable
     {
     public:
-        typedef std::chrono::system_clock ClockType;
-        typedef ClockType::time_point TimePointType;
-        typedef std::chrono::milliseconds DurationType;
-
-        enum UsageTypeEnum
-        {
-            TimePointUsage,
-            DurationUsage
-        };
+        typedef std::chrono::steady_clock ClockType;
 
     public:
-        explicit ThreadTimer(
-            UsageTypeEnum usageType = DurationUsage,
-            bool isAutoReset = false,
-            std::function<void()> handler = std::function<void()>()
-            );
-        ~ThreadTimer();
-
-        void Start();
-        void Stop();
-        bool IsRunning() const;
-        void SetHandler(std::function<void()> handler);
-
-        void SetUsage(UsageTypeEnum usageType);
-        UsageTypeEnum UsageType() const;
-
-        void SetTimePoint(const TimePointType & when);
-        TimePointType TimePoint() const;
-
-        void SetDuration(const DurationType & duration);
-        DurationType Duration() const;
+        explicit BandwidthBudget(int64_t bytesPerSecond = 0);
 
-        void SetAutoReset(bool value);
-        bool IsAutoReset() const;
+        void SetBytesPerSecond(int64_t bytesPerSecond);
+        int64_t BytesPerSecond() const;
 
-        void RethrowExceptionIfAny();
+        void Consume(int64_t bytes);
 
     private:
-        void TimerThread();
-
-    private:
-        std::thread m_worker;
         mutable std::mutex m_sync;
-        std::condition_variable m_conditionRunning;
-        std::exception_ptr m_currentException;
-
-        std::function<void()> m_handler;
-        TimePointType m_runTimePoint;
-        DurationType m_runPeriod;
-
-        bool m_isRunning;
-        bool m_isAutoReset;
-        UsageTypeEnum m_usageType;
+        int64_t m_bytesPerSecond;
+        double m_available;
+        ClockType::time_point m_lastRefill;
     };
 }
 
-#endif //!DISABLE_CRL_BACKGROUND_POLL
-
-#endif //!DISABLE_CRL
-
-#endif //__THREAD_TIMER_H__
\ No newline at end of file
+#endif //__BANDWIDTH_BUDGET_H__
@@ -36,15 +36,44 @@
 
 namespace lcp
 {
-    class BaseDownloadRequest : public IDownloadRequest
+    class BaseDownloadRequest : public IRangeDownloadRequest
     {
     public:
         BaseDownloadRequest(const std::string & url)
             : m_url(url)
             , m_canceled(false)
+            , m_notModified(false)
+            , m_resourceSize(-1)
+            , m_rangeStart(0)
+            , m_rangeEnd(-1)
         {
         }
 
+        //
+        // Validators of the copy the caller already has, left empty for an
+        // unconditional download.
+        //
+        void SetConditions(const std::string & ifNoneMatch, const std::string & ifModifiedSince)
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            m_ifNoneMatch = ifNoneMatch;
+            m_ifModifiedSince = ifModifiedSince;
+        }
+
+        //
+        // Restricts the download to the bytes [start, end) of the resource,
+        // end being -1 to get it up to its end. The validator, when not
+        // empty, is the ETag or Last-Modified value of the part already
+        // downloaded.
+        //
+        void SetRange(int64_t start, int64_t end, const std::string & ifRange)
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            m_rangeStart = start;
+            m_rangeEnd = end;
+            m_ifRange = ifRange;
+        }
+
         virtual std::string Url() const
         {
             return m_url;
@@ -72,13 +101,97 @@ namespace lcp
             return m_suggestedFileName;
         }
 
+        virtual std::string IfNoneMatch() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_ifNoneMatch;
+        }
+
+        virtual std::string IfModifiedSince() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_ifModifiedSince;
+        }
+
+        virtual std::string ETag() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_etag;
+        }
+
+        virtual void SetETag(const std::string & etag)
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            m_etag = etag;
+        }
+
+        virtual std::string LastModified() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_lastModified;
+        }
+
+        virtual void SetLastModified(const std::string & lastModified)
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            m_lastModified = lastModified;
+        }
+
+        virtual bool NotModified() const
+        {
+            return m_notModified;
+        }
+
+        virtual void SetNotModified(bool value)
+        {
+            m_notModified = value;
+        }
+
+        virtual int64_t RangeStart() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_rangeStart;
+        }
+
+        virtual int64_t RangeEnd() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_rangeEnd;
+        }
+
+        virtual std::string IfRange() const
+        {
+            std::unique_lock<std::mutex> locker(m_conditionsSync);
+            return m_ifRange;
+        }
+
+        virtual int64_t ResourceSize() const
+        {
+            return m_resourceSize;
+        }
+
+        virtual void SetResourceSize(int64_t size)
+        {
+            m_resourceSize = size;
+        }
+
     protected:
         std::atomic<bool> m_canceled;
+        std::atomic<bool> m_notModified;
+        std::atomic<int64_t> m_resourceSize;
         std::string m_url;
         std::string m_suggestedFileName;
+        std::string m_ifNoneMatch;
+        std::string m_ifModifiedSince;
+        std::string m_etag;
+        std::string m_lastModified;
+        int64_t m_rangeStart;
+        int64_t m_rangeEnd;
+        std::string m_ifRange;
 
     private:
         mutable std::mutex m_suggestedNameSync;
+        mutable std::mutex m_conditionsSync;
     };
 }
 
@@ -0,0 +1,176 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <memory>
+#include <stdexcept>
+#include "BatchStorageAdapter.h"
+#include "public/IStorageProvider.h"
+
+namespace lcp
+{
+    BatchStorageAdapter::BatchStorageAdapter(IStorageProvider * storageProvider)
+        : m_storageProvider(storageProvider)
+    {
+        if (m_storageProvider == nullptr)
+        {
+            throw std::invalid_argument("StorageProvider is nullptr");
+        }
+    }
+
+    std::vector<std::string> BatchStorageAdapter::GetValues(const std::string & vaultId, const std::vector<std::string> & keys)
+    {
+        std::vector<std::string> values;
+        if (m_storageProvider->GetValues(vaultId, keys, values) && values.size() == keys.size())
+        {
+            return values;
+        }
+
+        values.clear();
+        values.reserve(keys.size());
+        for (auto it = keys.begin(); it != keys.end(); ++it)
+        {
+            values.push_back(m_storageProvider->GetValue(vaultId, *it));
+        }
+        return values;
+    }
+
+    void BatchStorageAdapter::SetValues(const std::string & vaultId, const StringsMap & values)
+    {
+        if (values.empty() || m_storageProvider->SetValues(vaultId, values))
+        {
+            return;
+        }
+
+        for (auto it = values.begin(); it != values.end(); ++it)
+        {
+            m_storageProvider->SetValue(vaultId, it->first, it->second);
+        }
+    }
+
+    bool BatchStorageAdapter::ValuesWithPrefix(const std::string & vaultId, const std::string & keyPrefix, StringsMap & values)
+    {
+        std::string buffer;
+        if (m_storageProvider->EnumerateVaultToBuffer(vaultId, keyPrefix, buffer))
+        {
+            if (!ReadBuffer(buffer, values))
+            {
+                throw std::runtime_error("Storage buffer is malformed");
+            }
+            return true;
+        }
+
+        std::unique_ptr<KvStringsIterator> it(m_storageProvider->EnumerateVaultWithPrefix(vaultId, keyPrefix));
+        if (!it)
+        {
+            return false;
+        }
+        for (it->First(); !it->IsDone(); it->Next())
+        {
+            values[it->CurrentKey()] = it->Current();
+        }
+        return true;
+    }
+
+    StringsMap BatchStorageAdapter::VaultValues(const std::string & vaultId)
+    {
+        StringsMap values;
+        std::string buffer;
+        if (m_storageProvider->EnumerateVaultToBuffer(vaultId, std::string(), buffer))
+        {
+            if (!ReadBuffer(buffer, values))
+            {
+                throw std::runtime_error("Storage buffer is malformed");
+            }
+            return values;
+        }
+
+        std::unique_ptr<KvStringsIterator> it(m_storageProvider->EnumerateVault(vaultId));
+        if (it)
+        {
+            for (it->First(); !it->IsDone(); it->Next())
+            {
+                values[it->CurrentKey()] = it->Current();
+            }
+        }
+        return values;
+    }
+
+    /*static*/ void BatchStorageAdapter::AppendToBuffer(std::string & buffer, const std::string & key, const std::string & value)
+    {
+        AppendField(buffer, key);
+        AppendField(buffer, value);
+    }
+
+    /*static*/ bool BatchStorageAdapter::ReadBuffer(const std::string & buffer, StringsMap & values)
+    {
+        size_t pos = 0;
+        std::string key;
+        std::string value;
+        while (pos < buffer.size())
+        {
+            if (!ReadField(buffer, pos, key) || !ReadField(buffer, pos, value))
+            {
+                return false;
+            }
+            values[key] = value;
+        }
+        return true;
+    }
+
+    /*static*/ void BatchStorageAdapter::AppendField(std::string & buffer, const std::string & field)
+    {
+        size_t length = field.size();
+        buffer.push_back(static_cast<char>((length >> 24) & 0xFF));
+        buffer.push_back(static_cast<char>((length >> 16) & 0xFF));
+        buffer.push_back(static_cast<char>((length >> 8) & 0xFF));
+        buffer.push_back(static_cast<char>(length & 0xFF));
+        buffer.append(field);
+    }
+
+    /*static*/ bool BatchStorageAdapter::ReadField(const std::string & buffer, size_t & pos, std::string & field)
+    {
+        if (buffer.size() - pos < 4)
+        {
+            return false;
+        }
+        const unsigned char * data = reinterpret_cast<const unsigned char *>(buffer.data() + pos);
+        size_t length = (static_cast<size_t>(data[0]) << 24) |
+            (static_cast<size_t>(data[1]) << 16) |
+            (static_cast<size_t>(data[2]) << 8) |
+            static_cast<size_t>(data[3]);
+        pos += 4;
+
+        if (buffer.size() - pos < length)
+        {
+            return false;
+        }
+        field.assign(buffer, pos, length);
+        pos += length;
+        return true;
+    }
+}
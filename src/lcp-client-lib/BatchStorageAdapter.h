@@ -0,0 +1,82 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __BATCH_STORAGE_ADAPTER_H__
+#define __BATCH_STORAGE_ADAPTER_H__
+
+#include <vector>
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class IStorageProvider;
+
+    //
+    // Gives the batch operations of an IStorageProvider, emulated with its
+    // single value calls when the provider doesn't implement them.
+    //
+    class BatchStorageAdapter : public NonCopyable
+    {
+    public:
+        explicit BatchStorageAdapter(IStorageProvider * storageProvider);
+
+        std::vector<std::string> GetValues(const std::string & vaultId, const std::vector<std::string> & keys);
+
+        //
+        // Stores the values in a single transaction if the provider supports
+        // it, one by one otherwise.
+        //
+        void SetValues(const std::string & vaultId, const StringsMap & values);
+
+        //
+        // Gets the key-values of the vault whose key starts with the given
+        // prefix. Returns false when the provider can only enumerate whole
+        // vaults, so that the caller can index them.
+        //
+        bool ValuesWithPrefix(const std::string & vaultId, const std::string & keyPrefix, StringsMap & values);
+
+        StringsMap VaultValues(const std::string & vaultId);
+
+        //
+        // Writes and reads the flat buffers of
+        // IStorageProvider::EnumerateVaultToBuffer().
+        //
+        static void AppendToBuffer(std::string & buffer, const std::string & key, const std::string & value);
+        static bool ReadBuffer(const std::string & buffer, StringsMap & values);
+
+    private:
+        static void AppendField(std::string & buffer, const std::string & field);
+        static bool ReadField(const std::string & buffer, size_t & pos, std::string & field);
+
+    private:
+        IStorageProvider * m_storageProvider;
+    };
+}
+
+#endif //__BATCH_STORAGE_ADAPTER_H__
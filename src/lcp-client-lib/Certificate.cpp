@@ -39,6 +39,7 @@ CRYPTOPP_INCLUDE_START
 #include <cryptopp/rsa.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/asn.h>
+#include <cryptopp/integer.h>
 #include <cryptopp/oids.h>
 #include <cryptopp/dsa.h>
 
@@ -85,7 +86,11 @@ namespace lcp
                     throw BERDecodeErr("Wrong version of the certificate");
                 }
 
-                m_serialNumber = CryptoppUtils::Cert::ReadIntegerAsString(toBeSignedCert);
+                Integer serialNumber;
+                serialNumber.BERDecode(toBeSignedCert);
+                m_serialNumber = CryptoppUtils::Cert::IntegerToString(serialNumber);
+                m_encodedSerialNumber.resize(serialNumber.MinEncodedSize(Integer::SIGNED));
+                serialNumber.Encode(m_encodedSerialNumber.data(), m_encodedSerialNumber.size(), Integer::SIGNED);
 
                 // algorithmId
                 CryptoppUtils::Cert::SkipNextSequence(toBeSignedCert);
@@ -291,6 +296,11 @@ namespace lcp
         return m_serialNumber;
     }
 
+    Buffer Certificate::EncodedSerialNumber() const
+    {
+        return m_encodedSerialNumber;
+    }
+
     std::string Certificate::NotBeforeDate() const
     {
         return m_notBeforeDate;
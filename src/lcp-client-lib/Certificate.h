@@ -58,6 +58,7 @@ namespace lcp
             );
 
         std::string SerialNumber() const;
+        Buffer EncodedSerialNumber() const;
         std::string NotBeforeDate() const;
         std::string NotAfterDate() const;
         KeyType PublicKey() const;
@@ -75,6 +76,7 @@ namespace lcp
 
     private:
         std::string m_serialNumber;
+        Buffer m_encodedSerialNumber;
         std::string m_notBeforeDate;
         std::string m_notAfterDate;
 
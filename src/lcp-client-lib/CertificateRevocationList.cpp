@@ -27,16 +27,36 @@
 
 #if !DISABLE_CRL
 
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
 #include "CertificateRevocationList.h"
+#include "CertificateExtension.h"
+#include "CrlDistributionPoints.h"
 #include "CryptoppUtils.h"
+#include "ReadableStreamStore.h"
 #include "IncludeMacros.h"
 
 CRYPTOPP_INCLUDE_START
 #include <cryptopp/asn.h>
+#include <cryptopp/integer.h>
+#include <cryptopp/oids.h>
 CRYPTOPP_INCLUDE_END
 
 using namespace CryptoPP;
 
+DEFINE_OID(ASN1::joint_iso_ccitt() + 5, joint_iso_ccitt_ds);
+DEFINE_OID(joint_iso_ccitt_ds() + 29, id_ce);
+DEFINE_OID(id_ce() + 20, id_ce_CRLNumber);
+DEFINE_OID(id_ce() + 21, id_ce_CRLReasons);
+DEFINE_OID(id_ce() + 27, id_ce_DeltaCRLIndicator);
+DEFINE_OID(id_ce() + 28, id_ce_IssuingDistributionPoint);
+DEFINE_OID(id_ce() + 46, id_ce_FreshestCRL);
+
+// CRLReason of the entries a delta CRL drops from its base
+static const word32 RemoveFromCrlReason = 8;
+
 namespace lcp
 {
 //    CertificateRevocationList::CertificateRevocationList(const Buffer & crlRaw)
@@ -44,103 +64,448 @@ namespace lcp
 //        this->UpdateRevocationList(crlRaw);
 //    }
 
+    CertificateRevocationList::SnapshotReader::SnapshotReader(const CertificateRevocationList & list)
+        : m_readIndicator(list.m_readIndicators[list.m_version.load()])
+    {
+        ++m_readIndicator;
+        m_snapshot = list.m_snapshots[list.m_currentSlot.load()].get();
+    }
+
+    CertificateRevocationList::SnapshotReader::~SnapshotReader()
+    {
+        --m_readIndicator;
+    }
+
+    CertificateRevocationList::CertificateRevocationList()
+        : m_currentSlot(0)
+        , m_version(0)
+    {
+        m_snapshots[0].reset(new Snapshot());
+        m_readIndicators[0] = 0;
+        m_readIndicators[1] = 0;
+    }
+
     void CertificateRevocationList::UpdateRevocationList(const Buffer & crlRaw)
     {
-        try {
-            std::unique_lock<std::mutex> locker(m_sync);
+        StringStore crlData(crlRaw.data(), crlRaw.size());
+        this->ParseRevocationList(crlData);
+    }
+
+    void CertificateRevocationList::UpdateRevocationList(IReadableStream * crlStream)
+    {
+        ReadableStreamStore crlData(crlStream);
+        this->ParseRevocationList(crlData);
+    }
+
+    //
+    // Decodes the list into a fresh snapshot, lookups keep being served
+    // from the previous one until it is published. A delta list is only
+    // applied to the base of its own issuer and distribution point, and
+    // keeps the numbering and the delta locations of that base.
+    //
+    void CertificateRevocationList::ParseRevocationList(BufferedTransformation & crlData)
+    {
+        DecodedList decoded;
+        CertificateRevocationList::DecodeRevocationList(crlData, decoded);
+
+        std::unique_lock<std::mutex> locker(m_writeSync);
+        const Snapshot * current = &this->PublishedSnapshot();
 
-            ByteQueue crlData;
-            crlData.Put(crlRaw.data(), crlRaw.size());
-            crlData.MessageEnd();
+        std::unique_ptr<Snapshot> updated(new Snapshot());
+        updated->thisUpdate = decoded.thisUpdate;
+        updated->nextUpdate = decoded.nextUpdate;
+        updated->scopes = current->scopes;
+        updated->insertedSerialNumbers = current->insertedSerialNumbers;
 
-            BERSequenceDecoder crl(crlData);
+        ListScope & scope = updated->scopes[ListScopeKey(decoded.issuer, decoded.issuingDistributionPoint)];
+        if (decoded.baseCrlNumber.empty())
+        {
+            scope.crlNumber = decoded.crlNumber;
+            scope.deltaCrlNumber.clear();
+            scope.freshestCrlUrls = decoded.freshestCrlUrls;
+        }
+        else
+        {
+            if (scope.crlNumber.empty() || Integer(scope.crlNumber.c_str()) < Integer(decoded.baseCrlNumber.c_str()))
             {
-                BERSequenceDecoder toBeSignedCertList(crl);
+                throw std::runtime_error("Delta CRL refers to a newer base CRL than the one in use");
+            }
+            scope.deltaCrlNumber = decoded.crlNumber;
+        }
+
+        SerialNumbers serials;
+        serials.reserve(scope.revokedSerialNumbers.size() + decoded.revokedSerialNumbers.size());
+        std::merge(
+            scope.revokedSerialNumbers.begin(), scope.revokedSerialNumbers.end(),
+            decoded.revokedSerialNumbers.begin(), decoded.revokedSerialNumbers.end(),
+            std::back_inserter(serials)
+            );
+        serials.erase(std::unique(serials.begin(), serials.end()), serials.end());
+        if (!decoded.removedSerialNumbers.empty())
+        {
+            serials.erase(
+                std::remove_if(serials.begin(), serials.end(), [&](const SerialNumber & serial) {
+                    return std::binary_search(decoded.removedSerialNumbers.begin(), decoded.removedSerialNumbers.end(), serial);
+                }),
+                serials.end()
+                );
+        }
+        serials.shrink_to_fit();
+        scope.revokedSerialNumbers.swap(serials);
+
+        CertificateRevocationList::CollectScopes(*updated);
+        this->Publish(std::move(updated));
+    }
+
+    //
+    // Builds the lookup set and the delta locations of every scope.
+    //
+    /*static*/ void CertificateRevocationList::CollectScopes(Snapshot & snapshot)
+    {
+        SerialNumbers & serials = snapshot.revokedSerialNumbers;
+        serials = snapshot.insertedSerialNumbers;
+        for (auto const & scope : snapshot.scopes)
+        {
+            size_t middle = serials.size();
+            serials.insert(serials.end(), scope.second.revokedSerialNumbers.begin(), scope.second.revokedSerialNumbers.end());
+            std::inplace_merge(serials.begin(), serials.begin() + middle, serials.end());
+
+            for (auto const & url : scope.second.freshestCrlUrls)
+            {
+                if (std::find(snapshot.freshestCrlUrls.begin(), snapshot.freshestCrlUrls.end(), url) == snapshot.freshestCrlUrls.end())
                 {
-                    word32 version = CryptoppUtils::Cert::ReadVersion(toBeSignedCertList,
-                                                                      CertificateVersion::Certificatev2);
-                    if (version != CertificateVersion::Certificatev2) {
-                        throw BERDecodeErr("Wrong version of the crl");
-                    }
+                    snapshot.freshestCrlUrls.push_back(url);
+                }
+            }
+        }
+        serials.erase(std::unique(serials.begin(), serials.end()), serials.end());
+        serials.shrink_to_fit();
+    }
 
-                    // algorithmId
-                    CryptoppUtils::Cert::SkipNextSequence(toBeSignedCertList);
-                    // issuer
-                    CryptoppUtils::Cert::SkipNextSequence(toBeSignedCertList);
-                    // this update
-                    CryptoppUtils::Cert::BERDecodeTime(toBeSignedCertList, m_thisUpdate);
-                    // next update
-                    if (!toBeSignedCertList.EndReached()) {
-                        byte nextId = toBeSignedCertList.PeekByte();
-                        if (nextId == UTC_TIME || nextId == GENERALIZED_TIME) {
-                            CryptoppUtils::Cert::BERDecodeTime(toBeSignedCertList, m_nextUpdate);
-                        }
-                    }
+    /*static*/ void CertificateRevocationList::DecodeRevocationList(BufferedTransformation & crlData, DecodedList & decoded)
+    {
+        BERSequenceDecoder crl(crlData);
+        {
+            BERSequenceDecoder toBeSignedCertList(crl);
+            {
+                CertificateRevocationList::ReadUpdateDates(toBeSignedCertList, decoded.issuer, decoded.thisUpdate, decoded.nextUpdate);
+
+                if (!toBeSignedCertList.EndReached() && toBeSignedCertList.PeekByte() == (SEQUENCE | CONSTRUCTED)) {
+                    BERSequenceDecoder revokedCertificates(toBeSignedCertList);
+                    {
+                        while (!revokedCertificates.EndReached()) {
+                            BERSequenceDecoder nextRevokedCertificate(revokedCertificates);
+                            {
+                                Integer value;
+                                value.BERDecode(nextRevokedCertificate);
 
-                    if (!toBeSignedCertList.EndReached()) {
-                        BERSequenceDecoder revokedCertificates(toBeSignedCertList);
-                        {
-                            while (!revokedCertificates.EndReached()) {
-                                BERSequenceDecoder nextRevokedCertificate(revokedCertificates);
-                                {
-                                    std::string serial = CryptoppUtils::Cert::ReadIntegerAsString(
-                                            nextRevokedCertificate);
-                                    m_revokedSerialNumbers.insert(serial);
+                                SerialNumber serialNumber;
+                                if (!CertificateRevocationList::ToSerialNumber(value, serialNumber)) {
+                                    throw BERDecodeErr("Serial number of the crl entry is too long");
+                                }
+
+                                if (CertificateRevocationList::RemovedFromCrl(nextRevokedCertificate)) {
+                                    decoded.removedSerialNumbers.push_back(serialNumber);
+                                }
+                                else {
+                                    decoded.revokedSerialNumbers.push_back(serialNumber);
                                 }
-                                nextRevokedCertificate.SkipAll();
                             }
+                            nextRevokedCertificate.SkipAll();
                         }
                     }
-                    toBeSignedCertList.SkipAll();
+                }
+
+                if (!toBeSignedCertList.EndReached() && toBeSignedCertList.PeekByte() == CryptoppUtils::Cert::ContextSpecificTagZero) {
+                    CertificateRevocationList::DecodeCrlExtensions(toBeSignedCertList, decoded);
+                }
+                toBeSignedCertList.SkipAll();
+            }
+        }
+
+        std::sort(decoded.revokedSerialNumbers.begin(), decoded.revokedSerialNumbers.end());
+        std::sort(decoded.removedSerialNumbers.begin(), decoded.removedSerialNumbers.end());
+    }
+
+    /*static*/ void CertificateRevocationList::DecodeCrlExtensions(BERSequenceDecoder & toBeSignedCertList, DecodedList & decoded)
+    {
+        BERGeneralDecoder crlExtensionsContext(toBeSignedCertList, CryptoppUtils::Cert::ContextSpecificTagZero);
+        {
+            BERSequenceDecoder crlExtensions(crlExtensionsContext);
+            {
+                while (!crlExtensions.EndReached())
+                {
+                    CertificateExtension extension(crlExtensions);
+                    OID oid = extension.CryptoOid();
+                    if (oid == id_ce_CRLNumber() || oid == id_ce_DeltaCRLIndicator())
+                    {
+                        StringStore value(extension.Value().data(), extension.Value().size());
+                        Integer number;
+                        number.BERDecode(value);
+                        std::string & target = (oid == id_ce_CRLNumber()) ? decoded.crlNumber : decoded.baseCrlNumber;
+                        target = CryptoppUtils::Cert::IntegerToString(number);
+                    }
+                    else if (oid == id_ce_IssuingDistributionPoint())
+                    {
+                        decoded.issuingDistributionPoint.assign(extension.Value().begin(), extension.Value().end());
+                    }
+                    else if (oid == id_ce_FreshestCRL())
+                    {
+                        CrlDistributionPoints freshestCrl(&extension);
+                        decoded.freshestCrlUrls = freshestCrl.CrlDistributionPointUrls();
+                    }
+                }
+            }
+            crlExtensions.MessageEnd();
+        }
+        crlExtensionsContext.MessageEnd();
+    }
+
+    //
+    // Skips the revocation date of the entry and looks for the CRLReason
+    // entry extension.
+    //
+    /*static*/ bool CertificateRevocationList::RemovedFromCrl(BERSequenceDecoder & revokedCertificate)
+    {
+        std::string revocationDate;
+        CryptoppUtils::Cert::BERDecodeTime(revokedCertificate, revocationDate);
+        if (revokedCertificate.EndReached())
+        {
+            return false;
+        }
+
+        bool removed = false;
+        BERSequenceDecoder entryExtensions(revokedCertificate);
+        {
+            while (!entryExtensions.EndReached())
+            {
+                CertificateExtension extension(entryExtensions);
+                if (extension.CryptoOid() == id_ce_CRLReasons())
+                {
+                    StringStore value(extension.Value().data(), extension.Value().size());
+                    word32 reason = 0;
+                    BERDecodeUnsigned<word32>(value, reason, ENUMERATED);
+                    removed = (reason == RemoveFromCrlReason);
                 }
             }
         }
-        catch (const std::exception & ex)
+        entryExtensions.MessageEnd();
+        return removed;
+    }
+
+    /*static*/ std::string CertificateRevocationList::ThisUpdateDateOf(const Buffer & crlRaw)
+    {
+        StringStore crlData(crlRaw.data(), crlRaw.size());
+        return CertificateRevocationList::ThisUpdateDateOf(crlData);
+    }
+
+    /*static*/ std::string CertificateRevocationList::ThisUpdateDateOf(IReadableStream * crlStream)
+    {
+        ReadableStreamStore crlData(crlStream);
+        return CertificateRevocationList::ThisUpdateDateOf(crlData);
+    }
+
+    /*static*/ std::string CertificateRevocationList::ThisUpdateDateOf(BufferedTransformation & crlData)
+    {
+        std::string issuer;
+        std::string thisUpdate;
+        std::string nextUpdate;
+
+        BERSequenceDecoder crl(crlData);
+        BERSequenceDecoder toBeSignedCertList(crl);
+        CertificateRevocationList::ReadUpdateDates(toBeSignedCertList, issuer, thisUpdate, nextUpdate);
+        return thisUpdate;
+    }
+
+    /*static*/ void CertificateRevocationList::ReadUpdateDates(
+        BERSequenceDecoder & toBeSignedCertList,
+        std::string & issuer,
+        std::string & thisUpdate,
+        std::string & nextUpdate
+        )
+    {
+        word32 version = CryptoppUtils::Cert::ReadVersion(toBeSignedCertList,
+                                                          CertificateVersion::Certificatev2);
+        if (version != CertificateVersion::Certificatev2) {
+            throw BERDecodeErr("Wrong version of the crl");
+        }
+
+        // algorithmId
+        CryptoppUtils::Cert::SkipNextSequence(toBeSignedCertList);
+        // issuer
         {
-            throw;
+            BERSequenceDecoder issuerName(toBeSignedCertList);
+            StringSink issuerSink(issuer);
+            issuerName.TransferTo(issuerSink);
+        }
+        // this update
+        CryptoppUtils::Cert::BERDecodeTime(toBeSignedCertList, thisUpdate);
+        // next update
+        if (!toBeSignedCertList.EndReached()) {
+            byte nextId = toBeSignedCertList.PeekByte();
+            if (nextId == UTC_TIME || nextId == GENERALIZED_TIME) {
+                CryptoppUtils::Cert::BERDecodeTime(toBeSignedCertList, nextUpdate);
+            }
         }
     }
 
     std::string CertificateRevocationList::ThisUpdateDate() const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return m_thisUpdate;
+        SnapshotReader snapshot(*this);
+        return snapshot->thisUpdate;
     }
 
     bool CertificateRevocationList::HasThisUpdateDate() const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return !m_thisUpdate.empty();
+        SnapshotReader snapshot(*this);
+        return !snapshot->thisUpdate.empty();
     }
 
     std::string CertificateRevocationList::NextUpdateDate() const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return m_nextUpdate;
+        SnapshotReader snapshot(*this);
+        return snapshot->nextUpdate;
     }
 
     bool CertificateRevocationList::HasNextUpdateDate() const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return !m_nextUpdate.empty();
+        SnapshotReader snapshot(*this);
+        return !snapshot->nextUpdate.empty();
     }
 
     bool CertificateRevocationList::SerialNumberRevoked(const std::string & serialNumber) const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return (m_revokedSerialNumbers.find(serialNumber) != m_revokedSerialNumbers.end());
+        SerialNumber value;
+        if (!CertificateRevocationList::ToSerialNumber(serialNumber, value))
+        {
+            return false;
+        }
+        return this->Revoked(value);
     }
 
-    const StringsSet & CertificateRevocationList::RevokedSerialNumbers() const
+    bool CertificateRevocationList::EncodedSerialNumberRevoked(const Buffer & serialNumber) const
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        return m_revokedSerialNumbers;
+        SerialNumber value;
+        if (!CertificateRevocationList::ToSerialNumber(serialNumber, value))
+        {
+            return false;
+        }
+        return this->Revoked(value);
+    }
+
+    bool CertificateRevocationList::Revoked(const SerialNumber & serialNumber) const
+    {
+        SnapshotReader snapshot(*this);
+        return std::binary_search(snapshot->revokedSerialNumbers.begin(), snapshot->revokedSerialNumbers.end(), serialNumber);
+    }
+
+    StringsSet CertificateRevocationList::RevokedSerialNumbers() const
+    {
+        SnapshotReader snapshot(*this);
+
+        StringsSet result;
+        for (const SerialNumber & serialNumber : snapshot->revokedSerialNumbers)
+        {
+            Integer value(serialNumber.data(), serialNumber.size(), Integer::SIGNED);
+            result.insert(CryptoppUtils::Cert::IntegerToString(value));
+        }
+        return result;
     }
 
     const void CertificateRevocationList::InsertRevokedSerialNumber(std::string serial)
     {
-        std::unique_lock<std::mutex> locker(m_sync);
-        m_revokedSerialNumbers.insert(serial);
+        SerialNumber value;
+        if (!CertificateRevocationList::ToSerialNumber(serial, value))
+        {
+            throw std::invalid_argument("Serial number is too long: " + serial);
+        }
+
+        std::unique_lock<std::mutex> locker(m_writeSync);
+        const Snapshot * current = &this->PublishedSnapshot();
+        auto position = std::lower_bound(current->revokedSerialNumbers.begin(), current->revokedSerialNumbers.end(), value);
+        if (position != current->revokedSerialNumbers.end() && *position == value)
+        {
+            return;
+        }
+
+        std::unique_ptr<Snapshot> updated(new Snapshot(*current));
+        updated->revokedSerialNumbers.insert(
+            updated->revokedSerialNumbers.begin() + (position - current->revokedSerialNumbers.begin()),
+            value
+            );
+        SerialNumbers & inserted = updated->insertedSerialNumbers;
+        inserted.insert(std::lower_bound(inserted.begin(), inserted.end(), value), value);
+        this->Publish(std::move(updated));
+    }
+
+    StringsList CertificateRevocationList::FreshestCrlUrls() const
+    {
+        SnapshotReader snapshot(*this);
+        return snapshot->freshestCrlUrls;
+    }
+
+    //
+    // Only called by writers, under m_writeSync.
+    //
+    const CertificateRevocationList::Snapshot & CertificateRevocationList::PublishedSnapshot() const
+    {
+        return *m_snapshots[m_currentSlot.load()];
+    }
+
+    void CertificateRevocationList::Publish(std::unique_ptr<const Snapshot> snapshot)
+    {
+        // No reader is left on the other slot since the previous Publish()
+        size_t previousSlot = m_currentSlot.load();
+        m_snapshots[1 - previousSlot] = std::move(snapshot);
+        m_currentSlot.store(1 - previousSlot);
+
+        // Readers which may have taken the previous slot are registered in
+        // either version: the next one is drained before readers are sent to
+        // it, then the previous one
+        size_t previousVersion = m_version.load();
+        this->WaitForReaders(1 - previousVersion);
+        m_version.store(1 - previousVersion);
+        this->WaitForReaders(previousVersion);
+
+        m_snapshots[previousSlot].reset();
+    }
+
+    void CertificateRevocationList::WaitForReaders(size_t version) const
+    {
+        while (m_readIndicators[version].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    /*static*/ bool CertificateRevocationList::ToSerialNumber(const Integer & value, SerialNumber & serialNumber)
+    {
+        if (value.MinEncodedSize(Integer::SIGNED) > serialNumber.size())
+        {
+            return false;
+        }
+        value.Encode(serialNumber.data(), serialNumber.size(), Integer::SIGNED);
+        return true;
+    }
+
+    /*static*/ bool CertificateRevocationList::ToSerialNumber(const std::string & value, SerialNumber & serialNumber)
+    {
+        return CertificateRevocationList::ToSerialNumber(Integer(value.c_str()), serialNumber);
+    }
+
+    /*static*/ bool CertificateRevocationList::ToSerialNumber(const Buffer & encoded, SerialNumber & serialNumber)
+    {
+        if (encoded.empty() || encoded.size() > serialNumber.size())
+        {
+            return false;
+        }
+
+        // Sign extension to the fixed width
+        unsigned char padding = (encoded.front() & 0x80) ? 0xFF : 0x00;
+        size_t paddingSize = serialNumber.size() - encoded.size();
+        std::fill(serialNumber.begin(), serialNumber.begin() + paddingSize, padding);
+        std::copy(encoded.begin(), encoded.end(), serialNumber.begin() + paddingSize);
+        return true;
     }
 }
 
@@ -30,34 +30,156 @@
 
 #if !DISABLE_CRL
 
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "ICertificate.h"
 #include "NonCopyable.h"
 
+namespace CryptoPP
+{
+    class BufferedTransformation;
+    class BERSequenceDecoder;
+    class Integer;
+}
+
 namespace lcp
 {
     class CertificateRevocationList : public ICertificateRevocationList, public NonCopyable
     {
     public:
-        CertificateRevocationList() = default;
+        CertificateRevocationList();
 //        explicit CertificateRevocationList(const Buffer & crlRaw);
         
         // ICertificateRevocationList
         virtual void UpdateRevocationList(const Buffer & crlRaw);
+        virtual void UpdateRevocationList(IReadableStream * crlStream);
         virtual bool HasThisUpdateDate() const;
         virtual std::string ThisUpdateDate() const;
         virtual bool HasNextUpdateDate() const;
         virtual std::string NextUpdateDate() const;
         virtual bool SerialNumberRevoked(const std::string & serialNumber) const;
-        virtual const StringsSet & RevokedSerialNumbers() const;
+        virtual bool EncodedSerialNumberRevoked(const Buffer & serialNumber) const;
+        virtual StringsSet RevokedSerialNumbers() const;
         virtual const void InsertRevokedSerialNumber(std::string serial);
+        virtual StringsList FreshestCrlUrls() const;
+
+        //
+        // Reads the thisUpdate date of an encoded list without decoding
+        // its entries, throws when the list is not valid.
+        //
+        static std::string ThisUpdateDateOf(const Buffer & crlRaw);
+        static std::string ThisUpdateDateOf(IReadableStream * crlStream);
+
+    private:
+        //
+        // Serial numbers are kept as fixed-width two's complement values,
+        // RFC 5280 allows up to 20 octets plus the DER sign octet.
+        //
+        static const size_t SerialNumberSize = 21;
+        typedef std::array<unsigned char, SerialNumberSize> SerialNumber;
+        typedef std::vector<SerialNumber> SerialNumbers;
+
+        //
+        // CRL numbers only order the lists of one issuer and issuing
+        // distribution point, the scope is keyed by both encoded values.
+        //
+        typedef std::pair<std::string, std::string> ListScopeKey;
+
+        struct ListScope
+        {
+            std::string crlNumber;
+            std::string deltaCrlNumber;
+            StringsList freshestCrlUrls;
+            SerialNumbers revokedSerialNumbers;
+        };
+
+        //
+        // Immutable state published as a whole, writers build a new one and
+        // swap it in. See SnapshotReader. The lookup set is the union of
+        // every scope and of the inserted serial numbers.
+        //
+        struct Snapshot
+        {
+            std::string thisUpdate;
+            std::string nextUpdate;
+            std::map<ListScopeKey, ListScope> scopes;
+            SerialNumbers insertedSerialNumbers;
+            StringsList freshestCrlUrls;
+            SerialNumbers revokedSerialNumbers;
+        };
+
+        //
+        // Content of one encoded list, base or delta. Entries with the
+        // removeFromCRL reason are only found in delta lists.
+        //
+        struct DecodedList
+        {
+            std::string thisUpdate;
+            std::string nextUpdate;
+            std::string issuer;
+            std::string issuingDistributionPoint;
+            std::string crlNumber;
+            std::string baseCrlNumber;
+            StringsList freshestCrlUrls;
+            SerialNumbers revokedSerialNumbers;
+            SerialNumbers removedSerialNumbers;
+        };
+
+        //
+        // Wait-free access to the published snapshot, following the
+        // left-right scheme: a reader registers in the read indicator of the
+        // current version, then takes the snapshot of the current slot,
+        // with neither a lock nor a retry. Publish() writes the unused slot,
+        // switches the readers to it, and waits for the readers of both
+        // versions to leave before the previous snapshot is released.
+        //
+        class SnapshotReader : public NonCopyable
+        {
+        public:
+            explicit SnapshotReader(const CertificateRevocationList & list);
+            ~SnapshotReader();
+
+            const Snapshot * operator->() const
+            {
+                return m_snapshot;
+            }
+
+        private:
+            std::atomic<size_t> & m_readIndicator;
+            const Snapshot * m_snapshot;
+        };
+
+        void ParseRevocationList(CryptoPP::BufferedTransformation & crlData);
+        static void DecodeRevocationList(CryptoPP::BufferedTransformation & crlData, DecodedList & decoded);
+        static void DecodeCrlExtensions(CryptoPP::BERSequenceDecoder & toBeSignedCertList, DecodedList & decoded);
+        static bool RemovedFromCrl(CryptoPP::BERSequenceDecoder & revokedCertificate);
+        static std::string ThisUpdateDateOf(CryptoPP::BufferedTransformation & crlData);
+        static void ReadUpdateDates(
+            CryptoPP::BERSequenceDecoder & toBeSignedCertList,
+            std::string & issuer,
+            std::string & thisUpdate,
+            std::string & nextUpdate
+            );
+        static void CollectScopes(Snapshot & snapshot);
+        const Snapshot & PublishedSnapshot() const;
+        void Publish(std::unique_ptr<const Snapshot> snapshot);
+        void WaitForReaders(size_t version) const;
 
+        static bool ToSerialNumber(const CryptoPP::Integer & value, SerialNumber & serialNumber);
+        static bool ToSerialNumber(const std::string & value, SerialNumber & serialNumber);
+        static bool ToSerialNumber(const Buffer & encoded, SerialNumber & serialNumber);
+        bool Revoked(const SerialNumber & serialNumber) const;
 
     private:
-        mutable std::mutex m_sync;
-        std::string m_thisUpdate;
-        std::string m_nextUpdate;
-        StringsSet m_revokedSerialNumbers;
+        std::mutex m_writeSync;
+        std::unique_ptr<const Snapshot> m_snapshots[2];
+        std::atomic<size_t> m_currentSlot;
+        std::atomic<size_t> m_version;
+        mutable std::atomic<size_t> m_readIndicators[2];
     };
 }
 
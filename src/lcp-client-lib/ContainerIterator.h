@@ -122,11 +122,67 @@ namespace lcp
         }
     };
 
+    template<typename KeyType, typename ValueType, typename Container>
+    class AssociativeRangeIterator : public IKeyValueIterator<KeyType, ValueType>
+    {
+    protected:
+        typename Container::const_iterator m_begin;
+        typename Container::const_iterator m_end;
+        typename Container::const_iterator m_current;
+
+    public:
+        AssociativeRangeIterator(
+            typename Container::const_iterator begin,
+            typename Container::const_iterator end
+            )
+            : m_begin(begin)
+            , m_end(end)
+            , m_current(begin)
+        {
+        }
+
+        virtual void First()
+        {
+            m_current = m_begin;
+        }
+
+        virtual void Next()
+        {
+            ++m_current;
+        }
+
+        virtual bool IsDone() const
+        {
+            return (m_current == m_end);
+        }
+
+        virtual KeyType CurrentKey() const
+        {
+            if (IsDone())
+            {
+                throw std::out_of_range("Iterator is out of range");
+            }
+            return m_current->first;
+        }
+
+        virtual const ValueType & Current() const
+        {
+            if (IsDone())
+            {
+                throw std::out_of_range("Iterator is out of range");
+            }
+            return m_current->second;
+        }
+    };
+
     template<typename ValueType>
     using MapIterator = AssociativeIterator<std::string, ValueType, std::map<std::string, ValueType> >;
 
     template<typename ValueType>
     using MultiMapIterator = AssociativeIterator<std::string, ValueType, std::multimap<std::string, ValueType> >;
+
+    template<typename ValueType>
+    using MapRangeIterator = AssociativeRangeIterator<std::string, ValueType, std::map<std::string, ValueType> >;
 }
 
 #endif //__CONTAINER_ITERATOR_H__
@@ -29,8 +29,21 @@
 
 #include <algorithm>
 #include <iterator>
+#include <sstream>
 #include <thread>
 #include "CrlUpdater.h"
+#include "CertificateRevocationList.h"
+#include "CryptoppUtils.h"
+#include "Statistics.h"
+#include "TraceSpan.h"
+#include "public/IStorageProvider.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+CRYPTOPP_INCLUDE_END
 
 #if !DISABLE_NET_PROVIDER
 #if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
@@ -43,11 +56,16 @@
 #endif //!DISABLE_NET_PROVIDER
 
 #include "DateTime.h"
-#include "ThreadTimer.h"
 
 namespace lcp
 {
     const int CrlUpdater::TenMinutesPeriod = 1000 * 60 * 10;
+    const int CrlUpdater::DefaultRequestTimeout = 1000 * 30;
+    const char * CrlUpdater::CacheMagic = "lcp-crl/2";
+    const int64_t CrlUpdater::MaxCacheHeaderSize = 256;
+    const size_t CrlUpdater::CacheCopyChunkSize = 64 * 1024;
+    const char * CrlUpdater::CacheMacKeyName = "crlCacheMacKey";
+    const size_t CrlUpdater::CacheMacKeySize = 32;
     
     CrlUpdater::CrlUpdater(
 #if !DISABLE_NET_PROVIDER
@@ -55,30 +73,75 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
 
             IFileSystemProvider * fileSystemProvider,
+        IStorageProvider * storageProvider,
 
         ICertificateRevocationList * revocationList,
 #if !DISABLE_CRL_BACKGROUND_POLL
-        ThreadTimer * threadTimer,
+        Scheduler * scheduler,
 #endif //!DISABLE_CRL_BACKGROUND_POLL
-        const std::string & defaultCrlUrl
+        const std::string & defaultCrlUrl,
+        const std::string & cachePath
         )
-        : m_requestRunning(false)
+        :
 #if !DISABLE_NET_PROVIDER
-        , m_netProvider(netProvider)
+        m_netProvider(netProvider),
 #endif //!DISABLE_NET_PROVIDER
-
-            , m_fileSystemProvider(fileSystemProvider)
-
-        , m_revocationList(revocationList)
+        m_revocationList(revocationList)
 #if !DISABLE_CRL_BACKGROUND_POLL
-          , m_threadTimer(threadTimer)
+        , m_scheduler(scheduler)
+        , m_pollTask(0)
 #endif //!DISABLE_CRL_BACKGROUND_POLL
+        , m_fileSystemProvider(fileSystemProvider)
+        , m_storageProvider(storageProvider)
+        , m_traceSink(nullptr)
+        , m_cachePath(cachePath)
+        , m_cacheLoaded(false)
+#if !DISABLE_NET_PROVIDER
+        , m_requestTimeout(DefaultRequestTimeout)
+        , m_canceled(false)
+#endif //!DISABLE_NET_PROVIDER
         , m_currentRequestStatus(Status(StatusCode::ErrorCommonSuccess))
     {
         if (!defaultCrlUrl.empty())
         {
             m_crlUrls.push_back(defaultCrlUrl);
         }
+
+        if (!m_cachePath.empty() && m_fileSystemProvider != nullptr && m_storageProvider != nullptr)
+        {
+            try
+            {
+                this->LoadCacheMacKey();
+            }
+            catch (const std::exception &)
+            {
+                // Without its key the cache is neither read nor written
+                m_cacheMacKey.clear();
+            }
+        }
+
+#if !DISABLE_CRL_BACKGROUND_POLL
+        if (m_scheduler != nullptr)
+        {
+            m_pollTask = m_scheduler->Register(std::bind(&CrlUpdater::Poll, this));
+        }
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+    }
+
+    CrlUpdater::~CrlUpdater()
+    {
+#if !DISABLE_CRL_BACKGROUND_POLL
+        if (m_scheduler != nullptr)
+        {
+            m_scheduler->Unschedule(m_pollTask);
+            this->Cancel();
+            m_scheduler->Unregister(m_pollTask);
+        }
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+#if !DISABLE_NET_PROVIDER
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        this->ReleaseAbandonedDownloads(locker, true);
+#endif //!DISABLE_NET_PROVIDER
     }
 
     void CrlUpdater::UpdateCrlUrls(ICrlDistributionPoints * distributionPoints)
@@ -111,65 +174,665 @@ namespace lcp
     void CrlUpdater::Update()
     {
         std::unique_lock<std::mutex> locker(m_downloadSync);
-        
-        // If the list will be changed, it won't affect current update
-        StringsList curUrls = m_crlUrls;
 
 #if !DISABLE_NET_PROVIDER
+        // Services created without a net provider only use cached lists
+        if (m_canceled || m_netProvider == nullptr)
+        {
+            return;
+        }
+
+        Statistics::Timer timer(StatisticsOperation::CrlUpdate);
+        TraceSpan span(m_traceSink, "CrlUpdater::Update");
         m_currentRequestStatus = Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed");
+
+        // While the base list is current, only the changes published since
+        // are fetched; the full list is the fallback.
+        StringsList deltaUrls = m_revocationList->FreshestCrlUrls();
+        if (!deltaUrls.empty() && this->BaseListIsCurrent())
+        {
+            bool deltasApplied = this->FetchLists(deltaUrls, locker, true);
+            span.SetAttribute("deltaUrls", static_cast<int64_t>(deltaUrls.size()));
+            span.SetAttribute("deltasApplied", deltasApplied ? "true" : "false");
+            if (deltasApplied || m_canceled)
+            {
+                return;
+            }
+        }
+
+        // If the list will be changed, it won't affect current update
+        StringsList curUrls = m_crlUrls;
+        bool listApplied = this->FetchLists(curUrls, locker, false);
+        span.SetAttribute("urls", static_cast<int64_t>(curUrls.size()));
+        span.SetAttribute("listApplied", listApplied ? "true" : "false");
 #else
         m_currentRequestStatus = Status(StatusCode::ErrorCommonSuccess);
 #endif //!DISABLE_NET_PROVIDER
+    }
 
-        for (auto const & url : curUrls)
+#if !DISABLE_NET_PROVIDER
+    //
+    // Fetches every url at once, returns true when the list in use is up
+    // to date with the answers.
+    //
+    bool CrlUpdater::FetchLists(const StringsList & urls, std::unique_lock<std::mutex> & locker, bool deltas)
+    {
+        this->ReleaseAbandonedDownloads(locker, false);
+        m_downloads.clear();
+        for (auto const & url : urls)
         {
-            this->Download(url);
-            m_conditionDownload.wait(locker, [&]() { return !m_requestRunning; });
+            m_downloads.push_back(this->CreateDownload(url, m_downloads.size()));
+        }
 
-            if (Status::IsSuccess(m_currentRequestStatus)
-#if !DISABLE_NET_PROVIDER
-                || m_downloadRequest->Canceled()
+        // Net providers may end a request before returning from the start call
+        std::vector<BaseDownloadRequest *> requests;
+        for (auto const & download : m_downloads)
+        {
+            requests.push_back(download->request.get());
+        }
+        locker.unlock();
+        for (auto request : requests)
+        {
+            m_netProvider->StartDownloadRequest(request, this);
+        }
+        locker.lock();
+
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + m_requestTimeout;
+        m_conditionDownload.wait_until(locker, deadline, [&]() { return m_canceled || this->DownloadsEnded(); });
+        this->AbandonPendingDownloads();
+
+        bool upToDate = false;
+        if (!m_canceled)
+        {
+            upToDate = this->ApplyDownloads(deltas);
+        }
+        m_downloads.clear();
+        return upToDate;
+    }
+
+    bool CrlUpdater::BaseListIsCurrent() const
+    {
+        try
+        {
+            return (!m_baseNextUpdate.empty() && DateTime(m_baseNextUpdate) > DateTime::Now());
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
 #endif //!DISABLE_NET_PROVIDER
-                    )
+
+    void CrlUpdater::LoadCachedList()
+    {
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        if (m_cacheLoaded)
+        {
+            return;
+        }
+        m_cacheLoaded = true;
+
+        if (m_cachePath.empty() || m_revocationList->HasThisUpdateDate())
+        {
+            return;
+        }
+
+        CacheHeader baseHeader;
+        if (!this->ReadCacheHeader(this->CachePath(false), baseHeader) || !this->LoadCacheFile(this->CachePath(false), baseHeader))
+        {
+            // A missing, forged or damaged cache is dropped, the list is
+            // downloaded instead
+            this->PollAfterFailedLoad();
+            return;
+        }
+        m_baseNextUpdate = baseHeader.nextUpdate;
+
+        // The base list stays in use until a delta is downloaded
+        CacheHeader deltaHeader;
+        bool deltaLoaded = this->ReadCacheHeader(this->CachePath(true), deltaHeader) &&
+            this->LoadCacheFile(this->CachePath(true), deltaHeader);
+        if (!deltaLoaded && !m_revocationList->FreshestCrlUrls().empty())
+        {
+            this->PollAfterFailedLoad();
+            return;
+        }
+
+        // Without a default URL no poll was started: the loaded list is
+        // refreshed at its next update date, right away once it has passed
+        this->PollAtNextUpdate(deltaLoaded ? deltaHeader.nextUpdate : baseHeader.nextUpdate);
+    }
+
+    bool CrlUpdater::LoadCacheFile(const std::string & path, const CacheHeader & cacheHeader)
+    {
+        try
+        {
+            // The list is only decoded once it matches the authenticated header
+            std::unique_ptr<IFile> cacheFile(m_fileSystemProvider->GetFile(path, IFileSystemProvider::ReadOnly));
+            if (ListDigest(cacheFile.get(), cacheHeader.listPosition) != cacheHeader.listDigest)
             {
-                break;
+                return false;
+            }
+            cacheFile->SetReadPosition(cacheHeader.listPosition);
+            m_revocationList->UpdateRevocationList(cacheFile.get());
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    void CrlUpdater::PollAfterFailedLoad()
+    {
+#if !DISABLE_CRL_BACKGROUND_POLL
+        if (m_scheduler != nullptr && !m_crlUrls.empty())
+        {
+            this->PollNow();
+        }
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+    }
+
+    void CrlUpdater::PollAtNextUpdate(const std::string & nextUpdateDate)
+    {
+#if !DISABLE_CRL_BACKGROUND_POLL
+        // StartPolling() has already scheduled it from the default URL
+        if (m_scheduler == nullptr || m_crlUrls.empty() || m_scheduler->IsScheduled(m_pollTask))
+        {
+            return;
+        }
+
+        bool current = false;
+        try
+        {
+            current = !nextUpdateDate.empty() && DateTime(nextUpdateDate) > DateTime::Now();
+        }
+        catch (const std::exception &)
+        {
+        }
+
+        if (current)
+        {
+            this->ScheduleNextUpdate(nextUpdateDate);
+        }
+        else
+        {
+            this->PollNow();
+        }
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+    }
+
+    std::string CrlUpdater::CachedNextUpdate()
+    {
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        CacheHeader header;
+        if (!this->ReadCacheHeader(this->CachePath(false), header))
+        {
+            return std::string();
+        }
+
+        // A cached delta is newer than its base
+        CacheHeader deltaHeader;
+        if (this->ReadCacheHeader(this->CachePath(true), deltaHeader))
+        {
+            return deltaHeader.nextUpdate;
+        }
+        return header.nextUpdate;
+    }
+
+    bool CrlUpdater::CachedListIsCurrent()
+    {
+        std::string nextUpdate = this->CachedNextUpdate();
+        if (nextUpdate.empty())
+        {
+            return false;
+        }
+
+        try
+        {
+            return (DateTime(nextUpdate) > DateTime::Now());
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+#if !DISABLE_CRL_BACKGROUND_POLL
+    void CrlUpdater::StartPolling()
+    {
+        if (this->CachedListIsCurrent())
+        {
+            this->ScheduleNextUpdate(this->CachedNextUpdate());
+        }
+        else
+        {
+            this->PollNow();
+        }
+    }
+
+    void CrlUpdater::PollNow()
+    {
+        m_scheduler->ScheduleAfter(m_pollTask, Scheduler::DurationType::zero());
+    }
+
+    void CrlUpdater::RethrowExceptionIfAny()
+    {
+        std::exception_ptr pollException;
+        {
+            std::unique_lock<std::mutex> locker(m_pollSync);
+            std::swap(pollException, m_pollException);
+        }
+        if (pollException != nullptr)
+        {
+            std::rethrow_exception(pollException);
+        }
+    }
+
+    void CrlUpdater::Poll()
+    {
+        try
+        {
+            this->Update();
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> locker(m_pollSync);
+            m_pollException = std::current_exception();
+        }
+
+        // A successful update schedules the poll at the next update date
+        if (!m_scheduler->IsScheduled(m_pollTask))
+        {
+            m_scheduler->ScheduleAfter(m_pollTask, Scheduler::DurationType(TenMinutesPeriod));
+        }
+    }
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+
+    //
+    // The base list and the last delta applied on top of it are cached in
+    // two files, each starting with a text header the DER encoded list
+    // follows:
+    //   lcp-crl/2\n<this update>\n<next update>\n<list digest>\n<mac>\n<list>
+    // The list digest is the hex SHA-256 of the list, the mac the hex
+    // HMAC-SHA256 of the header lines before it. Files are written under a
+    // temporary name, then renamed over the previous ones.
+    //
+    std::string CrlUpdater::CachePath(bool delta) const
+    {
+        return delta ? m_cachePath + ".delta" : m_cachePath;
+    }
+
+    bool CrlUpdater::ReadCacheHeader(const std::string & path, CacheHeader & cacheHeader)
+    {
+        if (m_cacheMacKey.empty())
+        {
+            return false;
+        }
+
+        try
+        {
+            std::unique_ptr<IFile> cacheFile(m_fileSystemProvider->GetFile(path, IFileSystemProvider::ReadOnly));
+            std::string header(static_cast<size_t>(std::min<int64_t>(cacheFile->Size(), MaxCacheHeaderSize)), '\0');
+            cacheFile->Read(reinterpret_cast<unsigned char *>(&header[0]), header.size());
+
+            size_t lineEnds[5];
+            size_t lineEnd = std::string::npos;
+            for (size_t i = 0; i < 5; ++i)
+            {
+                lineEnd = header.find('\n', (i == 0) ? 0 : lineEnd + 1);
+                if (lineEnd == std::string::npos)
+                {
+                    return false;
+                }
+                lineEnds[i] = lineEnd;
+            }
+            if (header.compare(0, lineEnds[0], CacheMagic) != 0)
+            {
+                return false;
             }
+
+            // Nothing in the header is trusted before its mac is checked
+            std::string mac = header.substr(lineEnds[3] + 1, lineEnds[4] - lineEnds[3] - 1);
+            std::string expectedMac = this->CalculateCacheMac(header.substr(0, lineEnds[3] + 1));
+            if (mac.size() != expectedMac.size() || !CryptoPP::VerifyBufsEqual(
+                reinterpret_cast<const byte *>(mac.data()), reinterpret_cast<const byte *>(expectedMac.data()), mac.size()))
+            {
+                return false;
+            }
+
+            cacheHeader.nextUpdate = header.substr(lineEnds[1] + 1, lineEnds[2] - lineEnds[1] - 1);
+            cacheHeader.listDigest = header.substr(lineEnds[2] + 1, lineEnds[3] - lineEnds[2] - 1);
+            cacheHeader.listPosition = static_cast<int64_t>(lineEnds[4] + 1);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    std::unique_ptr<IFile> CrlUpdater::CreateCacheFile(bool delta, const std::string & listDigest)
+    {
+        std::string thisUpdate = m_revocationList->ThisUpdateDate();
+        std::string nextUpdate = m_revocationList->NextUpdateDate();
+        std::unique_ptr<IFile> cacheFile(m_fileSystemProvider->GetFile(this->CachePath(delta) + ".tmp", IFileSystemProvider::CreateNew));
+        std::string header = std::string(CacheMagic) + "\n" + thisUpdate + "\n" + nextUpdate + "\n" + listDigest + "\n";
+        header += this->CalculateCacheMac(header) + "\n";
+        cacheFile->Write(reinterpret_cast<const unsigned char *>(header.data()), header.size());
+        return cacheFile;
+    }
+
+    void CrlUpdater::CommitCacheFile(std::unique_ptr<IFile> cacheFile, bool delta)
+    {
+        cacheFile->Flush();
+        std::string tempPath = cacheFile->Path();
+        cacheFile.reset();
+
+        if (!delta)
+        {
+            // Deltas cached so far refer to the previous base
+            std::unique_ptr<IFile> deltaCacheFile(m_fileSystemProvider->GetFile(this->CachePath(true), IFileSystemProvider::CreateNew));
+        }
+        m_fileSystemProvider->RenameFile(tempPath, this->CachePath(delta));
+    }
+
+    void CrlUpdater::StoreCachedList(const Buffer & crlRaw, bool delta)
+    {
+        if (m_cacheMacKey.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            Buffer digest(CryptoPP::SHA256::DIGESTSIZE);
+            CryptoPP::SHA256().CalculateDigest(digest.data(), crlRaw.data(), crlRaw.size());
+
+            std::unique_ptr<IFile> cacheFile = this->CreateCacheFile(delta, CryptoppUtils::RawToHex(digest));
+            cacheFile->Write(crlRaw.data(), crlRaw.size());
+            this->CommitCacheFile(std::move(cacheFile), delta);
+        }
+        catch (const std::exception &)
+        {
+            // The cache only saves a download on next start, the list is already updated
         }
     }
 
+    void CrlUpdater::StoreCachedList(IReadableStream * crlStream, bool delta)
+    {
+        if (m_cacheMacKey.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            std::unique_ptr<IFile> cacheFile = this->CreateCacheFile(delta, ListDigest(crlStream, 0));
+
+            Buffer chunk(CacheCopyChunkSize);
+            int64_t size = crlStream->Size();
+            crlStream->SetReadPosition(0);
+            for (int64_t copied = 0; copied < size; )
+            {
+                int64_t length = std::min<int64_t>(chunk.size(), size - copied);
+                crlStream->Read(chunk.data(), length);
+                cacheFile->Write(chunk.data(), length);
+                copied += length;
+            }
+            this->CommitCacheFile(std::move(cacheFile), delta);
+        }
+        catch (const std::exception &)
+        {
+            // The cache only saves a download on next start, the list is already updated
+        }
+    }
+
+    void CrlUpdater::LoadCacheMacKey()
+    {
+        std::string macKeyHex = m_storageProvider->GetValue(VerificationCacheVaultId, CacheMacKeyName);
+        if (!macKeyHex.empty())
+        {
+            m_cacheMacKey = CryptoppUtils::HexToRaw(macKeyHex);
+            return;
+        }
+
+        // The key never leaves the secure storage of this device
+        CryptoPP::AutoSeededRandomPool rnd;
+        m_cacheMacKey.resize(CacheMacKeySize);
+        rnd.GenerateBlock(m_cacheMacKey.data(), m_cacheMacKey.size());
+        m_storageProvider->SetValue(VerificationCacheVaultId, CacheMacKeyName, CryptoppUtils::RawToHex(m_cacheMacKey));
+    }
+
+    std::string CrlUpdater::CalculateCacheMac(const std::string & header) const
+    {
+        CryptoPP::HMAC<CryptoPP::SHA256> hmac(m_cacheMacKey.data(), m_cacheMacKey.size());
+        Buffer mac(hmac.DigestSize());
+        hmac.CalculateDigest(mac.data(), reinterpret_cast<const byte *>(header.data()), header.size());
+        return CryptoppUtils::RawToHex(mac);
+    }
+
+    /*static*/ std::string CrlUpdater::ListDigest(IReadableStream * stream, int64_t position)
+    {
+        CryptoPP::SHA256 hash;
+        Buffer chunk(CacheCopyChunkSize);
+        int64_t size = stream->Size();
+        stream->SetReadPosition(position);
+        for (int64_t read = position; read < size; )
+        {
+            int64_t length = std::min<int64_t>(chunk.size(), size - read);
+            stream->Read(chunk.data(), length);
+            hash.Update(chunk.data(), static_cast<size_t>(length));
+            read += length;
+        }
+
+        Buffer digest(hash.DigestSize());
+        hash.Final(digest.data());
+        return CryptoppUtils::RawToHex(digest);
+    }
+
     void CrlUpdater::Cancel()
     {
         std::unique_lock<std::mutex> locker(m_downloadSync);
 #if !DISABLE_NET_PROVIDER
-        if (m_downloadRequest.get() != nullptr)
+        m_canceled = true;
+        for (auto const & download : m_downloads)
         {
-            m_downloadRequest->SetCanceled(true);
+            download->request->SetCanceled(true);
         }
+        m_conditionDownload.notify_one();
 #endif //!DISABLE_NET_PROVIDER
     }
 
-    void CrlUpdater::Download(const std::string & url)
-    {
 #if !DISABLE_NET_PROVIDER
-        m_requestRunning = true;
+    void CrlUpdater::SetRequestTimeout(int timeoutMs)
+    {
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        m_requestTimeout = std::chrono::milliseconds(timeoutMs);
+    }
+
+    void CrlUpdater::SetTraceSink(ITraceSink * traceSink)
+    {
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        m_traceSink = traceSink;
+    }
+
+    std::unique_ptr<CrlUpdater::CrlDownload> CrlUpdater::CreateDownload(const std::string & url, size_t index)
+    {
+        std::unique_ptr<CrlDownload> download(new CrlDownload(url));
 
 #if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-        m_crlStream.reset(new SimpleMemoryWritableStream()); // not actually used with NetProvider Java which operates on File only :(
-        m_downloadRequest.reset(new DownloadInMemoryRequest(url, m_crlStream.get()));
+        download->stream.reset(new SimpleMemoryWritableStream()); // not actually used with NetProvider Java which operates on File only :(
+        download->request.reset(new DownloadInMemoryRequest(url, download->stream.get()));
 #else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-        m_crlFile.reset(m_fileSystemProvider->GetFile(PATH_TO_DOWNLOAD));
-        m_downloadRequest.reset(new DownloadInFileRequest(url, m_crlFile.get()));
+        std::stringstream path;
+        path << PATH_TO_DOWNLOAD << "." << index;
+        download->file.reset(m_fileSystemProvider->GetFile(path.str()));
+        download->request.reset(new DownloadInFileRequest(url, download->file.get()));
 #endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
 
-        m_netProvider->StartDownloadRequest(m_downloadRequest.get(), this);
-#else
-        m_currentRequestStatus = Status(StatusCode::ErrorCommonSuccess);
-        m_requestRunning = false;
-        m_conditionDownload.notify_one();
-#endif //!DISABLE_NET_PROVIDER
+        // Validators are only worth sending while the list they describe is in use
+        auto validators = m_validators.find(url);
+        if (validators != m_validators.end() && m_revocationList->HasThisUpdateDate())
+        {
+            download->request->SetConditions(validators->second.etag, validators->second.lastModified);
+        }
+        return download;
+    }
+
+    bool CrlUpdater::DownloadsEnded() const
+    {
+        return std::all_of(m_downloads.begin(), m_downloads.end(),
+            [](const std::unique_ptr<CrlDownload> & download) { return download->ended; });
+    }
+
+    void CrlUpdater::AbandonPendingDownloads()
+    {
+        for (auto & download : m_downloads)
+        {
+            if (!download->ended)
+            {
+                download->request->SetCanceled(true);
+                m_netProvider->CancelDownloadRequest(download->request.get());
+                m_abandonedDownloads.push_back(std::move(download));
+            }
+        }
+        m_downloads.erase(
+            std::remove(m_downloads.begin(), m_downloads.end(), nullptr),
+            m_downloads.end()
+            );
+    }
+
+    //
+    // Frees the abandoned downloads the net provider has ended. The callback
+    // which ended them has returned once the lock is held here.
+    //
+    void CrlUpdater::ReleaseAbandonedDownloads(std::unique_lock<std::mutex> & locker, bool waitForEnd)
+    {
+        if (waitForEnd)
+        {
+            m_conditionDownload.wait(locker, [&]() {
+                return std::all_of(m_abandonedDownloads.begin(), m_abandonedDownloads.end(),
+                    [](const std::unique_ptr<CrlDownload> & download) { return download->ended; });
+            });
+        }
+        m_abandonedDownloads.remove_if(
+            [](const std::unique_ptr<CrlDownload> & download) { return download->ended; });
+    }
+
+    //
+    // Picks the list with the latest thisUpdate among the answers, and
+    // decodes it only when it is newer than the list already in use.
+    //
+    bool CrlUpdater::ApplyDownloads(bool deltas)
+    {
+        std::vector<std::pair<Time64_T, CrlDownload *>> candidates;
+        bool anySucceeded = false;
+        for (auto const & download : m_downloads)
+        {
+            if (!Status::IsSuccess(download->status))
+            {
+                continue;
+            }
+            anySucceeded = true;
+            if (download->request->NotModified())
+            {
+                continue;
+            }
+
+            try
+            {
+                DateTime thisUpdate(this->DownloadedThisUpdate(download.get()));
+                candidates.push_back(std::make_pair(thisUpdate.ToTime(), download.get()));
+            }
+            catch (const std::exception &)
+            {
+                continue;
+            }
+
+            CrlValidators & validators = m_validators[download->url];
+            validators.etag = download->request->ETag();
+            validators.lastModified = download->request->LastModified();
+        }
+
+        std::stable_sort(candidates.begin(), candidates.end(),
+            [](const std::pair<Time64_T, CrlDownload *> & left, const std::pair<Time64_T, CrlDownload *> & right) { return left.first > right.first; });
+
+        Time64_T currentThisUpdate = 0;
+        if (m_revocationList->HasThisUpdateDate())
+        {
+            currentThisUpdate = DateTime(m_revocationList->ThisUpdateDate()).ToTime();
+        }
+
+        bool upToDate = true;
+        for (auto const & candidate : candidates)
+        {
+            if (currentThisUpdate != 0 && candidate.first <= currentThisUpdate)
+            {
+                break;
+            }
+
+            try
+            {
+                this->ApplyDownload(candidate.second, deltas);
+                upToDate = true;
+                break;
+            }
+            catch (const std::exception &)
+            {
+                // A delta made for a newer base than ours is not applied either
+                upToDate = false;
+                continue;
+            }
+        }
+
+        if (anySucceeded)
+        {
+            m_currentRequestStatus = Status(StatusCode::ErrorCommonSuccess);
+            this->ResetNextUpdate();
+        }
+        return (anySucceeded && upToDate);
+    }
+
+    std::string CrlUpdater::DownloadedThisUpdate(CrlDownload * download)
+    {
+#if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+        std::string path = download->request->SuggestedFileName();
+        if (path.length() && path.at(0) == '/') { // SUPER HACKY!! (because Android NetProvider only handles file download)
+            std::unique_ptr<IFile> file(m_fileSystemProvider->GetFile(path, IFileSystemProvider::ReadOnly));
+            return CertificateRevocationList::ThisUpdateDateOf(file.get());
+        }
+        return CertificateRevocationList::ThisUpdateDateOf(download->stream->Buffer());
+#else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+        download->file->SetReadPosition(0);
+        return CertificateRevocationList::ThisUpdateDateOf(download->file.get());
+#endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+    }
+
+    void CrlUpdater::ApplyDownload(CrlDownload * download, bool delta)
+    {
+#if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+        std::string path = download->request->SuggestedFileName();
+        if (path.length() && path.at(0) == '/') { // SUPER HACKY!! (because Android NetProvider only handles file download)
+            std::unique_ptr<IFile> file(m_fileSystemProvider->GetFile(path, IFileSystemProvider::ReadOnly));
+            m_revocationList->UpdateRevocationList(file.get());
+            this->StoreCachedList(file.get(), delta);
+        } else {
+            m_revocationList->UpdateRevocationList(download->stream->Buffer()); //std::vector<unsigned char>
+            this->StoreCachedList(download->stream->Buffer(), delta);
+        }
+#else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+        // IFile == IReadableStream
+        download->file->SetReadPosition(0);
+        m_revocationList->UpdateRevocationList(download->file.get());
+        this->StoreCachedList(download->file.get(), delta);
+#endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+
+        if (!delta)
+        {
+            m_baseNextUpdate = m_revocationList->NextUpdateDate();
+        }
     }
 
-#if !DISABLE_NET_PROVIDER
     void CrlUpdater::OnRequestStarted(INetRequest * request)
     {
         bool breakpoint = true;
@@ -182,107 +845,53 @@ namespace lcp
 
     void CrlUpdater::OnRequestCanceled(INetRequest * request)
     {
-        std::unique_lock<std::mutex> locker(m_downloadSync);
-        m_requestRunning = false;
-        m_conditionDownload.notify_one();
+        this->OnRequestEnded(request, Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed: canceled"));
     }
 
     void CrlUpdater::OnRequestEnded(INetRequest * request, Status result)
     {
-        try
+        std::unique_lock<std::mutex> locker(m_downloadSync);
+        for (auto const & download : m_abandonedDownloads)
         {
-            std::unique_lock<std::mutex> locker(m_downloadSync);
-            if (Status::IsSuccess(result))
+            if (download->request.get() == request)
             {
-#if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-                lcp::BaseDownloadRequest* request_ = dynamic_cast<lcp::BaseDownloadRequest*>(request);
-                if (request_) {
-                    std::string path = request_->SuggestedFileName();
-                    if (path.length() && path.at(0) == '/') { // SUPER HACKY!! (because Android NetProvider only handles file download)
-                        IFile* file = m_fileSystemProvider->GetFile(path, IFileSystemProvider::ReadOnly);
-
-                        size_t bufferSize = 1024 * 1024;
-                        std::vector<unsigned char> buffer(bufferSize);
-
-                        size_t read = 0;
-                        size_t sizeToRead = bufferSize;
-                        size_t fileSize = static_cast<size_t>(file->Size());
-                        while (read != fileSize)
-                        {
-                            sizeToRead = (fileSize - read > bufferSize) ? bufferSize : fileSize - read;
-                            file->Read(buffer.data(), sizeToRead);
-                            read += sizeToRead;
-                        }
-
-                        delete file;
-
-                        m_revocationList->UpdateRevocationList(buffer); //std::vector<unsigned char>
-                    } else {
-                        m_revocationList->UpdateRevocationList(m_crlStream->Buffer()); //std::vector<unsigned char>
-                    }
-                }
-
-#else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-                // IFile == IReadableStream
-                size_t bufferSize = 1024 * 1024;
-                std::vector<unsigned char> buffer(bufferSize);
-
-                size_t read = 0;
-                size_t sizeToRead = bufferSize;
-                size_t fileSize = static_cast<size_t>(m_crlFile->Size());
-                while (read != fileSize)
-                {
-                    sizeToRead = (fileSize - read > bufferSize) ? bufferSize : fileSize - read;
-                    m_crlFile->Read(buffer.data(), sizeToRead);
-                    read += sizeToRead;
-                }
-
-                m_revocationList->UpdateRevocationList(buffer); //std::vector<unsigned char>
-#endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-
-                this->ResetNextUpdate();
+                download->ended = true;
+                m_conditionDownload.notify_all();
+                return;
             }
-            m_currentRequestStatus = result;
-            m_requestRunning = false;
-            m_conditionDownload.notify_one();
         }
-        catch (const std::exception & ex)
+
+        for (auto const & download : m_downloads)
         {
-            m_currentRequestStatus = Status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed: " + std::string(ex.what()));
-            m_requestRunning = false;
-            m_conditionDownload.notify_one();
+            if (download->request.get() == request)
+            {
+                download->status = result;
+                download->ended = true;
+                m_conditionDownload.notify_all();
+                break;
+            }
         }
     }
 #endif //!DISABLE_NET_PROVIDER
 
     void CrlUpdater::ResetNextUpdate()
+    {
+        this->ScheduleNextUpdate(m_revocationList->NextUpdateDate());
+    }
+
+    void CrlUpdater::ScheduleNextUpdate(const std::string & nextUpdateDate)
     {
 #if !DISABLE_CRL_BACKGROUND_POLL
-        if (m_revocationList->HasNextUpdateDate())
+        if (!nextUpdateDate.empty())
         {
-            DateTime nextUpdate(m_revocationList->NextUpdateDate());
+            DateTime nextUpdate(nextUpdateDate);
             if (nextUpdate > DateTime::Now())
             {
-                m_threadTimer->SetUsage(ThreadTimer::TimePointUsage);
-                m_threadTimer->SetTimePoint(ThreadTimer::ClockType::from_time_t(nextUpdate.ToTime()));
-            }
-            else
-            {
-                m_threadTimer->SetUsage(ThreadTimer::DurationUsage);
-                m_threadTimer->SetDuration(ThreadTimer::DurationType(TenMinutesPeriod));
+                m_scheduler->ScheduleAt(m_pollTask, std::chrono::system_clock::from_time_t(nextUpdate.ToTime()));
+                return;
             }
         }
-        else
-        {
-            m_threadTimer->SetUsage(ThreadTimer::DurationUsage);
-            m_threadTimer->SetDuration(ThreadTimer::DurationType(TenMinutesPeriod));
-        }
-//
-//// TODO: remove this, for testing async update only!
-//        m_threadTimer->SetUsage(ThreadTimer::DurationUsage);
-//        m_threadTimer->SetDuration(ThreadTimer::DurationType(2000)); //TenMinutesPeriod == 1000 * 60 * 10
-
-        m_threadTimer->SetAutoReset(true);
+        m_scheduler->ScheduleAfter(m_pollTask, Scheduler::DurationType(TenMinutesPeriod));
 #endif //!DISABLE_CRL_BACKGROUND_POLL
     }
 }
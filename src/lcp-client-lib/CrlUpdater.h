@@ -30,14 +30,21 @@
 
 #if !DISABLE_CRL
 
+#include <chrono>
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <condition_variable>
+#include <exception>
 #include "public/lcp.h"
+#include "public/ITraceSink.h"
 #include "ICertificate.h"
 
 #if !DISABLE_NET_PROVIDER
 #include "public/INetProvider.h"
+#include "BaseDownloadRequest.h"
 #endif //!DISABLE_NET_PROVIDER
 
 #include "NonCopyable.h"
@@ -48,13 +55,14 @@
 
 #include "public/IFileSystemProvider.h"
 
+#if !DISABLE_CRL_BACKGROUND_POLL
+#include "Scheduler.h"
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+
 namespace lcp
 {
-    class ThreadTimer;
     class CrlDownloader;
-#if !DISABLE_NET_PROVIDER
-    class IDownloadRequest;
-#endif //!DISABLE_NET_PROVIDER
+    class IStorageProvider;
 
     class CrlUpdater :
 #if !DISABLE_NET_PROVIDER
@@ -69,21 +77,67 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
 
                 IFileSystemProvider * fileSystemProvider,
+            IStorageProvider * storageProvider,
 
             ICertificateRevocationList * revocationList,
 #if !DISABLE_CRL_BACKGROUND_POLL
-            ThreadTimer * threadTimer,
+            Scheduler * scheduler,
 #endif //!DISABLE_CRL_BACKGROUND_POLL
-            const std::string & defaultCrlUrl
+            const std::string & defaultCrlUrl,
+            const std::string & cachePath = std::string()
             );
+        ~CrlUpdater();
 
+        //
+        // Fetches every distribution point at once and applies the freshest
+        // valid list. Requests still running after the request timeout are
+        // canceled and their answers ignored. While the base list is current
+        // and announces delta CRLs, only the deltas are fetched.
+        //
         void Update();
         void Cancel();
+        void SetRequestTimeout(int timeoutMs);
+        void SetTraceSink(ITraceSink * traceSink);
 
         void UpdateCrlUrls(ICrlDistributionPoints * distributionPoints);
         bool ContainsUrl(const std::string & url);
         bool ContainsAnyUrl() const;
 
+        //
+        // Decodes the CRL cached by a previous run, on first use only.
+        // Nothing is loaded once a list has been downloaded. A cache failing
+        // to load polls the distribution points right away, a loaded one
+        // schedules the poll at its next update date, or right away when
+        // that date has passed.
+        //
+        void LoadCachedList();
+
+        //
+        // True when a cached CRL exists and its next update date, or the one
+        // of the delta CRL cached on top of it, is still in the future.
+        // The cache is authenticated with a HMAC whose key is kept in the
+        // IStorageProvider, so no cache is used without a storage provider.
+        //
+        bool CachedListIsCurrent();
+
+#if !DISABLE_CRL_BACKGROUND_POLL
+        //
+        // Schedules the first poll: at the next update date of a current
+        // cached list, right away otherwise.
+        //
+        void StartPolling();
+
+        //
+        // Polls as soon as a worker is free, without waiting for it.
+        //
+        void PollNow();
+
+        //
+        // Rethrows, once, the last exception raised by a background poll.
+        //
+        void RethrowExceptionIfAny();
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+
 #if !DISABLE_NET_PROVIDER
         // INetProviderCallback
         virtual void OnRequestStarted(INetRequest * request);
@@ -94,10 +148,84 @@ namespace lcp
 
     public:
         static const int TenMinutesPeriod;
+        static const int DefaultRequestTimeout;
+
+    private:
+        static const char * CacheMagic;
+        static const int64_t MaxCacheHeaderSize;
+        static const size_t CacheCopyChunkSize;
+        static const char * CacheMacKeyName;
+        static const size_t CacheMacKeySize;
 
     private:
-        void Download(const std::string & url);
+#if !DISABLE_NET_PROVIDER
+        struct CrlDownload
+        {
+            explicit CrlDownload(const std::string & url)
+                : url(url)
+                , ended(false)
+                , status(StatusCode::ErrorNetworkingRequestFailed, "ErrorNetworkingRequestFailed")
+            {
+            }
+
+            std::string url;
+#if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+            std::unique_ptr<SimpleMemoryWritableStream> stream;
+#else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+            std::unique_ptr<IFile> file;
+#endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+            std::unique_ptr<BaseDownloadRequest> request;
+            bool ended;
+            Status status;
+        };
+
+        //
+        // HTTP validators of the last list fetched from a distribution point.
+        //
+        struct CrlValidators
+        {
+            std::string etag;
+            std::string lastModified;
+        };
+
+        bool FetchLists(const StringsList & urls, std::unique_lock<std::mutex> & locker, bool deltas);
+        bool BaseListIsCurrent() const;
+        std::unique_ptr<CrlDownload> CreateDownload(const std::string & url, size_t index);
+        bool DownloadsEnded() const;
+        void AbandonPendingDownloads();
+        void ReleaseAbandonedDownloads(std::unique_lock<std::mutex> & locker, bool waitForEnd);
+        bool ApplyDownloads(bool deltas);
+        std::string DownloadedThisUpdate(CrlDownload * download);
+        void ApplyDownload(CrlDownload * download, bool delta);
+#endif //!DISABLE_NET_PROVIDER
+
+#if !DISABLE_CRL_BACKGROUND_POLL
+        void Poll();
+#endif //!DISABLE_CRL_BACKGROUND_POLL
+
         void ResetNextUpdate();
+        void ScheduleNextUpdate(const std::string & nextUpdateDate);
+
+        struct CacheHeader
+        {
+            std::string nextUpdate;
+            std::string listDigest;
+            int64_t listPosition;
+        };
+
+        std::string CachePath(bool delta) const;
+        std::string CachedNextUpdate();
+        bool ReadCacheHeader(const std::string & path, CacheHeader & cacheHeader);
+        bool LoadCacheFile(const std::string & path, const CacheHeader & cacheHeader);
+        void PollAfterFailedLoad();
+        void PollAtNextUpdate(const std::string & nextUpdateDate);
+        std::unique_ptr<IFile> CreateCacheFile(bool delta, const std::string & listDigest);
+        void CommitCacheFile(std::unique_ptr<IFile> cacheFile, bool delta);
+        void StoreCachedList(const Buffer & crlRaw, bool delta);
+        void StoreCachedList(IReadableStream * crlStream, bool delta);
+        void LoadCacheMacKey();
+        std::string CalculateCacheMac(const std::string & header) const;
+        static std::string ListDigest(IReadableStream * stream, int64_t position);
 
     private:
         StringsList m_crlUrls;
@@ -106,25 +234,34 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
         ICertificateRevocationList * m_revocationList;
 #if !DISABLE_CRL_BACKGROUND_POLL
-        ThreadTimer * m_threadTimer;
+        Scheduler * m_scheduler;
+        Scheduler::TaskId m_pollTask;
+        std::exception_ptr m_pollException;
+        std::mutex m_pollSync;
 #endif //!DISABLE_CRL_BACKGROUND_POLL
 
-#if !DISABLE_NET_PROVIDER
-
         IFileSystemProvider * m_fileSystemProvider;
+        IStorageProvider * m_storageProvider;
+        ITraceSink * m_traceSink;
 
-#if !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-        std::unique_ptr<SimpleMemoryWritableStream> m_crlStream;
-#else // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
-        std::unique_ptr<IFile> m_crlFile;
-#endif // !DISABLE_CRL_DOWNLOAD_IN_MEMORY
+        std::string m_cachePath;
+        KeyType m_cacheMacKey;
+        std::string m_baseNextUpdate;
+        bool m_cacheLoaded;
 
-        std::unique_ptr<IDownloadRequest> m_downloadRequest;
+#if !DISABLE_NET_PROVIDER
+        std::vector<std::unique_ptr<CrlDownload>> m_downloads;
+        // Timed out downloads, kept alive until the net provider ends them.
+        // They are released outside of the net provider's callbacks: by the
+        // next update, or by the destructor which waits for them to end.
+        std::list<std::unique_ptr<CrlDownload>> m_abandonedDownloads;
+        std::map<std::string, CrlValidators> m_validators;
+        std::chrono::milliseconds m_requestTimeout;
+        bool m_canceled;
 #endif //!DISABLE_NET_PROVIDER
 
         Status m_currentRequestStatus;
 
-        bool m_requestRunning;
         mutable std::mutex m_downloadSync;
         std::condition_variable m_conditionDownload;
     };
@@ -36,6 +36,36 @@ namespace lcp
 {
     class IDecryptionContext;
     class IReadableStream;
+    class IWritableStream;
+
+    //
+    // Encrypts a single message given in chunks. The output is written in
+    // the format read by ISymmetricAlgorithm::Decrypt(): a random IV, the
+    // cipher text and, for authenticated algorithms, the tag, completed by
+    // Finish().
+    //
+    class IEncryptor
+    {
+    public:
+        virtual void Update(const unsigned char * data, size_t dataLength) = 0;
+        virtual void Finish() = 0;
+        virtual ~IEncryptor() {}
+    };
+
+    //
+    // Decrypts a single message given in chunks, in the format written by
+    // IEncryptor, and writes the plain text as it goes. Finish() throws if
+    // the message is truncated or, for authenticated algorithms, if its
+    // tag does not match: the plain text written so far must then be
+    // discarded.
+    //
+    class IDecryptor
+    {
+    public:
+        virtual void Update(const unsigned char * data, size_t dataLength) = 0;
+        virtual void Finish() = 0;
+        virtual ~IDecryptor() {}
+    };
 
     class ISymmetricAlgorithm
     {
@@ -62,6 +92,21 @@ namespace lcp
 
         virtual size_t PlainTextSize(IReadableStream * stream) = 0;
 
+        //
+        // Creates an encryptor with the given key, writing to the given
+        // stream which must outlive it. The key is passed again since the
+        // algorithm only keeps the decryption key schedule, not the key.
+        //
+        virtual IEncryptor * CreateEncryptor(const KeyType & key, IWritableStream * output) = 0;
+
+        //
+        // Creates a decryptor sharing the key schedule of the algorithm,
+        // writing to the given stream; both must outlive it. Returns
+        // nullptr when the algorithm only decrypts by ranges, which is the
+        // default.
+        //
+        virtual IDecryptor * CreateDecryptor(IWritableStream * output) { return nullptr; }
+
         virtual ~ISymmetricAlgorithm() {}
     };
 
@@ -77,6 +122,18 @@ namespace lcp
         virtual ~IHashAlgorithm() {}
     };
 
+    //
+    // A hash algorithm whose intermediate state can be saved, to go on
+    // hashing the same data later, in another process.
+    //
+    class IResumableHashAlgorithm : public IHashAlgorithm
+    {
+    public:
+        virtual Buffer SaveState() const = 0;
+        // Returns false, leaving the algorithm unchanged, if the state is not valid
+        virtual bool RestoreState(const Buffer & state) = 0;
+    };
+
     class ISignatureAlgorithm
     {
     public:
@@ -36,7 +36,8 @@
 #if !DISABLE_CRL
 #include "CertificateRevocationList.h"
 #include "CrlUpdater.h"
-#include "ThreadTimer.h"
+#include "Scheduler.h"
+#include "Statistics.h"
 #endif //!DISABLE_CRL
 
 #include "DateTime.h"
@@ -45,6 +46,8 @@
 #include "CryptoppUtils.h"
 #include "Sha256HashAlgorithm.h"
 #include "SymmetricAlgorithmEncryptedStream.h"
+#include "VerificationCache.h"
+#include "TraceSpan.h"
 
 namespace lcp
 {
@@ -56,48 +59,49 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
 
             , IFileSystemProvider * fileSystemProvider
+        , IStorageProvider * storageProvider
 
 #if !DISABLE_CRL
         , const std::string & defaultCrlUrl
+        , const std::string & crlCachePath
+#if !DISABLE_CRL_BACKGROUND_POLL
+        , Scheduler * scheduler
+#endif //!DISABLE_CRL_BACKGROUND_POLL
 #endif //!DISABLE_CRL
         )
         :
             m_encryptionProfilesManager(encryptionProfilesManager)
 
             , m_fileSystemProvider(fileSystemProvider)
+            , m_verificationCache(nullptr)
+            , m_traceSink(nullptr)
 
     {
 #if !DISABLE_CRL
         m_revocationList.reset(new CertificateRevocationList());
 
-#if !DISABLE_CRL_BACKGROUND_POLL
-        m_threadTimer.reset(new ThreadTimer());
-#endif //!DISABLE_CRL_BACKGROUND_POLL
-
         m_crlUpdater.reset(new CrlUpdater(
 #if !DISABLE_NET_PROVIDER
                 netProvider,
 #endif //!DISABLE_NET_PROVIDER
 
                 m_fileSystemProvider,
+                storageProvider,
 
                 m_revocationList.get(),
 
 #if !DISABLE_CRL_BACKGROUND_POLL
-                m_threadTimer.get(),
+                (scheduler != nullptr) ? scheduler : Scheduler::Shared(),
 #endif //!DISABLE_CRL_BACKGROUND_POLL
 
-                defaultCrlUrl));
+                defaultCrlUrl,
+                crlCachePath));
 
 #if !DISABLE_CRL_BACKGROUND_POLL
-        m_threadTimer->SetHandler(std::bind(&CrlUpdater::Update, m_crlUpdater.get()));
-        m_threadTimer->SetAutoReset(false);
-
         if (m_crlUpdater->ContainsAnyUrl())
         {
-            m_threadTimer->SetUsage(ThreadTimer::DurationUsage);
-            m_threadTimer->SetDuration(ThreadTimer::DurationType(ThreadTimer::DurationType::zero()));
-            m_threadTimer->Start();
+            // A cached list that is still current defers the download to its next update
+            m_crlUpdater->StartPolling();
         }
 #endif //!DISABLE_CRL_BACKGROUND_POLL
 
@@ -110,10 +114,6 @@ namespace lcp
         try
         {
             m_crlUpdater->Cancel();
-
-#if !DISABLE_CRL_BACKGROUND_POLL
-            m_threadTimer->Stop();
-#endif //!DISABLE_CRL_BACKGROUND_POLL
         }
         catch (...)
         {
@@ -126,6 +126,7 @@ namespace lcp
         ILicense * license
         )
     {
+        TraceSpan span(m_traceSink, "CryptoppCryptoProvider::VerifyLicense");
         try
         {
 #if ENABLE_PROFILE_NAMES
@@ -163,7 +164,25 @@ namespace lcp
                 return Status(StatusCode::ErrorOpeningContentProviderCertificateNotValid, "ErrorOpeningContentProviderCertificateNotValid: " + ex.GetWhat());
             }
 
-            if (!providerCertificate->VerifyCertificate(rootCertificate.get()))
+            // A License already verified against the same certificates doesn't
+            // need the signature checks again
+            std::string canonicalDigest;
+            VerificationCache::Entry cacheEntry;
+            bool verifiedByCache = false;
+            if (m_verificationCache != nullptr)
+            {
+                canonicalDigest = VerificationCache::Digest(license->CanonicalContent());
+                verifiedByCache = m_verificationCache->Find(canonicalDigest, cacheEntry)
+                    && cacheEntry.rootCertificateDigest == VerificationCache::Digest(rootCertificateBase64)
+                    && cacheEntry.providerCertificateDigest == VerificationCache::Digest(license->Crypto()->SignatureCertificate());
+            }
+            if (span.Enabled())
+            {
+                span.SetAttribute("licenseId", license->Id());
+            }
+            span.SetAttribute("verifiedByCache", verifiedByCache ? "true" : "false");
+
+            if (!verifiedByCache && !providerCertificate->VerifyCertificate(rootCertificate.get()))
             {
                 return Status(StatusCode::ErrorOpeningContentProviderCertificateNotVerified, "ErrorOpeningContentProviderCertificateNotVerified");
             }
@@ -177,10 +196,13 @@ namespace lcp
 #endif //!DISABLE_CRL
 
             //providerCertificate->VerifyMessage
-            lcp::ISignatureAlgorithm* signatureAlgorithm = profile->CreateSignatureAlgorithm(providerCertificate->PublicKey(), license->Crypto()->SignatureAlgorithm());
-            if (!signatureAlgorithm->VerifySignature(license->CanonicalContent(), license->Crypto()->Signature()))
+            if (!verifiedByCache)
             {
-                return Status(StatusCode::ErrorOpeningLicenseSignatureNotValid, "ErrorOpeningLicenseSignatureNotValid");
+                lcp::ISignatureAlgorithm* signatureAlgorithm = profile->CreateSignatureAlgorithm(providerCertificate->PublicKey(), license->Crypto()->SignatureAlgorithm());
+                if (!signatureAlgorithm->VerifySignature(license->CanonicalContent(), license->Crypto()->Signature()))
+                {
+                    return Status(StatusCode::ErrorOpeningLicenseSignatureNotValid, "ErrorOpeningLicenseSignatureNotValid");
+                }
             }
 
             DateTime notBefore(providerCertificate->NotBeforeDate());
@@ -204,6 +226,33 @@ namespace lcp
             {
                 return Status(StatusCode::ErrorOpeningContentProviderCertificateExpired, "ErrorOpeningContentProviderCertificateExpired");
             }
+
+            if (m_verificationCache != nullptr)
+            {
+                std::string crlVersion;
+#if !DISABLE_CRL
+                if (m_revocationList->HasThisUpdateDate())
+                {
+                    crlVersion = m_revocationList->ThisUpdateDate();
+                }
+#endif //!DISABLE_CRL
+                // Revocation is always checked against the current CRL, the
+                // entry only follows the last CRL the License was checked with
+                if (!verifiedByCache || (!crlVersion.empty() && cacheEntry.crlVersion != crlVersion))
+                {
+                    cacheEntry.rootCertificateDigest = VerificationCache::Digest(rootCertificateBase64);
+                    cacheEntry.providerCertificateDigest = VerificationCache::Digest(license->Crypto()->SignatureCertificate());
+                    cacheEntry.crlVersion = crlVersion;
+                    try
+                    {
+                        m_verificationCache->Store(canonicalDigest, cacheEntry);
+                    }
+                    catch (const std::exception &)
+                    {
+                        // The cache is an optimization, the License is valid anyway
+                    }
+                }
+            }
             return Status(StatusCode::ErrorCommonSuccess);
         }
         catch (const CryptoPP::Exception & ex)
@@ -212,6 +261,19 @@ namespace lcp
         }
     }
 
+    void CryptoppCryptoProvider::SetVerificationCache(VerificationCache * verificationCache)
+    {
+        m_verificationCache = verificationCache;
+    }
+
+    void CryptoppCryptoProvider::SetTraceSink(ITraceSink * traceSink)
+    {
+        m_traceSink = traceSink;
+#if !DISABLE_CRL
+        m_crlUpdater->SetTraceSink(traceSink);
+#endif //!DISABLE_CRL
+    }
+
     Status CryptoppCryptoProvider::LegacyPassphraseUserKey(
             const KeyType & userKey1,
             KeyType & userKey2
@@ -340,6 +402,12 @@ namespace lcp
         }
     }
 
+    Status CryptoppCryptoProvider::CreateFileHashAlgorithm(IHashAlgorithm ** algorithm)
+    {
+        *algorithm = new Sha256HashAlgorithm();
+        return Status(StatusCode::ErrorCommonSuccess);
+    }
+
     Status CryptoppCryptoProvider::ConvertRawToHex(
         const std::vector<unsigned char> & data,
         std::string & hex
@@ -391,6 +459,31 @@ namespace lcp
         IKeyProvider * keyProvider,
         std::string & decrypted
         )
+    {
+        try
+        {
+            ISymmetricAlgorithm * algorithmPtr = nullptr;
+            Status res = this->CreateLicenseDataAlgorithm(license, keyProvider, &algorithmPtr);
+            if (!Status::IsSuccess(res))
+            {
+                return res;
+            }
+
+            std::unique_ptr<ISymmetricAlgorithm> contentKeyAlgorithm(algorithmPtr);
+            decrypted = contentKeyAlgorithm->Decrypt(dataBase64);
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const CryptoPP::Exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionLicenseEncrypted, "ErrorDecryptionLicenseEncrypted: " + ex.GetWhat());
+        }
+    }
+
+    Status CryptoppCryptoProvider::CreateLicenseDataAlgorithm(
+        ILicense * license,
+        IKeyProvider * keyProvider,
+        ISymmetricAlgorithm ** algorithm
+        )
     {
         try
         {
@@ -406,10 +499,9 @@ namespace lcp
 
             //http://www.w3.org/2009/xmlenc11#aes256-gcm
             //http://www.w3.org/2001/04/xmlenc#aes256-cbc
-            const std::string algorithm = license->Crypto()->ContentKeyAlgorithm();
+            const std::string algorithmName = license->Crypto()->ContentKeyAlgorithm();
 
-            std::unique_ptr<ISymmetricAlgorithm> contentKeyAlgorithm(profile->CreateContentKeyAlgorithm(keyProvider->UserKey(), algorithm));
-            decrypted = contentKeyAlgorithm->Decrypt(dataBase64);
+            *algorithm = profile->CreateContentKeyAlgorithm(keyProvider->UserKey(), algorithmName);
             return Status(StatusCode::ErrorCommonSuccess);
         }
         catch (const CryptoPP::Exception & ex)
@@ -475,7 +567,7 @@ namespace lcp
 
             Status res(StatusCode::ErrorCommonSuccess);
             std::unique_ptr<ISymmetricAlgorithm> algo(profile->CreatePublicationAlgorithm(keyProvider->ContentKey(), algorithm));
-            *encStream = new SymmetricAlgorithmEncryptedStream(stream, std::move(algo));
+            *encStream = new SymmetricAlgorithmEncryptedStream(stream, std::move(algo), m_traceSink);
             return res;
         }
         catch (const CryptoPP::Exception & ex)
@@ -513,8 +605,9 @@ namespace lcp
     }
 
     Status CryptoppCryptoProvider::CheckRevokation(ICertificate * providerCertificate) {
+        Statistics::Increment(StatisticsCounter::CrlChecks);
 
-        if (m_revocationList->SerialNumberRevoked(providerCertificate->SerialNumber())) {
+        if (m_revocationList->EncodedSerialNumberRevoked(providerCertificate->EncodedSerialNumber())) {
             return Status(StatusCode::ErrorOpeningContentProviderCertificateRevoked,
                           "ErrorOpeningContentProviderCertificateRevoked");
         }
@@ -526,44 +619,23 @@ namespace lcp
     {
         m_crlUpdater->UpdateCrlUrls(rootCertificate->DistributionPoints());
         m_crlUpdater->UpdateCrlUrls(providerCertificate->DistributionPoints());
+        m_crlUpdater->LoadCachedList();
 
         // First time processing of the CRL
         std::unique_lock<std::mutex> locker(m_processRevocationSync);
         if (m_crlUpdater->ContainsAnyUrl() && !m_revocationList->HasThisUpdateDate())
         {
 #if !DISABLE_CRL_BACKGROUND_POLL
-            if (m_threadTimer->IsRunning())
-            {
-                m_threadTimer->Stop();
-            }
-#endif //!DISABLE_CRL_BACKGROUND_POLL
-
-//            // Check once more, the CRL state could've been changed during the stop process
-//            if (!m_revocationList->HasThisUpdateDate())
-//            {
-//                // If CRL is absent, update it right before certificate verification
-//                m_crlUpdater->Update();
-//            }
-
-#if !DISABLE_CRL_BACKGROUND_POLL
-            // Start timer which will check CRL for updates periodically or by time point
-            m_threadTimer->SetAutoReset(true);
-            m_threadTimer->SetUsage(ThreadTimer::DurationUsage);
-
-            //std::function<void()>
-            m_threadTimer->SetHandler([&]{
-                m_crlUpdater->Update();
-            }); // std::bind(&CrlUpdater::Update, &m_crlUpdater);
-
-            m_threadTimer->SetDuration(ThreadTimer::DurationType(CrlUpdater::TenMinutesPeriod));
-            m_threadTimer->Start();
+            // Poll right away, then periodically or by time point; the
+            // license keeps opening meanwhile
+            m_crlUpdater->PollNow();
 #endif //!DISABLE_CRL_BACKGROUND_POLL
         }
         locker.unlock();
 
 #if !DISABLE_CRL_BACKGROUND_POLL
-        // If exception occurred in the timer thread, re-throw it
-        m_threadTimer->RethrowExceptionIfAny();
+        // If exception occurred in a background poll, re-throw it
+        m_crlUpdater->RethrowExceptionIfAny();
 #endif //!DISABLE_CRL_BACKGROUND_POLL
 
 
@@ -42,11 +42,14 @@ namespace lcp
 
 #if !DISABLE_CRL
     class CrlUpdater;
-    class ThreadTimer;
+#if !DISABLE_CRL_BACKGROUND_POLL
+    class Scheduler;
+#endif //!DISABLE_CRL_BACKGROUND_POLL
 #endif //!DISABLE_CRL
 
     class EncryptionProfilesManager;
     class ICertificate;
+    class IStorageProvider;
 
 #if !DISABLE_CRL
 class ICertificateRevocationList;
@@ -62,10 +65,16 @@ class ICertificateRevocationList;
 #endif //!DISABLE_NET_PROVIDER
 
                 , IFileSystemProvider * fileSystemProvider
-
+        // Keeps the key authenticating the CRL cache, no cache when null
+        , IStorageProvider * storageProvider
 
 #if !DISABLE_CRL
         , const std::string & defaultCrlUrl
+        , const std::string & crlCachePath
+#if !DISABLE_CRL_BACKGROUND_POLL
+        // Runs the CRL polling, the process-wide scheduler when null
+        , Scheduler * scheduler = nullptr
+#endif //!DISABLE_CRL_BACKGROUND_POLL
 #endif //!DISABLE_CRL
             );
         ~CryptoppCryptoProvider();
@@ -75,6 +84,9 @@ class ICertificateRevocationList;
             ILicense * license
             );
 
+        virtual void SetVerificationCache(VerificationCache * verificationCache);
+        virtual void SetTraceSink(ITraceSink * traceSink);
+
         virtual Status DecryptUserKey(
                 const std::string & userPassphrase,
                 ILicense * license,
@@ -98,6 +110,8 @@ class ICertificateRevocationList;
             std::vector<unsigned char> & rawHash
             );
 
+        virtual Status CreateFileHashAlgorithm(IHashAlgorithm ** algorithm);
+
         virtual Status ConvertRawToHex(
             const std::vector<unsigned char> & data,
             std::string & hex
@@ -117,6 +131,12 @@ class ICertificateRevocationList;
             std::string & decrypted
             );
 
+        virtual Status CreateLicenseDataAlgorithm(
+            ILicense * license,
+            IKeyProvider * keyProvider,
+            ISymmetricAlgorithm ** algorithm
+            );
+
         virtual Status DecryptPublicationData(
             ILicense * license,
             IKeyProvider * keyProvider,
@@ -145,11 +165,6 @@ class ICertificateRevocationList;
 
 
         std::unique_ptr<ICertificateRevocationList> m_revocationList;
-
-#if !DISABLE_CRL_BACKGROUND_POLL
-        std::unique_ptr<ThreadTimer> m_threadTimer;
-#endif //!DISABLE_CRL_BACKGROUND_POLL
-
         std::unique_ptr<CrlUpdater> m_crlUpdater;
         std::mutex m_processRevocationSync;
 #endif //!DISABLE_CRL
@@ -157,6 +172,8 @@ class ICertificateRevocationList;
         IFileSystemProvider * m_fileSystemProvider;
 
         EncryptionProfilesManager * m_encryptionProfilesManager;
+        VerificationCache * m_verificationCache;
+        ITraceSink * m_traceSink;
     };
 }
 
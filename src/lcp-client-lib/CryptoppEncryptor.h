@@ -0,0 +1,112 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __CRYPTOPP_ENCRYPTOR_H__
+#define __CRYPTOPP_ENCRYPTOR_H__
+
+#include <memory>
+#include "CryptoAlgorithmInterfaces.h"
+#include "IncludeMacros.h"
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+#include "Statistics.h"
+#include "public/StreamInterfaces.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/filters.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/secblock.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcp
+{
+    //
+    // Crypto++ sink writing what it receives to an IWritableStream.
+    //
+    class WritableStreamSink : public CryptoPP::Bufferless<CryptoPP::Sink>, public NonCopyable
+    {
+    public:
+        explicit WritableStreamSink(IWritableStream * stream)
+            : m_stream(stream)
+        {
+        }
+
+        virtual size_t Put2(const byte * inString, size_t length, int messageEnd, bool blocking)
+        {
+            if (length > 0)
+            {
+                m_stream->Write(inString, length);
+            }
+            return 0;
+        }
+
+    private:
+        IWritableStream * m_stream;
+    };
+
+    //
+    // IEncryptor applying a Crypto++ encryption mode through its filter:
+    // StreamTransformationFilter for the padded block modes,
+    // AuthenticatedEncryptionFilter for the authenticated ones. The IV is
+    // drawn from the OS random generator and written first.
+    //
+    template <typename Encryption, typename Filter>
+    class CryptoppEncryptor : public IEncryptor, public NonCopyable
+    {
+    public:
+        CryptoppEncryptor(const KeyType & key, size_t ivSize, IWritableStream * output, StatisticsCounter::CounterEnum counter)
+            : m_counter(counter)
+        {
+            CryptoPP::AutoSeededRandomPool random;
+            CryptoPP::SecByteBlock iv(ivSize);
+            random.GenerateBlock(iv.data(), iv.size());
+            output->Write(iv.data(), iv.size());
+
+            m_encryption.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+            m_filter.reset(new Filter(m_encryption, new WritableStreamSink(output)));
+        }
+
+        virtual void Update(const unsigned char * data, size_t dataLength)
+        {
+            m_filter->Put(data, dataLength);
+            Statistics::Increment(m_counter, dataLength);
+        }
+
+        virtual void Finish()
+        {
+            m_filter->MessageEnd();
+        }
+
+    private:
+        Encryption m_encryption;
+        std::unique_ptr<Filter> m_filter;
+        StatisticsCounter::CounterEnum m_counter;
+    };
+}
+
+#endif //__CRYPTOPP_ENCRYPTOR_H__
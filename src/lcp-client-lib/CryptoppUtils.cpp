@@ -27,6 +27,7 @@
 
 #include "CryptoppUtils.h"
 #include "IncludeMacros.h"
+#include "SecureBuffer.h"
 #include <sstream>
 
 CRYPTOPP_INCLUDE_START
@@ -166,6 +167,29 @@ namespace lcp
         }
     }
 
+    void CryptoppUtils::Base64ToSecureBuffer(const std::string & base64, SecureBuffer & result)
+    {
+        if (base64.empty())
+        {
+            throw std::runtime_error("base64 data is empty");
+        }
+
+        Base64Decoder decoder;
+        decoder.Put(reinterpret_cast<const byte *>(base64.data()), base64.size());
+        decoder.MessageEnd();
+
+        lword size = decoder.MaxRetrievable();
+        if (size > 0 && size <= SIZE_MAX)
+        {
+            result = SecureBuffer(static_cast<size_t>(size));
+            decoder.Get(result.Data(), result.Size());
+        }
+        else
+        {
+            throw std::runtime_error("result data is empty");
+        }
+    }
+
     void CryptoppUtils::Cert::BERDecodeTime(CryptoPP::BufferedTransformation& bt, std::string& time)
     {
         byte b;
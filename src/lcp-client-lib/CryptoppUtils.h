@@ -42,10 +42,13 @@ using namespace CryptoPP;
 
 namespace lcp
 {
+    class SecureBuffer;
+
     class CryptoppUtils
     {
     public:
         static void Base64ToSecBlock(const std::string & base64, SecByteBlock & result);
+        static void Base64ToSecureBuffer(const std::string & base64, SecureBuffer & result);
         static Buffer Base64ToVector(const std::string & base64);
         static std::string RawToHex(const Buffer & key);
         static Buffer HexToRaw(const std::string & hex);
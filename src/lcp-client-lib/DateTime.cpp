@@ -25,21 +25,16 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
-#include <sstream>
-#include <iomanip>
-#include <regex>
+#include <ctime>
+#include <stdexcept>
 #include "DateTime.h"
 
 namespace lcp
 {
     /*static*/ std::string DateTime::IsoUtcFormat = "2015-11-11T22:21:37Z";
-    /*static*/ std::string DateTime::IsoUtcFormatRegex = "\\d{4}-\\d{2}-\\d{2}T\\d{2}:\\d{2}:\\d{2}\\.*\\d*Z";
     /*static*/ std::string DateTime::IsoTimeZoneFormat = "2015-11-11T22:21:37+01:00";
-    /*static*/ std::string DateTime::IsoTimeZoneFormatRegex = "\\d{4}-\\d{2}-\\d{2}T\\d{2}:\\d{2}:\\d{2}\\.*\\d*[+-]\\d{2}:\\d{2}";
     /*static*/ std::string DateTime::IsoJointUtcFormat = "20151111T222137Z";
-    /*static*/ std::string DateTime::IsoJointUtcFormatRegex = "\\d{8}T\\d{6}Z";
     /*static*/ std::string DateTime::IsoJointTimeZoneFormat = "20151111T222137+0100";
-    /*static*/ std::string DateTime::IsoJointTimeZoneFormatRegex = "\\d{8}T\\d{6}\\+\\d{4}";
 
     /*static*/ DateTime DateTime::Now()
     {
@@ -47,10 +42,7 @@ namespace lcp
         std::time_t currentTime = { 0 };
         std::time(&currentTime);
         utcNow.m_time = currentTime;
-        TM * utcTmPtr = nullptr;
-        utcTmPtr = gmtime64(&utcNow.m_time);
-        utcNow.m_tm = *utcTmPtr;
-        utcNow.m_time = mktime64(&utcNow.m_tm);
+        gmtime64_r(&utcNow.m_time, &utcNow.m_tm);
         return utcNow;
     }
 
@@ -65,36 +57,7 @@ namespace lcp
     {
         m_tm = {};
         m_time = 0;
-
-        std::regex jointUtcRegex(IsoJointUtcFormatRegex);
-        std::regex jointTimeZoneRegex(IsoJointTimeZoneFormatRegex);
-        std::regex isoUtcRegex(IsoUtcFormatRegex);
-        std::regex isoTimeZoneRegex(IsoTimeZoneFormatRegex);
-
-        if (std::regex_match(isoTime, jointUtcRegex))
-        {
-            std::string normalIsoStr = JointToNormalIsoFormat(isoTime, true);
-            m_isoTime = normalIsoStr;
-            ProcessIsoUtcTime(m_isoTime);
-        }
-        else if (std::regex_match(isoTime, jointTimeZoneRegex))
-        {
-            std::string normalIsoStr = JointToNormalIsoFormat(isoTime, false);
-            m_isoTime = normalIsoStr;
-            ProcessIsoTimeZoneTime(m_isoTime);
-        }
-        else if (std::regex_match(isoTime, isoUtcRegex))
-        {
-            ProcessIsoUtcTime(m_isoTime);
-        }
-        else if (std::regex_match(isoTime, isoTimeZoneRegex))
-        {
-            ProcessIsoTimeZoneTime(m_isoTime);
-        }
-        else
-        {
-            throw std::invalid_argument("Wrong iso time format");
-        }
+        this->ParseIsoTime(isoTime);
     }
 
     DateTime::DateTime(const DateTime & right)
@@ -178,45 +141,141 @@ namespace lcp
         return m_tm;
     }
 
-    void DateTime::ProcessIsoUtcTime(const std::string & isoTime)
+    void DateTime::ParseIsoTime(const std::string & isoTime)
     {
-        // Fraction of seconds cannot be parsed so remove it
-        if (!TimeStringToTm(isoTime.substr(0, 19), "%Y-%m-%dT%H:%M:%S", m_tm))
+        size_t pos = 0;
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+
+        if (!ReadDigits(isoTime, pos, 4, year))
         {
-            throw std::runtime_error("Cannot parse iso time");
+            throw std::invalid_argument("Wrong iso time format");
         }
-        m_time = mktime64(&m_tm);
-    }
 
-    void DateTime::ProcessIsoTimeZoneTime(const std::string & isoTime)
-    {
-        size_t found = isoTime.find_last_of("+-");
-        bool isPlus = (isoTime[found] == '+' ? true : false);
-        std::string dateTimePart = isoTime.substr(0, found);
-        std::string timeZonePart = isoTime.substr(found + 1);
+        // Extended format separates date and time fields, the basic ("joint") one does not
+        bool extended = (pos < isoTime.size() && isoTime[pos] == '-');
+        bool valid = false;
+        if (extended)
+        {
+            valid = ReadChar(isoTime, pos, '-') && ReadDigits(isoTime, pos, 2, month) &&
+                ReadChar(isoTime, pos, '-') && ReadDigits(isoTime, pos, 2, day) &&
+                ReadChar(isoTime, pos, 'T') && ReadDigits(isoTime, pos, 2, hour) &&
+                ReadChar(isoTime, pos, ':') && ReadDigits(isoTime, pos, 2, minute) &&
+                ReadChar(isoTime, pos, ':') && ReadDigits(isoTime, pos, 2, second);
 
-        if (!TimeStringToTm(dateTimePart, "%Y-%m-%dT%H:%M:%S", m_tm))
+            // Fraction of seconds does not change the epoch seconds value, skip it
+            if (valid && ReadChar(isoTime, pos, '.'))
+            {
+                while (pos < isoTime.size() && isoTime[pos] >= '0' && isoTime[pos] <= '9')
+                {
+                    ++pos;
+                }
+            }
+        }
+        else
         {
-            throw std::runtime_error("Cannot parse iso time");
+            valid = ReadDigits(isoTime, pos, 2, month) && ReadDigits(isoTime, pos, 2, day) &&
+                ReadChar(isoTime, pos, 'T') && ReadDigits(isoTime, pos, 2, hour) &&
+                ReadDigits(isoTime, pos, 2, minute) && ReadDigits(isoTime, pos, 2, second);
+        }
+        if (!valid || pos >= isoTime.size())
+        {
+            throw std::invalid_argument("Wrong iso time format");
         }
 
-        TM timeZone = {};
-        if (!TimeStringToTm(timeZonePart, "%H:%M", timeZone))
+        bool isUtc = true;
+        int offsetSeconds = 0;
+        char designator = isoTime[pos++];
+        if (designator == '+' || designator == '-')
+        {
+            int offsetHour = 0, offsetMinute = 0;
+            isUtc = false;
+            valid = ReadDigits(isoTime, pos, 2, offsetHour) &&
+                (!extended || ReadChar(isoTime, pos, ':')) &&
+                ReadDigits(isoTime, pos, 2, offsetMinute);
+            if (!valid)
+            {
+                throw std::invalid_argument("Wrong iso time format");
+            }
+            if (offsetHour > 23 || offsetMinute > 59)
+            {
+                throw std::runtime_error("Cannot parse iso time");
+            }
+            offsetSeconds = (offsetHour * 60 + offsetMinute) * 60;
+            if (designator == '-')
+            {
+                offsetSeconds = -offsetSeconds;
+            }
+        }
+        else if (designator != 'Z')
+        {
+            throw std::invalid_argument("Wrong iso time format");
+        }
+        if (pos != isoTime.size())
+        {
+            throw std::invalid_argument("Wrong iso time format");
+        }
+
+        // Leap second (60) is accepted the same way strptime does
+        if (month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month) ||
+            hour > 23 || minute > 59 || second > 60)
         {
             throw std::runtime_error("Cannot parse iso time");
         }
 
-        if (isPlus)
+        if (!extended)
         {
-            m_tm.tm_hour -= timeZone.tm_hour;
-            m_tm.tm_min -= timeZone.tm_min;
+            m_isoTime = JointToNormalIsoFormat(isoTime, isUtc);
         }
-        else
+        m_time = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offsetSeconds;
+        gmtime64_r(&m_time, &m_tm);
+    }
+
+    /*static*/ bool DateTime::ReadDigits(const std::string & str, size_t & pos, size_t count, int & value)
+    {
+        if (pos + count > str.size())
+        {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < count; ++i, ++pos)
+        {
+            char c = str[pos];
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    /*static*/ bool DateTime::ReadChar(const std::string & str, size_t & pos, char expected)
+    {
+        if (pos < str.size() && str[pos] == expected)
         {
-            m_tm.tm_hour += timeZone.tm_hour;
-            m_tm.tm_min += timeZone.tm_min;
+            ++pos;
+            return true;
         }
-        m_time = mktime64(&m_tm);
+        return false;
+    }
+
+    /*static*/ int DateTime::DaysInMonth(int year, int month)
+    {
+        static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        bool isLeap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return (month == 2 && isLeap) ? 29 : daysInMonth[month - 1];
+    }
+
+    // Number of days since 1970-01-01 in the proleptic Gregorian calendar,
+    // see http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+    /*static*/ Time64_T DateTime::DaysFromCivil(int year, int month, int day)
+    {
+        year -= (month <= 2) ? 1 : 0;
+        Time64_T era = (year >= 0 ? year : year - 399) / 400;
+        Time64_T yearOfEra = year - era * 400;
+        Time64_T dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        Time64_T dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + dayOfEra - 719468;
     }
 
     /*static*/ std::string DateTime::JointToNormalIsoFormat(const std::string & jointTime, bool isUtc)
@@ -238,33 +297,4 @@ namespace lcp
         }
         return result;
     }
-
-    /*static*/ bool DateTime::TimeStringToTm(const std::string & time, const std::string & format, TM & result)
-    {
-        result = {};
-        std::tm tempResult = {};
-
-        if (strptime(time.c_str(), format.c_str(), &tempResult) == NULL) {
-            // Unable to convert time
-            return false;
-        }
-
-        result = TmToTm64(tempResult);
-        return true;
-    }
-
-    /*static*/ TM DateTime::TmToTm64(const std::tm & from)
-    {
-        TM res = {};
-        res.tm_year = from.tm_year;
-        res.tm_yday = from.tm_yday;
-        res.tm_mon = from.tm_mon;
-        res.tm_mday = from.tm_mday;
-        res.tm_wday = from.tm_wday;
-        res.tm_hour = from.tm_hour;
-        res.tm_min = from.tm_min;
-        res.tm_sec = from.tm_sec;
-        res.tm_isdst = from.tm_isdst;
-        return res;
-    }
 }
\ No newline at end of file
@@ -60,19 +60,18 @@ namespace lcp
         static std::string IsoTimeZoneFormat;
         static std::string IsoJointUtcFormat;
         static std::string IsoJointTimeZoneFormat;
-        static std::string IsoUtcFormatRegex;
-        static std::string IsoTimeZoneFormatRegex;
-        static std::string IsoJointUtcFormatRegex;
-        static std::string IsoJointTimeZoneFormatRegex;
 
     private:
-        void ProcessIsoUtcTime(const std::string & isoTime);
-        void ProcessIsoTimeZoneTime(const std::string & isoTime);
+        // Single pass parser for the four supported formats, with optional fraction
+        // of seconds in the extended ones. Computes m_time as UTC epoch seconds.
+        void ParseIsoTime(const std::string & isoTime);
 
-        static std::string JointToNormalIsoFormat(const std::string & jointTime, bool isUtc);
-        static bool TimeStringToTm(const std::string & time, const std::string & format, TM & result);
+        static bool ReadDigits(const std::string & str, size_t & pos, size_t count, int & value);
+        static bool ReadChar(const std::string & str, size_t & pos, char expected);
+        static int DaysInMonth(int year, int month);
+        static Time64_T DaysFromCivil(int year, int month, int day);
 
-        static TM TmToTm64(const std::tm & from);
+        static std::string JointToNormalIsoFormat(const std::string & jointTime, bool isUtc);
 
     private:
         std::string m_isoTime;
@@ -42,12 +42,23 @@ namespace lcp
         DownloadInFileRequest(const std::string & url, IFile * file)
             : BaseDownloadRequest(url)
             , m_file(file)
+            , m_destination(file)
+        {
+        }
+
+        //
+        // Writes go through the given stream, which must end up in the file.
+        //
+        DownloadInFileRequest(const std::string & url, IFile * file, IWritableStream * destination)
+            : BaseDownloadRequest(url)
+            , m_file(file)
+            , m_destination(destination)
         {
         }
 
         virtual IWritableStream * DestinationStream() const
         {
-            return m_file;
+            return m_destination;
         }
 
         virtual bool HasDestinationPath() const
@@ -62,6 +73,7 @@ namespace lcp
 
     private:
         IFile * m_file;
+        IWritableStream * m_destination;
     };
 }
 
@@ -28,6 +28,7 @@
 #include "EcdsaSha256SignatureAlgorithm.h"
 #include "AlgorithmNames.h"
 #include "CryptoppUtils.h"
+#include "Statistics.h"
 
 namespace lcp
 {
@@ -64,6 +65,7 @@ namespace lcp
             size_t signatureLength
     )
     {
+        Statistics::Increment(StatisticsCounter::SignatureVerifications);
         ByteQueue publicKeyQueue;
         publicKeyQueue.Put(&m_publicKeyType.at(0), m_publicKeyType.size());
         publicKeyQueue.MessageEnd();
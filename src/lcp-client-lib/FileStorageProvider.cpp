@@ -0,0 +1,618 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstring>
+#include <stdexcept>
+#include "FileStorageProvider.h"
+#include "BatchStorageAdapter.h"
+#include "LcpUtils.h"
+
+namespace lcp
+{
+    namespace
+    {
+        const char LogMagic[] = { 'L', 'C', 'P', 'S' };
+        const unsigned char LogVersion = 1;
+        // Magic, version and generation, in clear
+        const size_t LogHeaderSize = sizeof(LogMagic) + 1 + 8;
+
+        const size_t NonceSize = 12;
+        const size_t TagSize = 16;
+
+        const unsigned char BatchRecord = 'B';
+        const unsigned char CommitRecord = 'C';
+
+        // Length prefixes of the vault identifier, key and value
+        const size_t EntryOverhead = 12;
+        const size_t MaxSnapshotRecordSize = 64 * 1024;
+        const int64_t CompactionRatio = 2;
+
+        class VaultSnapshotIterator : public KvStringsIterator
+        {
+        public:
+            explicit VaultSnapshotIterator(StringsMap && values)
+                : m_values(std::move(values))
+                , m_current(m_values.cbegin())
+            {
+            }
+
+            virtual void First()
+            {
+                m_current = m_values.cbegin();
+            }
+
+            virtual void Next()
+            {
+                ++m_current;
+            }
+
+            virtual bool IsDone() const
+            {
+                return (m_current == m_values.cend());
+            }
+
+            virtual std::string CurrentKey() const
+            {
+                if (this->IsDone())
+                {
+                    throw std::out_of_range("Iterator is out of range");
+                }
+                return m_current->first;
+            }
+
+            virtual const std::string & Current() const
+            {
+                if (this->IsDone())
+                {
+                    throw std::out_of_range("Iterator is out of range");
+                }
+                return m_current->second;
+            }
+
+        private:
+            StringsMap m_values;
+            StringsMap::const_iterator m_current;
+        };
+    }
+
+    /*static*/ const size_t FileStorageProvider::KeySize = 32;
+    /*static*/ const int64_t FileStorageProvider::MinCompactionSize = 64 * 1024;
+
+    FileStorageProvider::LogState::LogState()
+        : committed(false)
+        , rejected(false)
+        , generation(0)
+        , sequence(0)
+        , size(0)
+    {
+    }
+
+    FileStorageProvider::FileStorageProvider(
+        IFileSystemProvider * fileSystemProvider,
+        const std::string & storagePath,
+        const KeyType & encryptionKey
+        )
+        : m_fileSystemProvider(fileSystemProvider)
+        , m_storagePath(storagePath)
+        , m_liveSize(0)
+        , m_logFileIndex(0)
+        , m_generation(0)
+        , m_sequence(0)
+    {
+        if (m_fileSystemProvider == nullptr)
+        {
+            throw std::invalid_argument("FileSystemProvider is nullptr");
+        }
+        if (encryptionKey.size() != KeySize)
+        {
+            throw std::invalid_argument("Storage encryption key must be 32 bytes long");
+        }
+
+        // Every record gives its own nonce
+        unsigned char nonce[NonceSize] = {};
+        m_encryption.SetKeyWithIV(encryptionKey.data(), encryptionKey.size(), nonce, NonceSize);
+        m_decryption.SetKeyWithIV(encryptionKey.data(), encryptionKey.size(), nonce, NonceSize);
+    }
+
+    void FileStorageProvider::Open()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_logFile.reset();
+
+        LogState states[2];
+        this->ReplayLog(0, states[0]);
+        this->ReplayLog(1, states[1]);
+
+        // A compaction interrupted before its commit record leaves the
+        // previous generation in force
+        int selected = -1;
+        for (int i = 0; i < 2; ++i)
+        {
+            if (states[i].committed && (selected < 0 || states[i].generation > states[selected].generation))
+            {
+                selected = i;
+            }
+        }
+
+        if (selected < 0)
+        {
+            if (states[0].rejected || states[1].rejected)
+            {
+                throw StatusException(Status(StatusCode::ErrorDecryptionCommonError,
+                    "Storage can not be decrypted with the given key: " + m_storagePath));
+            }
+
+            m_index.clear();
+            m_liveSize = 0;
+            m_logFileIndex = 0;
+            m_generation = 1;
+            m_logFile.reset(m_fileSystemProvider->GetFile(this->LogPath(m_logFileIndex), IFileSystemProvider::CreateNew));
+            m_sequence = this->WriteSnapshot(m_logFile.get(), m_generation);
+            return;
+        }
+
+        LogState & state = states[selected];
+        m_index.swap(state.index);
+        m_liveSize = 0;
+        for (auto vaultIt = m_index.begin(); vaultIt != m_index.end(); ++vaultIt)
+        {
+            for (auto it = vaultIt->second.begin(); it != vaultIt->second.end(); ++it)
+            {
+                m_liveSize += EntrySize(vaultIt->first, it->first, it->second);
+            }
+        }
+        m_logFileIndex = static_cast<size_t>(selected);
+        m_generation = state.generation;
+        m_sequence = state.sequence;
+
+        // New records overwrite a torn one
+        m_logFile.reset(m_fileSystemProvider->GetFile(this->LogPath(m_logFileIndex), IFileSystemProvider::ReadWrite));
+        m_logFile->SetWritePosition(state.size);
+    }
+
+    void FileStorageProvider::Compact()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        this->CheckOpened();
+        this->CompactLog();
+    }
+
+    bool FileStorageProvider::SetValues(const std::string & vaultId, const StringsMap & values)
+    {
+        if (values.empty())
+        {
+            return true;
+        }
+
+        Buffer batch(1, BatchRecord);
+        for (auto it = values.begin(); it != values.end(); ++it)
+        {
+            WriteField(batch, vaultId);
+            WriteField(batch, it->first);
+            WriteField(batch, it->second);
+        }
+
+        std::unique_lock<std::mutex> locker(m_sync);
+        this->CheckOpened();
+        this->AppendRecord(m_logFile.get(), m_generation, m_sequence, batch);
+        for (auto it = values.begin(); it != values.end(); ++it)
+        {
+            this->SetIndexValue(vaultId, it->first, it->second);
+        }
+        this->CompactIfNeeded();
+        return true;
+    }
+
+    std::string FileStorageProvider::GetValue(const std::string & vaultId, const std::string & key)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto vaultIt = m_index.find(vaultId);
+        if (vaultIt == m_index.end())
+        {
+            return std::string();
+        }
+        auto it = vaultIt->second.find(key);
+        if (it == vaultIt->second.end())
+        {
+            return std::string();
+        }
+        return it->second;
+    }
+
+    void FileStorageProvider::SetValue(const std::string & vaultId, const std::string & key, const std::string & value)
+    {
+        Buffer batch(1, BatchRecord);
+        batch.reserve(1 + EntrySize(vaultId, key, value));
+        WriteField(batch, vaultId);
+        WriteField(batch, key);
+        WriteField(batch, value);
+
+        std::unique_lock<std::mutex> locker(m_sync);
+        this->CheckOpened();
+        this->AppendRecord(m_logFile.get(), m_generation, m_sequence, batch);
+        this->SetIndexValue(vaultId, key, value);
+        this->CompactIfNeeded();
+    }
+
+    KvStringsIterator * FileStorageProvider::EnumerateVault(const std::string & vaultId)
+    {
+        return new VaultSnapshotIterator(this->ValuesWithPrefix(vaultId, std::string()));
+    }
+
+    KvStringsIterator * FileStorageProvider::EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix)
+    {
+        return new VaultSnapshotIterator(this->ValuesWithPrefix(vaultId, keyPrefix));
+    }
+
+    bool FileStorageProvider::GetValues(const std::string & vaultId, const std::vector<std::string> & keys, std::vector<std::string> & values)
+    {
+        values.clear();
+        values.reserve(keys.size());
+
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto vaultIt = m_index.find(vaultId);
+        for (auto keyIt = keys.begin(); keyIt != keys.end(); ++keyIt)
+        {
+            if (vaultIt == m_index.end())
+            {
+                values.push_back(std::string());
+                continue;
+            }
+            auto it = vaultIt->second.find(*keyIt);
+            values.push_back((it != vaultIt->second.end()) ? it->second : std::string());
+        }
+        return true;
+    }
+
+    bool FileStorageProvider::EnumerateVaultToBuffer(const std::string & vaultId, const std::string & keyPrefix, std::string & buffer)
+    {
+        StringsMap values = this->ValuesWithPrefix(vaultId, keyPrefix);
+        buffer.clear();
+        for (auto it = values.begin(); it != values.end(); ++it)
+        {
+            BatchStorageAdapter::AppendToBuffer(buffer, it->first, it->second);
+        }
+        return true;
+    }
+
+    StringsMap FileStorageProvider::ValuesWithPrefix(const std::string & vaultId, const std::string & keyPrefix)
+    {
+        StringsMap values;
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto vaultIt = m_index.find(vaultId);
+        if (vaultIt != m_index.end())
+        {
+            for (auto it = vaultIt->second.begin(); it != vaultIt->second.end(); ++it)
+            {
+                if (it->first.compare(0, keyPrefix.size(), keyPrefix) == 0)
+                {
+                    values.insert(*it);
+                }
+            }
+        }
+        return values;
+    }
+
+    std::string FileStorageProvider::LogPath(size_t fileIndex) const
+    {
+        return m_storagePath + ((fileIndex == 0) ? ".0" : ".1");
+    }
+
+    void FileStorageProvider::ReplayLog(size_t fileIndex, LogState & state)
+    {
+        std::unique_ptr<IFile> logFile;
+        try
+        {
+            logFile.reset(m_fileSystemProvider->GetFile(this->LogPath(fileIndex), IFileSystemProvider::ReadOnly));
+        }
+        catch (const std::exception &)
+        {
+            return;
+        }
+
+        int64_t size = logFile->Size();
+        if (size < static_cast<int64_t>(LogHeaderSize))
+        {
+            // Absent, or torn while being created
+            return;
+        }
+
+        Buffer buffer(static_cast<size_t>(size));
+        logFile->SetReadPosition(0);
+        logFile->Read(buffer.data(), size);
+
+        if (std::memcmp(buffer.data(), LogMagic, sizeof(LogMagic)) != 0 || buffer[sizeof(LogMagic)] != LogVersion)
+        {
+            state.rejected = true;
+            return;
+        }
+        state.generation = ReadUInt64(buffer.data() + sizeof(LogMagic) + 1);
+        state.size = LogHeaderSize;
+
+        // Records are applied in order, replay stops at the first record
+        // which is truncated or fails to decrypt
+        size_t pos = LogHeaderSize;
+        Buffer plainText;
+        while (buffer.size() - pos >= 4)
+        {
+            size_t recordSize = ReadLength(buffer.data() + pos);
+            if (buffer.size() - pos - 4 < recordSize)
+            {
+                break;
+            }
+            if (!this->DecryptRecord(buffer.data() + pos + 4, recordSize, state.generation, state.sequence, plainText))
+            {
+                // Nothing can be decrypted: wrong key or tampered log
+                state.rejected = (state.sequence == 0);
+                break;
+            }
+
+            if (plainText[0] == CommitRecord)
+            {
+                state.committed = true;
+            }
+            else if (plainText[0] != BatchRecord || !ApplyBatch(plainText, state.index))
+            {
+                break;
+            }
+
+            pos += 4 + recordSize;
+            state.size = static_cast<int64_t>(pos);
+            ++state.sequence;
+        }
+    }
+
+    uint64_t FileStorageProvider::WriteSnapshot(IFile * file, uint64_t generation)
+    {
+        Buffer header(LogMagic, LogMagic + sizeof(LogMagic));
+        header.push_back(LogVersion);
+        WriteUInt64(header, generation);
+        file->Write(header.data(), header.size());
+
+        uint64_t sequence = 0;
+        Buffer batch(1, BatchRecord);
+        for (auto vaultIt = m_index.begin(); vaultIt != m_index.end(); ++vaultIt)
+        {
+            for (auto it = vaultIt->second.begin(); it != vaultIt->second.end(); ++it)
+            {
+                WriteField(batch, vaultIt->first);
+                WriteField(batch, it->first);
+                WriteField(batch, it->second);
+                if (batch.size() >= MaxSnapshotRecordSize)
+                {
+                    this->AppendRecord(file, generation, sequence, batch);
+                    batch.resize(1);
+                }
+            }
+        }
+        if (batch.size() > 1)
+        {
+            this->AppendRecord(file, generation, sequence, batch);
+        }
+        this->AppendRecord(file, generation, sequence, Buffer(1, CommitRecord));
+        return sequence;
+    }
+
+    void FileStorageProvider::AppendRecord(IFile * file, uint64_t generation, uint64_t & sequence, const Buffer & plainText)
+    {
+        Buffer associatedData;
+        WriteUInt64(associatedData, generation);
+        WriteUInt64(associatedData, sequence);
+
+        size_t recordSize = NonceSize + plainText.size() + TagSize;
+        Buffer record;
+        record.reserve(4 + recordSize);
+        WriteLength(record, recordSize);
+        record.resize(4 + recordSize);
+
+        unsigned char * nonce = record.data() + 4;
+        unsigned char * cipherText = nonce + NonceSize;
+        m_random.GenerateBlock(nonce, NonceSize);
+        m_encryption.EncryptAndAuthenticate(
+            cipherText, cipherText + plainText.size(), TagSize,
+            nonce, NonceSize,
+            associatedData.data(), associatedData.size(),
+            plainText.data(), plainText.size()
+            );
+
+        // A record torn by a failed write is overwritten by the next one,
+        // as replaying the log would stop at it
+        int64_t recordPosition = file->WritePosition();
+        try
+        {
+            file->Write(record.data(), record.size());
+            file->Flush();
+        }
+        catch (...)
+        {
+            file->SetWritePosition(recordPosition);
+            throw;
+        }
+        ++sequence;
+    }
+
+    bool FileStorageProvider::DecryptRecord(
+        const unsigned char * record,
+        size_t recordSize,
+        uint64_t generation,
+        uint64_t sequence,
+        Buffer & plainText
+        )
+    {
+        if (recordSize <= NonceSize + TagSize)
+        {
+            return false;
+        }
+
+        Buffer associatedData;
+        WriteUInt64(associatedData, generation);
+        WriteUInt64(associatedData, sequence);
+
+        size_t textSize = recordSize - NonceSize - TagSize;
+        plainText.resize(textSize);
+        return m_decryption.DecryptAndVerify(
+            plainText.data(), record + NonceSize + textSize, TagSize,
+            record, NonceSize,
+            associatedData.data(), associatedData.size(),
+            record + NonceSize, textSize
+            );
+    }
+
+    void FileStorageProvider::CheckOpened() const
+    {
+        if (!m_logFile)
+        {
+            throw std::logic_error("FileStorageProvider is not opened");
+        }
+    }
+
+    void FileStorageProvider::SetIndexValue(const std::string & vaultId, const std::string & key, const std::string & value)
+    {
+        VaultIndex & vault = m_index[vaultId];
+        auto result = vault.emplace(key, std::string());
+        if (result.second)
+        {
+            m_liveSize += EntrySize(vaultId, key, std::string());
+        }
+        m_liveSize -= result.first->second.size();
+        m_liveSize += value.size();
+        result.first->second = value;
+    }
+
+    void FileStorageProvider::CompactLog()
+    {
+        size_t fileIndex = 1 - m_logFileIndex;
+        uint64_t generation = m_generation + 1;
+
+        // The current log, whose records are all flushed, stays in force
+        // until the snapshot is committed. It is left untouched afterwards:
+        // its older generation is ignored when replaying, and it is only
+        // truncated by the next compaction, once this snapshot is durable.
+        std::unique_ptr<IFile> logFile(m_fileSystemProvider->GetFile(this->LogPath(fileIndex), IFileSystemProvider::CreateNew));
+        m_sequence = this->WriteSnapshot(logFile.get(), generation);
+        m_logFile = std::move(logFile);
+        m_logFileIndex = fileIndex;
+        m_generation = generation;
+    }
+
+    void FileStorageProvider::CompactIfNeeded()
+    {
+        int64_t logSize = m_logFile->WritePosition();
+        if (logSize > MinCompactionSize && logSize > CompactionRatio * static_cast<int64_t>(m_liveSize))
+        {
+            try
+            {
+                this->CompactLog();
+            }
+            catch (const std::exception &)
+            {
+                // The log keeps growing, next write retries
+            }
+        }
+    }
+
+    /*static*/ bool FileStorageProvider::ApplyBatch(const Buffer & batch, StorageIndex & index)
+    {
+        size_t pos = 1;
+        std::string vaultId;
+        std::string key;
+        std::string value;
+        while (pos < batch.size())
+        {
+            if (!ReadField(batch, pos, vaultId) || !ReadField(batch, pos, key) || !ReadField(batch, pos, value))
+            {
+                return false;
+            }
+            index[vaultId][key] = value;
+        }
+        return true;
+    }
+
+    /*static*/ size_t FileStorageProvider::EntrySize(const std::string & vaultId, const std::string & key, const std::string & value)
+    {
+        return EntryOverhead + vaultId.size() + key.size() + value.size();
+    }
+
+    /*static*/ void FileStorageProvider::WriteLength(Buffer & buffer, size_t length)
+    {
+        buffer.push_back(static_cast<unsigned char>((length >> 24) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>((length >> 16) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>((length >> 8) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>(length & 0xFF));
+    }
+
+    /*static*/ size_t FileStorageProvider::ReadLength(const unsigned char * data)
+    {
+        return (static_cast<size_t>(data[0]) << 24) |
+            (static_cast<size_t>(data[1]) << 16) |
+            (static_cast<size_t>(data[2]) << 8) |
+            static_cast<size_t>(data[3]);
+    }
+
+    /*static*/ void FileStorageProvider::WriteUInt64(Buffer & buffer, uint64_t value)
+    {
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            buffer.push_back(static_cast<unsigned char>((value >> shift) & 0xFF));
+        }
+    }
+
+    /*static*/ uint64_t FileStorageProvider::ReadUInt64(const unsigned char * data)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            value = (value << 8) | data[i];
+        }
+        return value;
+    }
+
+    /*static*/ void FileStorageProvider::WriteField(Buffer & buffer, const std::string & field)
+    {
+        WriteLength(buffer, field.size());
+        buffer.insert(buffer.end(), field.begin(), field.end());
+    }
+
+    /*static*/ bool FileStorageProvider::ReadField(const Buffer & buffer, size_t & pos, std::string & field)
+    {
+        if (buffer.size() - pos < 4)
+        {
+            return false;
+        }
+        size_t length = ReadLength(buffer.data() + pos);
+        pos += 4;
+
+        if (buffer.size() - pos < length)
+        {
+            return false;
+        }
+        field.assign(reinterpret_cast<const char *>(buffer.data() + pos), length);
+        pos += length;
+        return true;
+    }
+}
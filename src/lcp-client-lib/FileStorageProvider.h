@@ -0,0 +1,161 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __FILE_STORAGE_PROVIDER_H__
+#define __FILE_STORAGE_PROVIDER_H__
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+#include "IncludeMacros.h"
+#include "public/IFileSystemProvider.h"
+#include "public/IStorageProvider.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/aes.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/osrng.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcp
+{
+    //
+    // Storage provider keeping all the vaults in memory, indexed by vault and
+    // key, and persisting them in an append-only log of AES-256-GCM
+    // encrypted records. Each record is authenticated with its generation
+    // and sequence number, so records can be neither altered nor reordered,
+    // and replaying the log stops at the first record failing to decrypt,
+    // which drops a record torn by a crash.
+    // The log alternates between two files, "<path>.0" and "<path>.1": once
+    // it has grown well past the live values, they are compacted into the
+    // other file under the next generation, which only replaces the log
+    // when its commit record is written. The previous file is left as it
+    // is until the following compaction reuses it.
+    // Every record is flushed through IFile::Flush before the call
+    // returns, durability beyond that is the one of the underlying
+    // IFileSystemProvider. A record whose write fails is overwritten by the
+    // next one.
+    //
+    class FileStorageProvider : public IStorageProvider, public NonCopyable
+    {
+    public:
+        FileStorageProvider(
+            IFileSystemProvider * fileSystemProvider,
+            const std::string & storagePath,
+            const KeyType & encryptionKey
+            );
+
+        //
+        // Replays the log, or creates it when there is none. Throws a
+        // StatusException when a log exists but can not be decrypted with
+        // the key.
+        //
+        void Open();
+
+        //
+        // Rewrites the live values in the other log file.
+        //
+        void Compact();
+
+        // IStorageProvider
+        virtual std::string GetValue(const std::string & vaultId, const std::string & key);
+        virtual void SetValue(const std::string & vaultId, const std::string & key, const std::string & value);
+        virtual KvStringsIterator * EnumerateVault(const std::string & vaultId);
+        virtual KvStringsIterator * EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix);
+        virtual bool GetValues(const std::string & vaultId, const std::vector<std::string> & keys, std::vector<std::string> & values);
+        virtual bool EnumerateVaultToBuffer(const std::string & vaultId, const std::string & keyPrefix, std::string & buffer);
+
+        //
+        // Sets all the given values of the vault in a single record, so that
+        // either all or none of them are replayed after a crash.
+        //
+        virtual bool SetValues(const std::string & vaultId, const StringsMap & values);
+
+    public:
+        static const size_t KeySize;
+        static const int64_t MinCompactionSize;
+
+    private:
+        typedef std::unordered_map<std::string, std::string> VaultIndex;
+        typedef std::unordered_map<std::string, VaultIndex> StorageIndex;
+
+        struct LogState
+        {
+            LogState();
+
+            bool committed;
+            bool rejected;
+            uint64_t generation;
+            uint64_t sequence;
+            int64_t size;
+            StorageIndex index;
+        };
+
+    private:
+        StringsMap ValuesWithPrefix(const std::string & vaultId, const std::string & keyPrefix);
+        std::string LogPath(size_t fileIndex) const;
+        void ReplayLog(size_t fileIndex, LogState & state);
+        uint64_t WriteSnapshot(IFile * file, uint64_t generation);
+        void AppendRecord(IFile * file, uint64_t generation, uint64_t & sequence, const Buffer & plainText);
+        bool DecryptRecord(const unsigned char * record, size_t recordSize, uint64_t generation, uint64_t sequence, Buffer & plainText);
+        void CheckOpened() const;
+        void SetIndexValue(const std::string & vaultId, const std::string & key, const std::string & value);
+        void CompactLog();
+        void CompactIfNeeded();
+
+        static bool ApplyBatch(const Buffer & batch, StorageIndex & index);
+        static size_t EntrySize(const std::string & vaultId, const std::string & key, const std::string & value);
+        static void WriteLength(Buffer & buffer, size_t length);
+        static size_t ReadLength(const unsigned char * data);
+        static void WriteUInt64(Buffer & buffer, uint64_t value);
+        static uint64_t ReadUInt64(const unsigned char * data);
+        static void WriteField(Buffer & buffer, const std::string & field);
+        static bool ReadField(const Buffer & buffer, size_t & pos, std::string & field);
+
+    private:
+        IFileSystemProvider * m_fileSystemProvider;
+        std::string m_storagePath;
+
+        StorageIndex m_index;
+        size_t m_liveSize;
+
+        std::unique_ptr<IFile> m_logFile;
+        size_t m_logFileIndex;
+        uint64_t m_generation;
+        uint64_t m_sequence;
+
+        CryptoPP::GCM<CryptoPP::AES>::Encryption m_encryption;
+        CryptoPP::GCM<CryptoPP::AES>::Decryption m_decryption;
+        CryptoPP::AutoSeededRandomPool m_random;
+        std::mutex m_sync;
+    };
+}
+
+#endif //__FILE_STORAGE_PROVIDER_H__
@@ -0,0 +1,159 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __HASHING_WRITABLE_STREAM_H__
+#define __HASHING_WRITABLE_STREAM_H__
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "public/StreamInterfaces.h"
+#include "CryptoAlgorithmInterfaces.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    //
+    // Forwards writes to the underlying stream and hashes the bytes on the
+    // way, as long as they are written one after the other from the start.
+    // Bytes written further are left to CatchUp(), which reads them back
+    // once everything before them is written. Once a write lands on bytes
+    // already hashed the hash no longer describes the content,
+    // IsSequential() tells the owner to hash the stream again.
+    // With a resumable algorithm, the hash of the first bytes can be saved
+    // and given back to another stream writing the rest of the content.
+    //
+    class HashingWritableStream : public IWritableStream, public NonCopyable
+    {
+    public:
+        HashingWritableStream(IWritableStream * stream, IHashAlgorithm * algorithm)
+            : m_stream(stream)
+            , m_algorithm(algorithm)
+            , m_hashedSize(0)
+            , m_sequential(true)
+        {
+        }
+
+        virtual void Write(const unsigned char * pBuffer, int64_t sizeToWrite)
+        {
+            int64_t position = m_stream->WritePosition();
+            if (m_sequential && position == m_hashedSize)
+            {
+                m_algorithm->UpdateHash(pBuffer, static_cast<size_t>(sizeToWrite));
+                m_hashedSize += sizeToWrite;
+            }
+            else if (position < m_hashedSize)
+            {
+                m_sequential = false;
+            }
+            m_stream->Write(pBuffer, sizeToWrite);
+        }
+
+        //
+        // Hashes the bytes of source from the hashed size up to end, which
+        // must have been written already.
+        //
+        void CatchUp(IReadableStream * source, int64_t end)
+        {
+            std::vector<unsigned char> buffer(CatchUpBufferSize);
+            while (m_sequential && m_hashedSize < end)
+            {
+                int64_t sizeToRead = std::min<int64_t>(end - m_hashedSize, buffer.size());
+                source->SetReadPosition(m_hashedSize);
+                source->Read(buffer.data(), sizeToRead);
+                m_algorithm->UpdateHash(buffer.data(), static_cast<size_t>(sizeToRead));
+                m_hashedSize += sizeToRead;
+            }
+        }
+
+        virtual void SetWritePosition(int64_t pos)
+        {
+            m_stream->SetWritePosition(pos);
+        }
+
+        virtual int64_t WritePosition() const
+        {
+            return m_stream->WritePosition();
+        }
+
+        bool IsSequential() const
+        {
+            return m_sequential;
+        }
+
+        int64_t HashedSize() const
+        {
+            return m_hashedSize;
+        }
+
+        //
+        // State of the hash of the first HashedSize() bytes, empty when it
+        // can not be saved.
+        //
+        Buffer SaveState() const
+        {
+            IResumableHashAlgorithm * resumable = dynamic_cast<IResumableHashAlgorithm *>(m_algorithm.get());
+            if (!m_sequential || resumable == nullptr)
+            {
+                return Buffer();
+            }
+            return resumable->SaveState();
+        }
+
+        //
+        // Goes on from the hash of the first hashedSize bytes of the stream,
+        // before anything is written. Returns false if the state does not
+        // fit the algorithm, the stream is then hashed from the start.
+        //
+        bool RestoreState(int64_t hashedSize, const Buffer & state)
+        {
+            IResumableHashAlgorithm * resumable = dynamic_cast<IResumableHashAlgorithm *>(m_algorithm.get());
+            if (m_hashedSize != 0 || resumable == nullptr || !resumable->RestoreState(state))
+            {
+                return false;
+            }
+            m_hashedSize = hashedSize;
+            return true;
+        }
+
+        KeyType Hash()
+        {
+            return m_algorithm->Hash();
+        }
+
+    private:
+        static const int64_t CatchUpBufferSize = 64 * 1024;
+
+    private:
+        IWritableStream * m_stream;
+        std::unique_ptr<IHashAlgorithm> m_algorithm;
+        int64_t m_hashedSize;
+        bool m_sequential;
+    };
+}
+
+#endif //__HASHING_WRITABLE_STREAM_H__
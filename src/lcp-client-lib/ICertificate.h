@@ -32,6 +32,8 @@
 
 namespace lcp
 {
+    class IReadableStream;
+
     class ICrlDistributionPoints
     {
     public:
@@ -44,6 +46,12 @@ namespace lcp
     {
     public:
         virtual std::string SerialNumber() const = 0;
+
+        //
+        // Minimal two's complement encoding of the serial number, as in the
+        // DER of the certificate.
+        //
+        virtual Buffer EncodedSerialNumber() const = 0;
         virtual std::string NotBeforeDate() const = 0;
         virtual std::string NotAfterDate() const = 0;
         virtual KeyType PublicKey() const = 0;
@@ -68,13 +76,34 @@ namespace lcp
     {
     public:
         virtual void UpdateRevocationList(const Buffer & crlRaw) = 0;
+
+        //
+        // Decodes the list straight from the current read position of the
+        // stream, window by window instead of loading it in memory first.
+        //
+        virtual void UpdateRevocationList(IReadableStream * crlStream) = 0;
         virtual bool HasThisUpdateDate() const = 0;
         virtual std::string ThisUpdateDate() const = 0;
         virtual bool HasNextUpdateDate() const = 0;
         virtual std::string NextUpdateDate() const = 0;
         virtual bool SerialNumberRevoked(const std::string & serialNumber) const = 0;
-        virtual const StringsSet & RevokedSerialNumbers() const = 0;
+
+        //
+        // Looks up a serial number in the two's complement encoding of
+        // ICertificate::EncodedSerialNumber(), without converting it to a
+        // big integer first.
+        //
+        virtual bool EncodedSerialNumberRevoked(const Buffer & serialNumber) const = 0;
+        virtual StringsSet RevokedSerialNumbers() const = 0;
         virtual const void InsertRevokedSerialNumber(std::string serial) = 0;
+
+        //
+        // Delta CRL locations announced by the base list (Freshest CRL
+        // extension). A delta CRL passed to UpdateRevocationList() is
+        // applied on top of the base list, and rejected with an exception
+        // when it refers to a newer base than the one in use.
+        //
+        virtual StringsList FreshestCrlUrls() const = 0;
         virtual ~ICertificateRevocationList() {}
     };
 
@@ -37,6 +37,10 @@ namespace lcp
     class IKeyProvider;
     class IReadableStream;
     class IEncryptedStream;
+    class ISymmetricAlgorithm;
+    class IHashAlgorithm;
+    class VerificationCache;
+    class ITraceSink;
 
     class ICryptoProvider
     {
@@ -46,6 +50,9 @@ namespace lcp
             ILicense * license
             ) = 0;
 
+        virtual void SetVerificationCache(VerificationCache * verificationCache) = 0;
+        virtual void SetTraceSink(ITraceSink * traceSink) = 0;
+
 #if !DISABLE_CRL
         virtual Status CheckRevokation(ILicense* license) = 0;
 #endif //!DISABLE_CRL
@@ -73,6 +80,12 @@ namespace lcp
             std::vector<unsigned char> & rawHash
             ) = 0;
 
+        //
+        // Same digest as CalculateFileHash(), fed by the caller, for content
+        // hashed while it is being written.
+        //
+        virtual Status CreateFileHashAlgorithm(IHashAlgorithm ** algorithm) = 0;
+
         virtual Status ConvertRawToHex(
             const std::vector<unsigned char> & data,
             std::string & hex
@@ -92,6 +105,12 @@ namespace lcp
             std::string & decrypted
             ) = 0;
 
+        virtual Status CreateLicenseDataAlgorithm(
+            ILicense * license,
+            IKeyProvider * keyProvider,
+            ISymmetricAlgorithm ** algorithm
+            ) = 0;
+
         virtual Status DecryptPublicationData(
             ILicense * license,
             IKeyProvider * keyProvider,
@@ -35,8 +35,12 @@ namespace lcp
     class IKeyProvider
     {
     public:
-        virtual KeyType UserKey() const = 0;
-        virtual KeyType ContentKey() const = 0;
+        //
+        // The keys are returned by reference, they are only copied by the
+        // algorithms using them.
+        //
+        virtual const KeyType & UserKey() const = 0;
+        virtual const KeyType & ContentKey() const = 0;
         virtual ~IKeyProvider() {}
     };
 }
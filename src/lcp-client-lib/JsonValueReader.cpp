@@ -28,6 +28,19 @@
 #include "JsonValueReader.h"
 #include "LcpUtils.h"
 
+namespace
+{
+    //
+    // Returned for the missing optional members, which callers hold by
+    // reference.
+    //
+    const rapidjson::Value & NullValue()
+    {
+        static const rapidjson::Value nullValue(rapidjson::kNullType);
+        return nullValue;
+    }
+}
+
 namespace lcp
 {
     std::string JsonValueReader::ReadString(const std::string & name, const rapidjson::Value & jsonValue)
@@ -63,7 +76,7 @@ namespace lcp
         {
             return it->value;
         }
-        return rapidjson::Value(rapidjson::kNullType).Move();
+        return NullValue();
     }
 
     const rapidjson::Value & JsonValueReader::ReadArrayCheck(const std::string & name, const rapidjson::Value & jsonValue)
@@ -83,7 +96,7 @@ namespace lcp
         {
             return it->value;
         }
-        return rapidjson::Value(rapidjson::kNullType).Move();
+        return NullValue();
     }
 
     const rapidjson::Value & JsonValueReader::ReadObjectCheck(const std::string & name, const rapidjson::Value & jsonValue)
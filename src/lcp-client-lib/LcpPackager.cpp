@@ -0,0 +1,173 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <memory>
+#include <stdexcept>
+#include "public/LcpPackager.h"
+#include "IncludeMacros.h"
+#include "Lcp1dot0EncryptionProfile.h"
+#include "LcpUtils.h"
+#include "PublicationEncryptor.h"
+#include "WorkerPool.h"
+#if ENABLE_TEST_LICENSE_ISSUER
+#include "TestLicenseIssuer.h"
+#endif //ENABLE_TEST_LICENSE_ISSUER
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/osrng.h>
+#include <cryptopp/secblock.h>
+CRYPTOPP_INCLUDE_END
+
+namespace
+{
+    const size_t ContentKeySize = 32;
+
+    void CheckContentKey(const std::string & contentKey)
+    {
+        if (contentKey.size() != ContentKeySize)
+        {
+            throw std::invalid_argument("contentKey must hold 32 bytes");
+        }
+    }
+}
+
+namespace lcp
+{
+    Status LcpPackager::GenerateContentKey(std::string & contentKey)
+    {
+        try
+        {
+            CryptoPP::AutoSeededRandomPool rng;
+            CryptoPP::SecByteBlock key(ContentKeySize);
+            rng.GenerateBlock(key.data(), key.size());
+            contentKey.assign(key.begin(), key.end());
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const CryptoPP::Exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + ex.GetWhat());
+        }
+    }
+
+    Status LcpPackager::EncryptPublication(
+        IFileSystemProvider * fileSystemProvider,
+        const std::string & publicationPath,
+        const std::string & outputPath,
+        const std::string & contentKey,
+        bool compress,
+        const AlgorithmSelector & algorithmSelector,
+        const ILcpService::ExportProgressCallback & progress,
+        CancellationToken * cancellation,
+        size_t maxWorkerThreads
+        )
+    {
+        if (fileSystemProvider == nullptr)
+        {
+            throw std::invalid_argument("fileSystemProvider is nullptr");
+        }
+        CheckContentKey(contentKey);
+
+        try
+        {
+            Lcp1dot0EncryptionProfile profile;
+            WorkerPool workerPool((maxWorkerThreads != 0) ? maxWorkerThreads : WorkerPool::DefaultThreadsCount());
+            PublicationEncryptor encryptor(fileSystemProvider, &workerPool, &profile);
+            encryptor.Encrypt(
+                publicationPath,
+                outputPath,
+                KeyType(contentKey.begin(), contentKey.end()),
+                [&profile, &algorithmSelector](const std::string & entryName)
+                {
+                    ContentAlgorithm algorithm = algorithmSelector ? algorithmSelector(entryName) : AesCbc;
+                    if (algorithm == AesCbc)
+                        return profile.PublicationAlgorithmCBC();
+                    else if (algorithm == AesGcm)
+                        return profile.PublicationAlgorithmGCM();
+                    return std::string();
+                },
+                compress,
+                progress,
+                cancellation
+                );
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+        catch (const CryptoPP::Exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + ex.GetWhat());
+        }
+        catch (const std::exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + std::string(ex.what()));
+        }
+    }
+
+#if ENABLE_TEST_LICENSE_ISSUER
+    Status LcpPackager::CreateTestAuthority(const std::string & provider, TestAuthority & authority)
+    {
+        try
+        {
+            authority = TestLicenseIssuer::CreateAuthority(provider);
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const CryptoPP::Exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + ex.GetWhat());
+        }
+    }
+
+    Status LcpPackager::IssueTestLicense(
+        const TestAuthority & authority,
+        const std::string & contentKey,
+        const TestLicenseInfo & licenseInfo,
+        std::string & license
+        )
+    {
+        CheckContentKey(contentKey);
+
+        try
+        {
+            Lcp1dot0EncryptionProfile profile;
+            TestLicenseIssuer issuer(&profile, authority);
+            license = issuer.IssueLicense(KeyType(contentKey.begin(), contentKey.end()), licenseInfo);
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+        catch (const CryptoPP::Exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + ex.GetWhat());
+        }
+    }
+#endif //ENABLE_TEST_LICENSE_ISSUER
+}
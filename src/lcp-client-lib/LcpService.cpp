@@ -25,6 +25,8 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <algorithm>
+#include <cstdio>
 #include "IncludeMacros.h"
 
 #include "LcpService.h"
@@ -36,17 +38,28 @@
 #include "LcpUtils.h"
 #include "JsonValueReader.h"
 #include "JsonCanonicalizer.h"
+#include "PublicationExporter.h"
+#include "SymmetricAlgorithmEncryptedStream.h"
 #include "EncryptionProfilesManager.h"
 #include "CryptoppCryptoProvider.h"
 #include "SimpleKeyProvider.h"
 #include "public/IStorageProvider.h"
 #include "RightsService.h"
+#include "BatchStorageAdapter.h"
+#include "Scheduler.h"
+#include "Statistics.h"
+#include "StatisticsStorageProvider.h"
+#include "TraceSpan.h"
+#include "WorkerPool.h"
+#include "public/CancellationToken.h"
+#include "VerificationCache.h"
 #include "public/DefaultFileSystemProvider.h"
 
 #include "DateTime.h"
 
 #if ENABLE_NET_PROVIDER_ACQUISITION
 #include "Acquisition.h"
+#include "AcquisitionManager.h"
 #endif //ENABLE_NET_PROVIDER_ACQUISITION
 
 ZIPLIB_INCLUDE_START
@@ -54,6 +67,8 @@ ZIPLIB_INCLUDE_START
 ZIPLIB_INCLUDE_END
 
 static std::string const LcpLicensePath = "META-INF/license.lcpl";
+// Cancellation of DecryptFileAsync is checked between chunks
+static int64_t const DecryptFileChunkSize = 256 * 1024;
 
 namespace lcp
 {
@@ -69,15 +84,24 @@ namespace lcp
         IFileSystemProvider * fileSystemProvider
 #if !DISABLE_CRL
         , const std::string & defaultCrlUrl
+        , const std::string & crlCachePath
 #endif //!DISABLE_CRL
+        , ITraceSink * traceSink
+        , IExecutor * executor
+        , size_t maxWorkerThreads
         )
         : m_rootCertificate(rootCertificate)
 #if !DISABLE_NET_PROVIDER
         , m_netProvider(netProvider)
 #endif //!DISABLE_NET_PROVIDER
-        , m_storageProvider(storageProvider)
+        , m_statistics(new Statistics())
+        , m_statisticsStorageProvider(storageProvider != nullptr ? new StatisticsStorageProvider(storageProvider, m_statistics.get()) : nullptr)
+        , m_storageProvider(m_statisticsStorageProvider.get())
         , m_fileSystemProvider(fileSystemProvider)
-        , m_rightsService(new RightsService(m_storageProvider, UnknownUserId))
+        , m_traceSink(traceSink)
+        , m_workerPool(new WorkerPool((maxWorkerThreads != 0) ? maxWorkerThreads : WorkerPool::DefaultThreadsCount(), m_statistics.get()))
+        , m_scheduler(new Scheduler(m_workerPool.get()))
+        , m_rightsService(new RightsService(m_storageProvider, m_fileSystemProvider, UnknownUserId, m_scheduler.get()))
         , m_jsonReader(new JsonValueReader())
         , m_encryptionProfilesManager(new EncryptionProfilesManager())
         , m_cryptoProvider(new CryptoppCryptoProvider(m_encryptionProfilesManager.get()
@@ -86,21 +110,40 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
 
                     , fileSystemProvider
+                    , m_storageProvider
 
 #if !DISABLE_CRL
                     , defaultCrlUrl
+                    , crlCachePath
+#if !DISABLE_CRL_BACKGROUND_POLL
+                    , m_scheduler.get()
+#endif //!DISABLE_CRL_BACKGROUND_POLL
 #endif //!DISABLE_CRL
             ))
+        , m_executor((executor != nullptr) ? executor : m_workerPool.get())
+        , m_pendingOperations(0)
     {
+        m_cryptoProvider->SetTraceSink(m_traceSink);
+    }
+
+    LcpService::~LcpService()
+    {
+        // The queued operations complete while the service is still whole
+        std::unique_lock<std::mutex> locker(m_pendingOperationsSync);
+        m_conditionPendingOperations.wait(locker, [this]() { return m_pendingOperations == 0; });
     }
 
     Status LcpService::InjectLicense(
             const std::string & publicationPath,
             const std::string & licenseJson) {
+        Statistics::Scope statisticsScope(m_statistics.get());
         try
         {
             std::stringstream licenseStream(licenseJson);
-            ZipFile::AddFile(publicationPath, licenseStream, LcpLicensePath);
+            if (!ZipFile::AddFileInPlace(publicationPath, licenseStream, LcpLicensePath))
+            {
+                ZipFile::AddFile(publicationPath, licenseStream, LcpLicensePath);
+            }
             return Status(StatusCode::ErrorCommonSuccess);
         }
         catch (const StatusException & ex)
@@ -148,13 +191,18 @@ namespace lcp
     {
         // When no EPUB path is provided, this means the LCPL file is opened directly (client needs "publication" link to acquire / download the EPUB)
         m_publicationPath = publicationPath;
+        Statistics::Scope statisticsScope(m_statistics.get());
+        Statistics::Timer timer(StatisticsOperation::OpenLicense);
+        TraceSpan span(m_traceSink, "LcpService::OpenLicense");
 
         try
         {
             std::string canonicalJson = this->CalculateCanonicalForm(licenseJson);
 
             bool foundLicense = this->FindLicense(canonicalJson, licensePTR);
+            span.SetAttribute("alreadyOpened", foundLicense ? "true" : "false");
             if (foundLicense) {
+                Statistics::Increment(StatisticsCounter::LicensesOpened);
                 Status res = Status(StatusCode::ErrorCommonSuccess);
 
                 if (!(*licensePTR)->Decrypted()) {
@@ -210,6 +258,7 @@ namespace lcp
             }
             (*licensePTR) = insertRes.first->second.get();
             locker.unlock();
+            Statistics::Increment(StatisticsCounter::LicensesOpened);
 
             Status result = Status(StatusCode::ErrorCommonSuccess);
 
@@ -335,6 +384,9 @@ namespace lcp
 
     Status LcpService::DecryptLicense(ILicense * license, const std::string & userPassphrase)
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
+        Statistics::Timer timer(StatisticsOperation::DecryptLicense);
+        TraceSpan span(m_traceSink, "LcpService::DecryptLicense");
         try
         {
             if (license == nullptr)
@@ -379,6 +431,7 @@ namespace lcp
     
     Status LcpService::DecryptLicenseByUserKeyHexString(ILicense * license, const std::string & userKeyHexString)
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
         KeyType userKey1;
         KeyType userKey2;
 
@@ -435,19 +488,31 @@ namespace lcp
 
     Status LcpService::DecryptLicenseByStorage(ILicense * license)
     {
+        TraceSpan span(m_traceSink, "LcpService::DecryptLicenseByStorage");
         if (m_storageProvider == nullptr)
         {
             return Status(StatusCode::ErrorCommonNoStorageProvider, "ErrorCommonNoStorageProvider");
         }
 
-        std::string userKeyHex = m_storageProvider->GetValue(
-            UserKeysVaultId,
-            BuildStorageProviderKey(license)
-            );
-        if (!userKeyHex.empty())
+        // The keys stored for this License, under its User or registered
+        // without one, are fetched at once
+        std::vector<std::string> licenseKeys(1, BuildStorageProviderKey(license));
+        std::string unknownUserKey = BuildStorageProviderKey(license->Provider(), UnknownUserId, license->Id());
+        if (unknownUserKey != licenseKeys.front())
+        {
+            licenseKeys.push_back(unknownUserKey);
+        }
+        BatchStorageAdapter storage(m_storageProvider);
+        std::vector<std::string> licenseUserKeys = storage.GetValues(UserKeysVaultId, licenseKeys);
+        for (auto keyIt = licenseUserKeys.begin(); keyIt != licenseUserKeys.end(); ++keyIt)
         {
+            if (keyIt->empty())
+            {
+                continue;
+            }
+
             KeyType userKey1;
-            Status res = m_cryptoProvider->ConvertHexToRaw(userKeyHex, userKey1);
+            Status res = m_cryptoProvider->ConvertHexToRaw(*keyIt, userKey1);
             if (!Status::IsSuccess(res))
                 return res;
 
@@ -458,14 +523,23 @@ namespace lcp
 
             res = this->DecryptLicenseByUserKey(license, userKey2);
             if (Status::IsSuccess(res)) {
+                span.SetAttribute("walkedKeys", static_cast<int64_t>(0));
                 return res;
             }
         }
 
-        std::unique_ptr<KvStringsIterator> it(m_storageProvider->EnumerateVault(UserKeysVaultId));
-        for (it->First(); !it->IsDone(); it->Next())
+        // Without the key stored for this License, every other user key is
+        // tried, the vault being read in one call when the storage allows it
+        int64_t walkedKeys = 0;
+        StringsMap userKeys = storage.VaultValues(UserKeysVaultId);
+        for (auto it = userKeys.begin(); it != userKeys.end(); ++it)
         {
-            std::string userKeyHex = it->Current();
+            if (std::find(licenseKeys.begin(), licenseKeys.end(), it->first) != licenseKeys.end())
+            {
+                continue;
+            }
+            const std::string & userKeyHex = it->second;
+            ++walkedKeys;
 
             KeyType userKey1;
             Status res = m_cryptoProvider->ConvertHexToRaw(userKeyHex, userKey1);
@@ -479,8 +553,12 @@ namespace lcp
 
             res = this->DecryptLicenseByUserKey(license, userKey2);
             if (Status::IsSuccess(res))
+            {
+                span.SetAttribute("walkedKeys", walkedKeys);
                 return res;
+            }
         }
+        span.SetAttribute("walkedKeys", walkedKeys);
         return Status(StatusCode::ErrorDecryptionLicenseEncrypted, "ErrorDecryptionLicenseEncrypted");
     }
 
@@ -493,6 +571,11 @@ namespace lcp
         const std::string & algorithm
         )
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
+        Statistics::Timer timer(StatisticsOperation::DecryptData);
+        TraceSpan span(m_traceSink, "LcpService::DecryptData");
+        span.SetAttribute("algorithm", algorithm);
+        span.SetAttribute("length", static_cast<int64_t>(dataLength));
         try
         {
             if (license == nullptr)
@@ -549,6 +632,7 @@ namespace lcp
         IEncryptedStream ** encStream
         )
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
         try
         {
             if (license == nullptr || encStream == nullptr)
@@ -637,6 +721,7 @@ namespace lcp
         const std::string & licenseId
         )
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
         try
         {
             if (m_storageProvider == nullptr)
@@ -666,6 +751,7 @@ namespace lcp
             IAcquisition ** acquisition
     )
     {
+        Statistics::Scope statisticsScope(m_statistics.get());
         try
         {
             if (acquisition == nullptr)
@@ -676,13 +762,48 @@ namespace lcp
             {
                 return Status(StatusCode::ErrorCommonNoNetProvider, "ErrorCommonNoNetProvider");
             }
-            *acquisition = new Acquisition(
+            Acquisition * newAcquisition = new Acquisition(
                     license,
                     m_fileSystemProvider,
                     m_netProvider,
                     m_cryptoProvider.get(),
                     publicationPath
             );
+            newAcquisition->SetTraceSink(m_traceSink);
+            *acquisition = newAcquisition;
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+    }
+
+    Status LcpService::CreateAcquisitionManager(
+            size_t maxConcurrentAcquisitions,
+            IAcquisitionManagerCallback * callback,
+            IAcquisitionManager ** manager
+    )
+    {
+        Statistics::Scope statisticsScope(m_statistics.get());
+        try
+        {
+            if (manager == nullptr)
+            {
+                throw std::invalid_argument("manager is nullptr");
+            }
+            if (m_netProvider == nullptr)
+            {
+                return Status(StatusCode::ErrorCommonNoNetProvider, "ErrorCommonNoNetProvider");
+            }
+            *manager = new AcquisitionManager(
+                    m_fileSystemProvider,
+                    m_netProvider,
+                    m_cryptoProvider.get(),
+                    maxConcurrentAcquisitions,
+                    callback,
+                    m_traceSink
+            );
             return Status(StatusCode::ErrorCommonSuccess);
         }
         catch (const StatusException & ex)
@@ -692,6 +813,189 @@ namespace lcp
     }
 #endif //ENABLE_NET_PROVIDER_ACQUISITION
 
+    Status LcpService::EnableVerificationCache(const std::string & cachePath)
+    {
+        Statistics::Scope statisticsScope(m_statistics.get());
+        try
+        {
+            if (m_storageProvider == nullptr)
+            {
+                return Status(StatusCode::ErrorCommonNoStorageProvider, "ErrorCommonNoStorageProvider");
+            }
+
+            std::unique_ptr<VerificationCache> verificationCache(
+                new VerificationCache(m_storageProvider, m_fileSystemProvider, cachePath)
+                );
+            verificationCache->Load();
+
+            m_cryptoProvider->SetVerificationCache(verificationCache.get());
+            m_verificationCache = std::move(verificationCache);
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+        catch (const std::exception & ex)
+        {
+            return Status(StatusCode::ErrorCommonNoStorageProvider, "ErrorCommonNoStorageProvider: " + std::string(ex.what()));
+        }
+    }
+
+    Status LcpService::ReadStatistics(StatisticsSnapshot & snapshot, bool reset)
+    {
+        m_statistics->Read(snapshot, reset);
+        return Status(StatusCode::ErrorCommonSuccess);
+    }
+
+    void LcpService::OpenLicenseAsync(
+            const std::string & publicationPath,
+            const std::string & licenseJson,
+            OpenLicenseCallback callback,
+            CancellationToken * cancellation)
+    {
+        this->PostAsyncOperation([this, publicationPath, licenseJson, callback, cancellation]()
+        {
+            ILicense * license = nullptr;
+            Status result = this->RunAsyncOperation(cancellation, [&]()
+            {
+                return this->OpenLicense(publicationPath, licenseJson, &license);
+            });
+            callback(result, license);
+        });
+    }
+
+    void LcpService::DecryptLicenseAsync(
+            ILicense * license,
+            const std::string & userPassphrase,
+            CompletionCallback callback,
+            CancellationToken * cancellation)
+    {
+        this->PostAsyncOperation([this, license, userPassphrase, callback, cancellation]()
+        {
+            Status result = this->RunAsyncOperation(cancellation, [&]()
+            {
+                return this->DecryptLicense(license, userPassphrase);
+            });
+            callback(result);
+        });
+    }
+
+    void LcpService::DecryptFileAsync(
+            const std::string & licenseJson,
+            const std::string & file_in,
+            const std::string & file_out,
+            CompletionCallback callback,
+            CancellationToken * cancellation)
+    {
+        this->PostAsyncOperation([this, licenseJson, file_in, file_out, callback, cancellation]()
+        {
+            Status result = this->RunAsyncOperation(cancellation, [&]()
+            {
+                return this->DecryptFile(licenseJson, file_in, file_out, cancellation);
+            });
+            callback(result);
+        });
+    }
+
+    Status LcpService::ExportPublication(
+            ILicense * license,
+            const std::string & publicationPath,
+            const std::string & outputPath,
+            ExportTarget target,
+            ExportProgressCallback progress,
+            CancellationToken * cancellation)
+    {
+        Statistics::Scope statisticsScope(m_statistics.get());
+        TraceSpan span(m_traceSink, "LcpService::ExportPublication");
+        try
+        {
+            if (license == nullptr)
+            {
+                throw std::invalid_argument("wrong input params");
+            }
+
+            if (!license->Decrypted())
+            {
+                return Status(StatusCode::ErrorDecryptionLicenseEncrypted, "ErrorDecryptionLicenseEncrypted");
+            }
+
+            PublicationExporter exporter(
+                m_fileSystemProvider,
+                m_workerPool.get(),
+                [this, license](IReadableStream * stream, const std::string & algorithm, IEncryptedStream ** encStream)
+                {
+                    return this->CreateEncryptedDataStream(license, stream, algorithm, encStream);
+                });
+            exporter.Export(publicationPath, outputPath, target, progress, cancellation);
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+        catch (const std::exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + std::string(ex.what()));
+        }
+    }
+
+    void LcpService::PostAsyncOperation(std::function<void()> operation)
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_pendingOperationsSync);
+            ++m_pendingOperations;
+        }
+        m_executor->Execute([this, operation]()
+        {
+            // The executor may be the client's
+            Statistics::Scope statisticsScope(m_statistics.get());
+
+            // A throwing callback must not leave the destructor waiting
+            try
+            {
+                operation();
+            }
+            catch (...)
+            {
+                this->EndAsyncOperation();
+                throw;
+            }
+            this->EndAsyncOperation();
+        });
+    }
+
+    void LcpService::EndAsyncOperation()
+    {
+        std::unique_lock<std::mutex> locker(m_pendingOperationsSync);
+        if (--m_pendingOperations == 0)
+        {
+            m_conditionPendingOperations.notify_all();
+        }
+    }
+
+    Status LcpService::RunAsyncOperation(CancellationToken * cancellation, const std::function<Status()> & operation)
+    {
+        if (cancellation != nullptr && cancellation->IsCanceled())
+        {
+            return Status(StatusCode::ErrorCommonOperationCanceled, "ErrorCommonOperationCanceled");
+        }
+
+        // Nothing may escape to the thread of the executor
+        try
+        {
+            return operation();
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+        catch (const std::exception & ex)
+        {
+            return Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: " + std::string(ex.what()));
+        }
+    }
+
     IRightsService * LcpService::GetRightsService() const
     {
         return m_rightsService.get();
@@ -762,6 +1066,15 @@ namespace lcp
     }
 
     Status LcpService::DecryptFile(const std::string & licenseJson, const std::string & file_in, const std::string & file_out) {
+        return this->DecryptFile(licenseJson, file_in, file_out, nullptr);
+    }
+
+    Status LcpService::DecryptFile(
+            const std::string & licenseJson,
+            const std::string & file_in,
+            const std::string & file_out,
+            CancellationToken * cancellation) {
+        Statistics::Scope statisticsScope(m_statistics.get());
         std::string canonicalJson = this->CalculateCanonicalForm(licenseJson);
         ILicense *license;
         bool foundLicense = this->FindLicense(canonicalJson, &license);
@@ -769,22 +1082,61 @@ namespace lcp
             return Status(StatusCode::ErrorDecryptionLicenseEncrypted, "ErrorDecryptionLicenseEncrypted");
         }
 
-        IEncryptedStream *encryptedStream;
-        DefaultFile *readableStream = new DefaultFile(file_in, IFileSystemProvider::OpenMode::ReadOnly);
-            Status status = CreateEncryptedDataStream(license, readableStream, license->Crypto()->ContentKeyAlgorithm(), &encryptedStream);
+        std::unique_ptr<DefaultFile> readableStream(new DefaultFile(file_in, IFileSystemProvider::OpenMode::ReadOnly));
+        IEncryptedStream *encStream = nullptr;
+        Status status = CreateEncryptedDataStream(license, readableStream.get(), license->Crypto()->ContentKeyAlgorithm(), &encStream);
         if (!Status::IsSuccess(status)) {
             return status;
         }
+        std::unique_ptr<IEncryptedStream> encryptedStream(encStream);
 
-        DefaultFile *writableStream = new DefaultFile(file_out, IFileSystemProvider::OpenMode::CreateNew);
-        int64_t bytesToRead = encryptedStream->DecryptedSize();
-        uint8_t *buffer = (uint8_t *)malloc(bytesToRead);
-        encryptedStream->Read(buffer, bytesToRead);
-        writableStream->Write(buffer, bytesToRead);
-        free(buffer);
-        delete readableStream;
-        delete writableStream;
-        delete encryptedStream;
+        std::unique_ptr<DefaultFile> writableStream(new DefaultFile(file_out, IFileSystemProvider::OpenMode::CreateNew));
+        try {
+            // GCM is decrypted in one pass over the file, which checks its
+            // tag at the end, the other algorithms by ranges
+            IReadableStream *source = encryptedStream.get();
+            int64_t size = 0;
+            std::unique_ptr<IDecryptor> decryptor;
+            SymmetricAlgorithmEncryptedStream *algorithmStream = dynamic_cast<SymmetricAlgorithmEncryptedStream *>(encryptedStream.get());
+            if (algorithmStream != nullptr) {
+                decryptor.reset(algorithmStream->CreateDecryptor(writableStream.get()));
+            }
+            if (decryptor != nullptr) {
+                source = readableStream.get();
+                size = readableStream->Size();
+                readableStream->SetReadPosition(0);
+            }
+            else {
+                size = encryptedStream->DecryptedSize();
+            }
+
+            Buffer buffer(static_cast<size_t>(std::min(size, DecryptFileChunkSize)));
+            for (int64_t position = 0; position < size; position += DecryptFileChunkSize) {
+                if (cancellation != nullptr && cancellation->IsCanceled()) {
+                    writableStream.reset();
+                    std::remove(file_out.c_str());
+                    return Status(StatusCode::ErrorCommonOperationCanceled, "ErrorCommonOperationCanceled");
+                }
+
+                size_t count = static_cast<size_t>(std::min(DecryptFileChunkSize, size - position));
+                source->Read(buffer.data(), count);
+                if (decryptor != nullptr) {
+                    decryptor->Update(buffer.data(), count);
+                }
+                else {
+                    writableStream->Write(buffer.data(), count);
+                }
+            }
+            if (decryptor != nullptr) {
+                decryptor->Finish();
+            }
+        }
+        catch (...) {
+            // The plain text of a file which fails to decrypt is not kept
+            writableStream.reset();
+            std::remove(file_out.c_str());
+            throw;
+        }
         return Status(StatusCode::ErrorCommonSuccess);
     }
 }
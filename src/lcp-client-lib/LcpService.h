@@ -28,6 +28,7 @@
 #ifndef __LCP_SERVICE_H__
 #define __LCP_SERVICE_H__
 
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -41,6 +42,13 @@ namespace lcp
     class JsonValueReader;
     class EncryptionProfilesManager;
     class ICryptoProvider;
+    class VerificationCache;
+    class Statistics;
+    class StatisticsStorageProvider;
+    class ITraceSink;
+    class IExecutor;
+    class WorkerPool;
+    class Scheduler;
 
     class LcpService : public ILcpService, public NonCopyable
     {
@@ -60,8 +68,13 @@ namespace lcp
             IFileSystemProvider * fileSystemProvider
 #if !DISABLE_CRL
             , const std::string & defaultCrlUrl
+            , const std::string & crlCachePath
 #endif //!DISABLE_CRL
+            , ITraceSink * traceSink = nullptr
+            , IExecutor * executor = nullptr
+            , size_t maxWorkerThreads = 0
             );
+        ~LcpService();
 
         // ILcpService
         virtual Status OpenLicense(
@@ -116,8 +129,42 @@ namespace lcp
                 ILicense * license,
                 IAcquisition ** acquisition
         );
+        virtual Status CreateAcquisitionManager(
+                size_t maxConcurrentAcquisitions,
+                IAcquisitionManagerCallback * callback,
+                IAcquisitionManager ** manager
+        );
 #endif //ENABLE_NET_PROVIDER_ACQUISITION
 
+        virtual Status EnableVerificationCache(const std::string & cachePath);
+
+        virtual Status ReadStatistics(StatisticsSnapshot & snapshot, bool reset);
+
+        virtual void OpenLicenseAsync(
+                const std::string & publicationPath,
+                const std::string & licenseJson,
+                OpenLicenseCallback callback,
+                CancellationToken * cancellation = nullptr);
+        virtual void DecryptLicenseAsync(
+                ILicense * license,
+                const std::string & userPassphrase,
+                CompletionCallback callback,
+                CancellationToken * cancellation = nullptr);
+        virtual void DecryptFileAsync(
+                const std::string & licenseJson,
+                const std::string & file_in,
+                const std::string & file_out,
+                CompletionCallback callback,
+                CancellationToken * cancellation = nullptr);
+
+        virtual Status ExportPublication(
+                ILicense * license,
+                const std::string & publicationPath,
+                const std::string & outputPath,
+                ExportTarget target,
+                ExportProgressCallback progress = ExportProgressCallback(),
+                CancellationToken * cancellation = nullptr);
+
         virtual IRightsService * GetRightsService() const;
 
         virtual std::string RootCertificate() const;
@@ -131,8 +178,17 @@ namespace lcp
         bool FindLicense(const std::string & canonicalJson, ILicense ** license);
         
         Status DecryptLicenseOnOpening(ILicense * license);
-        Status DecryptLicenseByUserKey(ILicense * license, const KeyType & userKey);
+        Status DecryptLicenseByUserKey(ILicense * license, const KeyType & userKey);
         Status DecryptFile(const std::string & licenseJson, const std::string & file_in, const std::string & file_out);
+        Status DecryptFile(
+            const std::string & licenseJson,
+            const std::string & file_in,
+            const std::string & file_out,
+            CancellationToken * cancellation
+            );
+        void PostAsyncOperation(std::function<void()> operation);
+        void EndAsyncOperation();
+        Status RunAsyncOperation(CancellationToken * cancellation, const std::function<Status()> & operation);
 //        Status DecryptLicenseByHexUserKey(ILicense * license, const std::string & hexUserKey);
         Status DecryptLicenseByStorage(ILicense * license);
         Status AddDecryptedUserKey(ILicense * license, const KeyType & userKey);
@@ -151,16 +207,33 @@ namespace lcp
 #if !DISABLE_NET_PROVIDER
         INetProvider * m_netProvider;
 #endif //!DISABLE_NET_PROVIDER
+        // Recorded by the calls of the service and by its threads
+        std::unique_ptr<Statistics> m_statistics;
+        std::unique_ptr<StatisticsStorageProvider> m_statisticsStorageProvider;
         IStorageProvider * m_storageProvider;
         IFileSystemProvider * m_fileSystemProvider;
+        ITraceSink * m_traceSink;
+
+        // Threads shared by the subsystems below, destroyed after them
+        std::unique_ptr<WorkerPool> m_workerPool;
+        std::unique_ptr<Scheduler> m_scheduler;
 
         std::unique_ptr<RightsService> m_rightsService;
         std::unique_ptr<JsonValueReader> m_jsonReader;
         std::unique_ptr<EncryptionProfilesManager> m_encryptionProfilesManager;
+        std::unique_ptr<VerificationCache> m_verificationCache;
         std::unique_ptr<ICryptoProvider> m_cryptoProvider;
         std::map<std::string, std::unique_ptr<ILicense> > m_licenses;
         std::mutex m_licensesSync;
 
+        // Runs the asynchronous operations, the worker pool when the client
+        // gives no executor. The service waits for the pending ones before
+        // being destroyed.
+        IExecutor * m_executor;
+        size_t m_pendingOperations;
+        std::mutex m_pendingOperationsSync;
+        std::condition_variable m_conditionPendingOperations;
+
     private:
 
         static std::string UnknownProvider;
@@ -44,7 +44,11 @@ namespace lcp
         ILcpService ** lcpService
 #if !DISABLE_CRL
         , const std::string & defaultCrlUrl
+        , const std::string & crlCachePath
 #endif //!DISABLE_CRL
+        , ITraceSink * traceSink
+        , IExecutor * executor
+        , size_t maxWorkerThreads
         )
     {
         if (lcpService == nullptr)
@@ -59,7 +63,11 @@ namespace lcp
                                      storageProvider, fileSystemProvider
 #if !DISABLE_CRL
         , defaultCrlUrl
+        , crlCachePath
 #endif //!DISABLE_CRL
+        , traceSink
+        , executor
+        , maxWorkerThreads
         );
         return status;
     }
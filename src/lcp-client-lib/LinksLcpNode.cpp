@@ -26,6 +26,7 @@
 
 
 #include <algorithm>
+#include <limits>
 #include "rapidjson/document.h"
 #include "LinksLcpNode.h"
 #include "JsonValueReader.h"
@@ -34,6 +35,11 @@
 
 namespace lcp
 {
+    LinksLcpNode::LinksLcpNode()
+        : m_linksValue(nullptr)
+    {
+    }
+
     void LinksLcpNode::ParseNode(const rapidjson::Value & parentObject, JsonValueReader * reader)
     {
         auto linksMember = parentObject.FindMember("links");
@@ -83,17 +89,13 @@ namespace lcp
 
                 if (type == rapidjson::kObjectType)
                 {
-                    const rapidjson::Value & linkObject = linksMember->value;
-
-                    Link link = this->ParseLinkValues(linkObject, reader, checkHref);
-                    m_linksMultiMap.insert(std::make_pair(name, link));
+                    this->ValidateLink(linksMember->value, reader, checkHref);
                 }
                 else if (type == rapidjson::kArrayType)
                 {
                     for (auto linkObject = linksMember->value.Begin(); linkObject != linksMember->value.End(); ++linkObject)
                     {
-                        Link link = this->ParseLinkValues(*linkObject, reader, checkHref);
-                        m_linksMultiMap.insert(std::make_pair(name, link));
+                        this->ValidateLink(*linkObject, reader, checkHref);
                     }
                 }
                 else
@@ -143,8 +145,7 @@ namespace lcp
                     hintFound = true;
                     checkHref = false;
                 }
-                Link link = this->ParseLinkValues(*linkObject, reader, checkHref);
-                m_linksMultiMap.insert(std::make_pair(name, link));
+                this->ValidateLink(*linkObject, reader, checkHref);
             }
 
             if (!hintFound)
@@ -162,6 +163,8 @@ namespace lcp
         {
             throw StatusException(Status(StatusCode::ErrorOpeningLicenseNotValid, "ErrorOpeningLicenseNotValid: links object is not valid"));
         }
+
+        m_linksValue = &linksMember->value;
     }
 
 #if ENABLE_GENERIC_JSON_NODE
@@ -185,21 +188,16 @@ namespace lcp
 
     bool LinksLcpNode::GetLinks(const std::string & name, std::vector<Link> & links) const
     {
-        std::pair<LinksMapConstIt, LinksMapConstIt> range = m_linksMultiMap.equal_range(name);
-        std::transform(
-            range.first, range.second,
-            std::back_inserter(links),
-            [&links](const LinksMap::value_type & val) { return val.second; }
-        );
+        this->FindLinks(name, std::numeric_limits<size_t>::max(), &links);
         return !links.empty();
     }
 
     bool LinksLcpNode::GetLink(const std::string & name, Link & link) const
     {
-        auto it = m_linksMultiMap.find(name);
-        if (it != m_linksMultiMap.end())
+        std::vector<Link> links;
+        if (this->FindLinks(name, 1, &links) > 0)
         {
-            link = it->second;
+            link = links.front();
             return true;
         }
         return false;
@@ -207,21 +205,89 @@ namespace lcp
 
     bool LinksLcpNode::HasMany(const std::string & name) const
     {
-        auto range = m_linksMultiMap.equal_range(name);
-        return std::distance(range.first, range.second) > 1;
+        return this->FindLinks(name, 2, nullptr) > 1;
     }
 
     bool LinksLcpNode::Has(const std::string & name) const
     {
-        return (m_linksMultiMap.find(name) != m_linksMultiMap.end());
+        return this->FindLinks(name, 1, nullptr) > 0;
     }
 
     IKeyValueIterator<std::string, Link> * LinksLcpNode::Enumerate() const
     {
+        std::call_once(m_linksMapBuilt, &LinksLcpNode::BuildLinksMap, this);
         return new MultiMapIterator<Link>(m_linksMultiMap);
     }
 
-    Link LinksLcpNode::ParseLinkValues(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref)
+    size_t LinksLcpNode::FindLinks(const std::string & name, size_t maxCount, std::vector<Link> * links) const
+    {
+        std::call_once(m_linksMapBuilt, &LinksLcpNode::BuildLinksMap, this);
+
+        size_t count = 0;
+        auto range = m_linksMultiMap.equal_range(name);
+        for (auto it = range.first; it != range.second && count < maxCount; ++it)
+        {
+            if (links != nullptr)
+            {
+                links->push_back(it->second);
+            }
+            ++count;
+        }
+        return count;
+    }
+
+    void LinksLcpNode::BuildLinksMap() const
+    {
+        if (m_linksValue == nullptr)
+        {
+            return;
+        }
+
+        JsonValueReader reader;
+        const rapidjson::Value & linksValue = *m_linksValue;
+        if (linksValue.IsObject())
+        {
+            for (auto linksMember = linksValue.MemberBegin(); linksMember != linksValue.MemberEnd(); ++linksMember)
+            {
+                std::string name(linksMember->name.GetString(), linksMember->name.GetStringLength());
+                if (linksMember->value.IsObject())
+                {
+                    m_linksMultiMap.insert(std::make_pair(name, this->ParseLinkValues(linksMember->value, &reader, name != Hint)));
+                    continue;
+                }
+                for (auto linkObject = linksMember->value.Begin(); linkObject != linksMember->value.End(); ++linkObject)
+                {
+                    m_linksMultiMap.insert(std::make_pair(name, this->ParseLinkValues(*linkObject, &reader, name != Hint)));
+                }
+            }
+        }
+        else if (linksValue.IsArray())
+        {
+            for (auto linkObject = linksValue.Begin(); linkObject != linksValue.End(); ++linkObject)
+            {
+                const rapidjson::Value & rel = (*linkObject)["rel"];
+                std::string name(rel.GetString(), rel.GetStringLength());
+                m_linksMultiMap.insert(std::make_pair(name, this->ParseLinkValues(*linkObject, &reader, name != Hint)));
+            }
+        }
+
+        // The map holds every link from now on
+        m_linksValue = nullptr;
+    }
+
+    void LinksLcpNode::ValidateLink(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref)
+    {
+        if (!linkObject.IsObject())
+        {
+            throw StatusException(Status(StatusCode::ErrorOpeningLicenseNotValid, "ErrorOpeningLicenseNotValid: links object is not valid"));
+        }
+        if (checkHref)
+        {
+            reader->ReadStringCheck("href", linkObject);
+        }
+    }
+
+    Link LinksLcpNode::ParseLinkValues(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref) const
     {
         Link link;
         if (checkHref) {
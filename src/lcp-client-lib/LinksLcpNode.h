@@ -30,14 +30,23 @@
 
 #include <map>
 #include <list>
+#include <mutex>
+#include "rapidjson/document.h"
 #include "BaseLcpNode.h"
 #include "public/ILinks.h"
 
 namespace lcp
 {
+    //
+    // Links are only validated when the License is parsed, the Link values
+    // are read from the parsed JSON once, when the first one is looked up.
+    // The document given to ParseNode() must outlive the node.
+    //
     class LinksLcpNode : public BaseLcpNode, public ILinks
     {
     public:
+        LinksLcpNode();
+
         // ILcpNode
         virtual void ParseNode(const rapidjson::Value & parentObject, JsonValueReader * reader);
         virtual Status VerifyNode(ILicense * license, IClientProvider * clientProvider, ICryptoProvider * cryptoProvider);
@@ -52,12 +61,18 @@ namespace lcp
         virtual bool GetLinks(const std::string & name, std::vector<Link> & links) const;
 
     private:
-        Link ParseLinkValues(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref);
+        void ValidateLink(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref);
+        Link ParseLinkValues(const rapidjson::Value & linkObject, JsonValueReader * reader, bool checkHref) const;
+        size_t FindLinks(const std::string & name, size_t maxCount, std::vector<Link> * links) const;
+        void BuildLinksMap() const;
 
     private:
         typedef std::multimap<std::string, Link> LinksMap;
         typedef LinksMap::const_iterator LinksMapConstIt;
-        LinksMap m_linksMultiMap;
+
+        mutable const rapidjson::Value * m_linksValue;
+        mutable LinksMap m_linksMultiMap;
+        mutable std::once_flag m_linksMapBuilt;
     };
 }
 
@@ -0,0 +1,162 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include "ParallelJobs.h"
+#include "LcpUtils.h"
+#include "WorkerPool.h"
+#include "public/CancellationToken.h"
+
+namespace
+{
+    using namespace lcp;
+
+    //
+    // State shared by the jobs, which outlives Run() when a job is still
+    // queued in the pool at its end. Such a late job finds the state
+    // closed and returns at once.
+    //
+    struct JobsState
+    {
+        size_t count;
+        ParallelJobs::JobFactory jobFactory;
+        CancellationToken * cancellation;
+
+        std::atomic<size_t> nextIndex;
+        std::atomic<bool> stopped;
+        std::atomic<bool> canceled;
+
+        std::mutex sync;
+        std::condition_variable jobsDone;
+        bool closed;
+        size_t runningJobs;
+        std::exception_ptr error;
+
+        JobsState()
+            : nextIndex(0)
+            , stopped(false)
+            , canceled(false)
+            , closed(false)
+            , runningJobs(0)
+        {
+        }
+    };
+
+    void RunJob(const std::shared_ptr<JobsState> & state)
+    {
+        {
+            std::unique_lock<std::mutex> locker(state->sync);
+            if (state->closed)
+            {
+                return;
+            }
+            ++state->runningJobs;
+        }
+
+        try
+        {
+            ParallelJobs::Job job = state->jobFactory();
+            while (!state->stopped)
+            {
+                size_t index = state->nextIndex++;
+                if (index >= state->count)
+                {
+                    break;
+                }
+                if (state->cancellation != nullptr && state->cancellation->IsCanceled())
+                {
+                    state->canceled = true;
+                    state->stopped = true;
+                    break;
+                }
+                job(index);
+            }
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> locker(state->sync);
+            if (state->error == nullptr)
+            {
+                state->error = std::current_exception();
+            }
+            state->stopped = true;
+        }
+
+        std::unique_lock<std::mutex> locker(state->sync);
+        if (--state->runningJobs == 0)
+        {
+            state->jobsDone.notify_all();
+        }
+    }
+}
+
+namespace lcp
+{
+    /*static*/ void ParallelJobs::Run(
+        WorkerPool * workerPool,
+        size_t count,
+        const JobFactory & jobFactory,
+        CancellationToken * cancellation
+        )
+    {
+        std::shared_ptr<JobsState> state = std::make_shared<JobsState>();
+        state->count = count;
+        state->jobFactory = jobFactory;
+        state->cancellation = cancellation;
+
+        size_t jobsCount = (workerPool != nullptr) ? std::min(workerPool->ThreadsCount(), count) : 1;
+        for (size_t i = 1; i < jobsCount; ++i)
+        {
+            workerPool->Post(WorkerPool::Prefetch, [state]()
+            {
+                RunJob(state);
+            });
+        }
+        RunJob(state);
+
+        {
+            std::unique_lock<std::mutex> locker(state->sync);
+            state->closed = true;
+            state->jobsDone.wait(locker, [&]() { return state->runningJobs == 0; });
+        }
+
+        if (state->error != nullptr)
+        {
+            std::rethrow_exception(state->error);
+        }
+        if (state->canceled)
+        {
+            throw StatusException(Status(StatusCode::ErrorCommonOperationCanceled, "ErrorCommonOperationCanceled"));
+        }
+    }
+}
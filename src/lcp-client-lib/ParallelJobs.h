@@ -0,0 +1,66 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __PARALLEL_JOBS_H__
+#define __PARALLEL_JOBS_H__
+
+#include <functional>
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class WorkerPool;
+    class CancellationToken;
+
+    //
+    // Runs a task on each index of [0, count) with jobs posted in the
+    // prefetch lane of a worker pool, the calling thread running one of
+    // them so that the work goes on when the pool is busy. Each job is
+    // made by the factory on the thread running it, and keeps its own
+    // resources (files, buffers) for all the indices it takes. The first
+    // exception thrown by a job stops the others and is rethrown by Run(),
+    // a canceled token stops them with ErrorCommonOperationCanceled. A job
+    // starting after Run() returned does nothing, so the tasks may use
+    // the state of the caller.
+    //
+    class ParallelJobs : public NonCopyable
+    {
+    public:
+        typedef std::function<void(size_t index)> Job;
+        typedef std::function<Job()> JobFactory;
+
+        static void Run(
+            WorkerPool * workerPool,
+            size_t count,
+            const JobFactory & jobFactory,
+            CancellationToken * cancellation
+            );
+    };
+}
+
+#endif //__PARALLEL_JOBS_H__
@@ -0,0 +1,589 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include "PublicationEncryptor.h"
+#include "CryptoAlgorithmInterfaces.h"
+#include "IEncryptionProfile.h"
+#include "IncludeMacros.h"
+#include "LcpUtils.h"
+#include "ParallelJobs.h"
+#include "PublicationExporter.h"
+#include "StagedFileBuffer.h"
+#include "public/IFileSystemProvider.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+#include "ziplib/Source/ZipLib/methods/StoreMethod.h"
+#include "ziplib/Source/ZipLib/extlibs/zlib/zlib.h"
+ZIPLIB_INCLUDE_END
+
+namespace
+{
+    using namespace lcp;
+
+    const char * ContainerPath = "META-INF/container.xml";
+    const char * EncryptionPath = "META-INF/encryption.xml";
+    const char * LicensePath = "META-INF/license.lcpl";
+    const char * MimetypePath = "mimetype";
+    const uint16_t DeflatedMethod = 8;
+
+    //
+    // Entry of the protected publication, in the order of the archive. The
+    // encrypted ones have an algorithm, rewritten ones carry their content,
+    // the others are read from the entry of the publication at the given
+    // index.
+    //
+    struct EncryptEntry
+    {
+        std::string name;
+        std::string stagedPath;
+        int index;
+        bool directory;
+        bool deflated;
+        time_t lastWriteTime;
+        std::string algorithm;
+        bool compressed;
+        int64_t originalLength;
+        bool rewritten;
+        std::string content;
+    };
+
+    //
+    // State of an encryption, shared by its jobs.
+    //
+    struct EncryptState
+    {
+        std::string publicationPath;
+        IFileSystemProvider * fileSystemProvider;
+        IEncryptionProfile * encryptionProfile;
+        KeyType contentKey;
+        size_t chunkSize;
+        ILcpService::ExportProgressCallback progress;
+
+        std::vector<EncryptEntry> entries;
+
+        std::mutex progressSync;
+        size_t encryptedEntries;
+
+        EncryptState()
+            : encryptedEntries(0)
+        {
+        }
+    };
+
+    //
+    // Resources of an encryption job, kept from an entry to the next.
+    //
+    struct EncryptJob
+    {
+        ZipArchive::Ptr publication;
+        std::vector<unsigned char> input;
+        std::vector<unsigned char> output;
+    };
+
+    //
+    // Raw deflate encoder feeding an encryptor through a caller buffer.
+    //
+    class Deflater : public NonCopyable
+    {
+    public:
+        Deflater()
+        {
+            std::memset(&m_stream, 0, sizeof(m_stream));
+            if (deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                throw std::runtime_error("Can not initialize the deflater");
+            }
+        }
+
+        ~Deflater()
+        {
+            deflateEnd(&m_stream);
+        }
+
+        void Deflate(const unsigned char * data, size_t size, bool finish, std::vector<unsigned char> & buffer, IEncryptor * output)
+        {
+            m_stream.next_in = const_cast<Bytef *>(data);
+            m_stream.avail_in = static_cast<uInt>(size);
+            int result = Z_OK;
+            do
+            {
+                m_stream.next_out = buffer.data();
+                m_stream.avail_out = static_cast<uInt>(buffer.size());
+                result = deflate(&m_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+                if (result == Z_STREAM_ERROR)
+                {
+                    throw std::runtime_error("Can not deflate the entry");
+                }
+
+                size_t deflated = buffer.size() - m_stream.avail_out;
+                if (deflated > 0)
+                {
+                    output->Update(buffer.data(), deflated);
+                }
+            }
+            while (m_stream.avail_out == 0 || (finish && result != Z_STREAM_END));
+        }
+
+    private:
+        z_stream m_stream;
+    };
+
+    std::string EscapeXml(const std::string & value)
+    {
+        std::string result;
+        for (char c : value)
+        {
+            if (c == '&')
+                result += "&amp;";
+            else if (c == '<')
+                result += "&lt;";
+            else if (c == '>')
+                result += "&gt;";
+            else if (c == '"')
+                result += "&quot;";
+            else
+                result += c;
+        }
+        return result;
+    }
+
+    std::string EncryptedDataElement(const EncryptEntry & entry)
+    {
+        std::string element =
+            "  <EncryptedData xmlns=\"http://www.w3.org/2001/04/xmlenc#\">\n"
+            "    <EncryptionMethod Algorithm=\"" + EscapeXml(entry.algorithm) + "\"/>\n"
+            "    <KeyInfo xmlns=\"http://www.w3.org/2000/09/xmldsig#\">\n"
+            "      <RetrievalMethod URI=\"license.lcpl#/encryption/content_key\" Type=\"http://readium.org/2014/01/lcp#EncryptedContentKey\"/>\n"
+            "    </KeyInfo>\n"
+            "    <CipherData>\n"
+            "      <CipherReference URI=\"" + PublicationEncryptor::EscapeUri(entry.name) + "\"/>\n"
+            "    </CipherData>\n";
+        if (entry.compressed)
+        {
+            element +=
+                "    <EncryptionProperties>\n"
+                "      <EncryptionProperty xmlns:ns=\"http://www.idpf.org/2016/encryption#compression\">\n"
+                "        <ns:Compression Method=\"8\" OriginalLength=\"" + std::to_string(entry.originalLength) + "\"/>\n"
+                "      </EncryptionProperty>\n"
+                "    </EncryptionProperties>\n";
+        }
+        element += "  </EncryptedData>\n";
+        return element;
+    }
+
+    std::string ReadEntryContent(ZipArchiveEntry::Ptr zipEntry)
+    {
+        std::istream * stream = zipEntry->GetDecompressionStream();
+        if (stream == nullptr)
+        {
+            throw std::runtime_error("Can not read the entry: " + zipEntry->GetFullName());
+        }
+        std::string content((std::istreambuf_iterator<char>(*stream)), std::istreambuf_iterator<char>());
+        zipEntry->CloseDecompressionStream();
+        return content;
+    }
+
+    void ListEntries(
+        EncryptState & state,
+        const std::string & outputPath,
+        const PublicationEncryptor::AlgorithmSelector & algorithmSelector,
+        bool compress
+        )
+    {
+        // ziplib would create a missing publication
+        std::unique_ptr<IFile> publication(state.fileSystemProvider->GetFile(state.publicationPath, IFileSystemProvider::ReadOnly));
+        publication.reset();
+
+        ZipArchive::Ptr archive = ZipFile::Open(state.publicationPath);
+        if (archive->GetEntriesCount() == 0)
+        {
+            throw std::runtime_error("The publication is not an EPUB: " + state.publicationPath);
+        }
+        if (archive->GetEntry(LicensePath) != nullptr)
+        {
+            throw std::runtime_error("The publication already holds a License Document");
+        }
+
+        // The resources the publication already encrypts stay as they are
+        std::string encryptionXml;
+        std::set<std::string> encryptedPaths;
+        ZipArchiveEntry::Ptr encryptionEntry = archive->GetEntry(EncryptionPath);
+        if (encryptionEntry != nullptr)
+        {
+            encryptionXml = ReadEntryContent(encryptionEntry);
+            for (const PublicationExporter::EncryptedResource & resource : PublicationExporter::ParseEncryption(encryptionXml))
+            {
+                if (resource.algorithm == state.encryptionProfile->PublicationAlgorithmCBC()
+                    || resource.algorithm == state.encryptionProfile->PublicationAlgorithmGCM())
+                {
+                    throw std::runtime_error("The publication is already protected: " + resource.path);
+                }
+                encryptedPaths.insert(resource.path);
+            }
+        }
+
+        // The package documents stay in cleartext, whatever their name
+        std::set<std::string> rootFiles;
+        ZipArchiveEntry::Ptr containerEntry = archive->GetEntry(ContainerPath);
+        if (containerEntry != nullptr)
+        {
+            for (const std::string & rootFile : PublicationExporter::ParseRootFiles(ReadEntryContent(containerEntry)))
+            {
+                rootFiles.insert(rootFile);
+            }
+        }
+
+        std::string encryptedData;
+        size_t encryptionIndex = std::string::npos;
+        for (size_t i = 0; i < archive->GetEntriesCount(); ++i)
+        {
+            ZipArchiveEntry::Ptr zipEntry = archive->GetEntry(static_cast<int>(i));
+            EncryptEntry entry;
+            entry.name = zipEntry->GetFullName();
+            entry.index = static_cast<int>(i);
+            entry.directory = zipEntry->IsDirectory();
+            entry.deflated = (zipEntry->GetCompressionMethod() == DeflatedMethod) && entry.name != MimetypePath;
+            entry.lastWriteTime = zipEntry->GetLastWriteTime();
+            entry.compressed = false;
+            entry.originalLength = static_cast<int64_t>(zipEntry->GetSize());
+            entry.rewritten = false;
+            entry.stagedPath = outputPath + "." + std::to_string(state.entries.size()) + ".part";
+            if (entry.name == EncryptionPath)
+            {
+                encryptionIndex = state.entries.size();
+            }
+
+            if (!entry.directory && PublicationEncryptor::IsEncryptable(entry.name)
+                && rootFiles.count(entry.name) == 0 && encryptedPaths.count(entry.name) == 0)
+            {
+                entry.algorithm = algorithmSelector(entry.name);
+                if (!entry.algorithm.empty())
+                {
+                    if (entry.algorithm != state.encryptionProfile->PublicationAlgorithmCBC()
+                        && entry.algorithm != state.encryptionProfile->PublicationAlgorithmGCM())
+                    {
+                        throw StatusException(Status(StatusCode::ErrorCommonAlgorithmMismatch, "ErrorCommonAlgorithmMismatch: " + entry.algorithm));
+                    }
+                    entry.compressed = compress && !PublicationEncryptor::IsCompressedMedia(entry.name);
+                    encryptedData += EncryptedDataElement(entry);
+                }
+            }
+            state.entries.push_back(entry);
+        }
+
+        // A new encryption.xml is added last, an existing one gets the new
+        // elements before the end of its root
+        if (encryptedData.empty())
+        {
+            return;
+        }
+        if (encryptionIndex == std::string::npos)
+        {
+            EncryptEntry entry;
+            entry.name = EncryptionPath;
+            entry.index = -1;
+            entry.directory = false;
+            entry.stagedPath = outputPath + "." + std::to_string(state.entries.size()) + ".part";
+            entry.lastWriteTime = std::time(nullptr);
+            state.entries.push_back(entry);
+            encryptionIndex = state.entries.size() - 1;
+            encryptionXml =
+                "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<encryption xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                "</encryption>\n";
+        }
+        size_t rootEnd = encryptionXml.rfind("</");
+        if (rootEnd == std::string::npos)
+        {
+            throw std::runtime_error("Can not read META-INF/encryption.xml");
+        }
+
+        EncryptEntry & entry = state.entries[encryptionIndex];
+        entry.deflated = true;
+        entry.rewritten = true;
+        entry.compressed = false;
+        entry.originalLength = 0;
+        entry.content = encryptionXml.insert(rootEnd, encryptedData);
+    }
+
+    void EncryptEntryData(EncryptState & state, const EncryptEntry & entry, EncryptJob & job)
+    {
+        std::unique_ptr<IFile> file(state.fileSystemProvider->GetFile(entry.stagedPath, IFileSystemProvider::CreateNew));
+        if (entry.rewritten)
+        {
+            file->Write(reinterpret_cast<const unsigned char *>(entry.content.data()), entry.content.size());
+            return;
+        }
+
+        if (job.publication == nullptr)
+        {
+            job.publication = ZipFile::Open(state.publicationPath);
+        }
+        ZipArchiveEntry::Ptr zipEntry = job.publication->GetEntry(entry.index);
+        std::istream * stream = (zipEntry != nullptr) ? zipEntry->GetDecompressionStream() : nullptr;
+        if (stream == nullptr)
+        {
+            throw std::runtime_error("Can not read the entry: " + entry.name);
+        }
+
+        std::unique_ptr<ISymmetricAlgorithm> algorithm;
+        std::unique_ptr<IEncryptor> encryptor;
+        if (!entry.algorithm.empty())
+        {
+            algorithm.reset(state.encryptionProfile->CreatePublicationAlgorithm(state.contentKey, entry.algorithm));
+            encryptor.reset(algorithm->CreateEncryptor(state.contentKey, file.get()));
+        }
+        std::unique_ptr<Deflater> deflater(entry.compressed ? new Deflater() : nullptr);
+
+        int64_t size = 0;
+        while (true)
+        {
+            stream->read(reinterpret_cast<char *>(job.input.data()), job.input.size());
+            size_t count = static_cast<size_t>(stream->gcount());
+            if (count == 0)
+            {
+                break;
+            }
+            size += count;
+            if (deflater != nullptr)
+            {
+                deflater->Deflate(job.input.data(), count, false, job.output, encryptor.get());
+            }
+            else if (encryptor != nullptr)
+            {
+                encryptor->Update(job.input.data(), count);
+            }
+            else
+            {
+                file->Write(job.input.data(), count);
+            }
+        }
+        bool readError = stream->bad();
+        zipEntry->CloseDecompressionStream();
+        if (readError || size != entry.originalLength)
+        {
+            throw std::runtime_error("Can not read the entry: truncated data " + entry.name);
+        }
+
+        if (deflater != nullptr)
+        {
+            deflater->Deflate(nullptr, 0, true, job.output, encryptor.get());
+        }
+        if (encryptor != nullptr)
+        {
+            encryptor->Finish();
+        }
+    }
+
+    void RunEncryptJob(EncryptState & state, EncryptJob & job, size_t index)
+    {
+        const EncryptEntry & entry = state.entries[index];
+        if (!entry.directory)
+        {
+            EncryptEntryData(state, entry, job);
+        }
+
+        std::unique_lock<std::mutex> locker(state.progressSync);
+        ++state.encryptedEntries;
+        if (state.progress)
+        {
+            state.progress(state.encryptedEntries, state.entries.size());
+        }
+    }
+
+    void WriteEpub(EncryptState & state, const std::string & outputPath)
+    {
+        ZipArchive::Ptr archive = ZipArchive::Create();
+        std::vector<std::unique_ptr<StagedFileBuffer>> buffers;
+        std::vector<std::unique_ptr<std::istream>> streams;
+        for (const EncryptEntry & entry : state.entries)
+        {
+            ZipArchiveEntry::Ptr zipEntry = archive->CreateEntry(entry.name);
+            if (zipEntry == nullptr)
+            {
+                throw std::runtime_error("Can not add the entry: " + entry.name);
+            }
+            zipEntry->SetLastWriteTime(entry.lastWriteTime);
+            if (!entry.directory)
+            {
+                buffers.emplace_back(new StagedFileBuffer(state.fileSystemProvider, entry.stagedPath, state.chunkSize));
+                streams.emplace_back(new std::istream(buffers.back().get()));
+                ICompressionMethod::Ptr method = (entry.deflated && entry.algorithm.empty())
+                    ? static_cast<ICompressionMethod::Ptr>(DeflateMethod::Create())
+                    : static_cast<ICompressionMethod::Ptr>(StoreMethod::Create());
+                zipEntry->SetCompressionStream(*streams.back(), method, ZipArchiveEntry::CompressionMode::Deferred);
+            }
+        }
+
+        ZipFile::SaveAndClose(archive, outputPath);
+
+        for (const std::unique_ptr<std::istream> & stream : streams)
+        {
+            if (stream->bad())
+            {
+                state.fileSystemProvider->RemoveFile(outputPath);
+                throw std::runtime_error("Can not read a staged entry of: " + outputPath);
+            }
+        }
+    }
+
+    void RemoveStagedFiles(IFileSystemProvider * fileSystemProvider, const std::vector<EncryptEntry> & entries)
+    {
+        for (const EncryptEntry & entry : entries)
+        {
+            if (!entry.directory)
+            {
+                fileSystemProvider->RemoveFile(entry.stagedPath);
+            }
+        }
+    }
+}
+
+namespace lcp
+{
+    PublicationEncryptor::PublicationEncryptor(
+        IFileSystemProvider * fileSystemProvider,
+        WorkerPool * workerPool,
+        IEncryptionProfile * encryptionProfile,
+        size_t chunkSize
+        )
+        : m_fileSystemProvider(fileSystemProvider)
+        , m_workerPool(workerPool)
+        , m_encryptionProfile(encryptionProfile)
+        , m_chunkSize(chunkSize)
+    {
+    }
+
+    void PublicationEncryptor::Encrypt(
+        const std::string & publicationPath,
+        const std::string & outputPath,
+        const KeyType & contentKey,
+        const AlgorithmSelector & algorithmSelector,
+        bool compress,
+        const ILcpService::ExportProgressCallback & progress,
+        CancellationToken * cancellation
+        )
+    {
+        EncryptState state;
+        state.publicationPath = publicationPath;
+        state.fileSystemProvider = m_fileSystemProvider;
+        state.encryptionProfile = m_encryptionProfile;
+        state.contentKey = contentKey;
+        state.chunkSize = m_chunkSize;
+        state.progress = progress;
+
+        ListEntries(state, outputPath, algorithmSelector, compress);
+
+        try
+        {
+            size_t chunkSize = m_chunkSize;
+            ParallelJobs::Run(m_workerPool, state.entries.size(), [&state, chunkSize]()
+            {
+                std::shared_ptr<EncryptJob> job = std::make_shared<EncryptJob>();
+                job->input.resize(chunkSize);
+                job->output.resize(chunkSize);
+                return [&state, job](size_t index)
+                {
+                    RunEncryptJob(state, *job, index);
+                };
+            }, cancellation);
+
+            WriteEpub(state, outputPath);
+        }
+        catch (...)
+        {
+            RemoveStagedFiles(state.fileSystemProvider, state.entries);
+            throw;
+        }
+        RemoveStagedFiles(state.fileSystemProvider, state.entries);
+    }
+
+    /*static*/ bool PublicationEncryptor::IsEncryptable(const std::string & name)
+    {
+        static const char opfExtension[] = ".opf";
+        const size_t opfLength = sizeof(opfExtension) - 1;
+        bool packageDocument = name.size() > opfLength
+            && std::equal(name.end() - opfLength, name.end(), opfExtension, [](char left, char right)
+            {
+                return std::tolower(static_cast<unsigned char>(left)) == right;
+            });
+        return name != MimetypePath && name.compare(0, 9, "META-INF/") != 0 && !packageDocument;
+    }
+
+    /*static*/ bool PublicationEncryptor::IsCompressedMedia(const std::string & name)
+    {
+        static const char * extensions[] = {
+            "jpg", "jpeg", "png", "gif", "webp", "mp3", "mp4", "m4a", "m4v", "aac", "ogg", "oga", "webm",
+            "woff", "woff2", "zip", "gz"
+        };
+
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || name.find('/', dot) != std::string::npos)
+        {
+            return false;
+        }
+        std::string extension = name.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+        {
+            return static_cast<char>(std::tolower(c));
+        });
+        return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+    }
+
+    /*static*/ std::string PublicationEncryptor::EscapeUri(const std::string & name)
+    {
+        static const char * hexDigits = "0123456789ABCDEF";
+
+        std::string result;
+        for (char c : name)
+        {
+            unsigned char value = static_cast<unsigned char>(c);
+            if (std::isalnum(value) || c == '-' || c == '.' || c == '_' || c == '~' || c == '/')
+            {
+                result += c;
+            }
+            else
+            {
+                result += '%';
+                result += hexDigits[value >> 4];
+                result += hexDigits[value & 0x0f];
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __PUBLICATION_ENCRYPTOR_H__
+#define __PUBLICATION_ENCRYPTOR_H__
+
+#include <functional>
+#include <string>
+#include "public/ILcpService.h"
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class IEncryptionProfile;
+    class IFileSystemProvider;
+    class WorkerPool;
+
+    //
+    // Writes the protected version of an EPUB: its resources are encrypted
+    // with the content key and the algorithms of the encryption profile,
+    // then listed in META-INF/encryption.xml along with the License
+    // Document link. The mimetype and the META-INF entries stay in
+    // cleartext, as well as the resources the publication already lists in
+    // its encryption.xml (eg. obfuscated fonts), whose EncryptedData
+    // elements are kept. When asked to, resources are compressed with raw
+    // deflate before their encryption, except for the media formats which
+    // are compressed already.
+    //
+    // Entries are encrypted by ParallelJobs, each job reading the
+    // publication through its own archive and streaming every resource
+    // through the compressor and the encryptor with buffers of chunkSize
+    // bytes. They are staged in files next to the output, then assembled
+    // in their original order, the encrypted ones being stored.
+    //
+    class PublicationEncryptor : public NonCopyable
+    {
+    public:
+        static const size_t DefaultChunkSize = 64 * 1024;
+
+        //
+        // Returns the algorithm encrypting the resource with the given
+        // name, or an empty string to leave it in cleartext.
+        //
+        typedef std::function<std::string(const std::string & entryName)> AlgorithmSelector;
+
+    public:
+        PublicationEncryptor(
+            IFileSystemProvider * fileSystemProvider,
+            WorkerPool * workerPool,
+            IEncryptionProfile * encryptionProfile,
+            size_t chunkSize = DefaultChunkSize
+            );
+
+        //
+        // Throws StatusException, or std::exception for I/O and format
+        // errors. The staged entries are removed in any case. A
+        // publication which already holds LCP resources or a License
+        // Document is rejected.
+        //
+        void Encrypt(
+            const std::string & publicationPath,
+            const std::string & outputPath,
+            const KeyType & contentKey,
+            const AlgorithmSelector & algorithmSelector,
+            bool compress,
+            const ILcpService::ExportProgressCallback & progress,
+            CancellationToken * cancellation
+            );
+
+        //
+        // True for the entries an LCP publication may encrypt, ie. all but
+        // the mimetype, the META-INF directory and the .opf package
+        // documents. Encrypt also keeps the rootfiles container.xml lists
+        // in cleartext.
+        //
+        static bool IsEncryptable(const std::string & name);
+
+        //
+        // True for the media formats which gain nothing from a
+        // compression, given the extension of the entry name.
+        //
+        static bool IsCompressedMedia(const std::string & name);
+
+        //
+        // Percent-encodes an entry name for the URI of a CipherReference.
+        //
+        static std::string EscapeUri(const std::string & name);
+
+    private:
+        IFileSystemProvider * m_fileSystemProvider;
+        WorkerPool * m_workerPool;
+        IEncryptionProfile * m_encryptionProfile;
+        size_t m_chunkSize;
+    };
+}
+
+#endif //__PUBLICATION_ENCRYPTOR_H__
@@ -0,0 +1,900 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include "PublicationExporter.h"
+#include "AlgorithmNames.h"
+#include "IncludeMacros.h"
+#include "LcpUtils.h"
+#include "ParallelJobs.h"
+#include "StagedFileBuffer.h"
+#include "SymmetricAlgorithmEncryptedStream.h"
+#include "public/IFileSystemProvider.h"
+#include "utf8-cpp/utf8.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+#include "ziplib/Source/ZipLib/methods/StoreMethod.h"
+#include "ziplib/Source/ZipLib/extlibs/zlib/zlib.h"
+ZIPLIB_INCLUDE_END
+
+namespace
+{
+    using namespace lcp;
+
+    const char * EncryptionPath = "META-INF/encryption.xml";
+    const char * LicensePath = "META-INF/license.lcpl";
+    const uint16_t StoredMethod = 0;
+    const uint16_t DeflatedMethod = 8;
+
+    //
+    // Start or end tag of an XML document. Names are stripped of their
+    // namespace prefix, attribute values are unescaped.
+    //
+    struct XmlTag
+    {
+        std::string name;
+        bool closing;
+        bool selfClosing;
+        size_t begin;
+        size_t end;
+        std::map<std::string, std::string> attributes;
+    };
+
+    std::string LocalName(const std::string & name)
+    {
+        size_t colon = name.find(':');
+        return (colon == std::string::npos) ? name : name.substr(colon + 1);
+    }
+
+    std::string UnescapeXml(const std::string & value)
+    {
+        std::string result;
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            size_t end = (value[i] == '&') ? value.find(';', i) : std::string::npos;
+            if (end == std::string::npos)
+            {
+                result += value[i];
+                continue;
+            }
+
+            std::string entity = value.substr(i + 1, end - i - 1);
+            if (entity == "amp")
+                result += '&';
+            else if (entity == "lt")
+                result += '<';
+            else if (entity == "gt")
+                result += '>';
+            else if (entity == "quot")
+                result += '"';
+            else if (entity == "apos")
+                result += '\'';
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                bool hexadecimal = (entity[1] == 'x' || entity[1] == 'X');
+                uint32_t codePoint = static_cast<uint32_t>(std::strtoul(entity.c_str() + (hexadecimal ? 2 : 1), nullptr, hexadecimal ? 16 : 10));
+                utf8::append(codePoint, std::back_inserter(result));
+            }
+            else
+                result.append(value, i, end - i + 1);
+            i = end;
+        }
+        return result;
+    }
+
+    std::string UnescapeUri(const std::string & uri)
+    {
+        std::string result;
+        for (size_t i = 0; i < uri.size(); ++i)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2]))
+            {
+                result += static_cast<char>(std::strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            }
+            else
+            {
+                result += uri[i];
+            }
+        }
+        return result;
+    }
+
+    //
+    // Reads the tag following the given position, skipping text, comments,
+    // CDATA sections and declarations. Returns false at the end of the
+    // document, or if it is truncated.
+    //
+    bool ReadXmlTag(const std::string & xml, size_t & position, XmlTag & tag)
+    {
+        const char * whitespaces = " \t\r\n";
+        while (true)
+        {
+            size_t begin = xml.find('<', position);
+            if (begin == std::string::npos)
+            {
+                return false;
+            }
+
+            const char * skippedEnd = nullptr;
+            if (xml.compare(begin, 4, "<!--") == 0)
+                skippedEnd = "-->";
+            else if (xml.compare(begin, 9, "<![CDATA[") == 0)
+                skippedEnd = "]]>";
+            else if (begin + 1 < xml.size() && (xml[begin + 1] == '?' || xml[begin + 1] == '!'))
+                skippedEnd = ">";
+            if (skippedEnd != nullptr)
+            {
+                size_t end = xml.find(skippedEnd, begin + 1);
+                if (end == std::string::npos)
+                {
+                    return false;
+                }
+                position = end + std::strlen(skippedEnd);
+                continue;
+            }
+
+            tag = XmlTag();
+            tag.begin = begin;
+            size_t i = begin + 1;
+            tag.closing = (i < xml.size() && xml[i] == '/');
+            if (tag.closing)
+            {
+                ++i;
+            }
+            size_t nameEnd = xml.find_first_of(" \t\r\n/>", i);
+            if (nameEnd == std::string::npos)
+            {
+                return false;
+            }
+            tag.name = LocalName(xml.substr(i, nameEnd - i));
+            tag.selfClosing = false;
+
+            i = nameEnd;
+            while (true)
+            {
+                i = xml.find_first_not_of(whitespaces, i);
+                if (i == std::string::npos)
+                {
+                    return false;
+                }
+                if (xml[i] == '>')
+                {
+                    tag.end = i + 1;
+                    break;
+                }
+                if (xml[i] == '/')
+                {
+                    tag.selfClosing = true;
+                    ++i;
+                    continue;
+                }
+
+                size_t equal = xml.find('=', i);
+                size_t quote = (equal == std::string::npos) ? equal : xml.find_first_of("\"'", equal + 1);
+                size_t valueEnd = (quote == std::string::npos) ? quote : xml.find(xml[quote], quote + 1);
+                if (valueEnd == std::string::npos)
+                {
+                    return false;
+                }
+                std::string attribute = xml.substr(i, equal - i);
+                attribute.erase(attribute.find_last_not_of(whitespaces) + 1);
+                tag.attributes[LocalName(attribute)] = UnescapeXml(xml.substr(quote + 1, valueEnd - quote - 1));
+                i = valueEnd + 1;
+            }
+
+            position = tag.end;
+            return true;
+        }
+    }
+
+    //
+    // Entry of the publication to export, in the order of the archive.
+    // Rewritten entries carry their content, the others are read from the
+    // publication at the given offset.
+    //
+    struct ExportEntry
+    {
+        std::string name;
+        std::string outputPath;
+        bool directory;
+        bool deflated;
+        time_t lastWriteTime;
+        int64_t offset;
+        int64_t size;
+        const PublicationExporter::EncryptedResource * resource;
+        bool rewritten;
+        std::string content;
+
+        //
+        // True if the entry is worth compressing in an EPUB target.
+        //
+        bool Compressible() const
+        {
+            return deflated || rewritten || (resource != nullptr && resource->compressed);
+        }
+    };
+
+    //
+    // State of an export, shared by its jobs.
+    //
+    struct ExportState
+    {
+        std::string publicationPath;
+        IFileSystemProvider * fileSystemProvider;
+        PublicationExporter::DecryptionStreamFactory decryptionStreamFactory;
+        size_t chunkSize;
+        ILcpService::ExportProgressCallback progress;
+
+        std::vector<PublicationExporter::EncryptedResource> resources;
+        std::vector<ExportEntry> entries;
+
+        std::mutex progressSync;
+        size_t exportedEntries;
+
+        ExportState()
+            : exportedEntries(0)
+        {
+        }
+    };
+
+    //
+    // Resources of an export job, kept from an entry to the next.
+    //
+    struct ExportJob
+    {
+        std::unique_ptr<IFile> publication;
+        std::vector<unsigned char> input;
+        std::vector<unsigned char> output;
+    };
+
+    //
+    // Bytes [offset, offset + size) of a shared stream, positioned again
+    // before each read.
+    //
+    class WindowReadableStream : public IReadableStream, public NonCopyable
+    {
+    public:
+        WindowReadableStream(IReadableStream * stream, int64_t offset, int64_t size)
+            : m_stream(stream)
+            , m_offset(offset)
+            , m_size(size)
+            , m_position(0)
+        {
+        }
+
+        virtual void Read(unsigned char * pBuffer, int64_t sizeToRead)
+        {
+            if (m_position + sizeToRead > m_size)
+            {
+                throw std::out_of_range("Can not read past the end of the entry");
+            }
+            m_stream->SetReadPosition(m_offset + m_position);
+            m_stream->Read(pBuffer, sizeToRead);
+            m_position += sizeToRead;
+        }
+
+        virtual void SetReadPosition(int64_t pos)
+        {
+            m_position = pos;
+        }
+
+        virtual int64_t ReadPosition() const
+        {
+            return m_position;
+        }
+
+        virtual int64_t Size()
+        {
+            return m_size;
+        }
+
+    private:
+        IReadableStream * m_stream;
+        int64_t m_offset;
+        int64_t m_size;
+        int64_t m_position;
+    };
+
+    //
+    // Raw deflate decoder writing its output through a caller buffer.
+    //
+    class Inflater : public NonCopyable
+    {
+    public:
+        Inflater()
+            : m_finished(false)
+            , m_inflatedSize(0)
+        {
+            std::memset(&m_stream, 0, sizeof(m_stream));
+            if (inflateInit2(&m_stream, -MAX_WBITS) != Z_OK)
+            {
+                throw std::runtime_error("Can not initialize the inflater");
+            }
+        }
+
+        ~Inflater()
+        {
+            inflateEnd(&m_stream);
+        }
+
+        void Inflate(const unsigned char * data, size_t size, std::vector<unsigned char> & buffer, IWritableStream * output)
+        {
+            m_stream.next_in = const_cast<Bytef *>(data);
+            m_stream.avail_in = static_cast<uInt>(size);
+            while (!m_finished && (m_stream.avail_in > 0 || m_stream.avail_out == 0))
+            {
+                m_stream.next_out = buffer.data();
+                m_stream.avail_out = static_cast<uInt>(buffer.size());
+                int result = inflate(&m_stream, Z_NO_FLUSH);
+                if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+                {
+                    throw std::runtime_error("Can not inflate the entry: corrupted data");
+                }
+
+                size_t inflated = buffer.size() - m_stream.avail_out;
+                if (inflated > 0)
+                {
+                    output->Write(buffer.data(), inflated);
+                    m_inflatedSize += inflated;
+                }
+                else if (result == Z_BUF_ERROR)
+                {
+                    break;
+                }
+                m_finished = (result == Z_STREAM_END);
+            }
+        }
+
+        bool Finished() const
+        {
+            return m_finished;
+        }
+
+        int64_t InflatedSize() const
+        {
+            return m_inflatedSize;
+        }
+
+    private:
+        z_stream m_stream;
+        bool m_finished;
+        int64_t m_inflatedSize;
+    };
+
+    //
+    // Sequential output of an entry, inflating what it is given first
+    // when the entry is deflated.
+    //
+    class EntryWriter : public IWritableStream, public NonCopyable
+    {
+    public:
+        EntryWriter(IWritableStream * file, Inflater * inflater, std::vector<unsigned char> & buffer)
+            : m_file(file)
+            , m_inflater(inflater)
+            , m_buffer(buffer)
+            , m_position(0)
+        {
+        }
+
+        virtual void Write(const unsigned char * pBuffer, int64_t sizeToWrite)
+        {
+            if (m_inflater != nullptr)
+            {
+                m_inflater->Inflate(pBuffer, static_cast<size_t>(sizeToWrite), m_buffer, m_file);
+            }
+            else
+            {
+                m_file->Write(pBuffer, sizeToWrite);
+            }
+            m_position += sizeToWrite;
+        }
+
+        virtual void SetWritePosition(int64_t pos)
+        {
+            throw std::logic_error("The entry is written sequentially");
+        }
+
+        virtual int64_t WritePosition() const
+        {
+            return m_position;
+        }
+
+    private:
+        IWritableStream * m_file;
+        Inflater * m_inflater;
+        std::vector<unsigned char> & m_buffer;
+        int64_t m_position;
+    };
+
+    bool IsLcpAlgorithm(const std::string & algorithm)
+    {
+        return algorithm == AlgorithmNames::AesCbc256Id || algorithm == AlgorithmNames::AesGcm256Id;
+    }
+
+    void ListEntries(ExportState & state, const std::string & outputPath, ILcpService::ExportTarget target)
+    {
+        ZipArchive::Ptr archive = ZipFile::Open(state.publicationPath);
+
+        std::string encryptionXml;
+        ZipArchiveEntry::Ptr encryptionEntry = archive->GetEntry(EncryptionPath);
+        if (encryptionEntry != nullptr)
+        {
+            std::istream * stream = encryptionEntry->GetDecompressionStream();
+            if (stream == nullptr)
+            {
+                throw std::runtime_error("Can not read META-INF/encryption.xml");
+            }
+            encryptionXml.assign(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+            encryptionEntry->CloseDecompressionStream();
+            state.resources = PublicationExporter::ParseEncryption(encryptionXml);
+        }
+
+        // The elements of the decrypted resources are removed from
+        // encryption.xml, which is dropped when nothing else is encrypted
+        std::map<std::string, const PublicationExporter::EncryptedResource *> decryptedResources;
+        std::string remainingXml;
+        bool encryptionRemains = false;
+        size_t copied = 0;
+        for (const PublicationExporter::EncryptedResource & resource : state.resources)
+        {
+            if (IsLcpAlgorithm(resource.algorithm))
+            {
+                decryptedResources[resource.path] = &resource;
+                remainingXml.append(encryptionXml, copied, resource.elementBegin - copied);
+                copied = resource.elementEnd;
+            }
+            else
+            {
+                encryptionRemains = true;
+            }
+        }
+        remainingXml.append(encryptionXml, copied, std::string::npos);
+
+        for (size_t i = 0; i < archive->GetEntriesCount(); ++i)
+        {
+            ZipArchiveEntry::Ptr zipEntry = archive->GetEntry(static_cast<int>(i));
+            ExportEntry entry;
+            entry.name = zipEntry->GetFullName();
+            if (entry.name == LicensePath || (entry.name == EncryptionPath && !encryptionRemains))
+            {
+                continue;
+            }
+            if (target == ILcpService::ExportToDirectory && !PublicationExporter::IsSafeEntryName(entry.name))
+            {
+                throw StatusException(Status(StatusCode::ErrorDecryptionCommonError, "ErrorDecryptionCommonError: unsafe entry name " + entry.name));
+            }
+
+            entry.directory = zipEntry->IsDirectory();
+            entry.deflated = (zipEntry->GetCompressionMethod() == DeflatedMethod);
+            entry.lastWriteTime = zipEntry->GetLastWriteTime();
+            entry.offset = 0;
+            entry.size = 0;
+            entry.resource = nullptr;
+            entry.rewritten = (entry.name == EncryptionPath);
+            if (entry.rewritten)
+            {
+                entry.content = remainingXml;
+            }
+            else if (!entry.directory)
+            {
+                if (!entry.deflated && zipEntry->GetCompressionMethod() != StoredMethod)
+                {
+                    throw std::runtime_error("Unsupported compression method for entry: " + entry.name);
+                }
+
+                auto found = decryptedResources.find(entry.name);
+                if (found != decryptedResources.end())
+                {
+                    // LCP compresses resources before encrypting them
+                    if (entry.deflated)
+                    {
+                        throw std::runtime_error("Encrypted entry is not stored: " + entry.name);
+                    }
+                    entry.resource = found->second;
+                }
+                entry.offset = zipEntry->GetOffsetOfCompressedData();
+                entry.size = zipEntry->GetCompressedSize();
+            }
+
+            entry.outputPath = (target == ILcpService::ExportToDirectory)
+                ? outputPath + "/" + entry.name
+                : outputPath + "." + std::to_string(state.entries.size()) + ".part";
+            state.entries.push_back(entry);
+        }
+    }
+
+    void ExportEntryData(
+        ExportState & state,
+        const ExportEntry & entry,
+        IReadableStream * publication,
+        std::vector<unsigned char> & input,
+        std::vector<unsigned char> & output
+        )
+    {
+        std::unique_ptr<IFile> file(state.fileSystemProvider->GetFile(entry.outputPath, IFileSystemProvider::CreateNew));
+        if (entry.rewritten)
+        {
+            file->Write(reinterpret_cast<const unsigned char *>(entry.content.data()), entry.content.size());
+            return;
+        }
+
+        try
+        {
+            WindowReadableStream window(publication, entry.offset, entry.size);
+            IReadableStream * source = &window;
+            std::unique_ptr<IEncryptedStream> decryptedStream;
+            int64_t size = entry.size;
+            int64_t chunkSize = state.chunkSize;
+            bool inflate = entry.deflated;
+            if (entry.resource != nullptr)
+            {
+                IEncryptedStream * encStream = nullptr;
+                Status status = state.decryptionStreamFactory(&window, entry.resource->algorithm, &encStream);
+                if (!Status::IsSuccess(status))
+                {
+                    throw StatusException(status);
+                }
+                decryptedStream.reset(encStream);
+                inflate = entry.resource->compressed;
+            }
+
+            std::unique_ptr<Inflater> inflater(inflate ? new Inflater() : nullptr);
+            EntryWriter writer(file.get(), inflater.get(), output);
+            std::unique_ptr<IDecryptor> decryptor;
+            if (decryptedStream != nullptr)
+            {
+                // GCM resources are decrypted in one pass over their window,
+                // which checks their tag at the end
+                SymmetricAlgorithmEncryptedStream * algorithmStream = dynamic_cast<SymmetricAlgorithmEncryptedStream *>(decryptedStream.get());
+                if (algorithmStream != nullptr && entry.resource->algorithm == AlgorithmNames::AesGcm256Id)
+                {
+                    decryptor.reset(algorithmStream->CreateDecryptor(&writer));
+                }
+                if (decryptor == nullptr)
+                {
+                    source = decryptedStream.get();
+                    size = decryptedStream->DecryptedSize();
+                    if (entry.resource->algorithm == AlgorithmNames::AesGcm256Id)
+                    {
+                        // Other streams only check the tag when the resource is read at once
+                        chunkSize = std::max<int64_t>(size, 1);
+                    }
+                }
+            }
+
+            for (int64_t position = 0; position < size; position += chunkSize)
+            {
+                size_t count = static_cast<size_t>(std::min(chunkSize, size - position));
+                if (input.size() < count)
+                {
+                    input.resize(count);
+                }
+                source->Read(input.data(), count);
+                if (decryptor != nullptr)
+                {
+                    decryptor->Update(input.data(), count);
+                }
+                else
+                {
+                    writer.Write(input.data(), count);
+                }
+            }
+            if (decryptor != nullptr)
+            {
+                decryptor->Finish();
+            }
+
+            if (inflater != nullptr)
+            {
+                int64_t originalLength = (entry.resource != nullptr) ? entry.resource->originalLength : -1;
+                if (!inflater->Finished() || (originalLength != -1 && inflater->InflatedSize() != originalLength))
+                {
+                    throw std::runtime_error("Can not inflate the entry: truncated data " + entry.name);
+                }
+            }
+        }
+        catch (...)
+        {
+            // The plain text of a resource which fails to decrypt is not kept
+            file.reset();
+            state.fileSystemProvider->RemoveFile(entry.outputPath);
+            throw;
+        }
+
+        if (input.size() > state.chunkSize)
+        {
+            std::vector<unsigned char>(state.chunkSize).swap(input);
+        }
+    }
+
+    void RunExportJob(ExportState & state, ExportJob & job, size_t index)
+    {
+        const ExportEntry & entry = state.entries[index];
+        if (!entry.directory)
+        {
+            if (job.publication == nullptr && !entry.rewritten)
+            {
+                job.publication.reset(state.fileSystemProvider->GetFile(state.publicationPath, IFileSystemProvider::ReadOnly));
+            }
+            ExportEntryData(state, entry, job.publication.get(), job.input, job.output);
+        }
+
+        std::unique_lock<std::mutex> locker(state.progressSync);
+        ++state.exportedEntries;
+        if (state.progress)
+        {
+            state.progress(state.exportedEntries, state.entries.size());
+        }
+    }
+
+    void MakeDirectories(IFileSystemProvider * fileSystemProvider, const std::string & outputPath, const std::vector<ExportEntry> & entries)
+    {
+        // Parents sort before their children
+        std::set<std::string> directories;
+        for (const ExportEntry & entry : entries)
+        {
+            for (size_t separator = entry.name.find('/'); separator != std::string::npos; separator = entry.name.find('/', separator + 1))
+            {
+                directories.insert(entry.name.substr(0, separator));
+            }
+        }
+
+        fileSystemProvider->MakeDirectory(outputPath);
+        for (const std::string & directory : directories)
+        {
+            fileSystemProvider->MakeDirectory(outputPath + "/" + directory);
+        }
+    }
+
+    void WriteEpub(ExportState & state, const std::string & outputPath)
+    {
+        ZipArchive::Ptr archive = ZipArchive::Create();
+        std::vector<std::unique_ptr<StagedFileBuffer>> buffers;
+        std::vector<std::unique_ptr<std::istream>> streams;
+        for (const ExportEntry & entry : state.entries)
+        {
+            ZipArchiveEntry::Ptr zipEntry = archive->CreateEntry(entry.name);
+            if (zipEntry == nullptr)
+            {
+                throw std::runtime_error("Can not add the entry: " + entry.name);
+            }
+            zipEntry->SetLastWriteTime(entry.lastWriteTime);
+            if (!entry.directory)
+            {
+                buffers.emplace_back(new StagedFileBuffer(state.fileSystemProvider, entry.outputPath, state.chunkSize));
+                streams.emplace_back(new std::istream(buffers.back().get()));
+                ICompressionMethod::Ptr method = entry.Compressible()
+                    ? static_cast<ICompressionMethod::Ptr>(DeflateMethod::Create())
+                    : static_cast<ICompressionMethod::Ptr>(StoreMethod::Create());
+                zipEntry->SetCompressionStream(*streams.back(), method, ZipArchiveEntry::CompressionMode::Deferred);
+            }
+        }
+
+        ZipFile::SaveAndClose(archive, outputPath);
+
+        for (const std::unique_ptr<std::istream> & stream : streams)
+        {
+            if (stream->bad())
+            {
+                state.fileSystemProvider->RemoveFile(outputPath);
+                throw std::runtime_error("Can not read a staged entry of: " + outputPath);
+            }
+        }
+    }
+
+    void RemoveStagedFiles(IFileSystemProvider * fileSystemProvider, const std::vector<ExportEntry> & entries)
+    {
+        for (const ExportEntry & entry : entries)
+        {
+            if (!entry.directory)
+            {
+                fileSystemProvider->RemoveFile(entry.outputPath);
+            }
+        }
+    }
+}
+
+namespace lcp
+{
+    PublicationExporter::PublicationExporter(
+        IFileSystemProvider * fileSystemProvider,
+        WorkerPool * workerPool,
+        DecryptionStreamFactory decryptionStreamFactory,
+        size_t chunkSize
+        )
+        : m_fileSystemProvider(fileSystemProvider)
+        , m_workerPool(workerPool)
+        , m_decryptionStreamFactory(decryptionStreamFactory)
+        , m_chunkSize(chunkSize)
+    {
+    }
+
+    void PublicationExporter::Export(
+        const std::string & publicationPath,
+        const std::string & outputPath,
+        ILcpService::ExportTarget target,
+        const ILcpService::ExportProgressCallback & progress,
+        CancellationToken * cancellation
+        )
+    {
+        ExportState state;
+        state.publicationPath = publicationPath;
+        state.fileSystemProvider = m_fileSystemProvider;
+        state.decryptionStreamFactory = m_decryptionStreamFactory;
+        state.chunkSize = m_chunkSize;
+        state.progress = progress;
+
+        ListEntries(state, outputPath, target);
+        if (target == ILcpService::ExportToDirectory)
+        {
+            MakeDirectories(m_fileSystemProvider, outputPath, state.entries);
+        }
+
+        try
+        {
+            size_t chunkSize = m_chunkSize;
+            ParallelJobs::Run(m_workerPool, state.entries.size(), [&state, chunkSize]()
+            {
+                std::shared_ptr<ExportJob> job = std::make_shared<ExportJob>();
+                job->input.resize(chunkSize);
+                job->output.resize(chunkSize);
+                return [&state, job](size_t index)
+                {
+                    RunExportJob(state, *job, index);
+                };
+            }, cancellation);
+
+            if (target == ILcpService::ExportToEpub)
+            {
+                WriteEpub(state, outputPath);
+            }
+        }
+        catch (...)
+        {
+            if (target == ILcpService::ExportToEpub)
+            {
+                RemoveStagedFiles(state.fileSystemProvider, state.entries);
+            }
+            throw;
+        }
+
+        if (target == ILcpService::ExportToEpub)
+        {
+            RemoveStagedFiles(state.fileSystemProvider, state.entries);
+        }
+    }
+
+    /*static*/ std::vector<PublicationExporter::EncryptedResource> PublicationExporter::ParseEncryption(const std::string & encryptionXml)
+    {
+        std::vector<EncryptedResource> resources;
+        EncryptedResource resource;
+        bool inEncryptedData = false;
+        size_t position = 0;
+        XmlTag tag;
+        while (ReadXmlTag(encryptionXml, position, tag))
+        {
+            if (tag.name == "EncryptedData")
+            {
+                if (!tag.closing && !tag.selfClosing)
+                {
+                    resource = EncryptedResource();
+                    resource.compressed = false;
+                    resource.originalLength = -1;
+                    resource.elementBegin = tag.begin;
+                    inEncryptedData = true;
+                }
+                else if (tag.closing && inEncryptedData)
+                {
+                    resource.elementEnd = tag.end;
+                    inEncryptedData = false;
+                    if (!resource.path.empty())
+                    {
+                        resources.push_back(resource);
+                    }
+                }
+            }
+            else if (inEncryptedData && !tag.closing)
+            {
+                // The first method is the one of the data, a KeyInfo may hold others
+                if (tag.name == "EncryptionMethod" && resource.algorithm.empty())
+                {
+                    resource.algorithm = tag.attributes["Algorithm"];
+                }
+                else if (tag.name == "CipherReference")
+                {
+                    resource.path = UnescapeUri(tag.attributes["URI"]);
+                    resource.path.erase(0, resource.path.find_first_not_of('/'));
+                }
+                else if (tag.name == "Compression")
+                {
+                    resource.compressed = (tag.attributes["Method"] == "8");
+                    auto originalLength = tag.attributes.find("OriginalLength");
+                    if (originalLength != tag.attributes.end())
+                    {
+                        resource.originalLength = std::strtoll(originalLength->second.c_str(), nullptr, 10);
+                    }
+                }
+            }
+        }
+        return resources;
+    }
+
+    /*static*/ std::vector<std::string> PublicationExporter::ParseRootFiles(const std::string & containerXml)
+    {
+        std::vector<std::string> rootFiles;
+        size_t position = 0;
+        XmlTag tag;
+        while (ReadXmlTag(containerXml, position, tag))
+        {
+            if (tag.name == "rootfile" && !tag.closing)
+            {
+                std::string path = tag.attributes["full-path"];
+                path.erase(0, path.find_first_not_of('/'));
+                if (!path.empty())
+                {
+                    rootFiles.push_back(path);
+                }
+            }
+        }
+        return rootFiles;
+    }
+
+    /*static*/ bool PublicationExporter::IsSafeEntryName(const std::string & name)
+    {
+        if (name.empty() || name[0] == '/' || name[0] == '\\' || name.find(':') != std::string::npos)
+        {
+            return false;
+        }
+
+        size_t begin = 0;
+        while (begin <= name.size())
+        {
+            size_t end = name.find_first_of("/\\", begin);
+            if (end == std::string::npos)
+            {
+                end = name.size();
+            }
+            if (name.compare(begin, end - begin, "..") == 0)
+            {
+                return false;
+            }
+            begin = end + 1;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __PUBLICATION_EXPORTER_H__
+#define __PUBLICATION_EXPORTER_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "public/ILcpService.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class IFileSystemProvider;
+    class WorkerPool;
+
+    //
+    // Writes the cleartext of a whole protected publication, in a directory
+    // or in a new EPUB. The entries listed in META-INF/encryption.xml with
+    // an LCP algorithm are decrypted, then inflated when they were
+    // compressed before the encryption. Other encrypted entries, such as
+    // obfuscated fonts, are copied as they are and keep their
+    // EncryptedData element. The License Document is not exported.
+    //
+    // Entries are exported by jobs posted in the prefetch lane of the worker
+    // pool, the calling thread running one of them so that the export goes
+    // on when the pool is busy. Each job reads the publication through its
+    // own IFile, with buffers of chunkSize bytes. AES-GCM resources are
+    // streamed through the decryptor of their algorithm, which checks their
+    // tag once their last chunk is read; only the streams without one are
+    // read at once. Entries of an EPUB target are staged in files next to
+    // it, then assembled in their original order once all of them are
+    // exported.
+    //
+    class PublicationExporter : public NonCopyable
+    {
+    public:
+        static const size_t DefaultChunkSize = 64 * 1024;
+
+        //
+        // Creates the stream decrypting a resource of the publication
+        // encrypted with the given algorithm, usually bound to
+        // ILcpService::CreateEncryptedDataStream() and a decrypted License.
+        //
+        typedef std::function<Status(IReadableStream * stream, const std::string & algorithm, IEncryptedStream ** encStream)> DecryptionStreamFactory;
+
+        //
+        // Resource listed in META-INF/encryption.xml. The offsets delimit
+        // its EncryptedData element in the document, originalLength is -1
+        // when not given.
+        //
+        struct EncryptedResource
+        {
+            std::string path;
+            std::string algorithm;
+            bool compressed;
+            int64_t originalLength;
+            size_t elementBegin;
+            size_t elementEnd;
+        };
+
+    public:
+        PublicationExporter(
+            IFileSystemProvider * fileSystemProvider,
+            WorkerPool * workerPool,
+            DecryptionStreamFactory decryptionStreamFactory,
+            size_t chunkSize = DefaultChunkSize
+            );
+
+        //
+        // Throws StatusException, or std::exception for I/O and format
+        // errors. Entries already written in a directory target are left
+        // in place, the failing one and the staged entries of an EPUB
+        // target are removed through IFileSystemProvider::RemoveFile().
+        //
+        void Export(
+            const std::string & publicationPath,
+            const std::string & outputPath,
+            ILcpService::ExportTarget target,
+            const ILcpService::ExportProgressCallback & progress,
+            CancellationToken * cancellation
+            );
+
+        static std::vector<EncryptedResource> ParseEncryption(const std::string & encryptionXml);
+
+        //
+        // Paths of the package documents the META-INF/container.xml of a
+        // publication lists as its rootfiles.
+        //
+        static std::vector<std::string> ParseRootFiles(const std::string & containerXml);
+
+        //
+        // True if the entry name is relative and does not climb out of the
+        // directory it is extracted in.
+        //
+        static bool IsSafeEntryName(const std::string & name);
+
+    private:
+        IFileSystemProvider * m_fileSystemProvider;
+        WorkerPool * m_workerPool;
+        DecryptionStreamFactory m_decryptionStreamFactory;
+        size_t m_chunkSize;
+    };
+}
+
+#endif //__PUBLICATION_EXPORTER_H__
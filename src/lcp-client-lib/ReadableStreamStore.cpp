@@ -0,0 +1,150 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include "ReadableStreamStore.h"
+#include "public/StreamInterfaces.h"
+
+using namespace CryptoPP;
+
+namespace lcp
+{
+    ReadableStreamStore::ReadableStreamStore(IReadableStream * stream, size_t windowSize)
+        : m_stream(stream)
+        , m_begin(static_cast<lword>(stream->ReadPosition()))
+        , m_size(static_cast<lword>(std::max<int64_t>(stream->Size() - stream->ReadPosition(), 0)))
+        , m_position(0)
+        , m_window(windowSize)
+        , m_windowStart(0)
+        , m_windowLength(0)
+    {
+    }
+
+    lword ReadableStreamStore::MaxRetrievable() const
+    {
+        return m_size - m_position;
+    }
+
+    bool ReadableStreamStore::AnyRetrievable() const
+    {
+        return m_position < m_size;
+    }
+
+    size_t ReadableStreamStore::TransferTo2(
+        BufferedTransformation & target,
+        lword & transferBytes,
+        const std::string & channel,
+        bool blocking
+        )
+    {
+        size_t blockedBytes = this->PutRange(target, m_position, transferBytes, channel, blocking);
+        m_position += transferBytes;
+        return blockedBytes;
+    }
+
+    size_t ReadableStreamStore::CopyRangeTo2(
+        BufferedTransformation & target,
+        lword & begin,
+        lword end,
+        const std::string & channel,
+        bool blocking
+        ) const
+    {
+        lword remaining = this->MaxRetrievable();
+        if (begin >= end || begin >= remaining)
+        {
+            return 0;
+        }
+
+        lword count = std::min(end, remaining) - begin;
+        size_t blockedBytes = this->PutRange(target, m_position + begin, count, channel, blocking);
+        begin += count;
+        return blockedBytes;
+    }
+
+    void ReadableStreamStore::StoreInitialize(const NameValuePairs & parameters)
+    {
+    }
+
+    //
+    // Hands over at most count bytes starting at position, one window at a
+    // time. On return count holds the number of bytes the target accepted.
+    //
+    size_t ReadableStreamStore::PutRange(
+        BufferedTransformation & target,
+        lword position,
+        lword & count,
+        const std::string & channel,
+        bool blocking
+        ) const
+    {
+        lword done = 0;
+        while (done < count)
+        {
+            size_t available = 0;
+            const unsigned char * data = this->Window(position + done, available);
+            if (available == 0)
+            {
+                break;
+            }
+
+            size_t length = static_cast<size_t>(std::min<lword>(available, count - done));
+            size_t blockedBytes = target.ChannelPut2(channel, data, length, 0, blocking);
+            if (blockedBytes != 0)
+            {
+                count = done + length - blockedBytes;
+                return blockedBytes;
+            }
+            done += length;
+        }
+        count = done;
+        return 0;
+    }
+
+    const unsigned char * ReadableStreamStore::Window(lword position, size_t & available) const
+    {
+        if (position >= m_size || m_window.empty())
+        {
+            available = 0;
+            return nullptr;
+        }
+
+        if (position < m_windowStart || position >= m_windowStart + m_windowLength)
+        {
+            size_t length = static_cast<size_t>(std::min<lword>(m_window.size(), m_size - position));
+            m_windowLength = 0;
+            m_stream->SetReadPosition(static_cast<int64_t>(m_begin + position));
+            m_stream->Read(m_window.data(), static_cast<int64_t>(length));
+            m_windowStart = position;
+            m_windowLength = length;
+        }
+
+        size_t offset = static_cast<size_t>(position - m_windowStart);
+        available = m_windowLength - offset;
+        return m_window.data() + offset;
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __READABLE_STREAM_STORE_H__
+#define __READABLE_STREAM_STORE_H__
+
+#include <vector>
+#include "IncludeMacros.h"
+#include "NonCopyable.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/filters.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcp
+{
+    class IReadableStream;
+
+    //
+    // Crypto++ store reading an IReadableStream through a fixed-size window,
+    // so that BER decoders can walk a large stream without loading it whole.
+    // The store starts at the current read position of the stream, which
+    // must not be read by anyone else while the store is in use.
+    //
+    class ReadableStreamStore : public CryptoPP::Store, public NonCopyable
+    {
+    public:
+        static const size_t DefaultWindowSize = 64 * 1024;
+
+        explicit ReadableStreamStore(IReadableStream * stream, size_t windowSize = DefaultWindowSize);
+
+        // CryptoPP::Store
+        virtual CryptoPP::lword MaxRetrievable() const;
+        virtual bool AnyRetrievable() const;
+        virtual size_t TransferTo2(
+            CryptoPP::BufferedTransformation & target,
+            CryptoPP::lword & transferBytes,
+            const std::string & channel = CryptoPP::DEFAULT_CHANNEL,
+            bool blocking = true
+            );
+        virtual size_t CopyRangeTo2(
+            CryptoPP::BufferedTransformation & target,
+            CryptoPP::lword & begin,
+            CryptoPP::lword end = CryptoPP::LWORD_MAX,
+            const std::string & channel = CryptoPP::DEFAULT_CHANNEL,
+            bool blocking = true
+            ) const;
+
+    private:
+        virtual void StoreInitialize(const CryptoPP::NameValuePairs & parameters);
+
+        size_t PutRange(
+            CryptoPP::BufferedTransformation & target,
+            CryptoPP::lword position,
+            CryptoPP::lword & count,
+            const std::string & channel,
+            bool blocking
+            ) const;
+        const unsigned char * Window(CryptoPP::lword position, size_t & available) const;
+
+    private:
+        IReadableStream * m_stream;
+        CryptoPP::lword m_begin;
+        CryptoPP::lword m_size;
+        CryptoPP::lword m_position;
+
+        mutable std::vector<unsigned char> m_window;
+        mutable CryptoPP::lword m_windowStart;
+        mutable size_t m_windowLength;
+    };
+}
+
+#endif //__READABLE_STREAM_STORE_H__
@@ -0,0 +1,282 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdexcept>
+#include "RightsJournal.h"
+#include "BatchStorageAdapter.h"
+#include "public/IFileSystemProvider.h"
+#include "public/IStorageProvider.h"
+
+namespace lcp
+{
+    /*static*/ const int64_t RightsJournal::MaxJournalSize = 64 * 1024;
+
+    RightsJournal::RightsJournal(
+        IStorageProvider * storageProvider,
+        IFileSystemProvider * fileSystemProvider,
+        const std::string & journalPath,
+        const DurationType & flushPeriod,
+        Scheduler * scheduler
+        )
+        : m_storageProvider(storageProvider)
+        , m_fileSystemProvider(fileSystemProvider)
+        , m_journalPath(journalPath)
+        , m_flushPeriod(flushPeriod)
+        , m_scheduler(scheduler)
+        , m_flushTask(0)
+    {
+        if (m_storageProvider == nullptr)
+        {
+            throw std::invalid_argument("StorageProvider is nullptr");
+        }
+        if (m_fileSystemProvider == nullptr)
+        {
+            throw std::invalid_argument("FileSystemProvider is nullptr");
+        }
+    }
+
+    RightsJournal::~RightsJournal()
+    {
+        if (m_flushTask != 0)
+        {
+            m_scheduler->Unregister(m_flushTask);
+        }
+
+        try
+        {
+            this->Flush();
+        }
+        catch (const std::exception &)
+        {
+            // Values stay in the journal and will be replayed on next Open()
+        }
+    }
+
+    void RightsJournal::Open()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        this->Replay();
+        this->RewriteJournal();
+
+        if (m_flushTask == 0 && m_scheduler != nullptr && m_flushPeriod > DurationType::zero())
+        {
+            m_flushTask = m_scheduler->Register(std::bind(&RightsJournal::FlushTask, this));
+            m_scheduler->ScheduleAfter(m_flushTask, m_flushPeriod);
+        }
+    }
+
+    void RightsJournal::Flush()
+    {
+        std::unique_lock<std::mutex> flushLocker(m_flushSync);
+
+        StringsMap batch;
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            if (m_pendingValues.empty())
+            {
+                return;
+            }
+            batch = m_pendingValues;
+        }
+
+        // Storage writes can be slow, values are recorded meanwhile
+        BatchStorageAdapter(m_storageProvider).SetValues(LicenseRightsVaultId, batch);
+
+        std::unique_lock<std::mutex> locker(m_sync);
+        for (auto it = batch.begin(); it != batch.end(); ++it)
+        {
+            auto pendingIt = m_pendingValues.find(it->first);
+            if (pendingIt != m_pendingValues.end() && pendingIt->second == it->second)
+            {
+                m_pendingValues.erase(pendingIt);
+            }
+        }
+        if (m_journalFile)
+        {
+            this->RewriteJournal();
+        }
+    }
+
+    void RightsJournal::SetValue(const std::string & key, const std::string & value)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_pendingValues[key] = value;
+        this->AppendRecord(key, value);
+    }
+
+    bool RightsJournal::GetValue(const std::string & key, std::string & value) const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto it = m_pendingValues.find(key);
+        if (it == m_pendingValues.end())
+        {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    StringsMap RightsJournal::ValuesWithPrefix(const std::string & keyPrefix) const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        StringsMap result;
+        for (auto it = m_pendingValues.lower_bound(keyPrefix); it != m_pendingValues.end(); ++it)
+        {
+            if (it->first.compare(0, keyPrefix.size(), keyPrefix) != 0)
+            {
+                break;
+            }
+            result.insert(*it);
+        }
+        return result;
+    }
+
+    void RightsJournal::Replay()
+    {
+        std::unique_ptr<IFile> journalFile;
+        try
+        {
+            journalFile.reset(m_fileSystemProvider->GetFile(m_journalPath, IFileSystemProvider::ReadOnly));
+        }
+        catch (const std::exception &)
+        {
+            // No journal left by a previous session
+            return;
+        }
+
+        int64_t size = journalFile->Size();
+        if (size <= 0)
+        {
+            return;
+        }
+
+        Buffer buffer(static_cast<size_t>(size));
+        journalFile->SetReadPosition(0);
+        journalFile->Read(buffer.data(), size);
+
+        // Records are applied in order, a truncated last record is dropped
+        size_t pos = 0;
+        std::string key;
+        std::string value;
+        while (ReadRecordField(buffer, pos, key) && ReadRecordField(buffer, pos, value))
+        {
+            m_pendingValues[key] = value;
+        }
+    }
+
+    void RightsJournal::RewriteJournal()
+    {
+        Buffer records;
+        for (auto it = m_pendingValues.begin(); it != m_pendingValues.end(); ++it)
+        {
+            WriteLength(records, it->first.size());
+            records.insert(records.end(), it->first.begin(), it->first.end());
+            WriteLength(records, it->second.size());
+            records.insert(records.end(), it->second.begin(), it->second.end());
+        }
+
+        // The current journal stays in force until the new one replaces it
+        std::string tempPath = m_journalPath + ".tmp";
+        {
+            std::unique_ptr<IFile> tempFile(m_fileSystemProvider->GetFile(tempPath, IFileSystemProvider::CreateNew));
+            if (!records.empty())
+            {
+                tempFile->Write(records.data(), records.size());
+            }
+            tempFile->Flush();
+        }
+        m_journalFile.reset();
+        m_fileSystemProvider->RenameFile(tempPath, m_journalPath);
+
+        m_journalFile.reset(m_fileSystemProvider->GetFile(m_journalPath, IFileSystemProvider::ReadWrite));
+        m_journalFile->SetWritePosition(static_cast<int64_t>(records.size()));
+    }
+
+    void RightsJournal::AppendRecord(const std::string & key, const std::string & value)
+    {
+        if (!m_journalFile)
+        {
+            return;
+        }
+        if (m_journalFile->WritePosition() > MaxJournalSize)
+        {
+            // Pending values are coalesced, so the rewritten journal is compact
+            this->RewriteJournal();
+            return;
+        }
+
+        Buffer record;
+        record.reserve(key.size() + value.size() + 8);
+        WriteLength(record, key.size());
+        record.insert(record.end(), key.begin(), key.end());
+        WriteLength(record, value.size());
+        record.insert(record.end(), value.begin(), value.end());
+        m_journalFile->Write(record.data(), record.size());
+        m_journalFile->Flush();
+    }
+
+    void RightsJournal::FlushTask()
+    {
+        try
+        {
+            this->Flush();
+        }
+        catch (const std::exception &)
+        {
+            // Values are kept pending, next period will retry
+        }
+        m_scheduler->ScheduleAfter(m_flushTask, m_flushPeriod);
+    }
+
+    /*static*/ void RightsJournal::WriteLength(Buffer & buffer, size_t length)
+    {
+        buffer.push_back(static_cast<unsigned char>((length >> 24) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>((length >> 16) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>((length >> 8) & 0xFF));
+        buffer.push_back(static_cast<unsigned char>(length & 0xFF));
+    }
+
+    /*static*/ bool RightsJournal::ReadRecordField(const Buffer & buffer, size_t & pos, std::string & field)
+    {
+        if (buffer.size() - pos < 4)
+        {
+            return false;
+        }
+        size_t length = (static_cast<size_t>(buffer[pos]) << 24) |
+            (static_cast<size_t>(buffer[pos + 1]) << 16) |
+            (static_cast<size_t>(buffer[pos + 2]) << 8) |
+            static_cast<size_t>(buffer[pos + 3]);
+        pos += 4;
+
+        if (buffer.size() - pos < length)
+        {
+            return false;
+        }
+        field.assign(reinterpret_cast<const char *>(buffer.data() + pos), length);
+        pos += length;
+        return true;
+    }
+}
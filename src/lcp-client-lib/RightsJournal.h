@@ -0,0 +1,103 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __RIGHTS_JOURNAL_H__
+#define __RIGHTS_JOURNAL_H__
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+#include "Scheduler.h"
+
+namespace lcp
+{
+    class IStorageProvider;
+    class IFileSystemProvider;
+    class IFile;
+
+    //
+    // Write-back cache for the rights vault of the IStorageProvider.
+    // Values are kept in memory, coalesced by storage key, and written to the
+    // storage provider in batches by Flush(), which is also run periodically
+    // and on destruction. Every value is appended to a journal file first,
+    // and flushed to the file system, so values not yet written to the
+    // storage provider when the process dies are replayed by Open(). The
+    // journal is compacted through a temporary file, which is synced to the
+    // disk by IFileSystemProvider::RenameFile before it replaces the journal.
+    //
+    class RightsJournal : public NonCopyable
+    {
+    public:
+        typedef std::chrono::milliseconds DurationType;
+
+    public:
+        RightsJournal(
+            IStorageProvider * storageProvider,
+            IFileSystemProvider * fileSystemProvider,
+            const std::string & journalPath,
+            const DurationType & flushPeriod,
+            Scheduler * scheduler
+            );
+        ~RightsJournal();
+
+        void Open();
+        void Flush();
+
+        void SetValue(const std::string & key, const std::string & value);
+        bool GetValue(const std::string & key, std::string & value) const;
+        StringsMap ValuesWithPrefix(const std::string & keyPrefix) const;
+
+    public:
+        static const int64_t MaxJournalSize;
+
+    private:
+        void Replay();
+        void RewriteJournal();
+        void AppendRecord(const std::string & key, const std::string & value);
+        void FlushTask();
+
+        static void WriteLength(Buffer & buffer, size_t length);
+        static bool ReadRecordField(const Buffer & buffer, size_t & pos, std::string & field);
+
+    private:
+        IStorageProvider * m_storageProvider;
+        IFileSystemProvider * m_fileSystemProvider;
+        std::string m_journalPath;
+        DurationType m_flushPeriod;
+
+        StringsMap m_pendingValues;
+        std::unique_ptr<IFile> m_journalFile;
+        mutable std::mutex m_sync;
+        std::mutex m_flushSync;
+
+        Scheduler * m_scheduler;
+        Scheduler::TaskId m_flushTask;
+    };
+}
+
+#endif //__RIGHTS_JOURNAL_H__
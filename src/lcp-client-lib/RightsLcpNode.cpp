@@ -99,6 +99,7 @@ namespace lcp
     KvStringsIterator * RightsLcpNode::Enumerate() const
     {
         std::unique_lock<std::mutex> locker(m_rightsSync);
+        this->RefreshCountersInMap();
         return new MapIterator<std::string>(m_rights.valuesMap);
     }
 
@@ -111,6 +112,7 @@ namespace lcp
     bool RightsLcpNode::GetRightValue(const std::string & name, std::string & value) const
     {
         std::unique_lock<std::mutex> locker(m_rightsSync);
+        this->RefreshCountersInMap();
 
         auto it = m_rights.valuesMap.find(name);
         if (it != m_rights.valuesMap.end())
@@ -124,14 +126,12 @@ namespace lcp
     void RightsLcpNode::SetRightValue(const std::string & name, const std::string & value)
     {
         std::unique_lock<std::mutex> locker(m_rightsSync);
+        this->RefreshCountersInMap();
 
-        if (name == PrintRight)
+        std::atomic<int> * counter = this->RegisteredCounter(name);
+        if (counter != nullptr)
         {
-            m_rights.print = StringToInt(value);
-        }
-        else if (name == CopyRight)
-        {
-            m_rights.copy = StringToInt(value);
+            counter->store(StringToInt(value));
         }
 
         this->SetRightValueInMap(name, value);
@@ -144,49 +144,47 @@ namespace lcp
 
     bool RightsLcpNode::UseRight(const std::string & name, int amount)
     {
-        std::unique_lock<std::mutex> locker(m_rightsSync);
+        std::atomic<int> * counter = this->RegisteredCounter(name);
+        if (counter == nullptr)
+        {
+            return false;
+        }
+        return ConsumeCounter(*counter, amount);
+    }
 
-        bool result = false;
-        if (name == PrintRight)
+    bool RightsLcpNode::ConsumeCounter(std::atomic<int> & counter, int amount)
+    {
+        int current = counter.load();
+        while (true)
         {
-            if (m_rights.print >= amount)
+            if (current == IRightsService::UNLIMITED)
             {
-                m_rights.print -= amount;
-                this->SetRightValueInMap(name, ToString(m_rights.print));
-                result = true;
-            }
-            else if (m_rights.print == IRightsService::UNLIMITED)
-            {
-                result = true;
+                return true;
             }
-        }
-        else if (name == CopyRight)
-        {
-            if (m_rights.copy >= amount)
+            if (current < amount)
             {
-                m_rights.copy -= amount;
-                this->SetRightValueInMap(name, ToString(m_rights.copy));
-                result = true;
+                return false;
             }
-            else if (m_rights.copy == IRightsService::UNLIMITED)
+            // A failed exchange reloads the value consumed by another thread
+            if (counter.compare_exchange_weak(current, current - amount))
             {
-                result = true;
+                m_rights.changedCounters.fetch_or(this->CounterMask(counter));
+                return true;
             }
         }
-        return result;
     }
 
     bool RightsLcpNode::CanUseRight(const std::string & name) const
     {
-        std::unique_lock<std::mutex> locker(m_rightsSync);
-
         if (name == PrintRight)
         {
-            return m_rights.print == IRightsService::UNLIMITED || m_rights.print > 0;
+            int print = m_rights.print.load();
+            return print == IRightsService::UNLIMITED || print > 0;
         }
         else if (name == CopyRight)
         {
-            return m_rights.copy == IRightsService::UNLIMITED || m_rights.copy > 0;
+            int copy = m_rights.copy.load();
+            return copy == IRightsService::UNLIMITED || copy > 0;
         }
         else if (name == StartRight)
         {
@@ -206,12 +204,45 @@ namespace lcp
     {
         if (m_rights.valuesMap.find(PrintRight) == m_rights.valuesMap.end())
         {
-            this->SetRightValueInMap(PrintRight, ToString(m_rights.print));
+            this->SetRightValueInMap(PrintRight, ToString(m_rights.print.load()));
         }
         if (m_rights.valuesMap.find(CopyRight) == m_rights.valuesMap.end())
         {
-            this->SetRightValueInMap(CopyRight, ToString(m_rights.copy));
+            this->SetRightValueInMap(CopyRight, ToString(m_rights.copy.load()));
+        }
+    }
+
+    void RightsLcpNode::RefreshCountersInMap() const
+    {
+        // Cleared before formatting: a counter consumed meanwhile marks the
+        // view as changed again
+        unsigned int changedCounters = m_rights.changedCounters.exchange(0);
+        if ((changedCounters & this->CounterMask(m_rights.print)) != 0)
+        {
+            m_rights.valuesMap[PrintRight] = ToString(m_rights.print.load());
+        }
+        if ((changedCounters & this->CounterMask(m_rights.copy)) != 0)
+        {
+            m_rights.valuesMap[CopyRight] = ToString(m_rights.copy.load());
+        }
+    }
+
+    unsigned int RightsLcpNode::CounterMask(const std::atomic<int> & counter) const
+    {
+        return (&counter == &m_rights.print) ? 1 : 2;
+    }
+
+    std::atomic<int> * RightsLcpNode::RegisteredCounter(const std::string & name)
+    {
+        if (name == PrintRight)
+        {
+            return &m_rights.print;
+        }
+        else if (name == CopyRight)
+        {
+            return &m_rights.copy;
         }
+        return nullptr;
     }
 
     void RightsLcpNode::SetRightValueInMap(const std::string & name, const std::string & value)
@@ -259,11 +290,11 @@ namespace lcp
     {
         if (name == PrintRight)
         {
-            m_rights.print = value.GetInt();
+            m_rights.print.store(value.GetInt());
         }
         else if (name == CopyRight)
         {
-            m_rights.copy = value.GetInt();
+            m_rights.copy.store(value.GetInt());
         }
         else if (name == StartRight)
         {
@@ -28,6 +28,7 @@
 #ifndef __RIGHTS_LCP_NODE_H__
 #define __RIGHTS_LCP_NODE_H__
 
+#include <atomic>
 #include <mutex>
 #include "LcpTypedefs.h"
 #include "BaseLcpNode.h"
@@ -37,19 +38,28 @@
 
 namespace lcp
 {
+    //
+    // The print and copy counters are consumed without locking. The values
+    // map is a view of every right as a string, guarded by the node mutex,
+    // and the counters are only formatted into it when it is read.
+    // The start and end dates are only set while parsing.
+    //
     struct RightsInfo
     {
         RightsInfo()
             : print(IRightsService::UNLIMITED)
             , copy(IRightsService::UNLIMITED)
+            , changedCounters(0)
         {
         }
 
-        int print;
-        int copy;
+        std::atomic<int> print;
+        std::atomic<int> copy;
         std::string start;
         std::string end;
-        StringsMap valuesMap;
+        mutable StringsMap valuesMap;
+        // Mask of the counters consumed since the map was refreshed
+        mutable std::atomic<unsigned int> changedCounters;
     };
 
     class RightsLcpNode : public BaseLcpNode, public IRights, public IRightsManager
@@ -76,6 +86,10 @@ namespace lcp
     private:
         void SetRightValueInMap(const std::string & name, const std::string & value);
         void SetDefaultRightValuesInMap();
+        void RefreshCountersInMap() const;
+        std::atomic<int> * RegisteredCounter(const std::string & name);
+        unsigned int CounterMask(const std::atomic<int> & counter) const;
+        bool ConsumeCounter(std::atomic<int> & counter, int amount);
         bool DoesLicenseStart() const;
         bool DoesLicenseExpired() const;
         void FillRegisteredFields(const std::string & name, const rapidjson::Value & value);
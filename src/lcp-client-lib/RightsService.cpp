@@ -33,31 +33,125 @@
 #include "public/IUser.h"
 #include "public/IStorageProvider.h"
 #include "IRightsManager.h"
+#include "BatchStorageAdapter.h"
+#include "RightsJournal.h"
 
 namespace lcp
 {
     /* static */ int IRightsService::UNLIMITED = -1;
     
-    RightsService::RightsService(IStorageProvider * storageProvider, const std::string & unknownUserId)
+    RightsService::RightsService(
+        IStorageProvider * storageProvider,
+        IFileSystemProvider * fileSystemProvider,
+        const std::string & unknownUserId,
+        Scheduler * scheduler
+        )
         : m_storageProvider(storageProvider)
+        , m_fileSystemProvider(fileSystemProvider)
         , m_unknownUserId(unknownUserId)
+        , m_scheduler(scheduler)
+        , m_rightsIndexBuilt(false)
     {
     }
 
+    RightsService::~RightsService()
+    {
+        // Destroying the journal flushes the pending values
+        m_journal.reset();
+    }
+
+    void RightsService::EnableWriteBackJournal(const std::string & journalPath, int flushPeriodMs)
+    {
+        if (m_storageProvider == nullptr)
+        {
+            throw std::runtime_error("StorageProvider is nullptr");
+        }
+
+        std::unique_ptr<RightsJournal> journal(new RightsJournal(
+            m_storageProvider, m_fileSystemProvider, journalPath, RightsJournal::DurationType(flushPeriodMs),
+            (m_scheduler != nullptr) ? m_scheduler : Scheduler::Shared()
+            ));
+        journal->Open();
+        m_journal = std::move(journal);
+
+        // Replayed values may have been indexed from an outdated vault
+        std::unique_lock<std::mutex> locker(m_rightsIndexSync);
+        m_rightsIndex.clear();
+        m_rightsIndexBuilt = false;
+    }
+
+    void RightsService::Flush()
+    {
+        if (m_journal)
+        {
+            m_journal->Flush();
+        }
+    }
+
     void RightsService::SyncRightsFromStorage(ILicense * license)
     {
         IRightsManager * rightsManager = this->PerformChecks(license);
         std::string keyPrefix = this->BuildStorageProviderRightsKeyPrefix(license);
 
-        std::unique_ptr<KvStringsIterator> rightsIt(m_storageProvider->EnumerateVault(LicenseRightsVaultId));
-        for (rightsIt->First(); !rightsIt->IsDone(); rightsIt->Next())
+        StringsMap storedValues;
+        if (BatchStorageAdapter(m_storageProvider).ValuesWithPrefix(LicenseRightsVaultId, keyPrefix + "@", storedValues))
+        {
+            for (auto it = storedValues.begin(); it != storedValues.end(); ++it)
+            {
+                rightsManager->SetRightValue(this->ExtractRightsKey(it->first), it->second);
+            }
+        }
+        else
+        {
+            std::unique_lock<std::mutex> locker(m_rightsIndexSync);
+            if (!m_rightsIndexBuilt)
+            {
+                this->BuildRightsIndex();
+            }
+
+            auto licenseIt = m_rightsIndex.find(keyPrefix);
+            if (licenseIt != m_rightsIndex.end())
+            {
+                for (auto it = licenseIt->second.begin(); it != licenseIt->second.end(); ++it)
+                {
+                    rightsManager->SetRightValue(it->first, it->second);
+                }
+            }
+        }
+
+        // Values not flushed yet take precedence over the stored ones
+        if (m_journal)
+        {
+            StringsMap pendingValues = m_journal->ValuesWithPrefix(keyPrefix + "@");
+            for (auto it = pendingValues.begin(); it != pendingValues.end(); ++it)
+            {
+                rightsManager->SetRightValue(this->ExtractRightsKey(it->first), it->second);
+            }
+        }
+    }
+
+    void RightsService::BuildRightsIndex()
+    {
+        StringsMap storedValues = BatchStorageAdapter(m_storageProvider).VaultValues(LicenseRightsVaultId);
+        for (auto it = storedValues.begin(); it != storedValues.end(); ++it)
         {
-            std::string storageKey = rightsIt->CurrentKey();
-            if (storageKey.find(keyPrefix) != std::string::npos)
+            const std::string & storageKey = it->first;
+            size_t pos = storageKey.find_last_of("@");
+            if (pos == std::string::npos || pos + 1 == storageKey.size())
             {
-                std::string rightId = this->ExtractRightsKey(storageKey);
-                rightsManager->SetRightValue(rightId, rightsIt->Current());
+                continue;
             }
+            m_rightsIndex[storageKey.substr(0, pos)][storageKey.substr(pos + 1)] = it->second;
+        }
+        m_rightsIndexBuilt = true;
+    }
+
+    void RightsService::UpdateRightsIndex(ILicense * license, const std::string & rightId, const std::string & value)
+    {
+        std::unique_lock<std::mutex> locker(m_rightsIndexSync);
+        if (m_rightsIndexBuilt)
+        {
+            m_rightsIndex[this->BuildStorageProviderRightsKeyPrefix(license)][rightId] = value;
         }
     }
 
@@ -80,11 +174,7 @@ namespace lcp
             std::string currentValue;
             license->Rights()->GetRightValue(rightId, currentValue);
 
-            m_storageProvider->SetValue(
-                LicenseRightsVaultId,
-                this->BuildStorageProviderRightsKey(license, rightId),
-                currentValue
-                );
+            this->StoreValue(license, rightId, currentValue);
             return true;
         }
         return false;
@@ -94,12 +184,21 @@ namespace lcp
     {
         IRightsManager * rightsManager = this->PerformChecks(license);
         rightsManager->SetRightValue(rightId, value);
+        this->StoreValue(license, rightId, value);
+    }
 
-        m_storageProvider->SetValue(
-            LicenseRightsVaultId,
-            this->BuildStorageProviderRightsKey(license, rightId),
-            value
-            );
+    void RightsService::StoreValue(ILicense * license, const std::string & rightId, const std::string & value)
+    {
+        std::string storageKey = this->BuildStorageProviderRightsKey(license, rightId);
+        if (m_journal)
+        {
+            m_journal->SetValue(storageKey, value);
+        }
+        else
+        {
+            m_storageProvider->SetValue(LicenseRightsVaultId, storageKey, value);
+        }
+        this->UpdateRightsIndex(license, rightId, value);
     }
 
     std::string RightsService::GetValue(ILicense * license, const std::string & rightId) const
@@ -109,25 +208,17 @@ namespace lcp
         {
             return value;
         }
-        else
+        std::string storageKey = this->BuildStorageProviderRightsKey(license, rightId);
+        if (m_journal && m_journal->GetValue(storageKey, value))
         {
-            return m_storageProvider->GetValue(
-                LicenseRightsVaultId,
-                this->BuildStorageProviderRightsKey(license, rightId)
-                );
+            return value;
         }
+        return m_storageProvider->GetValue(LicenseRightsVaultId, storageKey);
     }
 
     std::string RightsService::BuildStorageProviderRightsKey(ILicense * license, const std::string & rightId) const
     {
-        std::string userId = license->User()->Id();
-        if (userId.empty())
-        {
-            userId = m_unknownUserId;
-        }
-        std::stringstream keyStream;
-        keyStream << license->Provider() << "@" << userId << "@" << license->Id() << "@" << rightId;
-        return keyStream.str();
+        return this->BuildStorageProviderRightsKeyPrefix(license) + "@" + rightId;
     }
 
     std::string RightsService::BuildStorageProviderRightsKeyPrefix(ILicense * license) const
@@ -28,17 +28,30 @@
 #ifndef __RIGHTS_SERVICE_H__
 #define __RIGHTS_SERVICE_H__
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include "LcpTypedefs.h"
 #include "public/IRightsService.h"
 
 namespace lcp
 {
     class IRightsManager;
     class IStorageProvider;
+    class IFileSystemProvider;
+    class RightsJournal;
+    class Scheduler;
 
     class RightsService : public IRightsService
     {
     public:
-        explicit RightsService(IStorageProvider * storageProvider, const std::string & unknownUserId);
+        RightsService(
+            IStorageProvider * storageProvider,
+            IFileSystemProvider * fileSystemProvider,
+            const std::string & unknownUserId,
+            Scheduler * scheduler = nullptr
+            );
+        ~RightsService();
         void SyncRightsFromStorage(ILicense * license);
 
     public:
@@ -48,6 +61,8 @@ namespace lcp
         virtual bool UseRight(ILicense * license, const std::string & rightId, int amount);
         virtual void SetValue(ILicense * license, const std::string & rightId, const std::string & value);
         virtual std::string GetValue(ILicense * license, const std::string & rightId) const;
+        virtual void EnableWriteBackJournal(const std::string & journalPath, int flushPeriodMs);
+        virtual void Flush();
 
     private:
         IRightsManager * PerformChecks(ILicense * license) const;
@@ -55,9 +70,23 @@ namespace lcp
         std::string BuildStorageProviderRightsKey(ILicense * license, const std::string & rightId) const;
         std::string ExtractRightsKey(const std::string & storageProviderKey) const;
 
+        void BuildRightsIndex();
+        void UpdateRightsIndex(ILicense * license, const std::string & rightId, const std::string & value);
+        void StoreValue(ILicense * license, const std::string & rightId, const std::string & value);
+
     private:
         IStorageProvider * m_storageProvider;
+        IFileSystemProvider * m_fileSystemProvider;
         std::string m_unknownUserId;
+        // Runs the journal flushes, the process-wide scheduler when null
+        Scheduler * m_scheduler;
+        std::unique_ptr<RightsJournal> m_journal;
+
+        // Rights vault content grouped by license key prefix, used when the
+        // storage provider can't enumerate by prefix. Built once on first sync.
+        std::map<std::string, StringsMap> m_rightsIndex;
+        bool m_rightsIndexBuilt;
+        std::mutex m_rightsIndexSync;
     };
 }
 
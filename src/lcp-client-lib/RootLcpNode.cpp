@@ -37,6 +37,9 @@
 
 namespace lcp
 {
+    // Keys of a license which isn't decrypted
+    static const KeyType EmptyKey;
+
     RootLcpNode::RootLcpNode(
         const std::string & licenseJson,
         const std::string & canonicalJson,
@@ -152,22 +155,22 @@ namespace lcp
         return m_decrypted;
     }
 
-    KeyType RootLcpNode::UserKey() const
+    const KeyType & RootLcpNode::UserKey() const
     {
         if (m_keyProvider != nullptr)
         {
             return m_keyProvider->UserKey();
         }
-        return std::move(KeyType());
+        return EmptyKey;
     }
 
-    KeyType RootLcpNode::ContentKey() const
+    const KeyType & RootLcpNode::ContentKey() const
     {
         if (m_keyProvider != nullptr)
         {
             return m_keyProvider->ContentKey();
         }
-        return std::move(KeyType());
+        return EmptyKey;
     }
 
     void RootLcpNode::SetKeyProvider(std::unique_ptr<IKeyProvider> keyProvider)
@@ -247,7 +250,7 @@ namespace lcp
 
     void RootLcpNode::ParseNode(const rapidjson::Value & parentObject, JsonValueReader * reader)
     {
-        rapidjson::Document rootObject;
+        rapidjson::Document & rootObject = m_document;
         if (rootObject.Parse<rapidjson::kParseValidateEncodingFlag>(m_rootInfo.content.data()).HasParseError())
         {
             throw StatusException(JsonValueReader::CreateRapidJsonError(
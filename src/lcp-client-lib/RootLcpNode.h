@@ -28,6 +28,7 @@
 #ifndef __ROOT_LCP_NODE_H__
 #define __ROOT_LCP_NODE_H__
 
+#include "rapidjson/document.h"
 #include "BaseLcpNode.h"
 #include "public/ILicense.h"
 #include "IKeyProvider.h"
@@ -103,11 +104,13 @@ namespace lcp
         virtual void setStatusDocumentProcessingFlag(bool flag);
 
     public:
-        virtual KeyType UserKey() const;
-        virtual KeyType ContentKey() const;
+        virtual const KeyType & UserKey() const;
+        virtual const KeyType & ContentKey() const;
 
     private:
         RootInfo m_rootInfo;
+        // Kept for the nodes reading their values after parsing
+        rapidjson::Document m_document;
 
 #if ENABLE_GENERIC_JSON_NODE
         ICrypto * m_crypto;
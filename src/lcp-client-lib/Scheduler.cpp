@@ -0,0 +1,296 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "Scheduler.h"
+#include "WorkerPool.h"
+
+namespace lcp
+{
+    /*static*/ const size_t Scheduler::DefaultWorkersCount = 2;
+
+    Scheduler::Scheduler(size_t workersCount)
+        : m_nextTaskId(1)
+        , m_stopping(false)
+        , m_pool(nullptr)
+        , m_postedTasks(0)
+    {
+        if (workersCount == 0)
+        {
+            workersCount = 1;
+        }
+        m_dispatcher = std::thread(&Scheduler::DispatcherThread, this);
+        for (size_t i = 0; i < workersCount; ++i)
+        {
+            m_workers.push_back(std::thread(&Scheduler::WorkerThread, this));
+        }
+    }
+
+    Scheduler::Scheduler(WorkerPool * pool)
+        : m_nextTaskId(1)
+        , m_stopping(false)
+        , m_pool(pool)
+        , m_postedTasks(0)
+    {
+        m_dispatcher = std::thread(&Scheduler::DispatcherThread, this);
+    }
+
+    Scheduler::~Scheduler()
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_stopping = true;
+        }
+        m_conditionQueue.notify_all();
+        m_conditionReady.notify_all();
+
+        m_dispatcher.join();
+        for (auto & worker : m_workers)
+        {
+            worker.join();
+        }
+
+        // The tasks posted to the pool refer to this scheduler
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_conditionIdle.wait(locker, [this]() { return m_postedTasks == 0; });
+    }
+
+    /*static*/ Scheduler * Scheduler::Shared()
+    {
+        // Never destroyed: services owned by static objects may still
+        // unregister their tasks while the process exits.
+        static Scheduler * instance = new Scheduler();
+        return instance;
+    }
+
+    Scheduler::TaskId Scheduler::Register(std::function<void()> handler)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        TaskId id = m_nextTaskId++;
+        Task & task = m_tasks[id];
+        task.handler = std::move(handler);
+        task.generation = 0;
+        task.scheduled = false;
+        task.running = false;
+        task.runAgain = false;
+        return id;
+    }
+
+    void Scheduler::Unregister(TaskId id)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end())
+        {
+            return;
+        }
+
+        Task & task = it->second;
+        ++task.generation;
+        task.scheduled = false;
+        task.runAgain = false;
+        // A task dispatched but not started yet is skipped once removed
+        bool started = (task.runningThread != std::thread::id());
+        if (task.running && started && task.runningThread != std::this_thread::get_id())
+        {
+            m_conditionIdle.wait(locker, [this, id]() {
+                auto found = m_tasks.find(id);
+                return found == m_tasks.end() || !found->second.running;
+            });
+        }
+        m_tasks.erase(id);
+    }
+
+    void Scheduler::ScheduleAfter(TaskId task, const DurationType & delay)
+    {
+        this->ScheduleAt(task, ClockType::now() + delay);
+    }
+
+    void Scheduler::ScheduleAt(TaskId task, const std::chrono::system_clock::time_point & when)
+    {
+        auto delay = when - std::chrono::system_clock::now();
+        this->ScheduleAt(task, ClockType::now() + std::chrono::duration_cast<ClockType::duration>(delay));
+    }
+
+    void Scheduler::ScheduleAt(TaskId id, const TimePointType & when)
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            auto it = m_tasks.find(id);
+            if (it == m_tasks.end())
+            {
+                return;
+            }
+
+            Task & task = it->second;
+            task.scheduled = true;
+            Entry entry = { when, id, ++task.generation };
+            m_queue.push(entry);
+        }
+        m_conditionQueue.notify_one();
+    }
+
+    void Scheduler::Unschedule(TaskId id)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto it = m_tasks.find(id);
+        if (it != m_tasks.end())
+        {
+            ++it->second.generation;
+            it->second.scheduled = false;
+            it->second.runAgain = false;
+        }
+    }
+
+    bool Scheduler::IsScheduled(TaskId id) const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto it = m_tasks.find(id);
+        return (it != m_tasks.end() && (it->second.scheduled || it->second.runAgain));
+    }
+
+    void Scheduler::DispatcherThread()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        while (!m_stopping)
+        {
+            if (m_queue.empty())
+            {
+                m_conditionQueue.wait(locker);
+                continue;
+            }
+
+            Entry entry = m_queue.top();
+            auto it = m_tasks.find(entry.task);
+            if (it == m_tasks.end() || !it->second.scheduled || it->second.generation != entry.generation)
+            {
+                // Rescheduled, unscheduled or unregistered since queued
+                m_queue.pop();
+                continue;
+            }
+
+            if (entry.when > ClockType::now())
+            {
+                m_conditionQueue.wait_until(locker, entry.when);
+                continue;
+            }
+
+            m_queue.pop();
+            Task & task = it->second;
+            task.scheduled = false;
+            if (task.running)
+            {
+                task.runAgain = true;
+            }
+            else
+            {
+                task.running = true;
+                this->Dispatch(entry.task);
+            }
+        }
+    }
+
+    void Scheduler::Dispatch(TaskId id)
+    {
+        if (m_pool != nullptr)
+        {
+            ++m_postedTasks;
+            m_pool->Post(WorkerPool::Background, [this, id]() { this->RunPostedTask(id); });
+        }
+        else
+        {
+            m_readyTasks.push_back(id);
+            m_conditionReady.notify_one();
+        }
+    }
+
+    void Scheduler::RunPostedTask(TaskId id)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        if (!m_stopping)
+        {
+            this->RunTask(locker, id);
+        }
+        --m_postedTasks;
+        m_conditionIdle.notify_all();
+    }
+
+    void Scheduler::WorkerThread()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        while (true)
+        {
+            m_conditionReady.wait(locker, [this]() { return m_stopping || !m_readyTasks.empty(); });
+            if (m_stopping)
+            {
+                break;
+            }
+
+            TaskId id = m_readyTasks.front();
+            m_readyTasks.pop_front();
+            this->RunTask(locker, id);
+        }
+    }
+
+    void Scheduler::RunTask(std::unique_lock<std::mutex> & locker, TaskId id)
+    {
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end())
+        {
+            return;
+        }
+
+        it->second.runningThread = std::this_thread::get_id();
+        std::function<void()> handler = it->second.handler;
+        locker.unlock();
+        try
+        {
+            handler();
+        }
+        catch (...)
+        {
+            // Tasks report their own failures
+        }
+        locker.lock();
+
+        it = m_tasks.find(id);
+        if (it != m_tasks.end())
+        {
+            Task & task = it->second;
+            task.runningThread = std::thread::id();
+            if (task.runAgain)
+            {
+                task.runAgain = false;
+                this->Dispatch(id);
+            }
+            else
+            {
+                task.running = false;
+            }
+        }
+        m_conditionIdle.notify_all();
+    }
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class WorkerPool;
+
+    //
+    // Runs registered tasks at scheduled points in time. A single thread
+    // keeps the due times in a heap and hands due tasks over to a small pool
+    // of workers, or to the background lane of a shared WorkerPool.
+    // Scheduling only queues an entry, it never waits for a running task; a
+    // task due while it is still running runs again once done, never
+    // concurrently with itself.
+    //
+    class Scheduler : public NonCopyable
+    {
+    public:
+        typedef std::chrono::steady_clock ClockType;
+        typedef ClockType::time_point TimePointType;
+        typedef std::chrono::milliseconds DurationType;
+        typedef uint64_t TaskId;
+
+    public:
+        explicit Scheduler(size_t workersCount = DefaultWorkersCount);
+
+        //
+        // Runs the due tasks on the pool, which must outlive the scheduler.
+        //
+        explicit Scheduler(WorkerPool * pool);
+        ~Scheduler();
+
+        //
+        // Process-wide instance, shared by every service.
+        //
+        static Scheduler * Shared();
+
+        TaskId Register(std::function<void()> handler);
+
+        //
+        // Removes the task, waiting for it to end when it is running on
+        // another thread. Can be called from the task itself.
+        //
+        void Unregister(TaskId task);
+
+        void ScheduleAfter(TaskId task, const DurationType & delay);
+        void ScheduleAt(TaskId task, const std::chrono::system_clock::time_point & when);
+        void Unschedule(TaskId task);
+        bool IsScheduled(TaskId task) const;
+
+    public:
+        static const size_t DefaultWorkersCount;
+
+    private:
+        struct Task
+        {
+            std::function<void()> handler;
+            uint64_t generation;
+            bool scheduled;
+            bool running;
+            bool runAgain;
+            std::thread::id runningThread;
+        };
+
+        struct Entry
+        {
+            TimePointType when;
+            TaskId task;
+            uint64_t generation;
+
+            bool operator>(const Entry & right) const
+            {
+                return when > right.when;
+            }
+        };
+
+        void ScheduleAt(TaskId task, const TimePointType & when);
+        void DispatcherThread();
+        void WorkerThread();
+        void Dispatch(TaskId task);
+        void RunPostedTask(TaskId task);
+        void RunTask(std::unique_lock<std::mutex> & locker, TaskId task);
+
+    private:
+        std::map<TaskId, Task> m_tasks;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> m_queue;
+        std::deque<TaskId> m_readyTasks;
+        TaskId m_nextTaskId;
+        bool m_stopping;
+
+        mutable std::mutex m_sync;
+        std::condition_variable m_conditionQueue;
+        std::condition_variable m_conditionReady;
+        std::condition_variable m_conditionIdle;
+
+        std::thread m_dispatcher;
+        std::vector<std::thread> m_workers;
+
+        WorkerPool * m_pool;
+        // Count of the tasks posted to the pool and not run yet
+        size_t m_postedTasks;
+    };
+}
+
+#endif //__SCHEDULER_H__
@@ -0,0 +1,212 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <vector>
+#include "IncludeMacros.h"
+#include "SecureBuffer.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/aes.h>
+#include <cryptopp/misc.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcp
+{
+    namespace
+    {
+        // Size classes from 64 bytes to 256 KiB, doubling
+        const size_t MinClassSize = 4 * CryptoPP::AES::BLOCKSIZE;
+        const size_t ClassesCount = 13;
+        // Enough for the input and output buffers of nested decryptions
+        const size_t MaxFreeBlocksPerClass = 4;
+
+        class ThreadBufferPool
+        {
+        public:
+            ~ThreadBufferPool()
+            {
+                for (auto & blocks : m_freeBlocks)
+                {
+                    for (unsigned char * block : blocks)
+                    {
+                        delete[] block;
+                    }
+                }
+            }
+
+            unsigned char * Acquire(size_t sizeClass)
+            {
+                std::vector<unsigned char *> & blocks = m_freeBlocks[sizeClass];
+                if (blocks.empty())
+                {
+                    // Zeroed, as the blocks coming back to the pool
+                    return new unsigned char[MinClassSize << sizeClass]();
+                }
+                unsigned char * block = blocks.back();
+                blocks.pop_back();
+                return block;
+            }
+
+            void Release(unsigned char * block, size_t sizeClass)
+            {
+                std::vector<unsigned char *> & blocks = m_freeBlocks[sizeClass];
+                if (blocks.size() < MaxFreeBlocksPerClass)
+                {
+                    if (blocks.capacity() < MaxFreeBlocksPerClass)
+                    {
+                        blocks.reserve(MaxFreeBlocksPerClass);
+                    }
+                    blocks.push_back(block);
+                }
+                else
+                {
+                    delete[] block;
+                }
+            }
+
+            size_t PooledCount() const
+            {
+                size_t count = 0;
+                for (auto & blocks : m_freeBlocks)
+                {
+                    count += blocks.size();
+                }
+                return count;
+            }
+
+        private:
+            std::vector<unsigned char *> m_freeBlocks[ClassesCount];
+        };
+
+        thread_local ThreadBufferPool CurrentPool;
+
+        size_t SizeClass(size_t size)
+        {
+            size_t sizeClass = 0;
+            while (sizeClass < ClassesCount && (MinClassSize << sizeClass) < size)
+            {
+                ++sizeClass;
+            }
+            return sizeClass;
+        }
+    }
+
+    /*static*/ const size_t SecureBuffer::MaxPooledSize = MinClassSize << (ClassesCount - 1);
+
+    SecureBuffer::SecureBuffer()
+        : m_data(nullptr)
+        , m_size(0)
+        , m_sizeClass(ClassesCount)
+    {
+    }
+
+    SecureBuffer::SecureBuffer(size_t size)
+        : m_data(nullptr)
+        , m_size(size)
+        , m_sizeClass(SizeClass(size))
+    {
+        if (m_sizeClass < ClassesCount)
+        {
+            m_data = CurrentPool.Acquire(m_sizeClass);
+        }
+        else
+        {
+            m_data = new unsigned char[size];
+        }
+    }
+
+    SecureBuffer::SecureBuffer(SecureBuffer && other)
+        : m_data(other.m_data)
+        , m_size(other.m_size)
+        , m_sizeClass(other.m_sizeClass)
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+
+    SecureBuffer & SecureBuffer::operator=(SecureBuffer && other)
+    {
+        if (this != &other)
+        {
+            this->Release();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_sizeClass = other.m_sizeClass;
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        return *this;
+    }
+
+    SecureBuffer::~SecureBuffer()
+    {
+        this->Release();
+    }
+
+    unsigned char * SecureBuffer::Data()
+    {
+        return m_data;
+    }
+
+    const unsigned char * SecureBuffer::Data() const
+    {
+        return m_data;
+    }
+
+    size_t SecureBuffer::Size() const
+    {
+        return m_size;
+    }
+
+    /*static*/ size_t SecureBuffer::PooledCount()
+    {
+        return CurrentPool.PooledCount();
+    }
+
+    void SecureBuffer::Release()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+        // Only the requested size may have been written, the rest of the
+        // block is still zeroed
+        CryptoPP::SecureWipeBuffer(m_data, m_size);
+        if (m_sizeClass < ClassesCount)
+        {
+            CurrentPool.Release(m_data, m_sizeClass);
+        }
+        else
+        {
+            delete[] m_data;
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
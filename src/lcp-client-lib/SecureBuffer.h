@@ -0,0 +1,76 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __SECURE_BUFFER_H__
+#define __SECURE_BUFFER_H__
+
+#include <cstddef>
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    //
+    // Temporary buffer for sensitive data, eg. cipher or plain text being
+    // decrypted. Buffers are drawn from a pool of the current thread, in
+    // size classes which are multiples of the AES block, so that the
+    // steady-state decryption allocates nothing. The content is wiped when
+    // the buffer is released, whether it goes back to the pool or not.
+    //
+    class SecureBuffer : public NonCopyable
+    {
+    public:
+        SecureBuffer();
+        explicit SecureBuffer(size_t size);
+        SecureBuffer(SecureBuffer && other);
+        SecureBuffer & operator=(SecureBuffer && other);
+        ~SecureBuffer();
+
+        unsigned char * Data();
+        const unsigned char * Data() const;
+        size_t Size() const;
+
+        //
+        // Count of the buffers kept by the pool of the current thread.
+        //
+        static size_t PooledCount();
+
+    public:
+        // Larger buffers are allocated on demand and freed on release
+        static const size_t MaxPooledSize;
+
+    private:
+        void Release();
+
+    private:
+        unsigned char * m_data;
+        size_t m_size;
+        size_t m_sizeClass;
+    };
+}
+
+#endif //__SECURE_BUFFER_H__
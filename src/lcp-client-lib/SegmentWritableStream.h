@@ -0,0 +1,126 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __SEGMENT_WRITABLE_STREAM_H__
+#define __SEGMENT_WRITABLE_STREAM_H__
+
+#include <algorithm>
+#include <mutex>
+#include "public/StreamInterfaces.h"
+#include "BandwidthBudget.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    //
+    // Destination of a single range of a download split in segments. The
+    // bytes received are written at their place in a stream shared with the
+    // other segments, whose accesses are serialized by the given mutex.
+    // Writing past the end of the range, which happens when the server sends
+    // something else than the requested range, drops the extra bytes and
+    // sets Overrun(). An end of -1 accepts anything.
+    // Writes are held back by the given budget, if any, before taking the
+    // lock so a throttled segment does not block the others.
+    //
+    class SegmentWritableStream : public IWritableStream, public NonCopyable
+    {
+    public:
+        SegmentWritableStream(IWritableStream * stream, std::mutex & streamSync, int64_t start, int64_t end, BandwidthBudget * budget = nullptr)
+            : m_stream(stream)
+            , m_streamSync(streamSync)
+            , m_budget(budget)
+            , m_start(start)
+            , m_end(end)
+            , m_position(start)
+            , m_overrun(false)
+        {
+        }
+
+        virtual void Write(const unsigned char * pBuffer, int64_t sizeToWrite)
+        {
+            if (m_budget != nullptr)
+            {
+                m_budget->Consume(sizeToWrite);
+            }
+
+            std::unique_lock<std::mutex> locker(m_streamSync);
+            if (m_end != -1 && m_position + sizeToWrite > m_end)
+            {
+                sizeToWrite = std::max<int64_t>(m_end - m_position, 0);
+                m_overrun = true;
+            }
+
+            if (sizeToWrite > 0)
+            {
+                m_stream->SetWritePosition(m_position);
+                m_stream->Write(pBuffer, sizeToWrite);
+                m_position += sizeToWrite;
+            }
+        }
+
+        //
+        // Positions are relative to the start of the range.
+        //
+        virtual void SetWritePosition(int64_t pos)
+        {
+            std::unique_lock<std::mutex> locker(m_streamSync);
+            m_position = m_start + pos;
+        }
+
+        virtual int64_t WritePosition() const
+        {
+            std::unique_lock<std::mutex> locker(m_streamSync);
+            return m_position - m_start;
+        }
+
+        //
+        // Position in the shared stream following the last byte written.
+        //
+        int64_t Position() const
+        {
+            std::unique_lock<std::mutex> locker(m_streamSync);
+            return m_position;
+        }
+
+        bool Overrun() const
+        {
+            std::unique_lock<std::mutex> locker(m_streamSync);
+            return m_overrun;
+        }
+
+    private:
+        IWritableStream * m_stream;
+        std::mutex & m_streamSync;
+        BandwidthBudget * m_budget;
+        int64_t m_start;
+        int64_t m_end;
+        int64_t m_position;
+        bool m_overrun;
+    };
+}
+
+#endif //__SEGMENT_WRITABLE_STREAM_H__
@@ -25,11 +25,24 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <algorithm>
+#include <cstring>
 #include "AlgorithmNames.h"
 #include "Sha256HashAlgorithm.h"
 
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/misc.h>
+CRYPTOPP_INCLUDE_END
+
+using namespace CryptoPP;
+
 namespace lcp
 {
+    Sha256HashAlgorithm::Sha256HashAlgorithm()
+    {
+        this->Restart();
+    }
+
     std::string Sha256HashAlgorithm::Name() const
     {
         return AlgorithmNames::Sha256Id;
@@ -37,7 +50,7 @@ namespace lcp
 
     size_t Sha256HashAlgorithm::DigestSize() const
     {
-        return CryptoPP::SHA256::DIGESTSIZE;
+        return SHA256::DIGESTSIZE;
     }
 
     void Sha256HashAlgorithm::UpdateHash(const std::string & dataStr)
@@ -47,13 +60,100 @@ namespace lcp
 
     void Sha256HashAlgorithm::UpdateHash(const unsigned char * data, const size_t dataLength)
     {
-        m_sha256.Update(data, dataLength);
+        size_t pending = static_cast<size_t>(m_length % BlockSize);
+        m_length += dataLength;
+
+        size_t offset = 0;
+        if (pending != 0)
+        {
+            size_t copied = std::min(BlockSize - pending, dataLength);
+            std::memcpy(m_block + pending, data, copied);
+            offset = copied;
+            if (pending + copied < BlockSize)
+            {
+                return;
+            }
+            this->HashBlock(m_block);
+        }
+        for (; offset + BlockSize <= dataLength; offset += BlockSize)
+        {
+            this->HashBlock(data + offset);
+        }
+        std::memcpy(m_block, data + offset, dataLength - offset);
     }
 
     KeyType Sha256HashAlgorithm::Hash()
     {
-        KeyType hash(CryptoPP::SHA256::DIGESTSIZE);
-        m_sha256.Final(hash.data());
+        // Padding: 0x80, zeros, then the length in bits on the last 8 bytes
+        uint64_t bitLength = m_length * 8;
+        size_t pending = static_cast<size_t>(m_length % BlockSize);
+        m_block[pending++] = 0x80;
+        if (pending > BlockSize - sizeof(uint64_t))
+        {
+            std::memset(m_block + pending, 0, BlockSize - pending);
+            this->HashBlock(m_block);
+            pending = 0;
+        }
+        std::memset(m_block + pending, 0, BlockSize - sizeof(uint64_t) - pending);
+        PutWord<word64>(false, BIG_ENDIAN_ORDER, m_block + BlockSize - sizeof(uint64_t), bitLength);
+        this->HashBlock(m_block);
+
+        KeyType hash(SHA256::DIGESTSIZE);
+        for (size_t i = 0; i < StateWords; ++i)
+        {
+            PutWord<word32>(false, BIG_ENDIAN_ORDER, hash.data() + i * sizeof(word32), m_state[i]);
+        }
+        this->Restart();
         return hash;
     }
-}
\ No newline at end of file
+
+    Buffer Sha256HashAlgorithm::SaveState() const
+    {
+        size_t pending = static_cast<size_t>(m_length % BlockSize);
+        Buffer state(StateSize + pending);
+        for (size_t i = 0; i < StateWords; ++i)
+        {
+            PutWord<word32>(false, BIG_ENDIAN_ORDER, state.data() + i * sizeof(word32), m_state[i]);
+        }
+        PutWord<word64>(false, BIG_ENDIAN_ORDER, state.data() + StateWords * sizeof(word32), m_length);
+        std::memcpy(state.data() + StateSize, m_block, pending);
+        return state;
+    }
+
+    bool Sha256HashAlgorithm::RestoreState(const Buffer & state)
+    {
+        if (state.size() < StateSize)
+        {
+            return false;
+        }
+        uint64_t length = GetWord<word64>(false, BIG_ENDIAN_ORDER, state.data() + StateWords * sizeof(word32));
+        size_t pending = static_cast<size_t>(length % BlockSize);
+        if (state.size() != StateSize + pending)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < StateWords; ++i)
+        {
+            m_state[i] = GetWord<word32>(false, BIG_ENDIAN_ORDER, state.data() + i * sizeof(word32));
+        }
+        m_length = length;
+        std::memcpy(m_block, state.data() + StateSize, pending);
+        return true;
+    }
+
+    void Sha256HashAlgorithm::Restart()
+    {
+        SHA256::InitState(m_state);
+        m_length = 0;
+    }
+
+    void Sha256HashAlgorithm::HashBlock(const unsigned char * block)
+    {
+        for (size_t i = 0; i < m_words.size(); ++i)
+        {
+            m_words[i] = GetWord<word32>(false, BIG_ENDIAN_ORDER, block + i * sizeof(word32));
+        }
+        SHA256::Transform(m_state, m_words);
+    }
+}
@@ -32,22 +32,46 @@
 #include "NonCopyable.h"
 
 CRYPTOPP_INCLUDE_START
+#include <cryptopp/secblock.h>
 #include <cryptopp/sha.h>
 CRYPTOPP_INCLUDE_END
 
 namespace lcp
 {
-    class Sha256HashAlgorithm : public IHashAlgorithm, public NonCopyable
+    //
+    // SHA-256 over the block transform of Crypto++. The length of the data
+    // is counted here, which lets the state be saved: the chaining value,
+    // the length and the bytes of the incomplete block.
+    //
+    class Sha256HashAlgorithm : public IResumableHashAlgorithm, public NonCopyable
     {
     public:
+        Sha256HashAlgorithm();
+
         virtual std::string Name() const;
         virtual size_t DigestSize() const;
         virtual void UpdateHash(const std::string & dataStr);
         virtual void UpdateHash(const unsigned char * data, const size_t dataLength);
         virtual KeyType Hash();
 
+        // IResumableHashAlgorithm
+        virtual Buffer SaveState() const;
+        virtual bool RestoreState(const Buffer & state);
+
+    private:
+        void Restart();
+        void HashBlock(const unsigned char * block);
+
+    private:
+        static const size_t BlockSize = CryptoPP::SHA256::BLOCKSIZE;
+        static const size_t StateWords = 8;
+        static const size_t StateSize = StateWords * sizeof(CryptoPP::word32) + sizeof(uint64_t);
+
     private:
-        CryptoPP::SHA256 m_sha256;
+        CryptoPP::FixedSizeAlignedSecBlock<CryptoPP::word32, 16, true> m_state;
+        CryptoPP::FixedSizeSecBlock<CryptoPP::word32, 16> m_words;
+        unsigned char m_block[BlockSize];
+        uint64_t m_length;
     };
 }
 
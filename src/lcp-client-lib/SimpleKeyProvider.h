@@ -41,12 +41,12 @@ namespace lcp
         {
         }
 
-        virtual KeyType UserKey() const
+        virtual const KeyType & UserKey() const
         {
             return m_userKey;
         }
 
-        virtual KeyType ContentKey() const
+        virtual const KeyType & ContentKey() const
         {
             return m_contentKey;
         }
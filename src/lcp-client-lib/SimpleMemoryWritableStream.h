@@ -37,9 +37,9 @@ namespace lcp
     {
     public:
         explicit SimpleMemoryWritableStream(size_t size = DefaultBufferSize)
-            : m_buffer(size)
-            , m_position(0)
+            : m_position(0)
         {
+            m_buffer.reserve(size);
         }
 
         const std::vector<unsigned char> & Buffer() const
@@ -52,6 +52,7 @@ namespace lcp
             size_t convSizeToWrite = static_cast<size_t>(sizeToWrite);
             this->EnsureSize(m_position + convSizeToWrite);
             std::copy(pBuffer, pBuffer + convSizeToWrite, m_buffer.begin() + m_position);
+            m_position += convSizeToWrite;
         }
 
         virtual void SetWritePosition(int64_t pos)
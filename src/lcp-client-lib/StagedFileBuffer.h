@@ -0,0 +1,106 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __STAGED_FILE_BUFFER_H__
+#define __STAGED_FILE_BUFFER_H__
+
+#include <algorithm>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "NonCopyable.h"
+#include "public/IFileSystemProvider.h"
+
+namespace lcp
+{
+    //
+    // Reads a file staged for an entry of a new archive, for ziplib. The
+    // file is opened on the first read and closed at its end, so that
+    // writing the archive keeps a single staged file open at a time. Read
+    // errors surface as a bad stream, to be checked once it is written.
+    //
+    class StagedFileBuffer : public std::streambuf, public NonCopyable
+    {
+    public:
+        StagedFileBuffer(IFileSystemProvider * fileSystemProvider, const std::string & path, size_t chunkSize)
+            : m_fileSystemProvider(fileSystemProvider)
+            , m_path(path)
+            , m_chunkSize(chunkSize)
+            , m_remaining(0)
+            , m_finished(false)
+        {
+        }
+
+    protected:
+        virtual int_type underflow()
+        {
+            if (this->gptr() < this->egptr())
+            {
+                return traits_type::to_int_type(*this->gptr());
+            }
+            if (m_finished)
+            {
+                return traits_type::eof();
+            }
+
+            if (m_file == nullptr)
+            {
+                m_file.reset(m_fileSystemProvider->GetFile(m_path, IFileSystemProvider::ReadOnly));
+                m_remaining = m_file->Size();
+                m_buffer.resize(m_chunkSize);
+            }
+
+            if (m_remaining == 0)
+            {
+                this->setg(nullptr, nullptr, nullptr);
+                m_file.reset();
+                std::vector<char>().swap(m_buffer);
+                m_finished = true;
+                return traits_type::eof();
+            }
+
+            size_t count = static_cast<size_t>(std::min<int64_t>(m_remaining, m_buffer.size()));
+            m_file->Read(reinterpret_cast<unsigned char *>(m_buffer.data()), count);
+            m_remaining -= count;
+            this->setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + count);
+            return traits_type::to_int_type(*this->gptr());
+        }
+
+    private:
+        IFileSystemProvider * m_fileSystemProvider;
+        std::string m_path;
+        size_t m_chunkSize;
+        std::unique_ptr<IFile> m_file;
+        std::vector<char> m_buffer;
+        int64_t m_remaining;
+        bool m_finished;
+    };
+}
+
+#endif //__STAGED_FILE_BUFFER_H__
@@ -0,0 +1,184 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "Statistics.h"
+
+namespace lcp
+{
+    namespace
+    {
+        // Statistics of the current thread, the shared ones when null
+        thread_local Statistics * CurrentStatistics = nullptr;
+    }
+
+    Statistics::Timer::Timer(StatisticsOperation::OperationEnum operation)
+        : m_statistics(Statistics::Current())
+        , m_operation(operation)
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    Statistics::Timer::~Timer()
+    {
+        m_statistics->AddLatency(m_operation, std::chrono::steady_clock::now() - m_start);
+    }
+
+    Statistics::Scope::Scope(Statistics * statistics)
+        : m_previous(CurrentStatistics)
+    {
+        if (statistics != nullptr)
+        {
+            CurrentStatistics = statistics;
+        }
+    }
+
+    Statistics::Scope::~Scope()
+    {
+        CurrentStatistics = m_previous;
+    }
+
+    Statistics::Statistics()
+        : m_nextShard(0)
+    {
+        for (Shard & shard : m_shards)
+        {
+            for (auto & counter : shard.counters)
+            {
+                counter = 0;
+            }
+            for (Histogram & histogram : shard.latencies)
+            {
+                for (auto & bucket : histogram.buckets)
+                {
+                    bucket = 0;
+                }
+                histogram.count = 0;
+                histogram.totalMicroseconds = 0;
+                histogram.maxMicroseconds = 0;
+            }
+        }
+    }
+
+    /*static*/ Statistics * Statistics::Shared()
+    {
+        // Never destroyed: operations may still be recorded by threads
+        // outliving the static objects
+        static Statistics * instance = new Statistics();
+        return instance;
+    }
+
+    /*static*/ Statistics * Statistics::Current()
+    {
+        return (CurrentStatistics != nullptr) ? CurrentStatistics : Statistics::Shared();
+    }
+
+    /*static*/ void Statistics::Increment(StatisticsCounter::CounterEnum counter, int64_t value)
+    {
+        Statistics::Current()->Add(counter, value);
+    }
+
+    /*static*/ void Statistics::RecordLatency(StatisticsOperation::OperationEnum operation, std::chrono::steady_clock::duration duration)
+    {
+        Statistics::Current()->AddLatency(operation, duration);
+    }
+
+    void Statistics::Add(StatisticsCounter::CounterEnum counter, int64_t value)
+    {
+        Shard & shard = this->CurrentShard();
+        shard.counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void Statistics::AddLatency(StatisticsOperation::OperationEnum operation, std::chrono::steady_clock::duration duration)
+    {
+        int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        if (microseconds < 0)
+        {
+            microseconds = 0;
+        }
+
+        size_t bucket = 0;
+        while (bucket + 1 < LatencyHistogram::BucketsCount && (microseconds >> bucket) != 0)
+        {
+            ++bucket;
+        }
+
+        Histogram & histogram = this->CurrentShard().latencies[operation];
+        histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        histogram.count.fetch_add(1, std::memory_order_relaxed);
+        histogram.totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+
+        int64_t max = histogram.maxMicroseconds.load(std::memory_order_relaxed);
+        while (microseconds > max && !histogram.maxMicroseconds.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void Statistics::Read(StatisticsSnapshot & snapshot, bool reset)
+    {
+        snapshot = StatisticsSnapshot();
+        for (Shard & shard : m_shards)
+        {
+            for (size_t i = 0; i < StatisticsCounter::CountersCount; ++i)
+            {
+                snapshot.counters[i] += ReadValue(shard.counters[i], reset);
+            }
+            for (size_t i = 0; i < StatisticsOperation::OperationsCount; ++i)
+            {
+                Histogram & histogram = shard.latencies[i];
+                LatencyHistogram & latencies = snapshot.latencies[i];
+                for (size_t j = 0; j < LatencyHistogram::BucketsCount; ++j)
+                {
+                    latencies.buckets[j] += ReadValue(histogram.buckets[j], reset);
+                }
+                latencies.count += ReadValue(histogram.count, reset);
+                latencies.totalMicroseconds += ReadValue(histogram.totalMicroseconds, reset);
+                int64_t max = ReadValue(histogram.maxMicroseconds, reset);
+                if (max > latencies.maxMicroseconds)
+                {
+                    latencies.maxMicroseconds = max;
+                }
+            }
+        }
+    }
+
+    Statistics::Shard & Statistics::CurrentShard()
+    {
+        // Threads are given the shards in turn, the first time they record,
+        // and keep the same index in every instance
+        static thread_local size_t shardIndex = m_nextShard.fetch_add(1, std::memory_order_relaxed) % ShardsCount;
+        return m_shards[shardIndex];
+    }
+
+    /*static*/ int64_t Statistics::ReadValue(std::atomic<int64_t> & value, bool reset)
+    {
+        if (reset)
+        {
+            return value.exchange(0, std::memory_order_relaxed);
+        }
+        return value.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __LCP_STATISTICS_INTERNAL_H__
+#define __LCP_STATISTICS_INTERNAL_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "public/LcpStatistics.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    //
+    // Counters and latency histograms of a service. The values are spread
+    // over shards picked by the calling thread, so that recording only
+    // touches relaxed atomics which are rarely shared between cores.
+    // Reading sums the shards without blocking the threads recording in
+    // the meantime.
+    // The static recording functions use the statistics of the current
+    // thread, set by a Scope: each LcpService installs its own in its
+    // calls, its worker threads and the streams it creates. Values recorded
+    // outside of any scope go to Shared().
+    //
+    class Statistics : public NonCopyable
+    {
+    public:
+        //
+        // Measures the duration of an operation, from its construction
+        // until its destruction.
+        //
+        class Timer : public NonCopyable
+        {
+        public:
+            explicit Timer(StatisticsOperation::OperationEnum operation);
+            ~Timer();
+
+        private:
+            Statistics * m_statistics;
+            StatisticsOperation::OperationEnum m_operation;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        //
+        // Makes the given statistics the current ones of the thread, until
+        // its destruction. A null pointer keeps the current ones.
+        //
+        class Scope : public NonCopyable
+        {
+        public:
+            explicit Scope(Statistics * statistics);
+            ~Scope();
+
+        private:
+            Statistics * m_previous;
+        };
+
+    public:
+        Statistics();
+
+        static Statistics * Shared();
+        static Statistics * Current();
+
+        static void Increment(StatisticsCounter::CounterEnum counter, int64_t value = 1);
+        static void RecordLatency(StatisticsOperation::OperationEnum operation, std::chrono::steady_clock::duration duration);
+
+        void Add(StatisticsCounter::CounterEnum counter, int64_t value = 1);
+        void AddLatency(StatisticsOperation::OperationEnum operation, std::chrono::steady_clock::duration duration);
+
+        //
+        // Fills the snapshot with the current values. When reset is true,
+        // every value is zeroed as it is read: a value recorded
+        // concurrently is either in this snapshot or in the next one.
+        //
+        void Read(StatisticsSnapshot & snapshot, bool reset);
+
+    private:
+        struct Histogram
+        {
+            std::atomic<int64_t> buckets[LatencyHistogram::BucketsCount];
+            std::atomic<int64_t> count;
+            std::atomic<int64_t> totalMicroseconds;
+            std::atomic<int64_t> maxMicroseconds;
+        };
+
+        // Padded by a cache line so that two shards never share one. Not
+        // aligned, since operator new does not honor the alignment before
+        // C++17 and services allocate their statistics.
+        struct Shard
+        {
+            std::atomic<int64_t> counters[StatisticsCounter::CountersCount];
+            Histogram latencies[StatisticsOperation::OperationsCount];
+            char padding[64];
+        };
+
+        Shard & CurrentShard();
+
+        static int64_t ReadValue(std::atomic<int64_t> & value, bool reset);
+
+    private:
+        static const size_t ShardsCount = 16;
+
+        Shard m_shards[ShardsCount];
+        std::atomic<size_t> m_nextShard;
+    };
+}
+
+#endif //__LCP_STATISTICS_INTERNAL_H__
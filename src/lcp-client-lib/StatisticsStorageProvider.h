@@ -0,0 +1,98 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __STATISTICS_STORAGE_PROVIDER_H__
+#define __STATISTICS_STORAGE_PROVIDER_H__
+
+#include "public/IStorageProvider.h"
+#include "NonCopyable.h"
+#include "Statistics.h"
+
+namespace lcp
+{
+    //
+    // Counts the calls made to the storage provider given by the client in
+    // the statistics of the service, and forwards them.
+    //
+    class StatisticsStorageProvider : public IStorageProvider, public NonCopyable
+    {
+    public:
+        StatisticsStorageProvider(IStorageProvider * storageProvider, Statistics * statistics)
+            : m_storageProvider(storageProvider)
+            , m_statistics(statistics)
+        {
+        }
+
+        virtual std::string GetValue(const std::string & vaultId, const std::string & key)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->GetValue(vaultId, key);
+        }
+
+        virtual void SetValue(const std::string & vaultId, const std::string & key, const std::string & value)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            m_storageProvider->SetValue(vaultId, key, value);
+        }
+
+        virtual KvStringsIterator * EnumerateVault(const std::string & vaultId)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->EnumerateVault(vaultId);
+        }
+
+        virtual KvStringsIterator * EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->EnumerateVaultWithPrefix(vaultId, keyPrefix);
+        }
+
+        virtual bool GetValues(const std::string & vaultId, const std::vector<std::string> & keys, std::vector<std::string> & values)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->GetValues(vaultId, keys, values);
+        }
+
+        virtual bool SetValues(const std::string & vaultId, const std::map<std::string, std::string> & values)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->SetValues(vaultId, values);
+        }
+
+        virtual bool EnumerateVaultToBuffer(const std::string & vaultId, const std::string & keyPrefix, std::string & buffer)
+        {
+            m_statistics->Add(StatisticsCounter::StorageProviderCalls);
+            return m_storageProvider->EnumerateVaultToBuffer(vaultId, keyPrefix, buffer);
+        }
+
+    private:
+        IStorageProvider * m_storageProvider;
+        Statistics * m_statistics;
+    };
+}
+
+#endif //__STATISTICS_STORAGE_PROVIDER_H__
@@ -0,0 +1,66 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <memory>
+#include <stdexcept>
+#include "public/StorageProviderCreator.h"
+#include "FileStorageProvider.h"
+#include "LcpUtils.h"
+
+namespace lcp
+{
+    //
+    // Factory for creating the storage providers of the library.
+    //
+    Status StorageProviderCreator::CreateFileStorageProvider(
+        const std::string & storagePath,
+        const std::string & encryptionKey,
+        IFileSystemProvider * fileSystemProvider,
+        IStorageProvider ** storageProvider
+        )
+    {
+        if (storageProvider == nullptr)
+        {
+            throw std::invalid_argument("storageProvider is nullptr");
+        }
+
+        try
+        {
+            std::unique_ptr<FileStorageProvider> provider(new FileStorageProvider(
+                fileSystemProvider, storagePath, KeyType(encryptionKey.begin(), encryptionKey.end())
+                ));
+            provider->Open();
+            *storageProvider = provider.release();
+            return Status(StatusCode::ErrorCommonSuccess);
+        }
+        catch (const StatusException & ex)
+        {
+            return ex.ResultStatus();
+        }
+    }
+}
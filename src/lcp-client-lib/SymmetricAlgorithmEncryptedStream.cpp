@@ -28,6 +28,8 @@
 #include "IncludeMacros.h"
 #include "DecryptionContextImpl.h"
 #include "SymmetricAlgorithmEncryptedStream.h"
+#include "Statistics.h"
+#include "TraceSpan.h"
 
 CRYPTOPP_INCLUDE_START
 #include <cryptopp/cryptlib.h>
@@ -37,16 +39,20 @@ namespace lcp
 {
     SymmetricAlgorithmEncryptedStream::SymmetricAlgorithmEncryptedStream(
         IReadableStream * stream,
-        std::unique_ptr<ISymmetricAlgorithm> algorithm
+        std::unique_ptr<ISymmetricAlgorithm> algorithm,
+        ITraceSink * traceSink
         )
-        : m_stream(stream)
+        : m_readPosition(0)
+        , m_stream(stream)
         , m_algorithm(std::move(algorithm))
-        , m_readPosition(0)
+        , m_traceSink(traceSink)
+        , m_statistics(Statistics::Current())
     {
     }
 
     int64_t SymmetricAlgorithmEncryptedStream::DecryptedSize()
     {
+        Statistics::Scope statisticsScope(m_statistics);
         try
         {
             return m_algorithm->PlainTextSize(m_stream);;
@@ -59,11 +65,24 @@ namespace lcp
 
     void SymmetricAlgorithmEncryptedStream::Read(unsigned char * pBuffer, int64_t sizeToRead)
     {
+        Statistics::Scope statisticsScope(m_statistics);
+        Statistics::Timer timer(StatisticsOperation::EncryptedStreamRead);
+        TraceSpan span(m_traceSink, "SymmetricAlgorithmEncryptedStream::Read");
         try
         {
             DecryptionContextImpl context;
             context.SetDecryptionRange(static_cast<size_t>(m_readPosition), static_cast<size_t>(sizeToRead));
             m_algorithm->Decrypt(&context, m_stream, pBuffer, static_cast<size_t>(sizeToRead));
+            if (span.Enabled())
+            {
+                // Reading a whole resource at once decrypts it in one pass,
+                // checking its authentication tag when there is one
+                bool wholeResource = (m_readPosition == 0 && static_cast<size_t>(sizeToRead) == m_algorithm->PlainTextSize(m_stream));
+                span.SetAttribute("algorithm", m_algorithm->Name());
+                span.SetAttribute("position", std::to_string(m_readPosition));
+                span.SetAttribute("length", std::to_string(sizeToRead));
+                span.SetAttribute("wholeResource", wholeResource ? "true" : "false");
+            }
             m_readPosition += sizeToRead;
         }
         catch (const CryptoPP::Exception & ex)
@@ -86,4 +105,9 @@ namespace lcp
     {
         return m_stream->Size();
     }
+
+    IDecryptor * SymmetricAlgorithmEncryptedStream::CreateDecryptor(IWritableStream * output)
+    {
+        return m_algorithm->CreateDecryptor(output);
+    }
 }
@@ -32,15 +32,24 @@
 #include "public/StreamInterfaces.h"
 #include "CryptoAlgorithmInterfaces.h"
 #include "NonCopyable.h"
+#include "public/ITraceSink.h"
 
 namespace lcp
 {
+    class Statistics;
+
+    //
+    // Decrypts a resource by ranges, as it is read. Reads are recorded in
+    // the statistics current when the stream is created, since streams are
+    // read by the threads of the client.
+    //
     class SymmetricAlgorithmEncryptedStream : public IEncryptedStream, public NonCopyable
     {
     public:
         SymmetricAlgorithmEncryptedStream(
             IReadableStream * stream,
-            std::unique_ptr<ISymmetricAlgorithm> algorithm
+            std::unique_ptr<ISymmetricAlgorithm> algorithm,
+            ITraceSink * traceSink = nullptr
             );
 
         // IEncryptedStream
@@ -52,10 +61,19 @@ namespace lcp
         virtual int64_t ReadPosition() const;
         virtual int64_t Size();
 
+        //
+        // Decryptor of the whole stream, writing to the given output, or
+        // nullptr when the algorithm only decrypts by ranges.
+        // See ISymmetricAlgorithm::CreateDecryptor().
+        //
+        IDecryptor * CreateDecryptor(IWritableStream * output);
+
     private:
         int64_t m_readPosition;
         IReadableStream * m_stream;
         std::unique_ptr<ISymmetricAlgorithm> m_algorithm;
+        ITraceSink * m_traceSink;
+        Statistics * m_statistics;
     };
 }
 
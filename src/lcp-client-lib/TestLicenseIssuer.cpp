@@ -0,0 +1,322 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#if ENABLE_TEST_LICENSE_ISSUER
+
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include "TestLicenseIssuer.h"
+#include "AlgorithmNames.h"
+#include "CryptoAlgorithmInterfaces.h"
+#include "CryptoppUtils.h"
+#include "IEncryptionProfile.h"
+#include "IncludeMacros.h"
+#include "JsonCanonicalizer.h"
+#include "JsonValueReader.h"
+#include "SimpleMemoryWritableStream.h"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "time64/time64.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/asn.h>
+#include <cryptopp/base64.h>
+#include <cryptopp/oids.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/rsa.h>
+#include <cryptopp/sha.h>
+CRYPTOPP_INCLUDE_END
+
+using namespace CryptoPP;
+
+namespace
+{
+    using namespace lcp;
+
+    const int SecondsPerDay = 24 * 60 * 60;
+
+    OID Sha256WithRsaEncryption()
+    {
+        return ASN1::pkcs_1() + 11;
+    }
+
+    OID CommonName()
+    {
+        return OID(2) + 5 + 4 + 3;
+    }
+
+    std::string ToBase64(const byte * data, size_t size)
+    {
+        std::string base64;
+        StringSource source(data, size, true, new Base64Encoder(new StringSink(base64), false));
+        return base64;
+    }
+
+    std::string ToBase64(ByteQueue & queue)
+    {
+        std::string raw;
+        queue.TransferTo(StringSink(raw).Ref());
+        return ToBase64(reinterpret_cast<const byte *>(raw.data()), raw.size());
+    }
+
+    //
+    // Formats an UTC time with a strftime() format.
+    //
+    std::string FormatTime(Time64_T time, const char * format)
+    {
+        TM tm;
+        gmtime64_r(&time, &tm);
+        struct tm standardTm = {};
+        standardTm.tm_year = static_cast<int>(tm.tm_year);
+        standardTm.tm_mon = tm.tm_mon;
+        standardTm.tm_mday = tm.tm_mday;
+        standardTm.tm_hour = tm.tm_hour;
+        standardTm.tm_min = tm.tm_min;
+        standardTm.tm_sec = tm.tm_sec;
+
+        char buffer[32] = {};
+        std::strftime(buffer, sizeof(buffer), format, &standardTm);
+        return buffer;
+    }
+
+    void EncodeAlgorithm(BufferedTransformation & parent)
+    {
+        DERSequenceEncoder algorithm(parent);
+        Sha256WithRsaEncryption().DEREncode(algorithm);
+        DEREncodeNull(algorithm);
+        algorithm.MessageEnd();
+    }
+
+    void EncodeName(BufferedTransformation & parent, const std::string & commonName)
+    {
+        DERSequenceEncoder name(parent);
+        {
+            DERSetEncoder relativeName(name);
+            {
+                DERSequenceEncoder attribute(relativeName);
+                CommonName().DEREncode(attribute);
+                DEREncodeTextString(attribute, commonName, UTF8_STRING);
+                attribute.MessageEnd();
+            }
+            relativeName.MessageEnd();
+        }
+        name.MessageEnd();
+    }
+
+    //
+    // DER encoded X.509 v3 certificate of the subject key, signed with the
+    // issuer key.
+    //
+    std::string CreateCertificate(
+        const RSA::PrivateKey & issuerKey,
+        const std::string & issuerName,
+        const RSA::PublicKey & subjectKey,
+        const std::string & subjectName,
+        word32 serialNumber
+        )
+    {
+        Time64_T now = std::time(nullptr);
+        std::string notBefore = FormatTime(now - SecondsPerDay, "%y%m%d%H%M%SZ");
+        std::string notAfter = FormatTime(now + TestLicenseIssuer::ValidityDays * static_cast<Time64_T>(SecondsPerDay), "%y%m%d%H%M%SZ");
+
+        ByteQueue toBeSigned;
+        DERSequenceEncoder toBeSignedCertificate(toBeSigned);
+        {
+            DERGeneralEncoder version(toBeSignedCertificate, CryptoppUtils::Cert::ContextSpecificTagZero);
+            DEREncodeUnsigned<word32>(version, 2);
+            version.MessageEnd();
+        }
+        DEREncodeUnsigned<word32>(toBeSignedCertificate, serialNumber);
+        EncodeAlgorithm(toBeSignedCertificate);
+        EncodeName(toBeSignedCertificate, issuerName);
+        {
+            DERSequenceEncoder validity(toBeSignedCertificate);
+            DEREncodeTextString(validity, notBefore, UTC_TIME);
+            DEREncodeTextString(validity, notAfter, UTC_TIME);
+            validity.MessageEnd();
+        }
+        EncodeName(toBeSignedCertificate, subjectName);
+        subjectKey.DEREncode(toBeSignedCertificate);
+        toBeSignedCertificate.MessageEnd();
+
+        std::string toBeSignedData;
+        toBeSigned.TransferTo(StringSink(toBeSignedData).Ref());
+
+        AutoSeededRandomPool rng;
+        RSASS<PKCS1v15, SHA256>::Signer signer(issuerKey);
+        SecByteBlock signature(signer.MaxSignatureLength());
+        size_t signatureLength = signer.SignMessage(
+            rng, reinterpret_cast<const byte *>(toBeSignedData.data()), toBeSignedData.size(), signature
+            );
+
+        ByteQueue certificate;
+        DERSequenceEncoder certificateSequence(certificate);
+        certificateSequence.Put(reinterpret_cast<const byte *>(toBeSignedData.data()), toBeSignedData.size());
+        EncodeAlgorithm(certificateSequence);
+        DEREncodeBitString(certificateSequence, signature.data(), signatureLength);
+        certificateSequence.MessageEnd();
+        return ToBase64(certificate);
+    }
+
+    rapidjson::Value StringValue(const std::string & value, rapidjson::Document::AllocatorType & allocator)
+    {
+        return rapidjson::Value(value.c_str(), static_cast<rapidjson::SizeType>(value.size()), allocator);
+    }
+
+    std::string Serialize(const rapidjson::Document & document)
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        document.Accept(writer);
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+}
+
+namespace lcp
+{
+    TestLicenseIssuer::TestLicenseIssuer(IEncryptionProfile * encryptionProfile, const TestAuthority & authority)
+        : m_encryptionProfile(encryptionProfile)
+        , m_authority(authority)
+    {
+    }
+
+    /*static*/ TestAuthority TestLicenseIssuer::CreateAuthority(const std::string & provider)
+    {
+        AutoSeededRandomPool rng;
+        RSA::PrivateKey rootKey;
+        rootKey.GenerateRandomWithKeySize(rng, KeySize);
+        RSA::PrivateKey providerKey;
+        providerKey.GenerateRandomWithKeySize(rng, KeySize);
+
+        TestAuthority authority;
+        authority.provider = provider;
+        authority.rootCertificate = CreateCertificate(rootKey, "Test Root CA", RSA::PublicKey(rootKey), "Test Root CA", 1);
+        authority.providerCertificate = CreateCertificate(rootKey, "Test Root CA", RSA::PublicKey(providerKey), provider, 2);
+
+        ByteQueue privateKey;
+        providerKey.DEREncode(privateKey);
+        authority.providerPrivateKey = ToBase64(privateKey);
+        return authority;
+    }
+
+    std::string TestLicenseIssuer::IssueLicense(const KeyType & contentKey, const TestLicenseInfo & licenseInfo)
+    {
+        std::unique_ptr<IHashAlgorithm> userKeyAlgorithm(m_encryptionProfile->CreateUserKeyAlgorithm());
+        userKeyAlgorithm->UpdateHash(licenseInfo.passphrase);
+        KeyType userKey = userKeyAlgorithm->Hash();
+
+        std::string id = CryptoppUtils::GenerateUuid();
+        std::string now = FormatTime(std::time(nullptr), "%Y-%m-%dT%H:%M:%SZ");
+        std::string contentKeyAlgorithm = m_encryptionProfile->ContentKeyAlgorithmCBC();
+#if ENABLE_PROFILE_NAMES
+        std::string profile = m_encryptionProfile->Name();
+#else
+        std::string profile = "http://readium.org/lcp/profile-1.0";
+#endif //ENABLE_PROFILE_NAMES
+
+        rapidjson::Document license(rapidjson::kObjectType);
+        rapidjson::Document::AllocatorType & allocator = license.GetAllocator();
+        license.AddMember("id", StringValue(id, allocator), allocator);
+        license.AddMember("issued", StringValue(now, allocator), allocator);
+        license.AddMember("updated", StringValue(now, allocator), allocator);
+        license.AddMember("provider", StringValue(m_authority.provider, allocator), allocator);
+
+        rapidjson::Value encryption(rapidjson::kObjectType);
+        encryption.AddMember("profile", StringValue(profile, allocator), allocator);
+        rapidjson::Value contentKeyObject(rapidjson::kObjectType);
+        contentKeyObject.AddMember("algorithm", StringValue(contentKeyAlgorithm, allocator), allocator);
+        contentKeyObject.AddMember("encrypted_value",
+            StringValue(this->EncryptBase64(userKey, std::string(contentKey.begin(), contentKey.end())), allocator), allocator);
+        encryption.AddMember("content_key", contentKeyObject, allocator);
+        rapidjson::Value userKeyObject(rapidjson::kObjectType);
+        userKeyObject.AddMember("algorithm", StringValue(m_encryptionProfile->UserKeyAlgorithm(), allocator), allocator);
+        userKeyObject.AddMember("text_hint", StringValue(licenseInfo.passphraseHint, allocator), allocator);
+        userKeyObject.AddMember("key_check", StringValue(this->EncryptBase64(userKey, id), allocator), allocator);
+        encryption.AddMember("user_key", userKeyObject, allocator);
+        license.AddMember("encryption", encryption, allocator);
+
+        rapidjson::Value links(rapidjson::kArrayType);
+        rapidjson::Value hintLink(rapidjson::kObjectType);
+        hintLink.AddMember("rel", "hint", allocator);
+        hintLink.AddMember("href", StringValue(m_authority.provider, allocator), allocator);
+        links.PushBack(hintLink, allocator);
+        rapidjson::Value publicationLink(rapidjson::kObjectType);
+        publicationLink.AddMember("rel", "publication", allocator);
+        publicationLink.AddMember("href", StringValue(licenseInfo.publicationHref, allocator), allocator);
+        publicationLink.AddMember("type", "application/epub+zip", allocator);
+        links.PushBack(publicationLink, allocator);
+        license.AddMember("links", links, allocator);
+
+        rapidjson::Value user(rapidjson::kObjectType);
+        user.AddMember("id", StringValue(licenseInfo.userId, allocator), allocator);
+        license.AddMember("user", user, allocator);
+
+        // The canonical form leaves the signature out
+        rapidjson::Value signature(rapidjson::kObjectType);
+        signature.AddMember("algorithm", StringValue(m_encryptionProfile->SignatureAlgorithmRSA(), allocator), allocator);
+        signature.AddMember("certificate", StringValue(m_authority.providerCertificate, allocator), allocator);
+        signature.AddMember("value", "", allocator);
+        license.AddMember("signature", signature, allocator);
+
+        JsonValueReader reader;
+        std::string canonicalLicense = JsonCanonicalizer(Serialize(license), &reader).CanonicalLicense();
+
+        SecByteBlock rawPrivateKey;
+        CryptoppUtils::Base64ToSecBlock(m_authority.providerPrivateKey, rawPrivateKey);
+        ByteQueue privateKeyQueue;
+        privateKeyQueue.Put(rawPrivateKey.data(), rawPrivateKey.size());
+        privateKeyQueue.MessageEnd();
+        RSA::PrivateKey providerKey;
+        providerKey.BERDecode(privateKeyQueue);
+
+        AutoSeededRandomPool rng;
+        RSASS<PKCS1v15, SHA256>::Signer signer(providerKey);
+        SecByteBlock signatureValue(signer.MaxSignatureLength());
+        size_t signatureLength = signer.SignMessage(
+            rng, reinterpret_cast<const byte *>(canonicalLicense.data()), canonicalLicense.size(), signatureValue
+            );
+        license["signature"]["value"] = StringValue(ToBase64(signatureValue.data(), signatureLength), allocator);
+        return Serialize(license);
+    }
+
+    std::string TestLicenseIssuer::EncryptBase64(const KeyType & key, const std::string & data)
+    {
+        std::unique_ptr<ISymmetricAlgorithm> algorithm(
+            m_encryptionProfile->CreateContentKeyAlgorithm(key, m_encryptionProfile->ContentKeyAlgorithmCBC())
+            );
+        SimpleMemoryWritableStream output;
+        std::unique_ptr<IEncryptor> encryptor(algorithm->CreateEncryptor(key, &output));
+        encryptor->Update(reinterpret_cast<const unsigned char *>(data.data()), data.size());
+        encryptor->Finish();
+        return ToBase64(output.Buffer().data(), output.Buffer().size());
+    }
+}
+
+#endif //ENABLE_TEST_LICENSE_ISSUER
@@ -0,0 +1,76 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#ifndef __TEST_LICENSE_ISSUER_H__
+#define __TEST_LICENSE_ISSUER_H__
+
+#if ENABLE_TEST_LICENSE_ISSUER
+
+#include <string>
+#include "public/LcpPackager.h"
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class IEncryptionProfile;
+
+    //
+    // Local certificate authority and issuer of License Documents, for
+    // tests and benchmarks. The root certificate is self-signed, the
+    // provider one is signed by the root key; both are X.509 v3
+    // certificates without extensions, so that the licenses they verify
+    // never trigger a CRL update. Licenses encrypt the content key with
+    // the user key of the profile and AES-CBC, and are signed with
+    // RSA-SHA256 over their canonical form.
+    //
+    class TestLicenseIssuer : public NonCopyable
+    {
+    public:
+        static const unsigned int KeySize = 2048;
+        static const int ValidityDays = 3650;
+
+    public:
+        TestLicenseIssuer(IEncryptionProfile * encryptionProfile, const TestAuthority & authority);
+
+        static TestAuthority CreateAuthority(const std::string & provider);
+
+        std::string IssueLicense(const KeyType & contentKey, const TestLicenseInfo & licenseInfo);
+
+    private:
+        std::string EncryptBase64(const KeyType & key, const std::string & data);
+
+    private:
+        IEncryptionProfile * m_encryptionProfile;
+        TestAuthority m_authority;
+    };
+}
+
+#endif //ENABLE_TEST_LICENSE_ISSUER
+
+#endif //__TEST_LICENSE_ISSUER_H__
@@ -0,0 +1,110 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __TRACE_SPAN_H__
+#define __TRACE_SPAN_H__
+
+#include <string>
+#include "public/ITraceSink.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    //
+    // Reports an operation to the trace sink, from its construction until
+    // its destruction or End(). Without a sink, only the sink pointer is
+    // tested: callers computing an attribute value should check Enabled()
+    // first, numbers are only formatted when there is a sink.
+    //
+    class TraceSpan : public NonCopyable
+    {
+    public:
+        TraceSpan(ITraceSink * sink, const char * name)
+            : m_sink(sink)
+            , m_name(name)
+            , m_id(0)
+        {
+            if (m_sink != nullptr)
+            {
+                this->Begin();
+            }
+        }
+
+        ~TraceSpan()
+        {
+            if (m_sink != nullptr)
+            {
+                this->End();
+            }
+        }
+
+        bool Enabled() const
+        {
+            return (m_sink != nullptr);
+        }
+
+        void SetAttribute(const char * name, const std::string & value)
+        {
+            if (m_sink != nullptr)
+            {
+                m_attributes.emplace_back(name, value);
+            }
+        }
+
+        void SetAttribute(const char * name, const char * value)
+        {
+            if (m_sink != nullptr)
+            {
+                m_attributes.emplace_back(name, value);
+            }
+        }
+
+        void SetAttribute(const char * name, int64_t value)
+        {
+            if (m_sink != nullptr)
+            {
+                m_attributes.emplace_back(name, std::to_string(value));
+            }
+        }
+
+        //
+        // Ends the span before the destruction, nothing is reported after.
+        //
+        void End();
+
+    private:
+        void Begin();
+
+    private:
+        ITraceSink * m_sink;
+        const char * m_name;
+        uint64_t m_id;
+        TraceAttributes m_attributes;
+    };
+}
+
+#endif //__TRACE_SPAN_H__
@@ -25,13 +25,20 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <memory>
 #include "UserLcpNode.h"
 #include "ContainerIterator.h"
 #include "JsonValueReader.h"
 #include "ICryptoProvider.h"
+#include "CryptoAlgorithmInterfaces.h"
 
 namespace lcp
 {
+    UserLcpNode::UserLcpNode()
+        : m_fieldsDecrypted(false)
+    {
+    }
+
     std::string UserLcpNode::Id() const
     {
         return m_userInfo.id;
@@ -79,20 +86,43 @@ namespace lcp
 
     Status UserLcpNode::DecryptNode(ILicense * license, IKeyProvider * keyProvider, ICryptoProvider * cryptoProvider)
     {
-        for (auto it = m_userInfo.encrypted.begin(); it != m_userInfo.encrypted.end(); ++it)
+        if (!m_fieldsDecrypted && !m_userInfo.encrypted.empty())
         {
-            auto valueIt = m_userInfo.valuesMap.find(*it);
-            if (valueIt == m_userInfo.valuesMap.end())
+            ISymmetricAlgorithm * algorithm = nullptr;
+            Status res = cryptoProvider->CreateLicenseDataAlgorithm(license, keyProvider, &algorithm);
+            if (!Status::IsSuccess(res))
             {
-                throw std::runtime_error("encrypted user field not found");
+                return res;
             }
+            std::unique_ptr<ISymmetricAlgorithm> fieldsAlgorithm(algorithm);
 
-            Status res = cryptoProvider->DecryptLicenseData(valueIt->second, license, keyProvider, valueIt->second);
-            if (!Status::IsSuccess(res))
-                return res;
+            // Applied once every field is decrypted
+            StringsMap decrypted;
+            for (auto it = m_userInfo.encrypted.begin(); it != m_userInfo.encrypted.end(); ++it)
+            {
+                auto valueIt = m_userInfo.valuesMap.find(*it);
+                if (valueIt == m_userInfo.valuesMap.end())
+                {
+                    throw std::runtime_error("encrypted user field not found");
+                }
 
-            this->FillRegisteredFields(valueIt->first, valueIt->second);
+                try
+                {
+                    decrypted[*it] = fieldsAlgorithm->Decrypt(valueIt->second);
+                }
+                catch (const std::exception & ex)
+                {
+                    return Status(StatusCode::ErrorDecryptionLicenseEncrypted, "ErrorDecryptionLicenseEncrypted: " + std::string(ex.what()));
+                }
+            }
+
+            for (auto it = decrypted.begin(); it != decrypted.end(); ++it)
+            {
+                m_userInfo.valuesMap[it->first] = it->second;
+                this->FillRegisteredFields(it->first, it->second);
+            }
         }
+        m_fieldsDecrypted = true;
 
 #if ENABLE_GENERIC_JSON_NODE
         return BaseLcpNode::DecryptNode(license, keyProvider, cryptoProvider);
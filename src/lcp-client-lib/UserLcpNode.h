@@ -45,8 +45,16 @@ namespace lcp
         StringsMap valuesMap;
     };
 
+    //
+    // Encrypted user fields are decrypted with a single symmetric algorithm
+    // instance created for the License. A field which does not decrypt fails
+    // the decryption of the License, leaving every field as it was.
+    //
     class UserLcpNode : public BaseLcpNode, public IUser
     {
+    public:
+        UserLcpNode();
+
     public:
         // ILcpNode
         virtual void ParseNode(const rapidjson::Value & parentObject, JsonValueReader * reader);
@@ -67,6 +75,7 @@ namespace lcp
 
     private:
         UserInfo m_userInfo;
+        bool m_fieldsDecrypted;
     };
 }
 
@@ -0,0 +1,269 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <memory>
+#include <stdexcept>
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "VerificationCache.h"
+#include "CryptoppUtils.h"
+#include "Sha256HashAlgorithm.h"
+#include "public/IFileSystemProvider.h"
+#include "public/IStorageProvider.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/osrng.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcp
+{
+    /*static*/ const char * VerificationCache::MacKeyName = "macKey";
+    /*static*/ const size_t VerificationCache::MacKeySize = 32;
+
+    VerificationCache::VerificationCache(
+        IStorageProvider * storageProvider,
+        IFileSystemProvider * fileSystemProvider,
+        const std::string & cachePath
+        )
+        : m_storageProvider(storageProvider)
+        , m_fileSystemProvider(fileSystemProvider)
+        , m_cachePath(cachePath)
+    {
+        if (m_storageProvider == nullptr)
+        {
+            throw std::invalid_argument("StorageProvider is nullptr");
+        }
+        if (m_fileSystemProvider == nullptr)
+        {
+            throw std::invalid_argument("FileSystemProvider is nullptr");
+        }
+    }
+
+    void VerificationCache::Load()
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        this->LoadMacKey();
+        m_entries.clear();
+
+        std::string content;
+        try
+        {
+            std::unique_ptr<IFile> cacheFile(m_fileSystemProvider->GetFile(m_cachePath, IFileSystemProvider::ReadOnly));
+            int64_t size = cacheFile->Size();
+            if (size <= 0)
+            {
+                return;
+            }
+            content.resize(static_cast<size_t>(size));
+            cacheFile->SetReadPosition(0);
+            cacheFile->Read(reinterpret_cast<unsigned char *>(&content[0]), size);
+        }
+        catch (const std::exception &)
+        {
+            // No cache written yet
+            return;
+        }
+
+        size_t lines = 0;
+        size_t begin = 0;
+        while (begin < content.size())
+        {
+            size_t end = content.find('\n', begin);
+            if (end == std::string::npos)
+            {
+                end = content.size();
+            }
+
+            std::string canonicalDigest;
+            Entry entry;
+            if (this->ReadRecord(content.substr(begin, end - begin), canonicalDigest, entry))
+            {
+                m_entries[canonicalDigest] = entry;
+            }
+            ++lines;
+            begin = end + 1;
+        }
+
+        if (lines > m_entries.size())
+        {
+            try
+            {
+                this->Save();
+            }
+            catch (const std::exception &)
+            {
+                // Compacted on the next load
+            }
+        }
+    }
+
+    bool VerificationCache::Find(const std::string & canonicalDigest, Entry & entry) const
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        auto it = m_entries.find(canonicalDigest);
+        if (it == m_entries.end())
+        {
+            return false;
+        }
+        entry = it->second;
+        return true;
+    }
+
+    void VerificationCache::Store(const std::string & canonicalDigest, const Entry & entry)
+    {
+        std::unique_lock<std::mutex> locker(m_sync);
+        m_entries[canonicalDigest] = entry;
+        this->Append(canonicalDigest, entry);
+    }
+
+    /*static*/ std::string VerificationCache::Digest(const std::string & data)
+    {
+        Sha256HashAlgorithm sha256;
+        sha256.UpdateHash(data);
+        return CryptoppUtils::RawToHex(sha256.Hash());
+    }
+
+    void VerificationCache::Save()
+    {
+        std::string content;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            content += this->Record(it->first, it->second);
+        }
+
+        // Written aside then renamed, the records in place are kept if
+        // the compaction is interrupted
+        std::string tempPath = m_cachePath + ".tmp";
+        std::unique_ptr<IFile> cacheFile(m_fileSystemProvider->GetFile(tempPath, IFileSystemProvider::CreateNew));
+        cacheFile->Write(reinterpret_cast<const unsigned char *>(content.data()), content.size());
+        cacheFile->Flush();
+        cacheFile.reset();
+        m_fileSystemProvider->RenameFile(tempPath, m_cachePath);
+    }
+
+    void VerificationCache::Append(const std::string & canonicalDigest, const Entry & entry)
+    {
+        std::unique_ptr<IFile> cacheFile;
+        try
+        {
+            cacheFile.reset(m_fileSystemProvider->GetFile(m_cachePath, IFileSystemProvider::ReadWrite));
+        }
+        catch (const std::exception &)
+        {
+            // No cache written yet
+        }
+        if (!cacheFile)
+        {
+            cacheFile.reset(m_fileSystemProvider->GetFile(m_cachePath, IFileSystemProvider::CreateNew));
+        }
+
+        std::string record = this->Record(canonicalDigest, entry);
+        cacheFile->SetWritePosition(cacheFile->Size());
+        cacheFile->Write(reinterpret_cast<const unsigned char *>(record.data()), record.size());
+    }
+
+    std::string VerificationCache::Record(const std::string & canonicalDigest, const Entry & entry) const
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("license");
+        writer.String(canonicalDigest.c_str());
+        writer.Key("root");
+        writer.String(entry.rootCertificateDigest.c_str());
+        writer.Key("provider");
+        writer.String(entry.providerCertificateDigest.c_str());
+        writer.Key("crl");
+        writer.String(entry.crlVersion.c_str());
+        writer.EndObject();
+
+        std::string json(buffer.GetString(), buffer.GetSize());
+        return this->CalculateMac(json) + " " + json + "\n";
+    }
+
+    bool VerificationCache::ReadRecord(const std::string & line, std::string & canonicalDigest, Entry & entry) const
+    {
+        size_t pos = line.find(' ');
+        if (pos == std::string::npos)
+        {
+            return false;
+        }
+        std::string mac = line.substr(0, pos);
+        std::string json = line.substr(pos + 1);
+        std::string expectedMac = this->CalculateMac(json);
+        if (mac.size() != expectedMac.size() || !CryptoPP::VerifyBufsEqual(
+            reinterpret_cast<const byte *>(mac.data()), reinterpret_cast<const byte *>(expectedMac.data()), mac.size()))
+        {
+            return false;
+        }
+
+        rapidjson::Document document;
+        if (document.Parse(json.c_str()).HasParseError() || !document.IsObject())
+        {
+            return false;
+        }
+        for (const char * name : { "license", "root", "provider", "crl" })
+        {
+            if (!document.HasMember(name) || !document[name].IsString())
+            {
+                return false;
+            }
+        }
+
+        canonicalDigest = document["license"].GetString();
+        entry.rootCertificateDigest = document["root"].GetString();
+        entry.providerCertificateDigest = document["provider"].GetString();
+        entry.crlVersion = document["crl"].GetString();
+        return true;
+    }
+
+    void VerificationCache::LoadMacKey()
+    {
+        std::string macKeyHex = m_storageProvider->GetValue(VerificationCacheVaultId, MacKeyName);
+        if (!macKeyHex.empty())
+        {
+            m_macKey = CryptoppUtils::HexToRaw(macKeyHex);
+            return;
+        }
+
+        // The key never leaves the secure storage of this device
+        AutoSeededRandomPool rnd;
+        m_macKey.resize(MacKeySize);
+        rnd.GenerateBlock(m_macKey.data(), m_macKey.size());
+        m_storageProvider->SetValue(VerificationCacheVaultId, MacKeyName, CryptoppUtils::RawToHex(m_macKey));
+    }
+
+    std::string VerificationCache::CalculateMac(const std::string & content) const
+    {
+        CryptoPP::HMAC<CryptoPP::SHA256> hmac(m_macKey.data(), m_macKey.size());
+        Buffer mac(hmac.DigestSize());
+        hmac.CalculateDigest(mac.data(), reinterpret_cast<const byte *>(content.data()), content.size());
+        return CryptoppUtils::RawToHex(mac);
+    }
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __VERIFICATION_CACHE_H__
+#define __VERIFICATION_CACHE_H__
+
+#include <map>
+#include <mutex>
+#include "LcpTypedefs.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class IStorageProvider;
+    class IFileSystemProvider;
+
+    //
+    // On-disk cache of successful License verifications, keyed by the digest
+    // of the License canonical form. An entry records the certificates and the
+    // CRL the License was verified against, so the signature checks can be
+    // skipped as long as they don't change.
+    // Each verification appends a line to the cache file, authenticated
+    // with a HMAC whose key is kept in the IStorageProvider: lines copied
+    // from another device or edited are discarded. The lines superseded by
+    // later ones are dropped when the cache is loaded, the others are written
+    // to a temporary file renamed over the cache.
+    //
+    class VerificationCache : public NonCopyable
+    {
+    public:
+        struct Entry
+        {
+            std::string rootCertificateDigest;
+            std::string providerCertificateDigest;
+            std::string crlVersion;
+        };
+
+    public:
+        VerificationCache(
+            IStorageProvider * storageProvider,
+            IFileSystemProvider * fileSystemProvider,
+            const std::string & cachePath
+            );
+
+        void Load();
+        bool Find(const std::string & canonicalDigest, Entry & entry) const;
+        void Store(const std::string & canonicalDigest, const Entry & entry);
+
+        static std::string Digest(const std::string & data);
+
+    private:
+        void Save();
+        void Append(const std::string & canonicalDigest, const Entry & entry);
+        std::string Record(const std::string & canonicalDigest, const Entry & entry) const;
+        bool ReadRecord(const std::string & line, std::string & canonicalDigest, Entry & entry) const;
+        void LoadMacKey();
+        std::string CalculateMac(const std::string & content) const;
+
+    private:
+        IStorageProvider * m_storageProvider;
+        IFileSystemProvider * m_fileSystemProvider;
+        std::string m_cachePath;
+
+        KeyType m_macKey;
+        std::map<std::string, Entry> m_entries;
+        mutable std::mutex m_sync;
+
+        static const char * MacKeyName;
+        static const size_t MacKeySize;
+    };
+}
+
+#endif //__VERIFICATION_CACHE_H__
@@ -0,0 +1,267 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include "WorkerPool.h"
+#include "Statistics.h"
+
+namespace lcp
+{
+    namespace
+    {
+        // Pool and index of the worker running on the current thread
+        thread_local const void * CurrentPool = nullptr;
+        thread_local size_t CurrentIndex = 0;
+    }
+
+    WorkerPool::WorkerPool(size_t maxThreads, Statistics * statistics)
+        : m_nextWorker(0)
+        , m_statistics(statistics)
+        , m_runningLowerTasks(0)
+        , m_stopping(false)
+        , m_sleepingWorkers(0)
+    {
+        maxThreads = std::max<size_t>(maxThreads, 1);
+        // A worker is left to the interactive lane when there are several
+        m_maxLowerTasks = std::max<size_t>(maxThreads - 1, 1);
+        for (size_t lane = 0; lane < LanesCount; ++lane)
+        {
+            m_queuedTasks[lane] = 0;
+        }
+        for (size_t i = 0; i < maxThreads; ++i)
+        {
+            m_workers.emplace_back(new Worker());
+        }
+        for (size_t i = 0; i < maxThreads; ++i)
+        {
+            m_workers[i]->thread = std::thread(&WorkerPool::WorkerThread, this, i);
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_stopping = true;
+        }
+        m_conditionTasks.notify_all();
+        for (auto & worker : m_workers)
+        {
+            worker->thread.join();
+        }
+    }
+
+    /*static*/ size_t WorkerPool::DefaultThreadsCount()
+    {
+        return std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    }
+
+    size_t WorkerPool::ThreadsCount() const
+    {
+        return m_workers.size();
+    }
+
+    void WorkerPool::Execute(std::function<void()> task)
+    {
+        this->Post(Interactive, std::move(task));
+    }
+
+    void WorkerPool::Post(Lane lane, std::function<void()> task)
+    {
+        size_t index = this->CurrentWorker();
+        if (index == m_workers.size())
+        {
+            index = m_nextWorker++ % m_workers.size();
+        }
+
+        Worker & worker = *m_workers[index];
+        {
+            std::unique_lock<std::mutex> workerLocker(worker.sync);
+            worker.tasks[lane].push_back(std::move(task));
+        }
+        ++m_queuedTasks[lane];
+        this->WakeWorker();
+    }
+
+    void WorkerPool::WorkerThread(size_t index)
+    {
+        CurrentPool = this;
+        CurrentIndex = index;
+        Statistics::Scope statisticsScope(m_statistics);
+
+        while (true)
+        {
+            size_t lane = 0;
+            std::function<void()> task;
+            if (this->TakeTask(index, lane, task))
+            {
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    // Tasks report their own failures
+                }
+                task = nullptr;
+                this->ReleaseLane(lane);
+                continue;
+            }
+
+            // A task queued after the scan is seen here, or its poster sees
+            // this worker sleeping and wakes it up
+            std::unique_lock<std::mutex> locker(m_sync);
+            ++m_sleepingWorkers;
+            bool canTake = false;
+            for (size_t i = 0; i < LanesCount; ++i)
+            {
+                canTake = canTake || this->CanTakeLane(i);
+            }
+            if (!canTake)
+            {
+                if (m_stopping && std::all_of(m_queuedTasks, m_queuedTasks + LanesCount, [](const std::atomic<int64_t> & count) { return count <= 0; }))
+                {
+                    --m_sleepingWorkers;
+                    return;
+                }
+                m_conditionTasks.wait(locker);
+            }
+            --m_sleepingWorkers;
+        }
+    }
+
+    bool WorkerPool::CanTakeLane(size_t lane) const
+    {
+        if (m_queuedTasks[lane] <= 0)
+        {
+            return false;
+        }
+        // Once stopping, the remaining tasks are run without limit
+        return (lane == Interactive || m_runningLowerTasks < m_maxLowerTasks || m_stopping);
+    }
+
+    bool WorkerPool::ReserveLane(size_t lane)
+    {
+        if (lane == Interactive)
+        {
+            return true;
+        }
+
+        size_t running = m_runningLowerTasks;
+        do
+        {
+            if (running >= m_maxLowerTasks && !m_stopping)
+            {
+                return false;
+            }
+        }
+        while (!m_runningLowerTasks.compare_exchange_weak(running, running + 1));
+        return true;
+    }
+
+    void WorkerPool::ReleaseLane(size_t lane)
+    {
+        if (lane == Interactive)
+        {
+            return;
+        }
+
+        --m_runningLowerTasks;
+        // A lower task may have been left waiting for this worker
+        if (m_queuedTasks[Prefetch] > 0 || m_queuedTasks[Background] > 0)
+        {
+            this->WakeWorker();
+        }
+    }
+
+    bool WorkerPool::TakeTask(size_t index, size_t & lane, std::function<void()> & task)
+    {
+        for (lane = 0; lane < LanesCount; ++lane)
+        {
+            if (m_queuedTasks[lane] <= 0 || !this->ReserveLane(lane))
+            {
+                continue;
+            }
+            if (this->PopTask(index, lane, task))
+            {
+                --m_queuedTasks[lane];
+                return true;
+            }
+            if (lane != Interactive)
+            {
+                --m_runningLowerTasks;
+            }
+        }
+        return false;
+    }
+
+    bool WorkerPool::PopTask(size_t index, size_t lane, std::function<void()> & task)
+    {
+        // The newest task of its own queue first, it is the most likely to
+        // be in cache, then the oldest task of another queue
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            Worker & worker = *m_workers[(index + i) % m_workers.size()];
+            std::unique_lock<std::mutex> workerLocker(worker.sync);
+            std::deque<std::function<void()>> & tasks = worker.tasks[lane];
+            if (tasks.empty())
+            {
+                continue;
+            }
+            if (i == 0)
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void WorkerPool::WakeWorker()
+    {
+        if (m_sleepingWorkers == 0)
+        {
+            return;
+        }
+        // Taking the lock waits for a worker about to sleep to be waiting
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+        }
+        m_conditionTasks.notify_one();
+    }
+
+    size_t WorkerPool::CurrentWorker() const
+    {
+        return (CurrentPool == this) ? CurrentIndex : m_workers.size();
+    }
+}
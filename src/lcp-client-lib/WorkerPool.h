@@ -0,0 +1,131 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "public/IExecutor.h"
+#include "NonCopyable.h"
+
+namespace lcp
+{
+    class Statistics;
+
+    //
+    // Work-stealing pool of worker threads, shared by the subsystems of a
+    // service. Each worker has its own queues: tasks submitted by a worker
+    // go to its queues, other tasks are spread over the queues in turn. A
+    // worker runs the newest task of its queue, and when it is empty takes
+    // the oldest task of another queue.
+    // Tasks are posted in priority lanes: a worker always takes a task of
+    // the highest lane queued, and the lower lanes never occupy every
+    // worker, so that interactive work doesn't wait behind background work.
+    // Taking a task only locks the queues, the pool lock is for the idle
+    // workers to sleep.
+    // Destroying the pool runs the queued tasks before joining the workers,
+    // so it must not be destroyed by one of its tasks. The workers record
+    // in the given statistics, which must outlive the pool.
+    //
+    class WorkerPool : public IExecutor, public NonCopyable
+    {
+    public:
+        enum Lane
+        {
+            // Work a user is waiting for, eg. decrypting for display
+            Interactive,
+            // Work anticipating a user request
+            Prefetch,
+            // Maintenance, eg. CRL updates or journal flushes
+            Background,
+
+            LanesCount
+        };
+
+    public:
+        explicit WorkerPool(size_t maxThreads = DefaultThreadsCount(), Statistics * statistics = nullptr);
+        ~WorkerPool();
+
+        //
+        // Runs the task in the interactive lane.
+        //
+        virtual void Execute(std::function<void()> task);
+
+        void Post(Lane lane, std::function<void()> task);
+
+        size_t ThreadsCount() const;
+
+        //
+        // One worker per hardware thread, at least two.
+        //
+        static size_t DefaultThreadsCount();
+
+    private:
+        struct Worker
+        {
+            std::deque<std::function<void()>> tasks[LanesCount];
+            std::mutex sync;
+            std::thread thread;
+        };
+
+        void WorkerThread(size_t index);
+        bool CanTakeLane(size_t lane) const;
+        bool ReserveLane(size_t lane);
+        void ReleaseLane(size_t lane);
+        bool TakeTask(size_t index, size_t & lane, std::function<void()> & task);
+        bool PopTask(size_t index, size_t lane, std::function<void()> & task);
+        void WakeWorker();
+        size_t CurrentWorker() const;
+
+    private:
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::atomic<size_t> m_nextWorker;
+        Statistics * m_statistics;
+
+        // Count of the tasks in the queues of each lane, counted once
+        // queued and uncounted once taken: it is briefly off by the tasks
+        // in between, which the workers find on their next scan
+        std::atomic<int64_t> m_queuedTasks[LanesCount];
+        // Count of the tasks of the lower lanes running
+        std::atomic<size_t> m_runningLowerTasks;
+        size_t m_maxLowerTasks;
+        std::atomic<bool> m_stopping;
+        std::atomic<size_t> m_sleepingWorkers;
+        std::mutex m_sync;
+        std::condition_variable m_conditionTasks;
+    };
+}
+
+#endif //__WORKER_POOL_H__
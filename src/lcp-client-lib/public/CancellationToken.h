@@ -0,0 +1,66 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __CANCELLATION_TOKEN_H__
+#define __CANCELLATION_TOKEN_H__
+
+#include <atomic>
+
+namespace lcp
+{
+    //
+    // Given to an asynchronous operation to cancel it. An operation which
+    // has not begun yet when the token is canceled ends with
+    // ErrorCommonOperationCanceled, long operations also check it while
+    // they run. The token must outlive the operations it is given to.
+    //
+    class CancellationToken
+    {
+    public:
+        CancellationToken()
+            : m_canceled(false)
+        {
+        }
+
+        CancellationToken(const CancellationToken &) = delete;
+        CancellationToken & operator=(const CancellationToken &) = delete;
+
+        void Cancel()
+        {
+            m_canceled = true;
+        }
+
+        bool IsCanceled() const
+        {
+            return m_canceled;
+        }
+
+    private:
+        std::atomic<bool> m_canceled;
+    };
+}
+
+#endif //__CANCELLATION_TOKEN_H__
@@ -28,11 +28,26 @@
 #ifndef __DEFAULT_FILE_SYSTEM_PROVIDER_H__
 #define __DEFAULT_FILE_SYSTEM_PROVIDER_H__
 
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <errno.h>
 #include <stdexcept>
 #include <cstring>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "IFileSystemProvider.h"
 
 namespace lcp
@@ -49,7 +64,7 @@ namespace lcp
                                          (std::ios::in | std::ios::out | std::fstream::trunc | std::ios::binary) :
                                          ((openMode == IFileSystemProvider::ReadOnly) ?
                                               (std::ios::in  | std::ios::binary) :
-                                              std::ios::binary)
+                                              (std::ios::in | std::ios::out | std::ios::binary))
             );
 
             if (!m_fstream.is_open())
@@ -130,6 +145,15 @@ namespace lcp
             return m_fstream.tellg();
         }
 
+        virtual void Flush()
+        {
+            m_fstream.flush();
+            if (m_fstream.bad())
+            {
+                this->ThrowError("Can not flush file: ");
+            }
+        }
+
         ~DefaultFile()
         {
             m_fstream.close();
@@ -171,6 +195,93 @@ namespace lcp
         {
             return new DefaultFile(path, openMode);
         }
+
+        virtual void MakeDirectory(const std::string & path)
+        {
+#if defined(_WIN32)
+            int result = _mkdir(path.c_str());
+#else
+            int result = mkdir(path.c_str(), 0755);
+#endif
+            if (result != 0 && errno != EEXIST)
+            {
+                std::stringstream strm;
+                strm << "Can not create directory: " << path << "; " << std::strerror(errno);
+                throw std::runtime_error(strm.str());
+            }
+        }
+
+        virtual void RemoveFile(const std::string & path)
+        {
+            std::remove(path.c_str());
+        }
+
+        virtual void RenameFile(const std::string & oldPath, const std::string & newPath)
+        {
+            // The content must reach the disk before it replaces the file,
+            // otherwise a power loss can leave an empty file under newPath
+            this->SyncFile(oldPath);
+#if defined(_WIN32)
+            // rename() does not replace an existing file on Windows
+            if (!::MoveFileExA(oldPath.c_str(), newPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            {
+                std::stringstream strm;
+                strm << "Can not rename file: " << oldPath << " to " << newPath << "; error " << ::GetLastError();
+                throw std::runtime_error(strm.str());
+            }
+#else
+            if (std::rename(oldPath.c_str(), newPath.c_str()) != 0)
+            {
+                std::stringstream strm;
+                strm << "Can not rename file: " << oldPath << " to " << newPath << "; " << std::strerror(errno);
+                throw std::runtime_error(strm.str());
+            }
+
+            // Makes the new directory entry durable as well
+            std::string::size_type separator = newPath.find_last_of('/');
+            std::string directory = (separator == std::string::npos) ? "." : newPath.substr(0, separator + 1);
+            int directoryHandle = ::open(directory.c_str(), O_RDONLY);
+            if (directoryHandle != -1)
+            {
+                ::fsync(directoryHandle);
+                ::close(directoryHandle);
+            }
+#endif
+        }
+
+    private:
+        void SyncFile(const std::string & path)
+        {
+#if defined(_WIN32)
+            HANDLE handle = ::CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            bool synced = (handle != INVALID_HANDLE_VALUE && ::FlushFileBuffers(handle));
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                ::CloseHandle(handle);
+            }
+            if (!synced)
+            {
+                std::stringstream strm;
+                strm << "Can not sync file: " << path << "; error " << ::GetLastError();
+                throw std::runtime_error(strm.str());
+            }
+#else
+            int handle = ::open(path.c_str(), O_RDWR);
+            bool synced = (handle != -1 && ::fsync(handle) == 0);
+            int error = errno;
+            if (handle != -1)
+            {
+                ::close(handle);
+            }
+            if (!synced)
+            {
+                std::stringstream strm;
+                strm << "Can not sync file: " << path << "; " << std::strerror(error);
+                throw std::runtime_error(strm.str());
+            }
+#endif
+        }
     };
 }
 
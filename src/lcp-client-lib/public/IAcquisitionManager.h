@@ -0,0 +1,118 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __I_ACQUISITION_MANAGER_H__
+#define __I_ACQUISITION_MANAGER_H__
+
+#if ENABLE_NET_PROVIDER_ACQUISITION
+
+#include <cstdint>
+#include <string>
+#include "LcpStatus.h"
+
+namespace lcp
+{
+    class ILicense;
+    class IAcquisitionCallback;
+    class IAcquisitionManager;
+
+    //
+    // Implement this interface to follow the acquisitions of an
+    // IAcquisitionManager as a whole.
+    //
+    class IAcquisitionManagerCallback
+    {
+    public:
+        //
+        // Called when any queued acquisition progresses. The progress covers
+        // every acquisition queued since the manager was last idle, ended
+        // ones counting as complete.
+        //
+        virtual void OnQueueProgressed(IAcquisitionManager * manager, float progress) = 0;
+
+        //
+        // Called when the last queued acquisition ends.
+        //
+        virtual void OnQueueIdle(IAcquisitionManager * manager) = 0;
+
+        virtual ~IAcquisitionManagerCallback() {}
+    };
+
+    //
+    // Queues publication acquisitions and runs a bounded number of them at
+    // once, highest priority first. An acquisition with a higher priority
+    // than a running one, when no slot is free, pauses it: the paused
+    // acquisition resumes later from what it already received.
+    // Acquisitions are identified by their publication path.
+    //
+    // @see LcpService::CreateAcquisitionManager()
+    //
+    class IAcquisitionManager
+    {
+    public:
+        enum Priority
+        {
+            Background,
+            Normal,
+            UserInitiated,
+        };
+
+    public:
+        //
+        // Queues the acquisition of the License publication to the given
+        // path. The callback is notified as with IAcquisition::Start(), the
+        // License must outlive the acquisition.
+        // Queuing a path already queued or running adds the callback to the
+        // existing acquisition, raising its priority when needed.
+        //
+        virtual Status Enqueue(
+            ILicense * license,
+            const std::string & publicationPath,
+            Priority priority,
+            IAcquisitionCallback * callback
+            ) = 0;
+
+        virtual Status SetPriority(const std::string & publicationPath, Priority priority) = 0;
+
+        //
+        // Cancels a queued or running acquisition, its callbacks are
+        // notified with OnAcquisitionCanceled().
+        //
+        virtual Status Cancel(const std::string & publicationPath) = 0;
+
+        //
+        // Bytes per second shared by all the running acquisitions, 0 for no
+        // limit.
+        //
+        virtual void SetBandwidthBudget(int64_t bytesPerSecond) = 0;
+
+        virtual ~IAcquisitionManager() {}
+    };
+}
+
+#endif //ENABLE_NET_PROVIDER_ACQUISITION
+
+#endif //__I_ACQUISITION_MANAGER_H__
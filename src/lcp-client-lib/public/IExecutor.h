@@ -0,0 +1,66 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __I_EXECUTOR_H__
+#define __I_EXECUTOR_H__
+
+#include <functional>
+
+namespace lcp
+{
+    //
+    // Interface which may be implemented by the client to run the
+    // asynchronous operations of the service on its own threads. By
+    // default, the service runs them on a pool of worker threads.
+    //
+    class IExecutor
+    {
+    public:
+        //
+        // Runs the task, on any thread. The task may be run before Execute()
+        // returns.
+        //
+        virtual void Execute(std::function<void()> task) = 0;
+
+        virtual ~IExecutor() {}
+    };
+
+    //
+    // Runs each task on the calling thread, before returning. Asynchronous
+    // operations then complete in the order they are called, which makes
+    // them deterministic in tests.
+    //
+    class InlineExecutor : public IExecutor
+    {
+    public:
+        virtual void Execute(std::function<void()> task)
+        {
+            task();
+        }
+    };
+}
+
+#endif //__I_EXECUTOR_H__
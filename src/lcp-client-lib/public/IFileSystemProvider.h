@@ -28,6 +28,7 @@
 #ifndef __I_FILE_SYSTEM_H__
 #define __I_FILE_SYSTEM_H__
 
+#include <memory>
 #include <string>
 #include "StreamInterfaces.h"
 
@@ -48,6 +49,9 @@ namespace lcp
         {
             CreateNew,
             ReadOnly,
+            // Opens an existing file for reading and writing, keeping its
+            // content
+            ReadWrite,
         };
 
     public:
@@ -55,6 +59,31 @@ namespace lcp
         // Opens a new IO stream to the given absolute path.
         //
         virtual IFile * GetFile(const std::string & path, OpenMode openMode = CreateNew) = 0;
+
+        //
+        // Creates a directory at the given absolute path, whose parent
+        // exists. Nothing is done if the directory exists already.
+        // Used when exporting a publication to a directory, the default
+        // implementation does nothing.
+        //
+        virtual void MakeDirectory(const std::string & path) {}
+
+        //
+        // Removes the file at the given absolute path, if any. Used to
+        // clean up staged and temporary files, so it must not throw.
+        // The default implementation does nothing.
+        //
+        virtual void RemoveFile(const std::string & path) {}
+
+        //
+        // Replaces the file at newPath, if any, with the one at oldPath.
+        // Used to rewrite journals and caches atomically, through a
+        // temporary file, so implementations should make the content of
+        // oldPath durable before it replaces newPath. The default
+        // implementation copies the content with GetFile, which is not
+        // atomic, then calls RemoveFile.
+        //
+        virtual void RenameFile(const std::string & oldPath, const std::string & newPath);
         
         virtual ~IFileSystemProvider() {}
     };
@@ -69,9 +98,38 @@ namespace lcp
         // Returns the absolute path to the file.
         //
         virtual std::string Path() const = 0;
+
+        //
+        // Pushes the data written so far to the file system, so that it
+        // outlives the process even when the file is not closed. Used to
+        // make journals durable, the default implementation does nothing
+        // for files writing through.
+        //
+        virtual void Flush() {}
         
         virtual ~IFile() {}
     };
+
+    inline void IFileSystemProvider::RenameFile(const std::string & oldPath, const std::string & newPath)
+    {
+        {
+            std::unique_ptr<IFile> oldFile(this->GetFile(oldPath, ReadOnly));
+            std::unique_ptr<IFile> newFile(this->GetFile(newPath, CreateNew));
+
+            unsigned char buffer[16 * 1024];
+            int64_t size = oldFile->Size();
+            oldFile->SetReadPosition(0);
+            for (int64_t pos = 0; pos < size; )
+            {
+                int64_t chunkSize = (size - pos < static_cast<int64_t>(sizeof(buffer))) ? (size - pos) : sizeof(buffer);
+                oldFile->Read(buffer, chunkSize);
+                newFile->Write(buffer, chunkSize);
+                pos += chunkSize;
+            }
+            newFile->Flush();
+        }
+        this->RemoveFile(oldPath);
+    }
 }
 
 #endif //__I_FILE_SYSTEM_H__
@@ -27,6 +27,7 @@
 #ifndef __I_LCP_SERVICE_H__
 #define __I_LCP_SERVICE_H__
 
+#include <functional>
 #include <string>
 #include "LcpStatus.h"
 
@@ -41,10 +42,14 @@ namespace lcp
 #if ENABLE_NET_PROVIDER_ACQUISITION
     class IAcquisition;
     class IAcquisitionCallback;
+    class IAcquisitionManager;
+    class IAcquisitionManagerCallback;
 #endif //ENABLE_NET_PROVIDER_ACQUISITION
     class IRightsService;
     class IReadableStream;
     class IEncryptedStream;
+    struct StatisticsSnapshot;
+    class CancellationToken;
 
     class IClientProvider
     {
@@ -167,6 +172,64 @@ namespace lcp
             ) = 0;
         virtual Status DecryptFile(const std::string & licenseJson, const std::string & file_in, const std::string & file_out) = 0;
 
+        //
+        // Asynchronous variants of OpenLicense(), DecryptLicense() and
+        // DecryptFile(), for callers which must not block on the crypto.
+        // They run on the executor given to LcpServiceCreator, or in the
+        // interactive lane of the worker pool of the service, ahead of its
+        // background work. The callback is called on the thread running the
+        // operation. An operation whose token is canceled before it begins
+        // ends with ErrorCommonOperationCanceled, and so does DecryptFileAsync
+        // canceled while it runs, which then removes file_out. Destroying
+        // the service waits for the pending operations, so a callback must
+        // not do it.
+        //
+        typedef std::function<void(const Status & result, ILicense * license)> OpenLicenseCallback;
+        typedef std::function<void(const Status & result)> CompletionCallback;
+
+        virtual void OpenLicenseAsync(
+                const std::string & publicationPath,
+                const std::string & licenseJson,
+                OpenLicenseCallback callback,
+                CancellationToken * cancellation = nullptr) = 0;
+        virtual void DecryptLicenseAsync(
+                ILicense * license,
+                const std::string & userPassphrase,
+                CompletionCallback callback,
+                CancellationToken * cancellation = nullptr) = 0;
+        virtual void DecryptFileAsync(
+                const std::string & licenseJson,
+                const std::string & file_in,
+                const std::string & file_out,
+                CompletionCallback callback,
+                CancellationToken * cancellation = nullptr) = 0;
+
+        //
+        // Writes the cleartext of a whole publication protected by the given
+        // decrypted License, for offline processing such as indexing or
+        // conversion. The target is a directory, created if needed, or a new
+        // EPUB at outputPath. The entries encrypted by LCP are decrypted and
+        // inflated in parallel on the worker pool of the service, the others
+        // are copied. The optional progress callback is called after each
+        // exported entry, one call at a time, on the thread which exported
+        // it. A canceled export ends with ErrorCommonOperationCanceled.
+        //
+        enum ExportTarget
+        {
+            ExportToDirectory,
+            ExportToEpub
+        };
+
+        typedef std::function<void(size_t exportedEntries, size_t entriesCount)> ExportProgressCallback;
+
+        virtual Status ExportPublication(
+                ILicense * license,
+                const std::string & publicationPath,
+                const std::string & outputPath,
+                ExportTarget target,
+                ExportProgressCallback progress = ExportProgressCallback(),
+                CancellationToken * cancellation = nullptr) = 0;
+
 #if ENABLE_NET_PROVIDER_ACQUISITION
         //
         // Creates a new instance of IAcquisition to download the publication
@@ -181,8 +244,38 @@ namespace lcp
                 ILicense * license,
                 IAcquisition ** acquisition
         ) = 0;
+
+        //
+        // Creates a new IAcquisitionManager running at most the given number
+        // of acquisitions at once. The callback may be null.
+        //
+        virtual Status CreateAcquisitionManager(
+                size_t maxConcurrentAcquisitions,
+                IAcquisitionManagerCallback * callback,
+                IAcquisitionManager ** manager
+        ) = 0;
 #endif //ENABLE_NET_PROVIDER_ACQUISITION
 
+        //
+        // Enables the cache of License verification results, stored in the
+        // file at the given absolute path. Opening a License already verified
+        // with the same root and Content Provider certificates then skips the
+        // certificate and signature checks, the revocation check is still
+        // performed. The cache file is authenticated with a key kept in the
+        // storage provider. It should be called before opening any License.
+        //
+        virtual Status EnableVerificationCache(const std::string & cachePath) = 0;
+
+        //
+        // Reads the counters and operation latencies recorded by this
+        // service, to monitor where time goes: its calls, the work of its
+        // threads and the reads of the streams it creates. When reset is
+        // true, the values are zeroed as they are read, so that successive
+        // snapshots give the activity between two calls. Recording never
+        // waits for a reader.
+        //
+        virtual Status ReadStatistics(StatisticsSnapshot & snapshot, bool reset = false) = 0;
+
         //
         // Returns the rights service, exposing the public License rights API.
         //
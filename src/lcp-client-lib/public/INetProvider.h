@@ -29,6 +29,7 @@
 
 #if !DISABLE_NET_PROVIDER
 
+#include <cstdint>
 #include <string>
 #include "LcpStatus.h"
 
@@ -126,6 +127,54 @@ namespace lcp
         virtual std::string SuggestedFileName() const = 0;
         virtual void SetSuggestedFileName(const std::string & fileName) = 0;
     };
+
+    //
+    // A download request which can be made conditional on the copy the
+    // library already has. Net providers which support it should send
+    // IfNoneMatch and IfModifiedSince, when not empty, as the matching HTTP
+    // headers, and report the ETag and Last-Modified headers of the answer.
+    // A 304 answer ends the request successfully without data, after
+    // SetNotModified(true). Providers ignoring this interface keep working,
+    // the whole resource is then downloaded every time.
+    //
+    class IConditionalDownloadRequest : public IDownloadRequest
+    {
+    public:
+        virtual std::string IfNoneMatch() const = 0;
+        virtual std::string IfModifiedSince() const = 0;
+
+        virtual std::string ETag() const = 0;
+        virtual void SetETag(const std::string & etag) = 0;
+        virtual std::string LastModified() const = 0;
+        virtual void SetLastModified(const std::string & lastModified) = 0;
+        virtual bool NotModified() const = 0;
+        virtual void SetNotModified(bool value) = 0;
+    };
+
+    //
+    // A download request which can target a part of the resource, to resume
+    // a download or to split it over several connections. When the range is
+    // not the whole resource, net providers which support it should send a
+    // Range header for the bytes [RangeStart(), RangeEnd()), along with
+    // IfRange() as If-Range when not empty. On a 206 answer they report the
+    // size of the whole resource given by Content-Range with
+    // SetResourceSize(), and must write the body through DestinationStream(),
+    // which puts it at RangeStart().
+    // Any other answer leaves ResourceSize() to -1, the body is then the
+    // whole resource. Providers ignoring this interface keep working, the
+    // library downloads the resource with a single request then.
+    //
+    class IRangeDownloadRequest : public IConditionalDownloadRequest
+    {
+    public:
+        virtual int64_t RangeStart() const = 0;
+        // -1 to get the resource up to its end
+        virtual int64_t RangeEnd() const = 0;
+        virtual std::string IfRange() const = 0;
+
+        virtual int64_t ResourceSize() const = 0;
+        virtual void SetResourceSize(int64_t size) = 0;
+    };
 }
 
 #endif //!DISABLE_NET_PROVIDER
@@ -72,6 +72,23 @@ namespace lcp
         virtual void SetValue(ILicense * license, const std::string & rightId, const std::string & value) = 0;
         virtual std::string GetValue(ILicense * license, const std::string & rightId) const = 0;
 
+        //
+        // Enables the write-back of rights values: instead of writing to the
+        // IStorageProvider on every use, values are kept in memory and written
+        // in batches every flushPeriodMs milliseconds, on Flush() and when the
+        // service is destroyed. Each value is first appended to the journal
+        // file at the given absolute path, and a journal left by a previous
+        // session which wasn't flushed is replayed by this call. It should be
+        // called once, before opening any License.
+        //
+        virtual void EnableWriteBackJournal(const std::string & journalPath, int flushPeriodMs = 5000) = 0;
+
+        //
+        // Writes the pending rights values to the IStorageProvider. Does
+        // nothing if the write-back journal isn't enabled.
+        //
+        virtual void Flush() = 0;
+
         virtual ~IRightsService() {}
         
         //
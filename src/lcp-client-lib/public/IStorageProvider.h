@@ -27,7 +27,9 @@
 #ifndef __I_STORAGE_PROVIDER_H__
 #define __I_STORAGE_PROVIDER_H__
 
+#include <map>
 #include <string>
+#include <vector>
 #include "IValueIterator.h"
 
 namespace lcp
@@ -58,6 +60,40 @@ namespace lcp
         //
         virtual KvStringsIterator * EnumerateVault(const std::string & vaultId) = 0;
 
+        //
+        // Enumerates over the key-values of the given vault identifier whose
+        // key starts with the given prefix. Implementing it is optional but
+        // recommended when enumerating a vault is costly: the default returns
+        // nullptr, and the library falls back to a single EnumerateVault()
+        // per vault whose result is indexed in memory.
+        //
+        virtual KvStringsIterator * EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix) { return nullptr; }
+
+        //
+        // Batch operations, saving a call per value when calls to the
+        // storage are costly (eg. through JNI). Implementing them is
+        // optional: the defaults return false, and the library falls back to
+        // the calls above.
+        //
+        // Gets the values of the given keys, in the same order. The value of
+        // a missing key is empty.
+        //
+        virtual bool GetValues(const std::string & vaultId, const std::vector<std::string> & keys, std::vector<std::string> & values) { return false; }
+
+        //
+        // Sets the given key-values in a single transaction: either all or
+        // none of them are stored.
+        //
+        virtual bool SetValues(const std::string & vaultId, const std::map<std::string, std::string> & values) { return false; }
+
+        //
+        // Reads the key-values of the given vault identifier whose key starts
+        // with the given prefix in a single flat buffer: each key followed by
+        // its value, both preceded by their size in bytes on 4 bytes,
+        // big-endian.
+        //
+        virtual bool EnumerateVaultToBuffer(const std::string & vaultId, const std::string & keyPrefix, std::string & buffer) { return false; }
+
         virtual ~IStorageProvider() {}
     };
 
@@ -69,6 +105,9 @@ namespace lcp
     static const char * UserKeysVaultId = "2b741732-f721-4182-9928-b9dcb7edb24e";
     // Identifier for the vault storing the License rights consumption.
     static const char * LicenseRightsVaultId = "8cd95d47-ee95-4f09-b217-621352499d79";
+    // Identifier for the vault storing the keys authenticating the License
+    // verification cache and the CRL cache.
+    static const char * VerificationCacheVaultId = "5c3a2d5e-7f0b-4f2e-9a61-3b8e4c1d9f27";
 }
 
 #endif //__I_STORAGE_PROVIDER_H__
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __I_TRACE_SINK_H__
+#define __I_TRACE_SINK_H__
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lcp
+{
+    //
+    // Name and value pairs describing a span, eg. the algorithm of a read
+    // or whether a cache was used.
+    //
+    typedef std::vector<std::pair<std::string, std::string> > TraceAttributes;
+
+    //
+    // Interface which may be implemented by the client to receive the
+    // spans of the library operations, to correlate them with its own
+    // traces. Spans are given to the sink from any thread, and may overlap.
+    // A span ends on the thread it began on, except for the acquisitions
+    // which end on a thread of the INetProvider.
+    //
+    class ITraceSink
+    {
+    public:
+        //
+        // Called when an operation begins. The span identifier is unique in
+        // the process, and given again when the span ends.
+        //
+        virtual void OnSpanBegin(uint64_t spanId, const char * name) = 0;
+
+        //
+        // Called when an operation ends, with the attributes gathered while
+        // it ran.
+        //
+        virtual void OnSpanEnd(uint64_t spanId, const char * name, const TraceAttributes & attributes) = 0;
+
+        virtual ~ITraceSink() {}
+    };
+}
+
+#endif //__I_TRACE_SINK_H__
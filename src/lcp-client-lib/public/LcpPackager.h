@@ -0,0 +1,141 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __LCP_PACKAGER_H__
+#define __LCP_PACKAGER_H__
+
+#include <functional>
+#include <string>
+#include "LcpStatus.h"
+#include "ILcpService.h"
+
+namespace lcp
+{
+    class IFileSystemProvider;
+    class CancellationToken;
+
+#if ENABLE_TEST_LICENSE_ISSUER
+    //
+    // Local certificate authority issuing test licenses, meant for the
+    // creation of protected publications offline (eg. benchmark corpora).
+    // The certificates and the PKCS #8 private key of the provider are
+    // DER encoded in base64. The root certificate is the one to give to
+    // LcpServiceCreator to open the licenses of the authority.
+    //
+    struct TestAuthority
+    {
+        std::string provider;
+        std::string rootCertificate;
+        std::string providerCertificate;
+        std::string providerPrivateKey;
+    };
+
+    //
+    // User and publication of a test license. The hint link of the license
+    // points to the provider.
+    //
+    struct TestLicenseInfo
+    {
+        std::string userId;
+        std::string passphrase;
+        std::string passphraseHint;
+        std::string publicationHref;
+    };
+#endif //ENABLE_TEST_LICENSE_ISSUER
+
+    //
+    // Protects publications with the LCP 1.0 encryption profile and, in
+    // builds defining ENABLE_TEST_LICENSE_ISSUER, issues the matching test
+    // licenses. Content keys are given as their 32 raw bytes. Errors of the crypto library, of the file system or of the
+    // publication format are reported as ErrorDecryptionCommonError.
+    //
+    class LcpPackager
+    {
+    public:
+        enum ContentAlgorithm
+        {
+            AesCbc,
+            AesGcm,
+            Cleartext
+        };
+
+        //
+        // Returns the algorithm encrypting an entry of the publication,
+        // given its name in the archive.
+        //
+        typedef std::function<ContentAlgorithm(const std::string & entryName)> AlgorithmSelector;
+
+    public:
+        Status GenerateContentKey(std::string & contentKey);
+
+        //
+        // Writes the protected version of an EPUB: its resources are
+        // encrypted with AES-CBC unless the selector says otherwise, and
+        // listed in META-INF/encryption.xml. The mimetype, the META-INF
+        // entries, the package documents (the rootfiles of
+        // META-INF/container.xml and the .opf entries) and the resources
+        // the publication already lists as encrypted (eg. obfuscated
+        // fonts) stay as they are. When compress is true, resources are
+        // deflated before their encryption, except for the media formats
+        // which are compressed already. Resources are encrypted on a pool
+        // of at most maxWorkerThreads threads owned by the call, one per
+        // hardware thread when 0.
+        //
+        Status EncryptPublication(
+            IFileSystemProvider * fileSystemProvider,
+            const std::string & publicationPath,
+            const std::string & outputPath,
+            const std::string & contentKey,
+            bool compress,
+            const AlgorithmSelector & algorithmSelector = AlgorithmSelector(),
+            const ILcpService::ExportProgressCallback & progress = ILcpService::ExportProgressCallback(),
+            CancellationToken * cancellation = nullptr,
+            size_t maxWorkerThreads = 0
+            );
+
+#if ENABLE_TEST_LICENSE_ISSUER
+        //
+        // Creates the RSA 2048 keys and the certificates of a new authority
+        // for the given provider URI, valid from the day before for ten years.
+        //
+        Status CreateTestAuthority(const std::string & provider, TestAuthority & authority);
+
+        //
+        // Issues a License Document signed by the authority, giving the
+        // user of the passphrase access to the publications protected
+        // with the content key.
+        //
+        Status IssueTestLicense(
+            const TestAuthority & authority,
+            const std::string & contentKey,
+            const TestLicenseInfo & licenseInfo,
+            std::string & license
+            );
+#endif //ENABLE_TEST_LICENSE_ISSUER
+    };
+}
+
+#endif //__LCP_PACKAGER_H__
@@ -37,9 +37,16 @@ namespace lcp
 #endif //!DISABLE_NET_PROVIDER
     class IStorageProvider;
     class IFileSystemProvider;
+    class ITraceSink;
+    class IExecutor;
 
     //
-    // Factory used to create LCP service instances.
+    // Factory used to create LCP service instances. The optional trace sink
+    // receives the spans of the service operations, the optional executor
+    // runs its asynchronous operations. Both must outlive the service.
+    // The background work of the service (CRL updates, rights journal
+    // flushes) runs on a pool of at most maxWorkerThreads threads owned by
+    // the service, one per hardware thread when 0.
     //
     class LcpServiceCreator
     {
@@ -54,7 +61,11 @@ namespace lcp
             ILcpService ** lcpService
 #if !DISABLE_CRL
             , const std::string & defaultCrlUrl = std::string()
+            , const std::string & crlCachePath = std::string()
 #endif //!DISABLE_CRL
+            , ITraceSink * traceSink = nullptr
+            , IExecutor * executor = nullptr
+            , size_t maxWorkerThreads = 0
             );
     };
 }
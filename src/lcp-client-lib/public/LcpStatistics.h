@@ -0,0 +1,127 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __LCP_STATISTICS_H__
+#define __LCP_STATISTICS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lcp
+{
+    struct StatisticsCounter
+    {
+        enum CounterEnum
+        {
+            // Licenses successfully opened, including the ones already
+            // opened by the service
+            LicensesOpened,
+            // Signatures verified, for Licenses and certificates
+            SignatureVerifications,
+            // Revocation checks of a Content Provider certificate against
+            // the CRL
+            CrlChecks,
+            // Bytes of publication data decrypted with AES-256-CBC
+            BytesDecryptedAesCbc,
+            // Bytes of publication data decrypted with AES-256-GCM
+            BytesDecryptedAesGcm,
+            // Bytes of publication data encrypted with AES-256-CBC
+            BytesEncryptedAesCbc,
+            // Bytes of publication data encrypted with AES-256-GCM
+            BytesEncryptedAesGcm,
+            // Calls computing the plain text size of an encrypted resource
+            PlainTextSizeCalls,
+            // Calls made to the IStorageProvider
+            StorageProviderCalls,
+
+            CountersCount
+        };
+    };
+
+    struct StatisticsOperation
+    {
+        enum OperationEnum
+        {
+            OpenLicense,
+            DecryptLicense,
+            DecryptData,
+            // Read() of an IEncryptedStream
+            EncryptedStreamRead,
+            // Download of the CRL by the background updater
+            CrlUpdate,
+            // From IAcquisition::Start() until the acquisition ends
+            Acquisition,
+
+            OperationsCount
+        };
+    };
+
+    //
+    // Distribution of the durations of an operation. The bucket i counts
+    // the durations shorter than 2^i microseconds and not counted by the
+    // previous bucket, the last bucket counts the longer durations.
+    //
+    struct LatencyHistogram
+    {
+        static const size_t BucketsCount = 32;
+
+        LatencyHistogram()
+            : count(0)
+            , totalMicroseconds(0)
+            , maxMicroseconds(0)
+        {
+            for (size_t i = 0; i < BucketsCount; ++i)
+            {
+                buckets[i] = 0;
+            }
+        }
+
+        int64_t buckets[BucketsCount];
+        int64_t count;
+        int64_t totalMicroseconds;
+        int64_t maxMicroseconds;
+    };
+
+    //
+    // Values of the library statistics, as read by
+    // ILcpService::ReadStatistics().
+    //
+    struct StatisticsSnapshot
+    {
+        StatisticsSnapshot()
+        {
+            for (size_t i = 0; i < StatisticsCounter::CountersCount; ++i)
+            {
+                counters[i] = 0;
+            }
+        }
+
+        int64_t counters[StatisticsCounter::CountersCount];
+        LatencyHistogram latencies[StatisticsOperation::OperationsCount];
+    };
+}
+
+#endif //__LCP_STATISTICS_H__
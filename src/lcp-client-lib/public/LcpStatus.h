@@ -129,6 +129,13 @@ namespace lcp
             ErrorNetworkingRequestFailed
 #endif //!DISABLE_NET_PROVIDER
             , LicenseStatusDocumentStartProcessing
+
+            //
+            // Common errors added after the codes above were published,
+            // appended so that the existing values do not change.
+            //
+            // The operation was canceled before it completed
+            , ErrorCommonOperationCanceled
         };
     };
 
@@ -27,6 +27,7 @@
 #define __LCP_PUBLIC_INTERFACES_H__
 
 #include "LcpStatus.h"
+#include "LcpStatistics.h"
 #include "IValueIterator.h"
 #include "INetProvider.h"
 #include "IStorageProvider.h"
@@ -34,6 +35,7 @@
 #include "IFileSystemProvider.h"
 #include "DefaultFileSystemProvider.h"
 #include "LcpServiceCreator.h"
+#include "StorageProviderCreator.h"
 #include "ILcpService.h"
 #include "IRightsService.h"
 #include "ILicense.h"
@@ -43,6 +45,11 @@
 #include "IRights.h"
 #include "IAcquistion.h"
 #include "IAcquistionCallback.h"
+#include "IAcquisitionManager.h"
+#include "ITraceSink.h"
+#include "IExecutor.h"
+#include "CancellationToken.h"
+#include "LcpPackager.h"
 #include "IRightsService.h"
 
 #endif // __LCP_PUBLIC_INTERFACES_H__
@@ -299,6 +299,16 @@ class ZipArchiveEntry
      */
     void Remove();
 
+    /**
+     * \brief Gets the offset of the compressed data of this entry in the archive stream.
+     *        Reads the local file header if it has not been read yet, so the archive stream
+     *        is used and moved. The data can then be read through another stream over the
+     *        same file, CompressedSize bytes from this offset.
+     *
+     * \return  The offset of the compressed data.
+     */
+    std::ios::pos_type GetOffsetOfCompressedData();
+
   private:
     static const uint16_t VERSION_MADEBY_DEFAULT            = 63;
                                                             
@@ -348,7 +358,6 @@ class ZipArchiveEntry
     void SyncLFH_with_CDFH();
     void SyncCDFH_with_LFH();
 
-    std::ios::pos_type GetOffsetOfCompressedData();
     std::ios::pos_type SeekToCompressedData();
 
     void SerializeLocalFileHeader(std::ostream& stream);
@@ -1,11 +1,22 @@
 #include "ZipFile.h"
 
 #include "utils/stream_utils.h"
+#include "streams/serialization.h"
 
 #include <fstream>
 #include <cassert>
+#include <limits>
 #include <stdexcept>
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace
 {
   std::string GetFilenameFromPath(const std::string& fullPath)
@@ -26,6 +37,47 @@ namespace
   {
     return fileName + ".tmp";
   }
+
+  bool TruncateFile(const std::string& fileName, std::streamoff size)
+  {
+#ifdef _WIN32
+    int fd = -1;
+    if (_sopen_s(&fd, fileName.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+    {
+      return false;
+    }
+    bool result = (_chsize_s(fd, size) == 0);
+    _close(fd);
+    return result;
+#else
+    return (truncate(fileName.c_str(), static_cast<off_t>(size)) == 0);
+#endif
+  }
+
+  void SerializeEndOfCentralDirectory(std::ostream& stream, const detail::EndOfCentralDirectoryBlock& block)
+  {
+    // same layout as EndOfCentralDirectoryBlock::Serialize()
+    serialize(stream, block.Signature);
+    serialize(stream, block.NumberOfThisDisk);
+    serialize(stream, block.NumberOfTheDiskWithTheStartOfTheCentralDirectory);
+    serialize(stream, block.NumberOfEntriesInTheCentralDirectoryOnThisDisk);
+    serialize(stream, block.NumberOfEntriesInTheCentralDirectory);
+    serialize(stream, block.SizeOfCentralDirectory);
+    serialize(stream, block.OffsetOfStartOfCentralDirectoryWithRespectToTheStartingDiskNumber);
+    serialize(stream, static_cast<uint16_t>(block.Comment.length()));
+    serialize(stream, block.Comment);
+  }
+
+  void RestoreFile(const std::string& fileName, std::streamoff offset, const std::string& content, std::streamoff size)
+  {
+    {
+      std::fstream file;
+      file.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(offset, std::ios::beg);
+      file.write(content.data(), content.size());
+    }
+    TruncateFile(fileName, size);
+  }
 }
 
 ZipArchive::Ptr ZipFile::Open(const std::string& zipPath)
@@ -163,6 +215,132 @@ void ZipFile::AddEncryptedFile(const std::string& zipPath, std::istream& dataStr
     rename(tmpName.c_str(), zipPath.c_str());
 }
 
+bool ZipFile::AddFileInPlace(const std::string& zipPath, std::istream& dataStream, const std::string& inArchiveName, ICompressionMethod::Ptr method)
+{
+  std::streamoff fileSize = 0;
+  std::streamoff offsetOfNewEntry = 0;
+  std::string overwritten;
+  try
+  {
+    std::fstream zipFile;
+    zipFile.open(zipPath, std::ios::in | std::ios::out | std::ios::binary);
+
+    if (!zipFile.is_open())
+    {
+      throw std::runtime_error("cannot open zip file");
+    }
+
+    zipFile.seekg(0, std::ios::end);
+    fileSize = zipFile.tellg();
+
+    ZipArchive::Ptr zipArchive = ZipArchive::Create(&zipFile, false);
+    detail::EndOfCentralDirectoryBlock& endOfCentralDirectory = zipArchive->_endOfCentralDirectoryBlock;
+
+    // the central directory, then the end block, must close the file
+    std::streamoff offsetOfCentralDirectory = endOfCentralDirectory.OffsetOfStartOfCentralDirectoryWithRespectToTheStartingDiskNumber;
+    std::streamoff endOfArchive = offsetOfCentralDirectory
+                                + endOfCentralDirectory.SizeOfCentralDirectory
+                                + detail::EndOfCentralDirectoryBlock::SIZE_IN_BYTES
+                                + endOfCentralDirectory.CommentLength;
+
+    if (endOfCentralDirectory.Signature != detail::EndOfCentralDirectoryBlock::SignatureConstant
+      || endOfCentralDirectory.NumberOfThisDisk != 0
+      || endOfCentralDirectory.NumberOfTheDiskWithTheStartOfTheCentralDirectory != 0
+      || endOfCentralDirectory.NumberOfEntriesInTheCentralDirectory != zipArchive->GetEntriesCount()
+      || zipArchive->GetEntriesCount() >= std::numeric_limits<uint16_t>::max()
+      || endOfArchive != fileSize)
+    {
+      return false;
+    }
+
+    // entries not rewritten keep their local headers where they are
+    offsetOfNewEntry = offsetOfCentralDirectory;
+    ZipArchiveEntry::Ptr replacedEntry = zipArchive->GetEntry(inArchiveName);
+
+    for (auto& entry : zipArchive->_entries)
+    {
+      entry->_offsetOfSerializedLocalFileHeader = entry->GetOffsetOfLocalHeader();
+    }
+
+    if (replacedEntry != nullptr)
+    {
+      for (auto& entry : zipArchive->_entries)
+      {
+        if (entry->GetOffsetOfLocalHeader() > replacedEntry->GetOffsetOfLocalHeader())
+        {
+          return false;
+        }
+      }
+
+      offsetOfNewEntry = replacedEntry->GetOffsetOfLocalHeader();
+      zipArchive->RemoveEntry(inArchiveName);
+    }
+
+    // kept to put the file back as it was if a write fails
+    zipFile.clear();
+    zipFile.seekg(offsetOfNewEntry, std::ios::beg);
+    overwritten.resize(static_cast<size_t>(fileSize - offsetOfNewEntry));
+    zipFile.read(&overwritten[0], overwritten.size());
+    if (!zipFile.good())
+    {
+      overwritten.clear();
+      throw std::runtime_error("cannot read zip file");
+    }
+
+    auto fileEntry = zipArchive->CreateEntry(inArchiveName);
+    fileEntry->SetCompressionStream(dataStream, method);
+
+    zipFile.seekp(offsetOfNewEntry, std::ios::beg);
+    fileEntry->SerializeLocalFileHeader(zipFile);
+
+    // the compression streams swallow read errors of the source
+    if (dataStream.bad())
+    {
+      throw std::runtime_error("cannot read data stream");
+    }
+
+    auto offsetOfStartOfCDFH = zipFile.tellp();
+    for (auto& entry : zipArchive->_entries)
+    {
+      entry->SerializeCentralDirectoryFileHeader(zipFile);
+    }
+    std::streamoff sizeOfCentralDirectory = zipFile.tellp() - offsetOfStartOfCDFH;
+    if (static_cast<std::streamoff>(offsetOfStartOfCDFH) + sizeOfCentralDirectory > std::numeric_limits<uint32_t>::max())
+    {
+      throw std::runtime_error("zip file too large");
+    }
+
+    endOfCentralDirectory.NumberOfEntriesInTheCentralDirectory = static_cast<uint16_t>(zipArchive->GetEntriesCount());
+    endOfCentralDirectory.NumberOfEntriesInTheCentralDirectoryOnThisDisk = static_cast<uint16_t>(zipArchive->GetEntriesCount());
+    endOfCentralDirectory.SizeOfCentralDirectory = static_cast<uint32_t>(sizeOfCentralDirectory);
+    endOfCentralDirectory.OffsetOfStartOfCentralDirectoryWithRespectToTheStartingDiskNumber = static_cast<uint32_t>(offsetOfStartOfCDFH);
+    SerializeEndOfCentralDirectory(zipFile, endOfCentralDirectory);
+
+    std::streamoff newFileSize = zipFile.tellp();
+    zipFile.flush();
+    if (!zipFile.good())
+    {
+      throw std::runtime_error("cannot write zip file");
+    }
+    zipFile.close();
+
+    // the replaced entry was longer, drop what is left of it
+    if (newFileSize < fileSize && !TruncateFile(zipPath, newFileSize))
+    {
+      throw std::runtime_error("cannot truncate zip file");
+    }
+    return true;
+  }
+  catch (...)
+  {
+    if (!overwritten.empty())
+    {
+      RestoreFile(zipPath, offsetOfNewEntry, overwritten, fileSize);
+    }
+    throw;
+  }
+}
+
 void ZipFile::ExtractFile(const std::string& zipPath, const std::string& fileName)
 {
   ExtractFile(zipPath, fileName, GetFilenameFromPath(fileName));
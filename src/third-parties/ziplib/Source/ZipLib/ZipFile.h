@@ -81,6 +81,25 @@ class ZipFile
     */
     static void AddFile(const std::string& zipPath, std::istream& dataStream, const std::string& inArchiveName, ICompressionMethod::Ptr method = DeflateMethod::Create());
 
+    /**
+    * \brief Adds a file to the zip archive without rewriting it.
+    *        The entry and a new central directory are written over the old
+    *        central directory, or over the entry it replaces when this one is
+    *        the last in the file. Other entries are neither read nor moved.
+    *        The overwritten bytes are put back if a write fails.
+    *
+    * \param zipPath       Full pathname of the zip file.
+    * \param dataStream    Data stream to add as a file
+    * \param inArchiveName Final name of the file in the archive.
+    * \param level         (Optional) The level of compression. Use CompressionLevel::Stored for no compression.
+    *
+    * \return false, leaving the file and the stream untouched, when the archive
+    *         layout does not allow it (multi-disk or zip64 archives, data after
+    *         the central directory, replaced entry not the last one, ...).
+    *         AddFile() should be used then.
+    */
+    static bool AddFileInPlace(const std::string& zipPath, std::istream& dataStream, const std::string& inArchiveName, ICompressionMethod::Ptr method = DeflateMethod::Create());
+
     /**
      * \brief Adds an encrypted file to the zip archive.
      *        The name of the file in the archive will be the same as the added file name.
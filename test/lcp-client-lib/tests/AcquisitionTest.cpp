@@ -0,0 +1,618 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#if ENABLE_NET_PROVIDER_ACQUISITION
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "FakeLicenseImpl.h"
+#include "Acquisition.h"
+#include "AcquisitionManager.h"
+#include "BandwidthBudget.h"
+#include "CryptoppCryptoProvider.h"
+#include "CryptoppUtils.h"
+#include "EncryptionProfilesManager.h"
+#include "IncludeMacros.h"
+#include "Sha256HashAlgorithm.h"
+#include "public/DefaultFileSystemProvider.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+ZIPLIB_INCLUDE_END
+
+namespace lcptest
+{
+    static const char * PublicationPath = "acquisition_test.epub";
+    static const char * PublicationUrl = "http://localhost/publication.epub";
+    static const int64_t TestSegmentSize = 8 * 1024;
+
+    class FakeLinks : public lcp::ILinks
+    {
+    public:
+        explicit FakeLinks(const lcp::Link & publication)
+            : m_publication(publication)
+        {
+        }
+        virtual lcp::IKeyValueIterator<std::string, lcp::Link> * Enumerate() const
+        {
+            return nullptr;
+        }
+        virtual bool Has(const std::string & name) const
+        {
+            return name == lcp::Publication;
+        }
+        virtual bool GetLink(const std::string & name, lcp::Link & link) const
+        {
+            link = m_publication;
+            return this->Has(name);
+        }
+        virtual bool HasMany(const std::string & name) const
+        {
+            return false;
+        }
+        virtual bool GetLinks(const std::string & name, std::vector<lcp::Link> & links) const
+        {
+            return false;
+        }
+
+    private:
+        lcp::Link m_publication;
+    };
+
+    class AcquisitionLicense : public FakeLicenseImpl
+    {
+    public:
+        explicit AcquisitionLicense(const lcp::Link & publication)
+            : FakeLicenseImpl(nullptr)
+            , m_links(publication)
+        {
+        }
+        virtual std::string OriginalContent() const
+        {
+            return "{\"id\":\"df09ac25-a386-4c5c-b167-33ce4c36ca65\"}";
+        }
+        virtual lcp::ILinks * Links() const
+        {
+            return const_cast<FakeLinks *>(&m_links);
+        }
+        virtual bool getStatusDocumentProcessingFlag() const
+        {
+            return false;
+        }
+        virtual void setStatusDocumentProcessingFlag(bool flag)
+        {
+        }
+
+    private:
+        FakeLinks m_links;
+    };
+
+    //
+    // Stands in for an HTTP server and client: serves the publication from
+    // worker threads, honouring Range and If-Range unless told otherwise,
+    // and can drop the connection after a given number of bytes.
+    //
+    class FakeRangeNetProvider : public lcp::INetProvider
+    {
+    public:
+        FakeRangeNetProvider(const std::string & content, bool honoursRanges)
+            : m_content(content)
+            , m_honoursRanges(honoursRanges)
+            , m_failAfter(-1)
+            , m_inFlight(0)
+            , m_maxInFlight(0)
+            , m_bytesSent(0)
+        {
+        }
+
+        ~FakeRangeNetProvider()
+        {
+            this->Join();
+        }
+
+        void FailAfter(int64_t bytes)
+        {
+            m_failAfter = bytes;
+        }
+
+        int MaxInFlight() const
+        {
+            return m_maxInFlight;
+        }
+
+        int64_t BytesSent() const
+        {
+            return m_bytesSent;
+        }
+
+        void Join()
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            while (!m_workers.empty())
+            {
+                std::vector<std::thread> workers;
+                workers.swap(m_workers);
+                locker.unlock();
+                for (auto & worker : workers)
+                {
+                    worker.join();
+                }
+                locker.lock();
+            }
+        }
+
+        virtual void StartDownloadRequest(lcp::IDownloadRequest * request, lcp::INetProviderCallback * callback)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_workers.push_back(std::thread(&FakeRangeNetProvider::Worker, this, request, callback));
+        }
+
+    private:
+        void Worker(lcp::IDownloadRequest * request, lcp::INetProviderCallback * callback)
+        {
+            int inFlight = ++m_inFlight;
+            int maxInFlight = m_maxInFlight;
+            while (inFlight > maxInFlight && !m_maxInFlight.compare_exchange_weak(maxInFlight, inFlight))
+            {
+            }
+            callback->OnRequestStarted(request);
+
+            int64_t start = 0;
+            int64_t end = static_cast<int64_t>(m_content.size());
+            lcp::IRangeDownloadRequest * ranged = dynamic_cast<lcp::IRangeDownloadRequest *>(request);
+            if (m_honoursRanges && ranged != nullptr && (ranged->IfRange().empty() || ranged->IfRange() == "\"v1\""))
+            {
+                start = ranged->RangeStart();
+                end = (ranged->RangeEnd() == -1) ? end : std::min(end, ranged->RangeEnd());
+                ranged->SetResourceSize(static_cast<int64_t>(m_content.size()));
+                ranged->SetETag("\"v1\"");
+            }
+
+            lcp::Status result(lcp::StatusCode::ErrorCommonSuccess);
+            for (int64_t position = start; position < end; position += 1024)
+            {
+                if (request->Canceled())
+                {
+                    --m_inFlight;
+                    callback->OnRequestCanceled(request);
+                    return;
+                }
+                int64_t size = std::min<int64_t>(1024, end - position);
+                if (m_failAfter != -1 && m_bytesSent + size > m_failAfter)
+                {
+                    result = lcp::Status(lcp::StatusCode::ErrorNetworkingRequestFailed);
+                    break;
+                }
+                request->DestinationStream()->Write(reinterpret_cast<const unsigned char *>(m_content.data() + position), size);
+                m_bytesSent += size;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            --m_inFlight;
+            callback->OnRequestEnded(request, result);
+        }
+
+    private:
+        std::string m_content;
+        bool m_honoursRanges;
+        std::atomic<int64_t> m_failAfter;
+        std::atomic<int> m_inFlight;
+        std::atomic<int> m_maxInFlight;
+        std::atomic<int64_t> m_bytesSent;
+        std::mutex m_sync;
+        std::vector<std::thread> m_workers;
+    };
+
+    class AcquisitionEndWaiter : public lcp::IAcquisitionCallback
+    {
+    public:
+        AcquisitionEndWaiter()
+            : m_ended(false)
+            , m_result(lcp::StatusCode::ErrorCommonSuccess)
+        {
+        }
+
+        lcp::Status Wait()
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_condition.wait_for(locker, std::chrono::seconds(10), [this]() { return m_ended; });
+            return m_ended ? m_result : lcp::Status(lcp::StatusCode::ErrorNetworkingRequestFailed, "timeout");
+        }
+
+        virtual void OnAcquisitionStarted(lcp::IAcquisition * acquisition) {}
+        virtual void OnAcquisitionProgressed(lcp::IAcquisition * acquisition, float progress) {}
+        virtual void OnAcquisitionCanceled(lcp::IAcquisition * acquisition) {}
+
+        virtual void OnAcquisitionEnded(lcp::IAcquisition * acquisition, lcp::Status result)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_ended = true;
+            m_result = result;
+            m_condition.notify_all();
+        }
+
+    private:
+        std::mutex m_sync;
+        std::condition_variable m_condition;
+        bool m_ended;
+        lcp::Status m_result;
+    };
+
+    class AcquisitionTest : public ::testing::Test
+    {
+    protected:
+        AcquisitionTest()
+            : m_cryptoProvider(&m_profilesManager, nullptr, nullptr, nullptr, "", "")
+        {
+        }
+
+        virtual void SetUp()
+        {
+            std::remove(PublicationPath);
+            std::remove((std::string(PublicationPath) + ".part").c_str());
+
+            // Not compressed, to span several segments
+            std::string chapter;
+            for (int i = 0; i < 6000; ++i)
+            {
+                chapter += std::to_string(i) + " ";
+            }
+            std::stringstream chapterStream(chapter);
+            ZipFile::AddFile(PublicationPath, chapterStream, "OEBPS/chapter.xhtml", StoreMethod::Create());
+            m_content = this->ReadPublication();
+            std::remove(PublicationPath);
+
+            lcp::Sha256HashAlgorithm hashAlgorithm;
+            hashAlgorithm.UpdateHash(reinterpret_cast<const unsigned char *>(m_content.data()), m_content.size());
+            m_publicationLink.href = PublicationUrl;
+            m_publicationLink.hash = lcp::CryptoppUtils::RawToHex(hashAlgorithm.Hash());
+            m_chapter = chapter;
+        }
+
+        virtual void TearDown()
+        {
+            std::remove(PublicationPath);
+            std::remove((std::string(PublicationPath) + ".part").c_str());
+        }
+
+        lcp::Status Acquire(FakeRangeNetProvider & netProvider)
+        {
+            AcquisitionLicense license(m_publicationLink);
+            AcquisitionEndWaiter waiter;
+            lcp::Acquisition acquisition(&license, &m_fileSystemProvider, &netProvider, &m_cryptoProvider, PublicationPath, TestSegmentSize);
+            lcp::Status result = acquisition.Start(&waiter);
+            if (lcp::Status::IsSuccess(result))
+            {
+                result = waiter.Wait();
+            }
+            netProvider.Join();
+            return result;
+        }
+
+        std::string ReadPublication()
+        {
+            std::ifstream file(PublicationPath, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        std::string ReadEntry(const std::string & name)
+        {
+            ZipArchive::Ptr archive = ZipFile::Open(PublicationPath);
+            ZipArchiveEntry::Ptr entry = archive->GetEntry(name);
+            if (entry == nullptr)
+            {
+                return std::string();
+            }
+            std::istream * stream = entry->GetDecompressionStream();
+            return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+        }
+
+        bool HasProgress()
+        {
+            std::ifstream file(std::string(PublicationPath) + ".part");
+            return file.good();
+        }
+
+    protected:
+        lcp::EncryptionProfilesManager m_profilesManager;
+        lcp::CryptoppCryptoProvider m_cryptoProvider;
+        lcp::DefaultFileSystemProvider m_fileSystemProvider;
+        lcp::Link m_publicationLink;
+        std::string m_content;
+        std::string m_chapter;
+    };
+
+    TEST_F(AcquisitionTest, SegmentsAreDownloadedInParallel)
+    {
+        FakeRangeNetProvider netProvider(m_content, true);
+
+        lcp::Status result = this->Acquire(netProvider);
+
+        ASSERT_TRUE(lcp::Status::IsSuccess(result)) << result.Code;
+        EXPECT_GT(netProvider.MaxInFlight(), 1);
+        EXPECT_EQ(static_cast<int64_t>(m_content.size()), netProvider.BytesSent());
+        EXPECT_EQ(m_chapter, this->ReadEntry("OEBPS/chapter.xhtml"));
+        EXPECT_FALSE(this->ReadEntry("META-INF/license.lcpl").empty());
+        EXPECT_FALSE(this->HasProgress());
+    }
+
+    TEST_F(AcquisitionTest, InterruptedAcquisitionResumes)
+    {
+        FakeRangeNetProvider failingProvider(m_content, true);
+        failingProvider.FailAfter(static_cast<int64_t>(m_content.size()) / 2);
+        ASSERT_FALSE(lcp::Status::IsSuccess(this->Acquire(failingProvider)));
+        ASSERT_TRUE(this->HasProgress());
+
+        FakeRangeNetProvider netProvider(m_content, true);
+        lcp::Status result = this->Acquire(netProvider);
+
+        ASSERT_TRUE(lcp::Status::IsSuccess(result)) << result.Code;
+        EXPECT_LT(netProvider.BytesSent(), static_cast<int64_t>(m_content.size()));
+        EXPECT_EQ(m_chapter, this->ReadEntry("OEBPS/chapter.xhtml"));
+        EXPECT_FALSE(this->HasProgress());
+    }
+
+    TEST_F(AcquisitionTest, InterruptedAcquisitionKeepsTheHashOfTheReceivedPart)
+    {
+        FakeRangeNetProvider failingProvider(m_content, true);
+        failingProvider.FailAfter(static_cast<int64_t>(m_content.size()) / 2);
+        ASSERT_FALSE(lcp::Status::IsSuccess(this->Acquire(failingProvider)));
+
+        std::ifstream progress(std::string(PublicationPath) + ".part");
+        std::string line;
+        std::string keyword;
+        int64_t hashedSize = 0;
+        std::string hashState;
+        while (std::getline(progress, line))
+        {
+            std::istringstream fields(line);
+            if (fields >> keyword >> hashedSize >> hashState && keyword == "hash")
+            {
+                break;
+            }
+        }
+        ASSERT_EQ("hash", keyword);
+        ASSERT_GT(hashedSize, 0);
+
+        // The saved state goes on with the rest of the publication
+        lcp::Sha256HashAlgorithm hashAlgorithm;
+        ASSERT_TRUE(hashAlgorithm.RestoreState(lcp::CryptoppUtils::HexToRaw(hashState)));
+        hashAlgorithm.UpdateHash(m_content.substr(static_cast<size_t>(hashedSize)));
+        ASSERT_EQ(m_publicationLink.hash, lcp::CryptoppUtils::RawToHex(hashAlgorithm.Hash()));
+
+        FakeRangeNetProvider netProvider(m_content, true);
+        lcp::Status result = this->Acquire(netProvider);
+        ASSERT_TRUE(lcp::Status::IsSuccess(result)) << result.Code;
+        EXPECT_EQ(m_chapter, this->ReadEntry("OEBPS/chapter.xhtml"));
+    }
+
+    TEST_F(AcquisitionTest, ServerIgnoringRangesSendsThePublicationAtOnce)
+    {
+        FakeRangeNetProvider netProvider(m_content, false);
+
+        lcp::Status result = this->Acquire(netProvider);
+
+        ASSERT_TRUE(lcp::Status::IsSuccess(result)) << result.Code;
+        EXPECT_EQ(1, netProvider.MaxInFlight());
+        EXPECT_EQ(m_chapter, this->ReadEntry("OEBPS/chapter.xhtml"));
+        EXPECT_FALSE(this->HasProgress());
+    }
+
+    TEST(BandwidthBudgetTest, RateIsSharedByWriters)
+    {
+        lcp::BandwidthBudget budget(40000);
+        auto begin = std::chrono::steady_clock::now();
+
+        // One second of burst, then 40000 bytes at the budget rate
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 4; ++i)
+        {
+            writers.push_back(std::thread([&budget]() {
+                for (int j = 0; j < 10; ++j)
+                {
+                    budget.Consume(2000);
+                }
+            }));
+        }
+        for (auto & writer : writers)
+        {
+            writer.join();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        EXPECT_GE(elapsed.count(), 900);
+        EXPECT_LT(elapsed.count(), 3000);
+    }
+
+    //
+    // Records the order in which the acquisitions of a manager start and
+    // end, and how many run at once.
+    //
+    class AcquisitionRecorder : public lcp::IAcquisitionCallback, public lcp::IAcquisitionManagerCallback
+    {
+    public:
+        AcquisitionRecorder()
+            : m_running(0)
+            , m_maxRunning(0)
+            , m_queueProgress(0)
+            , m_idle(false)
+        {
+        }
+
+        bool WaitIdle()
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            return m_condition.wait_for(locker, std::chrono::seconds(10), [this]() { return m_idle; });
+        }
+
+        std::vector<std::string> Ended() const
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            return m_ended;
+        }
+
+        int MaxRunning() const
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            return m_maxRunning;
+        }
+
+        float QueueProgress() const
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            return m_queueProgress;
+        }
+
+        virtual void OnAcquisitionStarted(lcp::IAcquisition * acquisition)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_maxRunning = std::max(m_maxRunning, ++m_running);
+        }
+
+        virtual void OnAcquisitionProgressed(lcp::IAcquisition * acquisition, float progress) {}
+        virtual void OnAcquisitionCanceled(lcp::IAcquisition * acquisition) {}
+
+        virtual void OnAcquisitionEnded(lcp::IAcquisition * acquisition, lcp::Status result)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            --m_running;
+            m_ended.push_back(lcp::Status::IsSuccess(result) ? acquisition->PublicationPath() : "failed");
+        }
+
+        virtual void OnQueueProgressed(lcp::IAcquisitionManager * manager, float progress)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_queueProgress = progress;
+        }
+
+        virtual void OnQueueIdle(lcp::IAcquisitionManager * manager)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_idle = true;
+            m_condition.notify_all();
+        }
+
+    private:
+        mutable std::mutex m_sync;
+        std::condition_variable m_condition;
+        std::vector<std::string> m_ended;
+        int m_running;
+        int m_maxRunning;
+        float m_queueProgress;
+        bool m_idle;
+    };
+
+    class AcquisitionManagerTest : public AcquisitionTest
+    {
+    protected:
+        virtual void TearDown()
+        {
+            for (const char * path : { "manager_a.epub", "manager_b.epub", "manager_c.epub" })
+            {
+                std::remove(path);
+                std::remove((std::string(path) + ".part").c_str());
+            }
+            AcquisitionTest::TearDown();
+        }
+    };
+
+    TEST_F(AcquisitionManagerTest, QueueIsBoundedAndDeduplicated)
+    {
+        FakeRangeNetProvider netProvider(m_content, true);
+        AcquisitionLicense license(m_publicationLink);
+        AcquisitionRecorder recorder;
+        AcquisitionRecorder duplicateRecorder;
+        {
+            lcp::AcquisitionManager manager(&m_fileSystemProvider, &netProvider, &m_cryptoProvider, 1, &recorder);
+            manager.Enqueue(&license, "manager_a.epub", lcp::IAcquisitionManager::Normal, &recorder);
+            manager.Enqueue(&license, "manager_b.epub", lcp::IAcquisitionManager::Normal, &recorder);
+            manager.Enqueue(&license, "manager_a.epub", lcp::IAcquisitionManager::Normal, &duplicateRecorder);
+
+            ASSERT_TRUE(recorder.WaitIdle());
+            netProvider.Join();
+        }
+
+        EXPECT_EQ(1, recorder.MaxRunning());
+        EXPECT_EQ((std::vector<std::string>{ "manager_a.epub", "manager_b.epub" }), recorder.Ended());
+        EXPECT_EQ((std::vector<std::string>{ "manager_a.epub" }), duplicateRecorder.Ended());
+        EXPECT_EQ(2 * static_cast<int64_t>(m_content.size()), netProvider.BytesSent());
+        EXPECT_FLOAT_EQ(1, recorder.QueueProgress());
+    }
+
+    TEST_F(AcquisitionManagerTest, UserInitiatedAcquisitionGoesFirst)
+    {
+        FakeRangeNetProvider netProvider(m_content, true);
+        AcquisitionLicense license(m_publicationLink);
+        AcquisitionRecorder recorder;
+        {
+            lcp::AcquisitionManager manager(&m_fileSystemProvider, &netProvider, &m_cryptoProvider, 1, &recorder, nullptr, TestSegmentSize);
+            manager.SetBandwidthBudget(static_cast<int64_t>(m_content.size()));
+            manager.Enqueue(&license, "manager_a.epub", lcp::IAcquisitionManager::Background, &recorder);
+            manager.Enqueue(&license, "manager_b.epub", lcp::IAcquisitionManager::Background, &recorder);
+            manager.Enqueue(&license, "manager_c.epub", lcp::IAcquisitionManager::UserInitiated, &recorder);
+
+            ASSERT_TRUE(recorder.WaitIdle());
+            netProvider.Join();
+        }
+
+        EXPECT_EQ((std::vector<std::string>{ "manager_c.epub", "manager_a.epub", "manager_b.epub" }), recorder.Ended());
+        EXPECT_GE(4 * static_cast<int64_t>(m_content.size()), netProvider.BytesSent());
+    }
+
+    TEST_F(AcquisitionManagerTest, AcquisitionWhichCanNotResumeIsNotPaused)
+    {
+        FakeRangeNetProvider netProvider(m_content, false);
+        AcquisitionLicense license(m_publicationLink);
+        AcquisitionRecorder recorder;
+        {
+            lcp::AcquisitionManager manager(&m_fileSystemProvider, &netProvider, &m_cryptoProvider, 1, &recorder, nullptr, TestSegmentSize);
+            manager.SetBandwidthBudget(static_cast<int64_t>(m_content.size()));
+            manager.Enqueue(&license, "manager_a.epub", lcp::IAcquisitionManager::Background, &recorder);
+            manager.Enqueue(&license, "manager_b.epub", lcp::IAcquisitionManager::Background, &recorder);
+            manager.Enqueue(&license, "manager_c.epub", lcp::IAcquisitionManager::UserInitiated, &recorder);
+
+            ASSERT_TRUE(recorder.WaitIdle());
+            netProvider.Join();
+        }
+
+        EXPECT_EQ((std::vector<std::string>{ "manager_a.epub", "manager_c.epub", "manager_b.epub" }), recorder.Ended());
+        EXPECT_EQ(3 * static_cast<int64_t>(m_content.size()), netProvider.BytesSent());
+    }
+}
+
+#endif //ENABLE_NET_PROVIDER_ACQUISITION
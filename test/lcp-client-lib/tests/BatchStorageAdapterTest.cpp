@@ -0,0 +1,160 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "BatchStorageAdapter.h"
+#include "TestStorageProvider.h"
+
+namespace lcptest
+{
+    //
+    // Implements only the batch operations, so any single value call made
+    // by the adapter fails.
+    //
+    class BatchOnlyStorageProvider : public lcp::IStorageProvider
+    {
+    public:
+        BatchOnlyStorageProvider()
+            : batchCalls(0)
+        {
+        }
+
+        virtual std::string GetValue(const std::string & vaultId, const std::string & key)
+        {
+            throw std::logic_error("Single value call");
+        }
+
+        virtual void SetValue(const std::string & vaultId, const std::string & key, const std::string & value)
+        {
+            throw std::logic_error("Single value call");
+        }
+
+        virtual lcp::KvStringsIterator * EnumerateVault(const std::string & vaultId)
+        {
+            throw std::logic_error("Single value call");
+        }
+
+        virtual bool GetValues(const std::string & vaultId, const std::vector<std::string> & keys, std::vector<std::string> & values)
+        {
+            ++batchCalls;
+            lcp::StringsMap & vault = vaults[vaultId];
+            for (auto it = keys.begin(); it != keys.end(); ++it)
+            {
+                auto valueIt = vault.find(*it);
+                values.push_back((valueIt != vault.end()) ? valueIt->second : std::string());
+            }
+            return true;
+        }
+
+        virtual bool SetValues(const std::string & vaultId, const std::map<std::string, std::string> & values)
+        {
+            ++batchCalls;
+            vaults[vaultId].insert(values.begin(), values.end());
+            return true;
+        }
+
+        virtual bool EnumerateVaultToBuffer(const std::string & vaultId, const std::string & keyPrefix, std::string & buffer)
+        {
+            ++batchCalls;
+            lcp::StringsMap & vault = vaults[vaultId];
+            for (auto it = vault.lower_bound(keyPrefix); it != vault.end() && it->first.compare(0, keyPrefix.size(), keyPrefix) == 0; ++it)
+            {
+                lcp::BatchStorageAdapter::AppendToBuffer(buffer, it->first, it->second);
+            }
+            return true;
+        }
+
+        std::map<std::string, lcp::StringsMap> vaults;
+        int batchCalls;
+    };
+
+    static lcp::StringsMap CreateRightsValues()
+    {
+        lcp::StringsMap values;
+        values["provider@user@license@print"] = "10";
+        values["provider@user@license@copy"] = "";
+        values["provider@user@other@print"] = "3";
+        return values;
+    }
+
+    TEST(BatchStorageAdapterTest, UsesTheBatchOperationsOfTheProvider)
+    {
+        BatchOnlyStorageProvider storageProvider;
+        lcp::BatchStorageAdapter storage(&storageProvider);
+        storage.SetValues(lcp::LicenseRightsVaultId, CreateRightsValues());
+
+        std::vector<std::string> keys;
+        keys.push_back("provider@user@other@print");
+        keys.push_back("provider@user@license@missing");
+        std::vector<std::string> values = storage.GetValues(lcp::LicenseRightsVaultId, keys);
+        ASSERT_EQ(2, values.size());
+        ASSERT_STREQ("3", values[0].c_str());
+        ASSERT_TRUE(values[1].empty());
+
+        lcp::StringsMap licenseValues;
+        ASSERT_TRUE(storage.ValuesWithPrefix(lcp::LicenseRightsVaultId, "provider@user@license@", licenseValues));
+        ASSERT_EQ(2, licenseValues.size());
+        ASSERT_STREQ("10", licenseValues["provider@user@license@print"].c_str());
+        ASSERT_TRUE(licenseValues["provider@user@license@copy"].empty());
+
+        ASSERT_EQ(CreateRightsValues(), storage.VaultValues(lcp::LicenseRightsVaultId));
+        ASSERT_EQ(4, storageProvider.batchCalls);
+    }
+
+    TEST(BatchStorageAdapterTest, FallsBackToSingleValueCalls)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::BatchStorageAdapter storage(&storageProvider);
+        storage.SetValues(lcp::LicenseRightsVaultId, CreateRightsValues());
+        ASSERT_STREQ("10", storageProvider.GetValue(lcp::LicenseRightsVaultId, "provider@user@license@print").c_str());
+
+        std::vector<std::string> keys(1, "provider@user@other@print");
+        std::vector<std::string> values = storage.GetValues(lcp::LicenseRightsVaultId, keys);
+        ASSERT_EQ(1, values.size());
+        ASSERT_STREQ("3", values[0].c_str());
+
+        lcp::StringsMap otherValues;
+        ASSERT_TRUE(storage.ValuesWithPrefix(lcp::LicenseRightsVaultId, "provider@user@other@", otherValues));
+        ASSERT_EQ(1, otherValues.size());
+        ASSERT_EQ(CreateRightsValues(), storage.VaultValues(lcp::LicenseRightsVaultId));
+    }
+
+    TEST(BatchStorageAdapterTest, MalformedBufferIsRejected)
+    {
+        std::string buffer;
+        lcp::BatchStorageAdapter::AppendToBuffer(buffer, "key", std::string("va\0ue", 5));
+        lcp::StringsMap values;
+        ASSERT_TRUE(lcp::BatchStorageAdapter::ReadBuffer(buffer, values));
+        ASSERT_EQ(std::string("va\0ue", 5), values["key"]);
+
+        buffer.resize(buffer.size() - 1);
+        ASSERT_FALSE(lcp::BatchStorageAdapter::ReadBuffer(buffer, values));
+    }
+}
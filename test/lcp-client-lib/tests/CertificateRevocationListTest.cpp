@@ -0,0 +1,928 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "TestInfo.h"
+#include "TestStorageProvider.h"
+#include "CryptoppUtils.h"
+#include "Certificate.h"
+#include "CryptoAlgorithmInterfaces.h"
+#include "CertificateRevocationList.h"
+#include "CrlUpdater.h"
+#include "EncryptionProfilesManager.h"
+#include "Scheduler.h"
+#include "ReadableStreamStore.h"
+#include "public/lcp.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/asn.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/integer.h>
+#include <cryptopp/sha.h>
+CRYPTOPP_INCLUDE_END
+
+namespace lcptest
+{
+    class MemoryReadableStream : public lcp::IReadableStream
+    {
+    public:
+        explicit MemoryReadableStream(const lcp::Buffer & data)
+            : m_data(data)
+            , m_position(0)
+            , m_reads(0)
+        {
+        }
+
+        virtual void Read(unsigned char * pBuffer, int64_t sizeToRead)
+        {
+            if (m_position + sizeToRead > this->Size())
+            {
+                throw std::out_of_range("read past the end of the stream");
+            }
+            std::copy(m_data.begin() + m_position, m_data.begin() + m_position + sizeToRead, pBuffer);
+            m_position += sizeToRead;
+            ++m_reads;
+        }
+
+        virtual void SetReadPosition(int64_t pos)
+        {
+            m_position = pos;
+        }
+
+        virtual int64_t ReadPosition() const
+        {
+            return m_position;
+        }
+
+        virtual int64_t Size()
+        {
+            return static_cast<int64_t>(m_data.size());
+        }
+
+        size_t Reads() const
+        {
+            return m_reads;
+        }
+
+    private:
+        lcp::Buffer m_data;
+        int64_t m_position;
+        size_t m_reads;
+    };
+
+    static lcp::Buffer BuildCrl(size_t revokedCount, const std::string & thisUpdate = "161019120000Z")
+    {
+        using namespace CryptoPP;
+
+        ByteQueue queue;
+        DERSequenceEncoder crl(queue);
+        {
+            DERSequenceEncoder toBeSignedCertList(crl);
+            DEREncodeUnsigned<word32>(toBeSignedCertList, lcp::CertificateVersion::Certificatev2);
+            {
+                DERSequenceEncoder algorithmId(toBeSignedCertList);
+                OID(1).DEREncode(algorithmId);
+                algorithmId.MessageEnd();
+            }
+            {
+                DERSequenceEncoder issuer(toBeSignedCertList);
+                issuer.MessageEnd();
+            }
+            DEREncodeTextString(toBeSignedCertList, thisUpdate, UTC_TIME);
+            DEREncodeTextString(toBeSignedCertList, "161026120000Z", UTC_TIME);
+            {
+                DERSequenceEncoder revokedCertificates(toBeSignedCertList);
+                for (size_t i = 0; i < revokedCount; ++i)
+                {
+                    DERSequenceEncoder revokedCertificate(revokedCertificates);
+                    Integer(static_cast<long>(1000000 + i)).DEREncode(revokedCertificate);
+                    DEREncodeTextString(revokedCertificate, "161019110000Z", UTC_TIME);
+                    revokedCertificate.MessageEnd();
+                }
+                revokedCertificates.MessageEnd();
+            }
+            toBeSignedCertList.MessageEnd();
+        }
+        {
+            DERSequenceEncoder signatureAlgorithm(crl);
+            OID(1).DEREncode(signatureAlgorithm);
+            signatureAlgorithm.MessageEnd();
+        }
+        const byte signature[] = { 0x00, 0x01, 0x02, 0x03 };
+        DEREncodeBitString(crl, signature, sizeof(signature));
+        crl.MessageEnd();
+
+        lcp::Buffer result(static_cast<size_t>(queue.MaxRetrievable()));
+        queue.Get(result.data(), result.size());
+        return result;
+    }
+
+    //
+    // Base or delta list carrying the extensions used by delta CRLs.
+    //
+    struct CrlContent
+    {
+        CrlContent()
+            : thisUpdate("161019120000Z")
+            , nextUpdate("491231120000Z")
+            , crlNumber(0)
+            , baseCrlNumber(0)
+        {
+        }
+
+        std::string thisUpdate;
+        std::string nextUpdate;
+        std::vector<long> revokedSerials;
+        std::vector<long> removedSerials;
+        long crlNumber;
+        long baseCrlNumber;
+        std::string freshestCrlUrl;
+        std::string issuerName;
+    };
+
+    static lcp::Buffer ToBuffer(CryptoPP::ByteQueue & queue)
+    {
+        lcp::Buffer result(static_cast<size_t>(queue.MaxRetrievable()));
+        queue.Get(result.data(), result.size());
+        return result;
+    }
+
+    static void EncodeExtension(CryptoPP::BufferedTransformation & extensions, const CryptoPP::OID & oid, const lcp::Buffer & value)
+    {
+        using namespace CryptoPP;
+
+        DERSequenceEncoder extension(extensions);
+        oid.DEREncode(extension);
+        DEREncodeOctetString(extension, value.data(), value.size());
+        extension.MessageEnd();
+    }
+
+    static lcp::Buffer EncodeInteger(long value)
+    {
+        CryptoPP::ByteQueue queue;
+        CryptoPP::Integer(value).DEREncode(queue);
+        return ToBuffer(queue);
+    }
+
+    static lcp::Buffer EncodeCrl(const CrlContent & content)
+    {
+        using namespace CryptoPP;
+
+        const OID idCe = OID(2) + 5 + 29;
+        ByteQueue queue;
+        DERSequenceEncoder crl(queue);
+        {
+            DERSequenceEncoder toBeSignedCertList(crl);
+            DEREncodeUnsigned<word32>(toBeSignedCertList, lcp::CertificateVersion::Certificatev2);
+            {
+                DERSequenceEncoder algorithmId(toBeSignedCertList);
+                OID(1).DEREncode(algorithmId);
+                algorithmId.MessageEnd();
+            }
+            {
+                DERSequenceEncoder issuer(toBeSignedCertList);
+                if (!content.issuerName.empty())
+                {
+                    DERSetEncoder relativeName(issuer);
+                    DERSequenceEncoder commonName(relativeName);
+                    (OID(2) + 5 + 4 + 3).DEREncode(commonName);
+                    DEREncodeTextString(commonName, content.issuerName, UTF8_STRING);
+                    commonName.MessageEnd();
+                    relativeName.MessageEnd();
+                }
+                issuer.MessageEnd();
+            }
+            DEREncodeTextString(toBeSignedCertList, content.thisUpdate, UTC_TIME);
+            DEREncodeTextString(toBeSignedCertList, content.nextUpdate, UTC_TIME);
+            if (!content.revokedSerials.empty() || !content.removedSerials.empty())
+            {
+                DERSequenceEncoder revokedCertificates(toBeSignedCertList);
+                for (long serial : content.revokedSerials)
+                {
+                    DERSequenceEncoder revokedCertificate(revokedCertificates);
+                    Integer(serial).DEREncode(revokedCertificate);
+                    DEREncodeTextString(revokedCertificate, "161019110000Z", UTC_TIME);
+                    revokedCertificate.MessageEnd();
+                }
+                for (long serial : content.removedSerials)
+                {
+                    DERSequenceEncoder revokedCertificate(revokedCertificates);
+                    Integer(serial).DEREncode(revokedCertificate);
+                    DEREncodeTextString(revokedCertificate, "161019110000Z", UTC_TIME);
+                    {
+                        DERSequenceEncoder entryExtensions(revokedCertificate);
+                        const byte removeFromCrl[] = { ENUMERATED, 0x01, 0x08 };
+                        EncodeExtension(entryExtensions, idCe + 21, lcp::Buffer(removeFromCrl, removeFromCrl + sizeof(removeFromCrl)));
+                        entryExtensions.MessageEnd();
+                    }
+                    revokedCertificate.MessageEnd();
+                }
+                revokedCertificates.MessageEnd();
+            }
+            {
+                DERGeneralEncoder crlExtensionsContext(toBeSignedCertList, 0xa0);
+                DERSequenceEncoder crlExtensions(crlExtensionsContext);
+                EncodeExtension(crlExtensions, idCe + 20, EncodeInteger(content.crlNumber));
+                if (content.baseCrlNumber != 0)
+                {
+                    EncodeExtension(crlExtensions, idCe + 27, EncodeInteger(content.baseCrlNumber));
+                }
+                if (!content.freshestCrlUrl.empty())
+                {
+                    ByteQueue distributionPointsQueue;
+                    DERSequenceEncoder distributionPoints(distributionPointsQueue);
+                    {
+                        DERSequenceEncoder distributionPoint(distributionPoints);
+                        DERGeneralEncoder name(distributionPoint, 0xa0);
+                        DERGeneralEncoder fullName(name, 0xa0);
+                        DEREncodeTextString(fullName, content.freshestCrlUrl, 0x86);
+                        fullName.MessageEnd();
+                        name.MessageEnd();
+                        distributionPoint.MessageEnd();
+                    }
+                    distributionPoints.MessageEnd();
+                    EncodeExtension(crlExtensions, idCe + 46, ToBuffer(distributionPointsQueue));
+                }
+                crlExtensions.MessageEnd();
+                crlExtensionsContext.MessageEnd();
+            }
+            toBeSignedCertList.MessageEnd();
+        }
+        {
+            DERSequenceEncoder signatureAlgorithm(crl);
+            OID(1).DEREncode(signatureAlgorithm);
+            signatureAlgorithm.MessageEnd();
+        }
+        const byte signature[] = { 0x00, 0x01, 0x02, 0x03 };
+        DEREncodeBitString(crl, signature, sizeof(signature));
+        crl.MessageEnd();
+        return ToBuffer(queue);
+    }
+
+    static CrlContent BaseCrlContent()
+    {
+        CrlContent base;
+        base.revokedSerials = { 1000000, 1000001, 1000002, 1000003 };
+        base.crlNumber = 5;
+        base.freshestCrlUrl = "http://localhost/delta.crl";
+        return base;
+    }
+
+    static CrlContent DeltaCrlContent()
+    {
+        CrlContent delta;
+        delta.thisUpdate = "161020120000Z";
+        delta.revokedSerials = { 1000010 };
+        delta.removedSerials = { 1000003 };
+        delta.crlNumber = 6;
+        delta.baseCrlNumber = 5;
+        return delta;
+    }
+
+    TEST(CertificateRevocationListTest, StreamMatchesBuffer)
+    {
+        lcp::Buffer rawCrl = lcp::CryptoppUtils::Base64ToVector(TestCrl);
+
+        lcp::CertificateRevocationList fromBuffer;
+        fromBuffer.UpdateRevocationList(rawCrl);
+
+        MemoryReadableStream stream(rawCrl);
+        lcp::CertificateRevocationList fromStream;
+        fromStream.UpdateRevocationList(&stream);
+
+        ASSERT_EQ(fromBuffer.ThisUpdateDate(), fromStream.ThisUpdateDate());
+        ASSERT_EQ(fromBuffer.NextUpdateDate(), fromStream.NextUpdateDate());
+        ASSERT_EQ(fromBuffer.RevokedSerialNumbers(), fromStream.RevokedSerialNumbers());
+        ASSERT_TRUE(fromStream.SerialNumberRevoked("1341769"));
+    }
+
+    TEST(CertificateRevocationListTest, LargeListIsReadInWindows)
+    {
+        const size_t revokedCount = 100000;
+        lcp::Buffer rawCrl = BuildCrl(revokedCount);
+        ASSERT_GT(rawCrl.size(), 1024u * 1024u);
+
+        MemoryReadableStream stream(rawCrl);
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(&stream);
+
+        ASSERT_EQ(revokedCount, revocation.RevokedSerialNumbers().size());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000000"));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1099999"));
+        ASSERT_FALSE(revocation.SerialNumberRevoked("1100000"));
+        ASSERT_TRUE(revocation.HasNextUpdateDate());
+
+        // Peeks straddling a window boundary may reload a window, nothing more.
+        size_t windows = (rawCrl.size() + lcp::ReadableStreamStore::DefaultWindowSize - 1) / lcp::ReadableStreamStore::DefaultWindowSize;
+        ASSERT_GE(stream.Reads(), windows);
+        ASSERT_LT(stream.Reads(), 2 * windows);
+    }
+
+    TEST(CertificateRevocationListTest, TruncatedStreamKeepsPreviousList)
+    {
+        lcp::Buffer rawCrl = lcp::CryptoppUtils::Base64ToVector(TestCrl);
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(rawCrl);
+
+        lcp::Buffer truncated(rawCrl.begin(), rawCrl.begin() + rawCrl.size() / 2);
+        MemoryReadableStream stream(truncated);
+        ASSERT_ANY_THROW(revocation.UpdateRevocationList(&stream));
+
+        ASSERT_EQ(5u, revocation.RevokedSerialNumbers().size());
+        ASSERT_STREQ("20130218T103200Z", revocation.ThisUpdateDate().c_str());
+    }
+
+    TEST(CertificateRevocationListTest, InsertedSerialNumbersAreRevoked)
+    {
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(BuildCrl(3));
+
+        // 20 octets, the longest serial number RFC 5280 allows
+        std::string longSerial = "1461501637330902918203684832716283019655932542975";
+        revocation.InsertRevokedSerialNumber(longSerial);
+        revocation.InsertRevokedSerialNumber("1000001");
+
+        ASSERT_TRUE(revocation.SerialNumberRevoked(longSerial));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000001"));
+        ASSERT_FALSE(revocation.SerialNumberRevoked("1000003"));
+        ASSERT_EQ(4u, revocation.RevokedSerialNumbers().size());
+        ASSERT_EQ(1u, revocation.RevokedSerialNumbers().count(longSerial));
+        ASSERT_ANY_THROW(revocation.InsertRevokedSerialNumber(longSerial + "0000"));
+    }
+
+    TEST(CertificateRevocationListTest, EncodedSerialNumbersAreRevoked)
+    {
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(lcp::CryptoppUtils::Base64ToVector(TestCrl));
+
+        // 1341769, and its opposite
+        ASSERT_TRUE(revocation.EncodedSerialNumberRevoked(lcp::Buffer({ 0x14, 0x79, 0x49 })));
+        ASSERT_FALSE(revocation.EncodedSerialNumberRevoked(lcp::Buffer({ 0xEB, 0x86, 0xB7 })));
+        ASSERT_FALSE(revocation.EncodedSerialNumberRevoked(lcp::Buffer()));
+
+        // 2^160 - 1 takes a leading zero octet
+        revocation.InsertRevokedSerialNumber("1461501637330902918203684832716283019655932542975");
+        lcp::Buffer longSerial(21, 0xFF);
+        longSerial[0] = 0x00;
+        ASSERT_TRUE(revocation.EncodedSerialNumberRevoked(longSerial));
+        longSerial.insert(longSerial.begin(), 0x00);
+        ASSERT_FALSE(revocation.EncodedSerialNumberRevoked(longSerial));
+    }
+
+    TEST(CertificateRevocationListTest, CertificateSerialNumberIsEncodedOnce)
+    {
+        lcp::EncryptionProfilesManager profilesManager;
+#if ENABLE_PROFILE_NAMES
+        lcp::IEncryptionProfile * profile = profilesManager.GetProfile("http://readium.org/lcp/profile-1.0");
+#else
+        lcp::IEncryptionProfile * profile = profilesManager.GetProfile();
+#endif //ENABLE_PROFILE_NAMES
+        ASSERT_NE(profile, nullptr);
+
+        lcp::Certificate certificate(TestDistributionPointCert, profile);
+        lcp::Buffer encoded = certificate.EncodedSerialNumber();
+        ASSERT_FALSE(encoded.empty());
+        ASSERT_EQ(CryptoPP::Integer(certificate.SerialNumber().c_str()),
+            CryptoPP::Integer(encoded.data(), encoded.size(), CryptoPP::Integer::SIGNED));
+
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(BuildCrl(3));
+        ASSERT_FALSE(revocation.EncodedSerialNumberRevoked(encoded));
+        revocation.InsertRevokedSerialNumber(certificate.SerialNumber());
+        ASSERT_TRUE(revocation.EncodedSerialNumberRevoked(encoded));
+    }
+
+    TEST(CertificateRevocationListTest, LookupsRunWhileListsArePublished)
+    {
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(BuildCrl(100));
+
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> misses(0);
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i)
+        {
+            readers.push_back(std::thread([&]()
+            {
+                while (!stop)
+                {
+                    // Revoked by every list published below
+                    if (!revocation.SerialNumberRevoked("1000050") || revocation.ThisUpdateDate().empty())
+                    {
+                        ++misses;
+                    }
+                }
+            }));
+        }
+
+        for (size_t i = 0; i < 200; ++i)
+        {
+            revocation.UpdateRevocationList(BuildCrl(100 + i % 10));
+            revocation.InsertRevokedSerialNumber(std::to_string(2000000 + i));
+        }
+        stop = true;
+        for (auto & reader : readers)
+        {
+            reader.join();
+        }
+
+        ASSERT_EQ(0u, misses.load());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("2000199"));
+    }
+
+    TEST(CertificateRevocationListTest, StoreCopiesAcrossWindowBoundaries)
+    {
+        lcp::Buffer rawCrl = lcp::CryptoppUtils::Base64ToVector(TestCrl);
+        MemoryReadableStream stream(rawCrl);
+        lcp::ReadableStreamStore store(&stream, 7);
+
+        std::string peeked;
+        CryptoPP::StringSink peekSink(peeked);
+        store.CopyRangeTo(peekSink, 5, 20);
+        ASSERT_EQ(std::string(rawCrl.begin() + 5, rawCrl.begin() + 25), peeked);
+
+        std::string copied;
+        CryptoPP::StringSink sink(copied);
+        store.TransferTo(sink);
+        ASSERT_EQ(std::string(rawCrl.begin(), rawCrl.end()), copied);
+        ASSERT_FALSE(store.AnyRetrievable());
+    }
+
+    static const char * CrlCachePath = "crl.cache";
+
+    TEST(CertificateRevocationListTest, DeltaIsAppliedOnTopOfItsBase)
+    {
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(EncodeCrl(BaseCrlContent()));
+        ASSERT_EQ(1u, revocation.FreshestCrlUrls().size());
+        ASSERT_STREQ("http://localhost/delta.crl", revocation.FreshestCrlUrls().front().c_str());
+
+        revocation.UpdateRevocationList(EncodeCrl(DeltaCrlContent()));
+        ASSERT_STREQ("20161020T120000Z", revocation.ThisUpdateDate().c_str());
+        ASSERT_EQ(4u, revocation.RevokedSerialNumbers().size());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000010"));
+        ASSERT_FALSE(revocation.SerialNumberRevoked("1000003"));
+        ASSERT_EQ(1u, revocation.FreshestCrlUrls().size());
+    }
+
+    TEST(CertificateRevocationListTest, DeltaForAnotherBaseIsRejected)
+    {
+        lcp::CertificateRevocationList empty;
+        ASSERT_ANY_THROW(empty.UpdateRevocationList(EncodeCrl(DeltaCrlContent())));
+        ASSERT_FALSE(empty.HasThisUpdateDate());
+
+        CrlContent olderBase = BaseCrlContent();
+        olderBase.crlNumber = 4;
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(EncodeCrl(olderBase));
+        ASSERT_ANY_THROW(revocation.UpdateRevocationList(EncodeCrl(DeltaCrlContent())));
+        ASSERT_STREQ("20161019T120000Z", revocation.ThisUpdateDate().c_str());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000003"));
+    }
+
+    TEST(CertificateRevocationListTest, DeltaOnlyChangesTheListOfItsIssuer)
+    {
+        CrlContent firstBase = BaseCrlContent();
+        firstBase.issuerName = "First CA";
+        CrlContent secondBase;
+        secondBase.issuerName = "Second CA";
+        secondBase.revokedSerials = { 1000003, 2000000 };
+        secondBase.crlNumber = 2;
+
+        lcp::CertificateRevocationList revocation;
+        revocation.UpdateRevocationList(EncodeCrl(firstBase));
+        revocation.UpdateRevocationList(EncodeCrl(secondBase));
+        ASSERT_EQ(5u, revocation.RevokedSerialNumbers().size());
+
+        // Numbered against the first issuer's base, which is newer than the second one
+        CrlContent firstDelta = DeltaCrlContent();
+        firstDelta.issuerName = "First CA";
+        firstDelta.removedSerials.clear();
+        revocation.UpdateRevocationList(EncodeCrl(firstDelta));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000010"));
+
+        // The entry dropped by the second issuer is still revoked by the first one
+        CrlContent secondDelta;
+        secondDelta.issuerName = "Second CA";
+        secondDelta.removedSerials = { 1000003, 2000000 };
+        secondDelta.crlNumber = 3;
+        secondDelta.baseCrlNumber = 2;
+        revocation.UpdateRevocationList(EncodeCrl(secondDelta));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000003"));
+        ASSERT_FALSE(revocation.SerialNumberRevoked("2000000"));
+        ASSERT_EQ(5u, revocation.RevokedSerialNumbers().size());
+    }
+
+    static const lcp::KeyType CrlCacheMacKey(32, 0x5A);
+
+    static void InitCrlCacheMacKey(TestStorageProvider & storageProvider)
+    {
+        storageProvider.SetValue(lcp::VerificationCacheVaultId, "crlCacheMacKey", lcp::CryptoppUtils::RawToHex(CrlCacheMacKey));
+    }
+
+    static void WriteCrlCache(const std::string & nextUpdate, const lcp::Buffer & crlRaw, const lcp::Buffer & cachedRaw)
+    {
+        lcp::Buffer digest(CryptoPP::SHA256::DIGESTSIZE);
+        CryptoPP::SHA256().CalculateDigest(digest.data(), crlRaw.data(), crlRaw.size());
+        std::string header = "lcp-crl/2\n20161019T120000Z\n" + nextUpdate + "\n" + lcp::CryptoppUtils::RawToHex(digest) + "\n";
+
+        CryptoPP::HMAC<CryptoPP::SHA256> hmac(CrlCacheMacKey.data(), CrlCacheMacKey.size());
+        lcp::Buffer mac(hmac.DigestSize());
+        hmac.CalculateDigest(mac.data(), reinterpret_cast<const byte *>(header.data()), header.size());
+
+        std::ofstream cache(CrlCachePath, std::ios::binary | std::ios::trunc);
+        cache << header << lcp::CryptoppUtils::RawToHex(mac) << "\n";
+        cache.write(reinterpret_cast<const char *>(cachedRaw.data()), cachedRaw.size());
+    }
+
+    static void WriteCrlCache(const std::string & nextUpdate, const lcp::Buffer & crlRaw)
+    {
+        WriteCrlCache(nextUpdate, crlRaw, crlRaw);
+    }
+
+    TEST(CertificateRevocationListTest, CachedListIsLoadedOnFirstUse)
+    {
+        WriteCrlCache("20991231T000000Z", BuildCrl(10));
+
+        TestStorageProvider storageProvider("storage.json", true);
+        InitCrlCacheMacKey(storageProvider);
+        lcp::DefaultFileSystemProvider fsProvider;
+        lcp::CertificateRevocationList revocation;
+        lcp::Scheduler scheduler;
+        lcp::CrlUpdater updater(nullptr, &fsProvider, &storageProvider, &revocation, &scheduler, "http://localhost/test.crl", CrlCachePath);
+
+        ASSERT_TRUE(updater.CachedListIsCurrent());
+        ASSERT_FALSE(revocation.HasThisUpdateDate());
+
+        updater.LoadCachedList();
+        ASSERT_TRUE(revocation.HasThisUpdateDate());
+        ASSERT_EQ(10u, revocation.RevokedSerialNumbers().size());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000009"));
+        std::remove(CrlCachePath);
+    }
+
+    TEST(CertificateRevocationListTest, StaleOrDamagedCacheIsNotTrusted)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        InitCrlCacheMacKey(storageProvider);
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            WriteCrlCache("20161026T120000Z", BuildCrl(10));
+            lcp::CertificateRevocationList revocation;
+            lcp::Scheduler scheduler;
+            lcp::CrlUpdater updater(nullptr, &fsProvider, &storageProvider, &revocation, &scheduler, "http://localhost/test.crl", CrlCachePath);
+            ASSERT_FALSE(updater.CachedListIsCurrent());
+
+            // A stale list still knows about past revocations
+            updater.LoadCachedList();
+            ASSERT_TRUE(revocation.SerialNumberRevoked("1000000"));
+        }
+        {
+            lcp::Buffer crlRaw = BuildCrl(10);
+            WriteCrlCache("20991231T000000Z", crlRaw, lcp::Buffer(crlRaw.begin(), crlRaw.begin() + crlRaw.size() / 2));
+            lcp::CertificateRevocationList revocation;
+            lcp::Scheduler scheduler;
+            lcp::CrlUpdater updater(nullptr, &fsProvider, &storageProvider, &revocation, &scheduler, "http://localhost/test.crl", CrlCachePath);
+            ASSERT_TRUE(updater.CachedListIsCurrent());
+            updater.LoadCachedList();
+            ASSERT_FALSE(revocation.HasThisUpdateDate());
+        }
+        {
+            // A next update date pushed back by hand fails authentication
+            WriteCrlCache("20161026T120000Z", BuildCrl(10));
+            std::ifstream cache(CrlCachePath, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(cache)), std::istreambuf_iterator<char>());
+            cache.close();
+            content.replace(content.find("20161026"), 8, "20991231");
+            std::ofstream(CrlCachePath, std::ios::binary | std::ios::trunc) << content;
+
+            lcp::CertificateRevocationList revocation;
+            lcp::Scheduler scheduler;
+            lcp::CrlUpdater updater(nullptr, &fsProvider, &storageProvider, &revocation, &scheduler, "http://localhost/test.crl", CrlCachePath);
+            ASSERT_FALSE(updater.CachedListIsCurrent());
+            updater.LoadCachedList();
+            ASSERT_FALSE(revocation.HasThisUpdateDate());
+        }
+        {
+            // Without a storage provider keeping its key, no cache is read
+            WriteCrlCache("20991231T000000Z", BuildCrl(10));
+            lcp::CertificateRevocationList revocation;
+            lcp::Scheduler scheduler;
+            lcp::CrlUpdater updater(nullptr, &fsProvider, nullptr, &revocation, &scheduler, "http://localhost/test.crl", CrlCachePath);
+            ASSERT_FALSE(updater.CachedListIsCurrent());
+        }
+        std::remove(CrlCachePath);
+    }
+
+    class FakeDistributionPoints : public lcp::ICrlDistributionPoints
+    {
+    public:
+        explicit FakeDistributionPoints(const lcp::StringsList & urls)
+            : m_urls(urls)
+        {
+        }
+
+        virtual bool HasCrlDistributionPoints() const
+        {
+            return !m_urls.empty();
+        }
+
+        virtual const lcp::StringsList & CrlDistributionPointUrls() const
+        {
+            return m_urls;
+        }
+
+    private:
+        lcp::StringsList m_urls;
+    };
+
+    //
+    // Serves canned CRLs from worker threads, honouring If-None-Match.
+    //
+    class FakeCrlNetProvider : public lcp::INetProvider
+    {
+    public:
+        struct Response
+        {
+            lcp::Buffer data;
+            std::string etag;
+            int delayMs;
+        };
+
+        FakeCrlNetProvider()
+            : m_fullDownloads(0)
+            , m_endedRequests(0)
+        {
+        }
+
+        ~FakeCrlNetProvider()
+        {
+            this->Join();
+        }
+
+        void SetResponse(const std::string & url, const lcp::Buffer & data, const std::string & etag, int delayMs = 0)
+        {
+            Response response = { data, etag, delayMs };
+            m_responses[url] = response;
+        }
+
+        int FullDownloads() const
+        {
+            return m_fullDownloads;
+        }
+
+        int Requests(const std::string & url)
+        {
+            return m_requests[url];
+        }
+
+        int EndedRequests() const
+        {
+            return m_endedRequests;
+        }
+
+        void Join()
+        {
+            for (auto & worker : m_workers)
+            {
+                worker.join();
+            }
+            m_workers.clear();
+        }
+
+        virtual void StartDownloadRequest(lcp::IDownloadRequest * request, lcp::INetProviderCallback * callback)
+        {
+            ++m_requests[request->Url()];
+            m_workers.push_back(std::thread(&FakeCrlNetProvider::Worker, this, request, callback, m_responses[request->Url()]));
+        }
+
+    private:
+        void Worker(lcp::IDownloadRequest * request, lcp::INetProviderCallback * callback, Response response)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(response.delayMs);
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                if (request->Canceled())
+                {
+                    ++m_endedRequests;
+                    callback->OnRequestCanceled(request);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+
+            lcp::IConditionalDownloadRequest * conditional = dynamic_cast<lcp::IConditionalDownloadRequest *>(request);
+            if (conditional != nullptr && !response.etag.empty() && conditional->IfNoneMatch() == response.etag)
+            {
+                conditional->SetNotModified(true);
+            }
+            else
+            {
+                request->DestinationStream()->Write(response.data.data(), response.data.size());
+                if (conditional != nullptr)
+                {
+                    conditional->SetETag(response.etag);
+                }
+                ++m_fullDownloads;
+            }
+            ++m_endedRequests;
+            callback->OnRequestEnded(request, lcp::Status(lcp::StatusCode::ErrorCommonSuccess));
+        }
+
+    private:
+        std::map<std::string, Response> m_responses;
+        std::map<std::string, int> m_requests;
+        std::vector<std::thread> m_workers;
+        std::atomic<int> m_fullDownloads;
+        std::atomic<int> m_endedRequests;
+    };
+
+    class CountingRevocationList : public lcp::CertificateRevocationList
+    {
+    public:
+        CountingRevocationList()
+            : m_updates(0)
+        {
+        }
+
+        using lcp::CertificateRevocationList::UpdateRevocationList;
+
+        virtual void UpdateRevocationList(const lcp::Buffer & crlRaw)
+        {
+            ++m_updates;
+            lcp::CertificateRevocationList::UpdateRevocationList(crlRaw);
+        }
+
+        int Updates() const
+        {
+            return m_updates;
+        }
+
+    private:
+        int m_updates;
+    };
+
+    TEST(CrlUpdaterTest, FreshestDistributionPointWins)
+    {
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/old.crl", BuildCrl(3, "161019120000Z"), "old");
+        netProvider.SetResponse("http://localhost/new.crl", BuildCrl(5, "161020120000Z"), "new", 50);
+        netProvider.SetResponse("http://localhost/slow.crl", BuildCrl(1, "161021120000Z"), "slow", 5000);
+
+        CountingRevocationList revocation;
+        lcp::Scheduler scheduler;
+        lcp::CrlUpdater updater(&netProvider, nullptr, nullptr, &revocation, &scheduler, "http://localhost/old.crl");
+        FakeDistributionPoints distributionPoints({ "http://localhost/new.crl", "http://localhost/slow.crl" });
+        updater.UpdateCrlUrls(&distributionPoints);
+        updater.SetRequestTimeout(500);
+
+        auto started = std::chrono::steady_clock::now();
+        updater.Update();
+        ASSERT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+
+        ASSERT_STREQ("20161020T120000Z", revocation.ThisUpdateDate().c_str());
+        ASSERT_EQ(5u, revocation.RevokedSerialNumbers().size());
+        ASSERT_EQ(1, revocation.Updates());
+        netProvider.Join();
+    }
+
+    TEST(CrlUpdaterTest, DestructorWaitsForAbandonedDownloads)
+    {
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/slow.crl", BuildCrl(1, "161021120000Z"), "slow", 5000);
+        {
+            lcp::CertificateRevocationList revocation;
+            lcp::CrlUpdater updater(&netProvider, nullptr, nullptr, &revocation, nullptr, "http://localhost/slow.crl");
+            updater.SetRequestTimeout(50);
+            updater.Update();
+        }
+        ASSERT_EQ(1, netProvider.EndedRequests());
+        netProvider.Join();
+    }
+
+    TEST(CrlUpdaterTest, StaleCachedListIsRefreshedFromCertificateUrls)
+    {
+        WriteCrlCache("20161026T120000Z", BuildCrl(10));
+        TestStorageProvider storageProvider("storage.json", true);
+        InitCrlCacheMacKey(storageProvider);
+        lcp::DefaultFileSystemProvider fsProvider;
+
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/new.crl", BuildCrl(12, "161027120000Z"), "new");
+        {
+            lcp::CertificateRevocationList revocation;
+            lcp::Scheduler scheduler;
+            // No default URL, so nothing polls before the certificate URLs are known
+            lcp::CrlUpdater updater(&netProvider, &fsProvider, &storageProvider, &revocation, &scheduler, "", CrlCachePath);
+            FakeDistributionPoints distributionPoints({ "http://localhost/new.crl" });
+            updater.UpdateCrlUrls(&distributionPoints);
+
+            updater.LoadCachedList();
+            ASSERT_TRUE(revocation.SerialNumberRevoked("1000009"));
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!revocation.SerialNumberRevoked("1000011") && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            ASSERT_TRUE(revocation.SerialNumberRevoked("1000011"));
+            ASSERT_STREQ("20161027T120000Z", revocation.ThisUpdateDate().c_str());
+        }
+        netProvider.Join();
+        std::remove(CrlCachePath);
+        std::remove((std::string(CrlCachePath) + ".delta").c_str());
+    }
+
+    TEST(CrlUpdaterTest, UnchangedListIsNotDownloadedAgain)
+    {
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/test.crl", BuildCrl(3), "v1");
+
+        CountingRevocationList revocation;
+        lcp::Scheduler scheduler;
+        lcp::CrlUpdater updater(&netProvider, nullptr, nullptr, &revocation, &scheduler, "http://localhost/test.crl");
+
+        updater.Update();
+        updater.Update();
+        netProvider.Join();
+
+        ASSERT_EQ(1, netProvider.FullDownloads());
+        ASSERT_EQ(1, revocation.Updates());
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000002"));
+    }
+
+    TEST(CrlUpdaterTest, DeltaIsFetchedWhileBaseIsCurrent)
+    {
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/test.crl", EncodeCrl(BaseCrlContent()), "base");
+        netProvider.SetResponse("http://localhost/delta.crl", EncodeCrl(DeltaCrlContent()), "delta");
+
+        lcp::CertificateRevocationList revocation;
+        lcp::Scheduler scheduler;
+        lcp::CrlUpdater updater(&netProvider, nullptr, nullptr, &revocation, &scheduler, "http://localhost/test.crl");
+
+        updater.Update();
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000003"));
+
+        updater.Update();
+        netProvider.Join();
+        ASSERT_EQ(1, netProvider.Requests("http://localhost/test.crl"));
+        ASSERT_EQ(1, netProvider.Requests("http://localhost/delta.crl"));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000010"));
+        ASSERT_FALSE(revocation.SerialNumberRevoked("1000003"));
+    }
+
+    TEST(CrlUpdaterTest, FullListIsFetchedWhenDeltaDoesNotApply)
+    {
+        CrlContent delta = DeltaCrlContent();
+        delta.baseCrlNumber = 7;
+
+        FakeCrlNetProvider netProvider;
+        netProvider.SetResponse("http://localhost/test.crl", EncodeCrl(BaseCrlContent()), "base");
+        netProvider.SetResponse("http://localhost/delta.crl", EncodeCrl(delta), "delta");
+
+        lcp::CertificateRevocationList revocation;
+        lcp::Scheduler scheduler;
+        lcp::CrlUpdater updater(&netProvider, nullptr, nullptr, &revocation, &scheduler, "http://localhost/test.crl");
+
+        updater.Update();
+        updater.Update();
+        netProvider.Join();
+        ASSERT_EQ(2, netProvider.Requests("http://localhost/test.crl"));
+        ASSERT_EQ(1, netProvider.Requests("http://localhost/delta.crl"));
+        ASSERT_TRUE(revocation.SerialNumberRevoked("1000003"));
+    }
+}
@@ -26,6 +26,9 @@
 
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <ctime>
+#include <iostream>
 #include "DateTime.h"
 
 namespace lcptest
@@ -102,41 +105,41 @@ namespace lcptest
     {
         std::string timeStr = "2015-11-11T22:21:37Z";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 1447273297);
+        ASSERT_EQ(object.ToTime(), 1447280497);
     }
 
     TEST(DateTimeTest, NormalIsoTimeToTime_t_TimeZoneZero)
     {
         std::string timeStr = "2015-11-11T22:21:37+00:00";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 1447273297);
+        ASSERT_EQ(object.ToTime(), 1447280497);
     }
 
     TEST(DateTimeTest, NormalIsoTimeToTime_t_TimeZonePlusTwo)
     {
         std::string timeStr = "2015-11-11T22:21:37+02:00";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 1447280497);
+        ASSERT_EQ(object.ToTime(), 1447273297);
     }
 
     TEST(DateTimeTest, NormalIsoTimeToTime_t_TimeZoneMinusTwo)
     {
         std::string timeStr = "2015-11-11T22:21:37-02:00";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 1447266097);
+        ASSERT_EQ(object.ToTime(), 1447287697);
     }
 
     TEST(DateTimeTest, CompareSmaller)
     {
-        lcp::DateTime left("2015-11-11T22:21:37Z");
-        lcp::DateTime right("2015-11-11T22:21:37+02:00");
+        lcp::DateTime left("2015-11-11T22:21:37+02:00");
+        lcp::DateTime right("2015-11-11T22:21:37Z");
         ASSERT_TRUE(left < right);
     }
 
     TEST(DateTimeTest, CompareBigger)
     {
-        lcp::DateTime left("2015-11-11T22:21:37+02:00");
-        lcp::DateTime right("2015-11-11T22:21:37Z");
+        lcp::DateTime left("2015-11-11T22:21:37Z");
+        lcp::DateTime right("2015-11-11T22:21:37+02:00");
         ASSERT_TRUE(left > right);
     }
 
@@ -158,7 +161,7 @@ namespace lcptest
     {
         std::string timeStr = "2015-11-11T22:21:37.984546-02:00";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 1447266097);
+        ASSERT_EQ(object.ToTime(), 1447287697);
         ASSERT_STREQ("2015-11-11T22:21:37.984546-02:00", object.ToString().c_str());
     }
 
@@ -166,12 +169,66 @@ namespace lcptest
     {
         std::string timeStr = "2045-11-11T22:21:37-02:00";
         lcp::DateTime object(timeStr);
-        ASSERT_EQ(object.ToTime(), 2394037297);
+        ASSERT_EQ(object.ToTime(), 2394058897);
         ASSERT_STREQ("2045-11-11T22:21:37-02:00", object.ToString().c_str());
     }
 
+    TEST(DateTimeTest, JointIsoTimeToTime_t)
+    {
+        lcp::DateTime utc("20151111T222137Z");
+        ASSERT_EQ(utc.ToTime(), 1447280497);
+
+        lcp::DateTime timeZone("20151111T222137+0200");
+        ASSERT_EQ(timeZone.ToTime(), 1447273297);
+    }
+
+    TEST(DateTimeTest, OutOfRangeFieldsThrow)
+    {
+        ASSERT_THROW(lcp::DateTime object("2015-13-11T22:21:37Z"), std::runtime_error);
+        ASSERT_THROW(lcp::DateTime object("2015-02-29T22:21:37Z"), std::runtime_error);
+        ASSERT_THROW(lcp::DateTime object("2015-11-11T24:21:37Z"), std::runtime_error);
+        ASSERT_THROW(lcp::DateTime object("2015-11-11T22:21:37+01:60"), std::runtime_error);
+    }
+
+    TEST(DateTimeTest, LeapYearDate)
+    {
+        lcp::DateTime object("2016-02-29T00:00:00Z");
+        ASSERT_EQ(object.ToTime(), 1456704000);
+        ASSERT_EQ(object.ToTm().tm_mon, 1);
+        ASSERT_EQ(object.ToTm().tm_mday, 29);
+    }
+
     TEST(DateTimeTest, DateTimeNow)
     {
         lcp::DateTime now = lcp::DateTime::Now();
+        ASSERT_EQ(now.ToTime(), static_cast<Time64_T>(std::time(nullptr)));
+    }
+
+    // Run with --gtest_also_run_disabled_tests to measure parsing throughput
+    TEST(DateTimeTest, DISABLED_ParsingBenchmark)
+    {
+        const std::string samples[] = {
+            "2015-11-11T22:21:37Z",
+            "2015-11-11T22:21:37.984546-02:00",
+            "20151111T222137Z",
+            "20151111T222137+0100"
+        };
+        const int iterations = 250000;
+
+        Time64_T checksum = 0;
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const std::string & sample : samples)
+            {
+                checksum += lcp::DateTime(sample).ToTime();
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count();
+
+        std::cout << iterations * 4 << " dates parsed in " << elapsed << " us ("
+            << (elapsed * 1000.0) / (iterations * 4) << " ns per date)" << std::endl;
+        ASSERT_NE(checksum, 0);
     }
 }
\ No newline at end of file
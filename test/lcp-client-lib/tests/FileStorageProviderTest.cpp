@@ -0,0 +1,295 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "FileStorageProvider.h"
+
+namespace lcptest
+{
+    static const char * StoragePath = "storage.log";
+    static const char * FirstLogPath = "storage.log.0";
+    static const char * SecondLogPath = "storage.log.1";
+
+    static lcp::KeyType StorageKey(unsigned char seed = 1)
+    {
+        return lcp::KeyType(lcp::FileStorageProvider::KeySize, seed);
+    }
+
+    static void RemoveStorage()
+    {
+        std::remove(FirstLogPath);
+        std::remove(SecondLogPath);
+    }
+
+    static std::string ReadFileContent(const char * path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static void WriteFileContent(const char * path, const std::string & content)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), content.size());
+    }
+
+    //
+    // Writes half of the next buffer, then throws, as a full disk would
+    //
+    class FailingWriteFile : public lcp::IFile
+    {
+    public:
+        FailingWriteFile(lcp::IFile * file, bool & failNextWrite)
+            : m_file(file)
+            , m_failNextWrite(failNextWrite)
+        {
+        }
+
+        virtual std::string Path() const { return m_file->Path(); }
+        virtual void Flush() { m_file->Flush(); }
+        virtual void Read(unsigned char * pBuffer, int64_t sizeToRead) { m_file->Read(pBuffer, sizeToRead); }
+        virtual void SetReadPosition(int64_t pos) { m_file->SetReadPosition(pos); }
+        virtual int64_t ReadPosition() const { return m_file->ReadPosition(); }
+        virtual int64_t Size() { return m_file->Size(); }
+        virtual void SetWritePosition(int64_t pos) { m_file->SetWritePosition(pos); }
+        virtual int64_t WritePosition() const { return m_file->WritePosition(); }
+
+        virtual void Write(const unsigned char * pBuffer, int64_t sizeToWrite)
+        {
+            if (m_failNextWrite)
+            {
+                m_failNextWrite = false;
+                m_file->Write(pBuffer, sizeToWrite / 2);
+                throw std::runtime_error("write error");
+            }
+            m_file->Write(pBuffer, sizeToWrite);
+        }
+
+    private:
+        std::unique_ptr<lcp::IFile> m_file;
+        bool & m_failNextWrite;
+    };
+
+    class FailingWriteFileSystemProvider : public lcp::IFileSystemProvider
+    {
+    public:
+        FailingWriteFileSystemProvider()
+            : failNextWrite(false)
+        {
+        }
+
+        virtual lcp::IFile * GetFile(const std::string & path, OpenMode openMode)
+        {
+            return new FailingWriteFile(m_fsProvider.GetFile(path, openMode), failNextWrite);
+        }
+
+        bool failNextWrite;
+
+    private:
+        lcp::DefaultFileSystemProvider m_fsProvider;
+    };
+
+    TEST(FileStorageProviderTest, ValuesAreReplayedAfterReopen)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::UserKeysVaultId, "provider|user", "key1");
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|print", "10");
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|print", "9");
+        }
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_STREQ("key1", storage.GetValue(lcp::UserKeysVaultId, "provider|user").c_str());
+        ASSERT_STREQ("9", storage.GetValue(lcp::LicenseRightsVaultId, "license|print").c_str());
+        ASSERT_TRUE(storage.GetValue(lcp::UserKeysVaultId, "license|print").empty());
+
+        std::unique_ptr<lcp::KvStringsIterator> it(storage.EnumerateVaultWithPrefix(lcp::LicenseRightsVaultId, "license|"));
+        ASSERT_FALSE(it->IsDone());
+        ASSERT_STREQ("license|print", it->CurrentKey().c_str());
+        it->Next();
+        ASSERT_TRUE(it->IsDone());
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, TornBatchIsDroppedAsAWhole)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|copy", "100");
+
+            lcp::StringsMap values;
+            values["license|print"] = "5";
+            values["license|copy"] = "50";
+            storage.SetValues(lcp::LicenseRightsVaultId, values);
+        }
+        std::string content = ReadFileContent(FirstLogPath);
+        WriteFileContent(FirstLogPath, content.substr(0, content.size() - 3));
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_STREQ("100", storage.GetValue(lcp::LicenseRightsVaultId, "license|copy").c_str());
+        ASSERT_TRUE(storage.GetValue(lcp::LicenseRightsVaultId, "license|print").empty());
+
+        // The torn record is overwritten by the next ones
+        storage.SetValue(lcp::LicenseRightsVaultId, "license|print", "4");
+        lcp::FileStorageProvider reopened(&fsProvider, StoragePath, StorageKey());
+        reopened.Open();
+        ASSERT_STREQ("4", reopened.GetValue(lcp::LicenseRightsVaultId, "license|print").c_str());
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, FailedWriteIsOverwrittenByTheNextRecord)
+    {
+        RemoveStorage();
+        FailingWriteFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|copy", "100");
+
+            fsProvider.failNextWrite = true;
+            ASSERT_ANY_THROW(storage.SetValue(lcp::LicenseRightsVaultId, "license|copy", "99"));
+            ASSERT_STREQ("100", storage.GetValue(lcp::LicenseRightsVaultId, "license|copy").c_str());
+
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|print", "5");
+        }
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_STREQ("100", storage.GetValue(lcp::LicenseRightsVaultId, "license|copy").c_str());
+        ASSERT_STREQ("5", storage.GetValue(lcp::LicenseRightsVaultId, "license|print").c_str());
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, CompactionKeepsTheLatestValues)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::UserKeysVaultId, "provider|user", "key1");
+            for (int i = 0; i < 200; ++i)
+            {
+                storage.SetValue(lcp::LicenseRightsVaultId, "license|data", std::string(1024, 'a' + i % 26));
+            }
+        }
+        // The previous generation is only reused by the next compaction
+        ASSERT_FALSE(ReadFileContent(FirstLogPath).empty());
+        ASSERT_LT(ReadFileContent(SecondLogPath).size(), static_cast<size_t>(lcp::FileStorageProvider::MinCompactionSize));
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_STREQ("key1", storage.GetValue(lcp::UserKeysVaultId, "provider|user").c_str());
+        ASSERT_EQ(std::string(1024, 'a' + 199 % 26), storage.GetValue(lcp::LicenseRightsVaultId, "license|data"));
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, InterruptedCompactionKeepsThePreviousGeneration)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::UserKeysVaultId, "provider|user", "key1");
+            storage.Compact();
+        }
+        std::string compacted = ReadFileContent(SecondLogPath);
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::UserKeysVaultId, "provider|user", "key2");
+            storage.Compact();
+        }
+        // Next generation torn before its commit record
+        std::string interrupted = ReadFileContent(FirstLogPath);
+        WriteFileContent(SecondLogPath, compacted);
+        WriteFileContent(FirstLogPath, interrupted.substr(0, interrupted.size() - 1));
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_STREQ("key1", storage.GetValue(lcp::UserKeysVaultId, "provider|user").c_str());
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, TamperedRecordIsNotReplayed)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+            storage.Open();
+            storage.SetValue(lcp::LicenseRightsVaultId, "license|print", "1");
+        }
+        {
+            std::fstream logFile(FirstLogPath, std::ios::in | std::ios::out | std::ios::binary);
+            logFile.seekp(-20, std::ios::end);
+            logFile.put('X');
+        }
+
+        lcp::FileStorageProvider storage(&fsProvider, StoragePath, StorageKey());
+        storage.Open();
+        ASSERT_TRUE(storage.GetValue(lcp::LicenseRightsVaultId, "license|print").empty());
+        RemoveStorage();
+    }
+
+    TEST(FileStorageProviderTest, OtherKeyIsRejected)
+    {
+        RemoveStorage();
+        lcp::DefaultFileSystemProvider fsProvider;
+        lcp::StorageProviderCreator creator;
+        lcp::IStorageProvider * storage = nullptr;
+        std::string key(lcp::FileStorageProvider::KeySize, '\x01');
+        lcp::Status status = creator.CreateFileStorageProvider(StoragePath, key, &fsProvider, &storage);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, status.Code);
+        storage->SetValue(lcp::UserKeysVaultId, "provider|user", "key1");
+        delete storage;
+        storage = nullptr;
+
+        std::string otherKey(lcp::FileStorageProvider::KeySize, '\x02');
+        status = creator.CreateFileStorageProvider(StoragePath, otherKey, &fsProvider, &storage);
+        ASSERT_EQ(lcp::StatusCode::ErrorDecryptionCommonError, status.Code);
+        ASSERT_EQ(nullptr, storage);
+        ASSERT_FALSE(ReadFileContent(FirstLogPath).empty());
+        RemoveStorage();
+    }
+}
@@ -0,0 +1,179 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "IncludeMacros.h"
+#include "TestStorageProvider.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+#include "ziplib/Source/ZipLib/methods/StoreMethod.h"
+ZIPLIB_INCLUDE_END
+
+namespace lcptest
+{
+    static const char * SourcePath = "packager_test.epub";
+    static const char * PackagedPath = "packager_test_protected.epub";
+    static const char * ExportedPath = "packager_test_exported.epub";
+    static const char * StoragePath = "packager_test_storage.json";
+    static const char * Provider = "https://provider.example.com";
+
+    static std::string ContainerXml()
+    {
+        return
+            "<?xml version=\"1.0\"?>\n"
+            "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+            "  <rootfiles>\n"
+            "    <rootfile full-path=\"OEBPS/package.xml\" media-type=\"application/oebps-package+xml\"/>\n"
+            "  </rootfiles>\n"
+            "</container>\n";
+    }
+
+    static std::string ChapterText()
+    {
+        std::stringstream content;
+        for (int i = 0; i < 300; ++i)
+        {
+            content << "<p>Sentence " << i << " of the packaged chapter.</p>\n";
+        }
+        return content.str();
+    }
+
+    static void AddSourceEntry(const std::string & name, const std::string & content, bool stored)
+    {
+        std::stringstream stream(content);
+        if (stored)
+        {
+            ZipFile::AddFile(SourcePath, stream, name, StoreMethod::Create());
+        }
+        else
+        {
+            ZipFile::AddFile(SourcePath, stream, name);
+        }
+    }
+
+    static std::string ReadPackagedEntry(const std::string & path, const std::string & name)
+    {
+        ZipArchive::Ptr archive = ZipFile::Open(path);
+        ZipArchiveEntry::Ptr entry = archive->GetEntry(name);
+        if (entry == nullptr)
+        {
+            return std::string();
+        }
+        std::istream * stream = entry->GetDecompressionStream();
+        return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+    }
+
+    class LcpPackagerTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            this->RemoveFiles();
+            AddSourceEntry("mimetype", "application/epub+zip", true);
+            AddSourceEntry("META-INF/container.xml", ContainerXml(), false);
+            AddSourceEntry("OEBPS/package.xml", "<package/>", false);
+            AddSourceEntry("OEBPS/chapter.xhtml", ChapterText(), false);
+        }
+
+        virtual void TearDown()
+        {
+            this->RemoveFiles();
+        }
+
+        void RemoveFiles()
+        {
+            std::remove(SourcePath);
+            std::remove(PackagedPath);
+            std::remove(ExportedPath);
+            std::remove(StoragePath);
+        }
+
+    protected:
+        lcp::DefaultFileSystemProvider m_fileSystemProvider;
+        lcp::LcpPackager m_packager;
+    };
+
+#if ENABLE_TEST_LICENSE_ISSUER
+    TEST_F(LcpPackagerTest, IssuesLicensesForPackagedPublications)
+    {
+        lcp::TestAuthority authority;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, m_packager.CreateTestAuthority(Provider, authority).Code);
+        std::string contentKey;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, m_packager.GenerateContentKey(contentKey).Code);
+        ASSERT_EQ(32u, contentKey.size());
+
+        lcp::Status status = m_packager.EncryptPublication(
+            &m_fileSystemProvider, SourcePath, PackagedPath, contentKey, true,
+            [](const std::string &) { return lcp::LcpPackager::AesGcm; }
+            );
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, status.Code) << status.Extension;
+        ASSERT_EQ(std::string::npos, ReadPackagedEntry(PackagedPath, "OEBPS/chapter.xhtml").find("Sentence"));
+        EXPECT_EQ("<package/>", ReadPackagedEntry(PackagedPath, "OEBPS/package.xml"));
+
+        lcp::TestLicenseInfo licenseInfo;
+        licenseInfo.userId = "user-1";
+        licenseInfo.passphrase = "open sesame";
+        licenseInfo.passphraseHint = "The usual one";
+        licenseInfo.publicationHref = "https://provider.example.com/chapter.epub";
+        std::string licenseJson;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, m_packager.IssueTestLicense(authority, contentKey, licenseInfo, licenseJson).Code);
+
+        std::unique_ptr<TestStorageProvider> storageProvider(new TestStorageProvider(StoragePath, true));
+        lcp::ILcpService * lcpServiceRaw = nullptr;
+        lcp::LcpServiceCreator creator;
+        status = creator.CreateLcpService(authority.rootCertificate, nullptr, storageProvider.get(), &m_fileSystemProvider, &lcpServiceRaw);
+        std::unique_ptr<lcp::ILcpService> lcpService(lcpServiceRaw);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, status.Code) << status.Extension;
+
+        lcp::ILicense * license = nullptr;
+        status = lcpService->OpenLicense(PackagedPath, licenseJson, &license);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, status.Code) << status.Extension;
+        EXPECT_EQ(Provider, license->Provider());
+        EXPECT_EQ(lcp::StatusCode::ErrorDecryptionUserPassphraseNotValid, lcpService->DecryptLicense(license, "wrong").Code);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, lcpService->DecryptLicense(license, licenseInfo.passphrase).Code);
+
+        status = lcpService->ExportPublication(license, PackagedPath, ExportedPath, lcp::ILcpService::ExportToEpub);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, status.Code) << status.Extension;
+        EXPECT_EQ(ChapterText(), ReadPackagedEntry(ExportedPath, "OEBPS/chapter.xhtml"));
+        EXPECT_EQ("application/epub+zip", ReadPackagedEntry(ExportedPath, "mimetype"));
+    }
+#endif //ENABLE_TEST_LICENSE_ISSUER
+
+    TEST_F(LcpPackagerTest, ReportsUnreadablePublications)
+    {
+        std::string contentKey;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, m_packager.GenerateContentKey(contentKey).Code);
+        lcp::Status status = m_packager.EncryptPublication(&m_fileSystemProvider, "missing.epub", PackagedPath, contentKey, false);
+        EXPECT_EQ(lcp::StatusCode::ErrorDecryptionCommonError, status.Code);
+    }
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <memory>
+#include <gtest/gtest.h>
+#include "rapidjson/document.h"
+#include "public/lcp.h"
+#include "LinksLcpNode.h"
+#include "JsonValueReader.h"
+#include "LcpUtils.h"
+
+namespace lcptest
+{
+    static void ParseLinks(const char * json, rapidjson::Document & document, lcp::LinksLcpNode & links)
+    {
+        document.Parse(json);
+        lcp::JsonValueReader reader;
+        links.ParseNode(document, &reader);
+    }
+
+    TEST(LinksLcpNodeTest, LinksArrayLookup)
+    {
+        rapidjson::Document document;
+        lcp::LinksLcpNode links;
+        ParseLinks("{\"links\":["
+            "{\"rel\":\"hint\",\"href\":\"http://example.com/hint\"},"
+            "{\"rel\":\"publication\",\"href\":\"http://example.com/book.epub\",\"type\":\"application/epub+zip\",\"length\":42},"
+            "{\"rel\":\"support\",\"href\":\"mailto:support@example.com\"},"
+            "{\"rel\":\"support\",\"href\":\"http://example.com/support\"}"
+            "]}", document, links);
+
+        ASSERT_TRUE(links.Has(lcp::Publication));
+        ASSERT_FALSE(links.Has("status"));
+        ASSERT_FALSE(links.HasMany(lcp::Publication));
+        ASSERT_TRUE(links.HasMany("support"));
+
+        lcp::Link link;
+        ASSERT_TRUE(links.GetLink(lcp::Publication, link));
+        ASSERT_STREQ("http://example.com/book.epub", link.href.c_str());
+        ASSERT_STREQ("application/epub+zip", link.type.c_str());
+        ASSERT_EQ(42, link.length);
+
+        std::vector<lcp::Link> supportLinks;
+        ASSERT_TRUE(links.GetLinks("support", supportLinks));
+        ASSERT_EQ(2, supportLinks.size());
+        ASSERT_STREQ("http://example.com/support", supportLinks[1].href.c_str());
+
+        std::unique_ptr<lcp::IKeyValueIterator<std::string, lcp::Link> > it(links.Enumerate());
+        int count = 0;
+        for (it->First(); !it->IsDone(); it->Next())
+        {
+            ++count;
+        }
+        ASSERT_EQ(4, count);
+    }
+
+    TEST(LinksLcpNodeTest, LinksObjectLookup)
+    {
+        rapidjson::Document document;
+        lcp::LinksLcpNode links;
+        ParseLinks("{\"links\":{"
+            "\"hint\":{\"href\":\"http://example.com/hint\"},"
+            "\"publication\":{\"href\":\"http://example.com/book.epub\"},"
+            "\"support\":[{\"href\":\"mailto:support@example.com\"},{\"href\":\"http://example.com/support\"}]"
+            "}}", document, links);
+
+        lcp::Link link;
+        ASSERT_TRUE(links.GetLink(lcp::Publication, link));
+        ASSERT_STREQ("http://example.com/book.epub", link.href.c_str());
+        ASSERT_TRUE(links.HasMany("support"));
+        ASSERT_FALSE(links.GetLink("status", link));
+    }
+
+    TEST(LinksLcpNodeTest, LinkWithoutHrefIsRejectedOnParsing)
+    {
+        rapidjson::Document document;
+        lcp::LinksLcpNode links;
+        ASSERT_THROW(ParseLinks("{\"links\":["
+            "{\"rel\":\"hint\",\"href\":\"http://example.com/hint\"},"
+            "{\"rel\":\"publication\",\"type\":\"application/epub+zip\"}"
+            "]}", document, links), lcp::StatusException);
+    }
+}
@@ -0,0 +1,316 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "IncludeMacros.h"
+#include "AesCbcSymmetricAlgorithm.h"
+#include "AlgorithmNames.h"
+#include "Lcp1dot0EncryptionProfile.h"
+#include "LcpUtils.h"
+#include "PublicationEncryptor.h"
+#include "PublicationExporter.h"
+#include "SymmetricAlgorithmEncryptedStream.h"
+#include "WorkerPool.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+#include "ziplib/Source/ZipLib/methods/StoreMethod.h"
+ZIPLIB_INCLUDE_END
+
+namespace lcptest
+{
+    static const char * CleartextPath = "encrypt_test.epub";
+    static const char * ProtectedPath = "encrypt_test_protected.epub";
+    static const char * ExportDirectory = "encrypt_test";
+    static const char * FontAlgorithm = "http://www.idpf.org/2008/embedding";
+
+    static lcp::KeyType EncryptionKey()
+    {
+        return lcp::KeyType(32, 9);
+    }
+
+    static std::string TextContent()
+    {
+        std::stringstream content;
+        for (int i = 0; i < 800; ++i)
+        {
+            content << "<p>Line " << i << " of the text.</p>\n";
+        }
+        return content.str();
+    }
+
+    static std::string PictureContent()
+    {
+        std::string content;
+        for (int i = 0; i < 5000; ++i)
+        {
+            content += static_cast<char>((i * 17) % 253);
+        }
+        return content;
+    }
+
+    static std::string FontEncryptionXml()
+    {
+        return std::string("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n")
+            + "<encryption xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\" xmlns:enc=\"http://www.w3.org/2001/04/xmlenc#\">\n"
+            + "<enc:EncryptedData><enc:EncryptionMethod Algorithm=\"" + FontAlgorithm + "\"/>"
+            + "<enc:CipherData><enc:CipherReference URI=\"OEBPS/font.otf\"/></enc:CipherData></enc:EncryptedData>\n"
+            + "</encryption>\n";
+    }
+
+    static void AddCleartextEntry(const std::string & name, const std::string & content, bool stored)
+    {
+        std::stringstream stream(content);
+        if (stored)
+        {
+            ZipFile::AddFile(CleartextPath, stream, name, StoreMethod::Create());
+        }
+        else
+        {
+            ZipFile::AddFile(CleartextPath, stream, name);
+        }
+    }
+
+    static std::string ReadExportedFile(const std::string & path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static std::string ReadArchiveEntry(ZipArchive::Ptr archive, const std::string & name)
+    {
+        ZipArchiveEntry::Ptr entry = archive->GetEntry(name);
+        if (entry == nullptr)
+        {
+            return std::string();
+        }
+        std::istream * stream = entry->GetDecompressionStream();
+        return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+    }
+
+    class PublicationEncryptorTest : public ::testing::Test
+    {
+    protected:
+        PublicationEncryptorTest()
+            : m_workerPool(4)
+            , m_encryptor(&m_fileSystemProvider, &m_workerPool, &m_profile, 100)
+        {
+        }
+
+        virtual void SetUp()
+        {
+            this->RemoveFiles();
+            AddCleartextEntry("mimetype", "application/epub+zip", true);
+            AddCleartextEntry("META-INF/container.xml", "<container/>", false);
+            AddCleartextEntry("META-INF/encryption.xml", FontEncryptionXml(), false);
+            AddCleartextEntry("OEBPS/text 1.xhtml", TextContent(), false);
+            AddCleartextEntry("OEBPS/picture.png", PictureContent(), true);
+            AddCleartextEntry("OEBPS/font.otf", "obfuscated font", false);
+            AddCleartextEntry("OEBPS/empty.css", "", true);
+        }
+
+        virtual void TearDown()
+        {
+            this->RemoveFiles();
+        }
+
+        void RemoveFiles()
+        {
+            std::remove(CleartextPath);
+            std::remove(ProtectedPath);
+            const char * exported[] = {
+                "mimetype", "META-INF/container.xml", "META-INF/encryption.xml", "OEBPS/text 1.xhtml",
+                "OEBPS/picture.png", "OEBPS/font.otf", "OEBPS/empty.css", "META-INF", "OEBPS", ""
+            };
+            for (const char * name : exported)
+            {
+                std::remove((std::string(ExportDirectory) + "/" + name).c_str());
+            }
+        }
+
+        void Encrypt(bool compress)
+        {
+            m_encryptor.Encrypt(CleartextPath, ProtectedPath, EncryptionKey(), [](const std::string & entryName)
+            {
+                return (entryName == "OEBPS/picture.png") ? lcp::AlgorithmNames::AesGcm256Id : lcp::AlgorithmNames::AesCbc256Id;
+            }, compress, nullptr, nullptr);
+        }
+
+        void Export()
+        {
+            lcp::PublicationExporter exporter(
+                &m_fileSystemProvider,
+                &m_workerPool,
+                [this](lcp::IReadableStream * stream, const std::string & algorithm, lcp::IEncryptedStream ** encStream)
+                {
+                    std::unique_ptr<lcp::ISymmetricAlgorithm> decryption(m_profile.CreatePublicationAlgorithm(EncryptionKey(), algorithm));
+                    *encStream = new lcp::SymmetricAlgorithmEncryptedStream(stream, std::move(decryption));
+                    return lcp::Status(lcp::StatusCode::ErrorCommonSuccess);
+                },
+                100);
+            exporter.Export(ProtectedPath, ExportDirectory, lcp::ILcpService::ExportToDirectory, nullptr, nullptr);
+        }
+
+    protected:
+        lcp::DefaultFileSystemProvider m_fileSystemProvider;
+        lcp::Lcp1dot0EncryptionProfile m_profile;
+        lcp::WorkerPool m_workerPool;
+        lcp::PublicationEncryptor m_encryptor;
+    };
+
+    TEST_F(PublicationEncryptorTest, ListsEncryptedResources)
+    {
+        this->Encrypt(true);
+
+        ZipArchive::Ptr archive = ZipFile::Open(ProtectedPath);
+        ASSERT_EQ(7u, archive->GetEntriesCount());
+        EXPECT_EQ("mimetype", archive->GetEntry(0)->GetFullName());
+        EXPECT_EQ(0, archive->GetEntry(0)->GetCompressionMethod());
+        EXPECT_EQ(0, archive->GetEntry("OEBPS/text 1.xhtml")->GetCompressionMethod());
+        EXPECT_EQ(std::string::npos, ReadArchiveEntry(archive, "OEBPS/text 1.xhtml").find("<p>"));
+        EXPECT_EQ("obfuscated font", ReadArchiveEntry(archive, "OEBPS/font.otf"));
+        EXPECT_EQ("<container/>", ReadArchiveEntry(archive, "META-INF/container.xml"));
+
+        std::string encryptionXml = ReadArchiveEntry(archive, "META-INF/encryption.xml");
+        EXPECT_NE(std::string::npos, encryptionXml.find("URI=\"OEBPS/text%201.xhtml\""));
+        std::vector<lcp::PublicationExporter::EncryptedResource> resources = lcp::PublicationExporter::ParseEncryption(encryptionXml);
+        ASSERT_EQ(4u, resources.size());
+        EXPECT_EQ("OEBPS/font.otf", resources[0].path);
+        EXPECT_EQ(FontAlgorithm, resources[0].algorithm);
+        EXPECT_EQ("OEBPS/text 1.xhtml", resources[1].path);
+        EXPECT_EQ(lcp::AlgorithmNames::AesCbc256Id, resources[1].algorithm);
+        EXPECT_TRUE(resources[1].compressed);
+        EXPECT_EQ(static_cast<int64_t>(TextContent().size()), resources[1].originalLength);
+        EXPECT_EQ("OEBPS/picture.png", resources[2].path);
+        EXPECT_EQ(lcp::AlgorithmNames::AesGcm256Id, resources[2].algorithm);
+        EXPECT_FALSE(resources[2].compressed);
+        EXPECT_EQ("OEBPS/empty.css", resources[3].path);
+    }
+
+    TEST_F(PublicationEncryptorTest, ExportsWhatItEncrypts)
+    {
+        for (bool compress : { true, false })
+        {
+            this->Encrypt(compress);
+            this->Export();
+
+            std::string directory = std::string(ExportDirectory) + "/";
+            EXPECT_EQ("application/epub+zip", ReadExportedFile(directory + "mimetype"));
+            EXPECT_EQ(TextContent(), ReadExportedFile(directory + "OEBPS/text 1.xhtml"));
+            EXPECT_EQ(PictureContent(), ReadExportedFile(directory + "OEBPS/picture.png"));
+            EXPECT_EQ("obfuscated font", ReadExportedFile(directory + "OEBPS/font.otf"));
+            EXPECT_EQ("", ReadExportedFile(directory + "OEBPS/empty.css"));
+
+            std::vector<lcp::PublicationExporter::EncryptedResource> resources =
+                lcp::PublicationExporter::ParseEncryption(ReadExportedFile(directory + "META-INF/encryption.xml"));
+            ASSERT_EQ(1u, resources.size());
+            EXPECT_EQ("OEBPS/font.otf", resources[0].path);
+
+            this->TearDown();
+            this->SetUp();
+        }
+    }
+
+    TEST_F(PublicationEncryptorTest, RejectsTamperedGcmResources)
+    {
+        this->Encrypt(false);
+        std::string picture;
+        {
+            ZipArchive::Ptr archive = ZipFile::Open(ProtectedPath);
+            picture = ReadArchiveEntry(archive, "OEBPS/picture.png");
+        }
+        ASSERT_FALSE(picture.empty());
+        picture.back() ^= 1;
+        ZipFile::RemoveEntry(ProtectedPath, "OEBPS/picture.png");
+        std::stringstream tampered(picture);
+        ZipFile::AddFile(ProtectedPath, tampered, "OEBPS/picture.png", StoreMethod::Create());
+
+        EXPECT_THROW(this->Export(), std::exception);
+        std::ifstream exported((std::string(ExportDirectory) + "/OEBPS/picture.png").c_str());
+        EXPECT_FALSE(exported.is_open());
+    }
+
+    TEST_F(PublicationEncryptorTest, RejectsProtectedPublications)
+    {
+        this->Encrypt(true);
+        std::rename(ProtectedPath, "encrypt_test_again.epub");
+        EXPECT_THROW(
+            m_encryptor.Encrypt("encrypt_test_again.epub", ProtectedPath, EncryptionKey(), [](const std::string &)
+            {
+                return lcp::AlgorithmNames::AesCbc256Id;
+            }, true, nullptr, nullptr),
+            std::runtime_error);
+        std::remove("encrypt_test_again.epub");
+
+        std::ifstream output(ProtectedPath);
+        EXPECT_FALSE(output.is_open());
+    }
+
+    TEST_F(PublicationEncryptorTest, ChecksEntryNames)
+    {
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsEncryptable("mimetype"));
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsEncryptable("META-INF/container.xml"));
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsEncryptable("OEBPS/content.opf"));
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsEncryptable("OEBPS/Content.OPF"));
+        EXPECT_TRUE(lcp::PublicationEncryptor::IsEncryptable("OEBPS/chapter.xhtml"));
+
+        EXPECT_TRUE(lcp::PublicationEncryptor::IsCompressedMedia("OEBPS/cover.JPG"));
+        EXPECT_TRUE(lcp::PublicationEncryptor::IsCompressedMedia("audio/track.mp3"));
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsCompressedMedia("OEBPS/chapter.xhtml"));
+        EXPECT_FALSE(lcp::PublicationEncryptor::IsCompressedMedia("OEBPS.png/chapter"));
+
+        EXPECT_EQ("OEBPS/a%20b%26c%C3%A9.xhtml", lcp::PublicationEncryptor::EscapeUri("OEBPS/a b&c\xC3\xA9.xhtml"));
+    }
+
+    TEST(AesCbcPlainTextSizeTest, BlockAlignedPlainTextDropsTheWholePaddingBlock)
+    {
+        static const char * Path = "encrypt_test_aligned.bin";
+        lcp::DefaultFileSystemProvider fsProvider;
+        lcp::AesCbcSymmetricAlgorithm aesCbc(EncryptionKey());
+        std::string plainText(32, 'a');
+        {
+            std::unique_ptr<lcp::IFile> file(fsProvider.GetFile(Path, lcp::IFileSystemProvider::CreateNew));
+            std::unique_ptr<lcp::IEncryptor> encryptor(aesCbc.CreateEncryptor(EncryptionKey(), file.get()));
+            encryptor->Update(reinterpret_cast<const unsigned char *>(plainText.data()), plainText.size());
+            encryptor->Finish();
+        }
+
+        std::unique_ptr<lcp::IFile> file(fsProvider.GetFile(Path, lcp::IFileSystemProvider::ReadOnly));
+        EXPECT_EQ(64, file->Size());
+        EXPECT_EQ(plainText.size(), aesCbc.PlainTextSize(file.get()));
+        file.reset();
+        std::remove(Path);
+    }
+}
@@ -0,0 +1,320 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "IncludeMacros.h"
+#include "AesCbcSymmetricAlgorithm.h"
+#include "LcpUtils.h"
+#include "PublicationExporter.h"
+#include "SymmetricAlgorithmEncryptedStream.h"
+#include "WorkerPool.h"
+
+CRYPTOPP_INCLUDE_START
+#include <cryptopp/aes.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/modes.h>
+CRYPTOPP_INCLUDE_END
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+#include "ziplib/Source/ZipLib/methods/StoreMethod.h"
+#include "ziplib/Source/ZipLib/extlibs/zlib/zlib.h"
+ZIPLIB_INCLUDE_END
+
+namespace lcptest
+{
+    static const char * PublicationPath = "export_test.epub";
+    static const char * ExportDirectory = "export_test";
+    static const char * ExportEpubPath = "export_test_out.epub";
+    static const char * ObfuscationAlgorithm = "http://www.idpf.org/2008/embedding";
+
+    static lcp::KeyType ContentKey()
+    {
+        return lcp::KeyType(32, 7);
+    }
+
+    static std::string ChapterContent()
+    {
+        std::stringstream content;
+        for (int i = 0; i < 500; ++i)
+        {
+            content << "<p>Paragraph " << i << " of the chapter.</p>\n";
+        }
+        return content.str();
+    }
+
+    static std::string ImageContent()
+    {
+        std::string content;
+        for (int i = 0; i < 3000; ++i)
+        {
+            content += static_cast<char>((i * 31) % 251);
+        }
+        return content;
+    }
+
+    static std::string Deflate(const std::string & data)
+    {
+        z_stream stream = z_stream();
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::string deflated(deflateBound(&stream, static_cast<uLong>(data.size())), 0);
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef *>(&deflated[0]);
+        stream.avail_out = static_cast<uInt>(deflated.size());
+        deflate(&stream, Z_FINISH);
+        deflated.resize(stream.total_out);
+        deflateEnd(&stream);
+        return deflated;
+    }
+
+    // IV followed by the AES-256-CBC cipher text, as in LCP publications
+    static std::string Encrypt(const std::string & data)
+    {
+        lcp::KeyType key = ContentKey();
+        std::string iv(CryptoPP::AES::BLOCKSIZE, 3);
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encryption(
+            key.data(), key.size(), reinterpret_cast<const unsigned char *>(iv.data()));
+        std::string encrypted;
+        CryptoPP::StringSource(data, true,
+            new CryptoPP::StreamTransformationFilter(encryption, new CryptoPP::StringSink(encrypted)));
+        return iv + encrypted;
+    }
+
+    static std::string EncryptionXml(size_t chapterLength)
+    {
+        std::stringstream xml;
+        xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<encryption xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\""
+            << " xmlns:enc=\"http://www.w3.org/2001/04/xmlenc#\" xmlns:ds=\"http://www.w3.org/2000/09/xmldsig#\">\n"
+            << "<!-- <enc:EncryptedData><enc:CipherReference URI=\"commented\"/></enc:EncryptedData> -->\n"
+            << "<enc:EncryptedData>"
+            << "<enc:EncryptionMethod Algorithm=\"http://www.w3.org/2001/04/xmlenc#aes256-cbc\"/>"
+            << "<ds:KeyInfo><ds:RetrievalMethod URI=\"license.lcpl#/encryption/content_key\"/></ds:KeyInfo>"
+            << "<enc:CipherData><enc:CipherReference URI=\"OEBPS/chapter%201.xhtml\"/></enc:CipherData>"
+            << "<enc:EncryptionProperties><enc:EncryptionProperty xmlns:ns=\"http://www.idpf.org/2016/encryption#compression\">"
+            << "<ns:Compression Method=\"8\" OriginalLength=\"" << chapterLength << "\"/>"
+            << "</enc:EncryptionProperty></enc:EncryptionProperties>"
+            << "</enc:EncryptedData>\n"
+            << "<enc:EncryptedData>"
+            << "<enc:EncryptionMethod Algorithm='http://www.w3.org/2001/04/xmlenc#aes256-cbc'/>"
+            << "<enc:CipherData><enc:CipherReference URI='OEBPS/image&amp;1.png'/></enc:CipherData>"
+            << "</enc:EncryptedData>\n"
+            << "<enc:EncryptedData>"
+            << "<enc:EncryptionMethod Algorithm=\"" << ObfuscationAlgorithm << "\"/>"
+            << "<enc:CipherData><enc:CipherReference URI=\"OEBPS/font.otf\"/></enc:CipherData>"
+            << "</enc:EncryptedData>\n"
+            << "</encryption>\n";
+        return xml.str();
+    }
+
+    static void AddEntry(const std::string & name, const std::string & content, bool stored)
+    {
+        std::stringstream stream(content);
+        if (stored)
+        {
+            ZipFile::AddFile(PublicationPath, stream, name, StoreMethod::Create());
+        }
+        else
+        {
+            ZipFile::AddFile(PublicationPath, stream, name);
+        }
+    }
+
+    static std::string ReadFileContent(const std::string & path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static std::string ReadEntry(ZipArchive::Ptr archive, const std::string & name)
+    {
+        ZipArchiveEntry::Ptr entry = archive->GetEntry(name);
+        if (entry == nullptr)
+        {
+            return std::string();
+        }
+        std::istream * stream = entry->GetDecompressionStream();
+        return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+    }
+
+    class PublicationExporterTest : public ::testing::Test
+    {
+    protected:
+        PublicationExporterTest()
+            : m_workerPool(4)
+            , m_exporter(
+                &m_fileSystemProvider,
+                &m_workerPool,
+                [](lcp::IReadableStream * stream, const std::string & algorithm, lcp::IEncryptedStream ** encStream)
+                {
+                    std::unique_ptr<lcp::ISymmetricAlgorithm> aesCbc(new lcp::AesCbcSymmetricAlgorithm(ContentKey()));
+                    *encStream = new lcp::SymmetricAlgorithmEncryptedStream(stream, std::move(aesCbc));
+                    return lcp::Status(lcp::StatusCode::ErrorCommonSuccess);
+                },
+                100)
+        {
+        }
+
+        virtual void SetUp()
+        {
+            this->RemoveFiles();
+            std::string chapter = ChapterContent();
+            AddEntry("mimetype", "application/epub+zip", true);
+            AddEntry("META-INF/container.xml", "<container/>", false);
+            AddEntry("META-INF/encryption.xml", EncryptionXml(chapter.size()), false);
+            AddEntry("META-INF/license.lcpl", "{}", false);
+            AddEntry("OEBPS/chapter 1.xhtml", Encrypt(Deflate(chapter)), true);
+            AddEntry("OEBPS/image&1.png", Encrypt(ImageContent()), true);
+            AddEntry("OEBPS/font.otf", "obfuscated font", false);
+        }
+
+        virtual void TearDown()
+        {
+            this->RemoveFiles();
+        }
+
+        void RemoveFiles()
+        {
+            std::remove(PublicationPath);
+            std::remove(ExportEpubPath);
+            const char * exported[] = {
+                "mimetype", "META-INF/container.xml", "META-INF/encryption.xml",
+                "OEBPS/chapter 1.xhtml", "OEBPS/image&1.png", "OEBPS/font.otf", "META-INF", "OEBPS", ""
+            };
+            for (const char * name : exported)
+            {
+                std::remove((std::string(ExportDirectory) + "/" + name).c_str());
+            }
+        }
+
+    protected:
+        lcp::DefaultFileSystemProvider m_fileSystemProvider;
+        lcp::WorkerPool m_workerPool;
+        lcp::PublicationExporter m_exporter;
+    };
+
+    TEST_F(PublicationExporterTest, ParsesEncryptedResources)
+    {
+        std::string xml = EncryptionXml(42);
+        std::vector<lcp::PublicationExporter::EncryptedResource> resources = lcp::PublicationExporter::ParseEncryption(xml);
+
+        ASSERT_EQ(3u, resources.size());
+        EXPECT_EQ("OEBPS/chapter 1.xhtml", resources[0].path);
+        EXPECT_EQ("http://www.w3.org/2001/04/xmlenc#aes256-cbc", resources[0].algorithm);
+        EXPECT_TRUE(resources[0].compressed);
+        EXPECT_EQ(42, resources[0].originalLength);
+        EXPECT_EQ(0u, xml.compare(resources[0].elementBegin, 18, "<enc:EncryptedData"));
+        EXPECT_EQ(0u, xml.compare(resources[0].elementEnd - 20, 20, "</enc:EncryptedData>"));
+
+        EXPECT_EQ("OEBPS/image&1.png", resources[1].path);
+        EXPECT_FALSE(resources[1].compressed);
+        EXPECT_EQ(-1, resources[1].originalLength);
+        EXPECT_EQ(ObfuscationAlgorithm, resources[2].algorithm);
+    }
+
+    TEST_F(PublicationExporterTest, RejectsUnsafeEntryNames)
+    {
+        EXPECT_TRUE(lcp::PublicationExporter::IsSafeEntryName("OEBPS/chapter.xhtml"));
+        EXPECT_TRUE(lcp::PublicationExporter::IsSafeEntryName("OEBPS/..chapter.xhtml"));
+        EXPECT_FALSE(lcp::PublicationExporter::IsSafeEntryName("/etc/passwd"));
+        EXPECT_FALSE(lcp::PublicationExporter::IsSafeEntryName("C:/windows"));
+        EXPECT_FALSE(lcp::PublicationExporter::IsSafeEntryName("OEBPS/../../outside"));
+        EXPECT_FALSE(lcp::PublicationExporter::IsSafeEntryName("OEBPS\\..\\..\\outside"));
+        EXPECT_FALSE(lcp::PublicationExporter::IsSafeEntryName(".."));
+    }
+
+    TEST_F(PublicationExporterTest, ExportsToDirectory)
+    {
+        std::vector<size_t> progress;
+        m_exporter.Export(PublicationPath, ExportDirectory, lcp::ILcpService::ExportToDirectory,
+            [&](size_t exportedEntries, size_t entriesCount)
+            {
+                progress.push_back(exportedEntries);
+                EXPECT_EQ(6u, entriesCount);
+            },
+            nullptr);
+
+        std::string directory = std::string(ExportDirectory) + "/";
+        EXPECT_EQ("application/epub+zip", ReadFileContent(directory + "mimetype"));
+        EXPECT_EQ(ChapterContent(), ReadFileContent(directory + "OEBPS/chapter 1.xhtml"));
+        EXPECT_EQ(ImageContent(), ReadFileContent(directory + "OEBPS/image&1.png"));
+        EXPECT_EQ("obfuscated font", ReadFileContent(directory + "OEBPS/font.otf"));
+        EXPECT_TRUE(ReadFileContent(directory + "META-INF/license.lcpl").empty());
+
+        std::string encryptionXml = ReadFileContent(directory + "META-INF/encryption.xml");
+        EXPECT_EQ(std::string::npos, encryptionXml.find("chapter"));
+        EXPECT_EQ(std::string::npos, encryptionXml.find("image"));
+        EXPECT_NE(std::string::npos, encryptionXml.find("OEBPS/font.otf"));
+
+        EXPECT_EQ((std::vector<size_t>{ 1, 2, 3, 4, 5, 6 }), progress);
+    }
+
+    TEST_F(PublicationExporterTest, ExportsToEpub)
+    {
+        m_exporter.Export(PublicationPath, ExportEpubPath, lcp::ILcpService::ExportToEpub, nullptr, nullptr);
+
+        ZipArchive::Ptr archive = ZipFile::Open(ExportEpubPath);
+        ASSERT_EQ(6u, archive->GetEntriesCount());
+        EXPECT_EQ("mimetype", archive->GetEntry(0)->GetFullName());
+        EXPECT_EQ(0, archive->GetEntry(0)->GetCompressionMethod());
+        EXPECT_EQ("application/epub+zip", ReadEntry(archive, "mimetype"));
+        EXPECT_EQ(ChapterContent(), ReadEntry(archive, "OEBPS/chapter 1.xhtml"));
+        EXPECT_EQ(ImageContent(), ReadEntry(archive, "OEBPS/image&1.png"));
+        EXPECT_EQ(nullptr, archive->GetEntry("META-INF/license.lcpl"));
+        archive.reset();
+
+        std::ifstream staged((std::string(ExportEpubPath) + ".0.part").c_str());
+        EXPECT_FALSE(staged.is_open());
+    }
+
+    TEST_F(PublicationExporterTest, StopsWhenCanceled)
+    {
+        lcp::CancellationToken cancellation;
+        cancellation.Cancel();
+        try
+        {
+            m_exporter.Export(PublicationPath, ExportEpubPath, lcp::ILcpService::ExportToEpub, nullptr, &cancellation);
+            FAIL() << "The export must be canceled";
+        }
+        catch (const lcp::StatusException & ex)
+        {
+            EXPECT_EQ(lcp::StatusCode::ErrorCommonOperationCanceled, ex.ResultStatus().Code);
+        }
+
+        std::ifstream output(ExportEpubPath);
+        EXPECT_FALSE(output.is_open());
+    }
+}
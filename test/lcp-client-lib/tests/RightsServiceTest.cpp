@@ -25,14 +25,235 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <atomic>
 #include <memory>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include "public/lcp.h"
+#include "RightsService.h"
+#include "RightsLcpNode.h"
 #include "TestStorageProvider.h"
 #include "TestInfo.h"
 
 namespace lcptest
 {
+    static const char * TtsRight = "tts";
+
+    class RightsTestUser : public lcp::IUser
+    {
+    public:
+        virtual std::string Id() const { return "user"; }
+        virtual std::string Email() const { return std::string(); }
+        virtual std::string Name() const { return std::string(); }
+        virtual bool HasUserValue(const std::string & name) const { return false; }
+        virtual bool GetUserValue(const std::string & name, std::string & value) const { return false; }
+        virtual lcp::KvStringsIterator * Enumerate() const { return nullptr; }
+    };
+
+    class RightsTestLicense : public lcp::ILicense
+    {
+    public:
+        explicit RightsTestLicense(const std::string & id) : m_id(id) {}
+        virtual std::string Id() const { return m_id; }
+        virtual std::string CanonicalContent() const { return std::string(); }
+        virtual std::string OriginalContent() const { return std::string(); }
+        virtual std::string Issued() const { return std::string(); }
+        virtual std::string Updated() const { return std::string(); }
+        virtual std::string Provider() const { return "http://example.com"; }
+        virtual lcp::ICrypto * Crypto() const { return nullptr; }
+        virtual lcp::ILinks * Links() const { return nullptr; }
+        virtual lcp::IUser * User() const { return const_cast<RightsTestUser *>(&m_user); }
+        virtual lcp::IRights * Rights() const { return const_cast<lcp::RightsLcpNode *>(&m_rights); }
+        virtual bool Decrypted() const { return true; }
+        virtual bool getStatusDocumentProcessingFlag() const { return false; }
+        virtual void setStatusDocumentProcessingFlag(bool flag) {}
+
+    private:
+        std::string m_id;
+        RightsTestUser m_user;
+        lcp::RightsLcpNode m_rights;
+    };
+
+    // Storage provider without the prefix enumeration capability
+    class EnumerateOnlyStorageProvider : public TestStorageProvider
+    {
+    public:
+        EnumerateOnlyStorageProvider() : TestStorageProvider("storage.json", true), EnumerateCount(0) {}
+
+        virtual lcp::KvStringsIterator * EnumerateVault(const std::string & vaultId)
+        {
+            ++EnumerateCount;
+            return TestStorageProvider::EnumerateVault(vaultId);
+        }
+
+        virtual lcp::KvStringsIterator * EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix)
+        {
+            return nullptr;
+        }
+
+        int EnumerateCount;
+    };
+
+    // Storage provider counting rights writes, which can be made to fail
+    class CountingStorageProvider : public TestStorageProvider
+    {
+    public:
+        CountingStorageProvider() : TestStorageProvider("storage.json", true), SetValueCount(0), FailWrites(false) {}
+
+        virtual void SetValue(const std::string & vaultId, const std::string & key, const std::string & value)
+        {
+            if (FailWrites)
+            {
+                throw std::runtime_error("Storage is not available");
+            }
+            ++SetValueCount;
+            TestStorageProvider::SetValue(vaultId, key, value);
+        }
+
+        int SetValueCount;
+        bool FailWrites;
+    };
+
+    static const char * RightsJournalPath = "rights.journal";
+
+    TEST(RightsServiceTest, SyncRightsByPrefixIgnoresOtherLicenses)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic@copy", "10");
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic2@copy", "3");
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic2@print", "7");
+
+        lcp::RightsService rightsService(&storageProvider, nullptr, "UnknownUserId");
+        RightsTestLicense license("lic");
+        rightsService.SyncRightsFromStorage(&license);
+
+        ASSERT_STREQ("10", rightsService.GetValue(&license, lcp::CopyRight).c_str());
+        ASSERT_FALSE(license.Rights()->HasRightValue(lcp::PrintRight));
+    }
+
+    TEST(RightsServiceTest, SyncRightsWithoutPrefixCapabilityEnumeratesVaultOnce)
+    {
+        EnumerateOnlyStorageProvider storageProvider;
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic@copy", "10");
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic2@copy", "3");
+
+        lcp::RightsService rightsService(&storageProvider, nullptr, "UnknownUserId");
+        RightsTestLicense license("lic");
+        RightsTestLicense license2("lic2");
+        rightsService.SyncRightsFromStorage(&license);
+        rightsService.SyncRightsFromStorage(&license2);
+        ASSERT_EQ(1, storageProvider.EnumerateCount);
+        ASSERT_STREQ("10", rightsService.GetValue(&license, lcp::CopyRight).c_str());
+        ASSERT_STREQ("3", rightsService.GetValue(&license2, lcp::CopyRight).c_str());
+
+        // Consumption is reflected in the index for licenses synchronized later
+        ASSERT_TRUE(rightsService.UseRight(&license, lcp::CopyRight, 4));
+        RightsTestLicense reopened("lic");
+        rightsService.SyncRightsFromStorage(&reopened);
+        ASSERT_EQ(1, storageProvider.EnumerateCount);
+        ASSERT_STREQ("6", rightsService.GetValue(&reopened, lcp::CopyRight).c_str());
+    }
+
+    TEST(RightsServiceTest, WriteBackJournalCoalescesUntilFlush)
+    {
+        CountingStorageProvider storageProvider;
+        storageProvider.SetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic@copy", "10");
+        storageProvider.SetValueCount = 0;
+
+        lcp::DefaultFileSystemProvider fsProvider;
+        lcp::RightsService rightsService(&storageProvider, &fsProvider, "UnknownUserId");
+        rightsService.EnableWriteBackJournal(RightsJournalPath, 0);
+
+        RightsTestLicense license("lic");
+        rightsService.SyncRightsFromStorage(&license);
+        for (int i = 0; i < 3; ++i)
+        {
+            ASSERT_TRUE(rightsService.UseRight(&license, lcp::CopyRight));
+        }
+        rightsService.SetValue(&license, TtsRight, "false");
+        ASSERT_EQ(0, storageProvider.SetValueCount);
+
+        // Pending values are visible before being flushed
+        RightsTestLicense reopened("lic");
+        rightsService.SyncRightsFromStorage(&reopened);
+        ASSERT_STREQ("7", rightsService.GetValue(&reopened, lcp::CopyRight).c_str());
+        ASSERT_STREQ("false", rightsService.GetValue(&reopened, TtsRight).c_str());
+
+        rightsService.Flush();
+        ASSERT_EQ(2, storageProvider.SetValueCount);
+        ASSERT_STREQ("7", storageProvider.GetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic@copy").c_str());
+
+        rightsService.Flush();
+        ASSERT_EQ(2, storageProvider.SetValueCount);
+        std::remove(RightsJournalPath);
+    }
+
+    TEST(RightsServiceTest, WriteBackJournalIsReplayedOnStartup)
+    {
+        lcp::DefaultFileSystemProvider fsProvider;
+        {
+            CountingStorageProvider lostStorage;
+            lostStorage.FailWrites = true;
+            lcp::RightsService rightsService(&lostStorage, &fsProvider, "UnknownUserId");
+            rightsService.EnableWriteBackJournal(RightsJournalPath, 0);
+
+            RightsTestLicense license("lic");
+            rightsService.SetValue(&license, lcp::PrintRight, "20");
+            ASSERT_TRUE(rightsService.UseRight(&license, lcp::PrintRight, 5));
+            ASSERT_THROW(rightsService.Flush(), std::runtime_error);
+        }
+
+        CountingStorageProvider storageProvider;
+        lcp::RightsService rightsService(&storageProvider, &fsProvider, "UnknownUserId");
+        rightsService.EnableWriteBackJournal(RightsJournalPath, 0);
+
+        RightsTestLicense license("lic");
+        rightsService.SyncRightsFromStorage(&license);
+        ASSERT_STREQ("15", rightsService.GetValue(&license, lcp::PrintRight).c_str());
+
+        rightsService.Flush();
+        ASSERT_EQ(1, storageProvider.SetValueCount);
+        ASSERT_STREQ("15", storageProvider.GetValue(lcp::LicenseRightsVaultId, "http://example.com@user@lic@print").c_str());
+        std::remove(RightsJournalPath);
+    }
+
+    TEST(RightsServiceTest, ConcurrentConsumptionNeverOverdraws)
+    {
+        RightsTestLicense license("lic");
+        lcp::IRightsManager * rightsManager = dynamic_cast<lcp::IRightsManager *>(license.Rights());
+        rightsManager->SetRightValue(lcp::CopyRight, "1000");
+
+        std::atomic<int> used(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                for (int j = 0; j < 200; ++j)
+                {
+                    if (rightsManager->UseRight(lcp::CopyRight, 1))
+                    {
+                        ++used;
+                    }
+                }
+            }));
+        }
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+
+        ASSERT_EQ(1000, used);
+        ASSERT_FALSE(rightsManager->CanUseRight(lcp::CopyRight));
+        std::string value;
+        ASSERT_TRUE(license.Rights()->GetRightValue(lcp::CopyRight, value));
+        ASSERT_STREQ("0", value.c_str());
+        ASSERT_FALSE(license.Rights()->HasRightValue(lcp::PrintRight));
+    }
+
     TEST(RightsServiceTest, RightsServiceTest)
     {
         TestStorageProvider storageProvider("storage.json", true);
@@ -52,7 +273,7 @@ namespace lcptest
             );
 
         lcp::ILicense * license = nullptr;
-        res = lcpService->OpenLicense(mobyDickLicenseStr, &license);
+        res = lcpService->OpenLicense("", mobyDickLicenseStr, &license);
         ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
         res = lcpService->DecryptLicense(license, "White whales are huge!");
         ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
@@ -65,8 +286,8 @@ namespace lcptest
         ASSERT_TRUE(rightsService->CanUseRight(license, lcp::CopyRight));
         ASSERT_STREQ("-1", rightsService->GetValue(license, lcp::CopyRight).c_str());
 
-        ASSERT_TRUE(rightsService->CanUseRight(license, lcp::TtsRight));
-        ASSERT_STREQ("true", rightsService->GetValue(license, lcp::TtsRight).c_str());
+        ASSERT_TRUE(rightsService->CanUseRight(license, TtsRight));
+        ASSERT_STREQ("true", rightsService->GetValue(license, TtsRight).c_str());
 
         ASSERT_TRUE(rightsService->UseRight(license, lcp::PrintRight, 200));
         ASSERT_STREQ("-1", rightsService->GetValue(license, lcp::PrintRight).c_str());
@@ -98,12 +319,12 @@ namespace lcptest
         ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
         
         lcp::ILicense * licenseCheck = nullptr;
-        res = lcpService->OpenLicense(mobyDickLicenseStr, &licenseCheck);
+        res = lcpService->OpenLicense("", mobyDickLicenseStr, &licenseCheck);
         ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
 
         lcp::IRightsService * rightsServiceCheck = lcpService->GetRightsService();
        
-        ASSERT_STREQ("true", rightsServiceCheck->GetValue(licenseCheck, lcp::TtsRight).c_str());
+        ASSERT_STREQ("true", rightsServiceCheck->GetValue(licenseCheck, TtsRight).c_str());
         ASSERT_STREQ("-1", rightsServiceCheck->GetValue(licenseCheck, lcp::CopyRight).c_str());
         ASSERT_STREQ("194342", rightsServiceCheck->GetValue(licenseCheck, lcp::PrintRight).c_str());
         ASSERT_STREQ("true", rightsServiceCheck->GetValue(licenseCheck, "http://www.righttorewrite/com").c_str());
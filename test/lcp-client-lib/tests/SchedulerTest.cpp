@@ -0,0 +1,157 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Scheduler.h"
+#include "WorkerPool.h"
+
+namespace lcptest
+{
+    static bool WaitFor(const std::function<bool()> & predicate)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!predicate())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    TEST(SchedulerTest, TasksRunInDueOrder)
+    {
+        lcp::Scheduler scheduler;
+        std::mutex sync;
+        std::vector<int> order;
+        auto record = [&](int value) { std::unique_lock<std::mutex> locker(sync); order.push_back(value); };
+
+        lcp::Scheduler::TaskId late = scheduler.Register([&]() { record(2); });
+        lcp::Scheduler::TaskId early = scheduler.Register([&]() { record(1); });
+        scheduler.ScheduleAfter(late, lcp::Scheduler::DurationType(150));
+        scheduler.ScheduleAfter(early, lcp::Scheduler::DurationType(20));
+
+        ASSERT_TRUE(WaitFor([&]() { std::unique_lock<std::mutex> locker(sync); return order.size() == 2; }));
+        ASSERT_EQ(1, order[0]);
+        ASSERT_EQ(2, order[1]);
+        ASSERT_FALSE(scheduler.IsScheduled(early));
+    }
+
+    TEST(SchedulerTest, ReschedulingReplacesThePreviousDueTime)
+    {
+        lcp::Scheduler scheduler;
+        std::atomic<int> runs(0);
+        lcp::Scheduler::TaskId task = scheduler.Register([&]() { ++runs; });
+
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType(1000 * 60));
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType::zero());
+        ASSERT_TRUE(WaitFor([&]() { return runs == 1; }));
+
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType(20));
+        scheduler.Unschedule(task);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ASSERT_EQ(1, runs);
+    }
+
+    TEST(SchedulerTest, SchedulingDoesNotWaitForARunningTask)
+    {
+        lcp::Scheduler scheduler;
+        std::atomic<bool> release(false);
+        std::atomic<int> runs(0);
+        lcp::Scheduler::TaskId task = scheduler.Register([&]() {
+            ++runs;
+            while (!release)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType::zero());
+        ASSERT_TRUE(WaitFor([&]() { return runs == 1; }));
+
+        // Due while running: runs again afterwards, never concurrently
+        auto started = std::chrono::steady_clock::now();
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType::zero());
+        ASSERT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(100));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(1, runs);
+
+        release = true;
+        ASSERT_TRUE(WaitFor([&]() { return runs == 2; }));
+        scheduler.Unregister(task);
+    }
+
+    TEST(SchedulerTest, TaskCanRescheduleAndUnregisterItself)
+    {
+        lcp::Scheduler scheduler;
+        std::atomic<int> runs(0);
+        std::atomic<bool> unregistered(false);
+        lcp::Scheduler::TaskId task = 0;
+        task = scheduler.Register([&]() {
+            if (++runs < 3)
+            {
+                scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType(5));
+            }
+            else
+            {
+                scheduler.Unregister(task);
+                unregistered = true;
+            }
+        });
+
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType::zero());
+        ASSERT_TRUE(WaitFor([&]() { return unregistered.load(); }));
+        ASSERT_EQ(3, runs);
+        ASSERT_FALSE(scheduler.IsScheduled(task));
+    }
+
+    TEST(SchedulerTest, TasksRunInTheBackgroundLaneOfAPool)
+    {
+        lcp::WorkerPool pool(2);
+        lcp::Scheduler scheduler(&pool);
+        std::atomic<int> runs(0);
+        lcp::Scheduler::TaskId task = 0;
+        task = scheduler.Register([&]() {
+            if (++runs < 3)
+            {
+                scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType(5));
+            }
+        });
+
+        scheduler.ScheduleAfter(task, lcp::Scheduler::DurationType::zero());
+        ASSERT_TRUE(WaitFor([&]() { return runs == 3; }));
+        scheduler.Unregister(task);
+        ASSERT_FALSE(scheduler.IsScheduled(task));
+    }
+}
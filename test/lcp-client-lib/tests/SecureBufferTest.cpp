@@ -0,0 +1,76 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <cstring>
+#include <thread>
+#include <gtest/gtest.h>
+#include "SecureBuffer.h"
+
+namespace lcptest
+{
+    TEST(SecureBufferTest, ReleasedBuffersAreWipedAndReused)
+    {
+        const unsigned char * first = nullptr;
+        {
+            lcp::SecureBuffer buffer(100);
+            ASSERT_EQ(100, buffer.Size());
+            std::memset(buffer.Data(), 0xA5, buffer.Size());
+            first = buffer.Data();
+        }
+
+        // Any size of the same class gets the block back, wiped
+        lcp::SecureBuffer buffer(128);
+        ASSERT_EQ(first, buffer.Data());
+        for (size_t i = 0; i < buffer.Size(); ++i)
+        {
+            ASSERT_EQ(0, buffer.Data()[i]);
+        }
+    }
+
+    TEST(SecureBufferTest, PoolsAreBoundedAndPerThread)
+    {
+        std::thread thread([]()
+        {
+            {
+                lcp::SecureBuffer buffers[8] = {};
+                for (auto & buffer : buffers)
+                {
+                    buffer = lcp::SecureBuffer(1000);
+                }
+                lcp::SecureBuffer large(lcp::SecureBuffer::MaxPooledSize + 1);
+                ASSERT_EQ(0, lcp::SecureBuffer::PooledCount());
+            }
+            // Large buffers are freed, and a class keeps a few blocks only
+            ASSERT_EQ(4, lcp::SecureBuffer::PooledCount());
+
+            lcp::SecureBuffer moved(lcp::SecureBuffer(1000));
+            ASSERT_EQ(3, lcp::SecureBuffer::PooledCount());
+        });
+        thread.join();
+    }
+}
@@ -28,6 +28,8 @@
 #include <gtest/gtest.h>
 #include "public/lcp.h"
 #include "Sha256HashAlgorithm.h"
+#include "HashingWritableStream.h"
+#include "SimpleMemoryWritableStream.h"
 #include "TestUtils.h"
 #include "TestInfo.h"
 
@@ -43,4 +45,79 @@ namespace lcptest
 
         ASSERT_TRUE(ArraysMatch<lcp::KeyType>(expected, actual));
     }
+
+    TEST(Sha256HashAlgorithmTest, MatchesCryptoppAcrossBlockBoundaries)
+    {
+        std::string content(300, '\0');
+        for (size_t i = 0; i < content.size(); ++i)
+        {
+            content[i] = static_cast<char>(i * 7);
+        }
+
+        for (size_t size : { 0, 1, 55, 56, 63, 64, 65, 119, 128, 300 })
+        {
+            lcp::KeyType expected(CryptoPP::SHA256::DIGESTSIZE);
+            CryptoPP::SHA256().CalculateDigest(expected.data(), reinterpret_cast<const byte *>(content.data()), size);
+
+            lcp::Sha256HashAlgorithm hashAlg;
+            hashAlg.UpdateHash(content.substr(0, size / 3));
+            hashAlg.UpdateHash(content.substr(size / 3, size - size / 3));
+            ASSERT_TRUE(ArraysMatch<lcp::KeyType>(expected, hashAlg.Hash())) << size;
+        }
+    }
+
+    TEST(Sha256HashAlgorithmTest, SavedStateGoesOnInAnotherAlgorithm)
+    {
+        const std::string content = "White whales are huge!";
+        lcp::KeyType expected(TestUserKey, TestUserKey + sizeof(TestUserKey) / sizeof(TestUserKey[0]));
+
+        lcp::SimpleMemoryWritableStream firstPart;
+        lcp::HashingWritableStream firstStream(&firstPart, new lcp::Sha256HashAlgorithm());
+        firstStream.Write(reinterpret_cast<const unsigned char *>(content.data()), 9);
+        lcp::Buffer state = firstStream.SaveState();
+        ASSERT_FALSE(state.empty());
+
+        lcp::SimpleMemoryWritableStream destination;
+        destination.Write(firstPart.Buffer().data(), firstPart.Buffer().size());
+        lcp::HashingWritableStream stream(&destination, new lcp::Sha256HashAlgorithm());
+        ASSERT_TRUE(stream.RestoreState(9, state));
+        stream.Write(reinterpret_cast<const unsigned char *>(content.data()) + 9, content.size() - 9);
+
+        ASSERT_TRUE(stream.IsSequential());
+        ASSERT_EQ(static_cast<int64_t>(content.size()), stream.HashedSize());
+        ASSERT_TRUE(ArraysMatch<lcp::KeyType>(expected, stream.Hash()));
+
+        lcp::Sha256HashAlgorithm hashAlg;
+        state.pop_back();
+        ASSERT_FALSE(hashAlg.RestoreState(state));
+    }
+
+    TEST(Sha256HashAlgorithmTest, SequentialWritesAreHashed)
+    {
+        const std::string content = "White whales are huge!";
+        lcp::SimpleMemoryWritableStream destination;
+        lcp::HashingWritableStream stream(&destination, new lcp::Sha256HashAlgorithm());
+        const unsigned char * data = reinterpret_cast<const unsigned char *>(content.data());
+        stream.Write(data, 5);
+        stream.Write(data + 5, content.size() - 5);
+
+        lcp::KeyType expected(TestUserKey, TestUserKey + sizeof(TestUserKey) / sizeof(TestUserKey[0]));
+        ASSERT_TRUE(stream.IsSequential());
+        ASSERT_EQ(static_cast<int64_t>(content.size()), stream.HashedSize());
+        ASSERT_TRUE(ArraysMatch<lcp::KeyType>(expected, stream.Hash()));
+        ASSERT_EQ(content, std::string(destination.Buffer().begin(), destination.Buffer().end()));
+    }
+
+    TEST(Sha256HashAlgorithmTest, OutOfOrderWritesAreNotHashed)
+    {
+        const unsigned char data[] = { 1, 2, 3, 4 };
+        lcp::SimpleMemoryWritableStream destination;
+        lcp::HashingWritableStream stream(&destination, new lcp::Sha256HashAlgorithm());
+        stream.Write(data, 2);
+        stream.SetWritePosition(0);
+        stream.Write(data, 4);
+
+        ASSERT_FALSE(stream.IsSequential());
+        ASSERT_EQ(4, destination.WritePosition());
+    }
 }
\ No newline at end of file
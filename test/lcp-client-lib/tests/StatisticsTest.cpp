@@ -0,0 +1,175 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "Statistics.h"
+#include "WorkerPool.h"
+
+namespace lcptest
+{
+    TEST(StatisticsTest, CountersAreSummedOverThreads)
+    {
+        lcp::StatisticsSnapshot snapshot;
+        lcp::Statistics::Shared()->Read(snapshot, true);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([]()
+            {
+                for (int j = 0; j < 10000; ++j)
+                {
+                    lcp::Statistics::Increment(lcp::StatisticsCounter::PlainTextSizeCalls);
+                }
+                lcp::Statistics::Increment(lcp::StatisticsCounter::BytesDecryptedAesGcm, 1024);
+            });
+        }
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+
+        lcp::Statistics::Shared()->Read(snapshot, false);
+        ASSERT_EQ(80000, snapshot.counters[lcp::StatisticsCounter::PlainTextSizeCalls]);
+        ASSERT_EQ(8 * 1024, snapshot.counters[lcp::StatisticsCounter::BytesDecryptedAesGcm]);
+    }
+
+    TEST(StatisticsTest, LatenciesAreSortedInPowerOfTwoBuckets)
+    {
+        lcp::StatisticsSnapshot snapshot;
+        lcp::Statistics::Shared()->Read(snapshot, true);
+
+        lcp::Statistics::RecordLatency(lcp::StatisticsOperation::DecryptLicense, std::chrono::microseconds(0));
+        lcp::Statistics::RecordLatency(lcp::StatisticsOperation::DecryptLicense, std::chrono::microseconds(5));
+        lcp::Statistics::RecordLatency(lcp::StatisticsOperation::DecryptLicense, std::chrono::seconds(1));
+        std::thread([]()
+        {
+            lcp::Statistics::RecordLatency(lcp::StatisticsOperation::DecryptLicense, std::chrono::microseconds(7));
+        }).join();
+
+        lcp::Statistics::Shared()->Read(snapshot, false);
+        const lcp::LatencyHistogram & latencies = snapshot.latencies[lcp::StatisticsOperation::DecryptLicense];
+        ASSERT_EQ(4, latencies.count);
+        ASSERT_EQ(1000012, latencies.totalMicroseconds);
+        ASSERT_EQ(1000000, latencies.maxMicroseconds);
+        ASSERT_EQ(1, latencies.buckets[0]);
+        ASSERT_EQ(2, latencies.buckets[3]);
+        ASSERT_EQ(1, latencies.buckets[20]);
+    }
+
+    TEST(StatisticsTest, ResetZeroesTheReadValues)
+    {
+        lcp::StatisticsSnapshot snapshot;
+        lcp::Statistics::Shared()->Read(snapshot, true);
+
+        {
+            lcp::Statistics::Timer timer(lcp::StatisticsOperation::DecryptData);
+            lcp::Statistics::Increment(lcp::StatisticsCounter::StorageProviderCalls, 3);
+        }
+
+        lcp::Statistics::Shared()->Read(snapshot, true);
+        ASSERT_EQ(3, snapshot.counters[lcp::StatisticsCounter::StorageProviderCalls]);
+        ASSERT_EQ(1, snapshot.latencies[lcp::StatisticsOperation::DecryptData].count);
+
+        lcp::Statistics::Shared()->Read(snapshot, false);
+        ASSERT_EQ(0, snapshot.counters[lcp::StatisticsCounter::StorageProviderCalls]);
+        ASSERT_EQ(0, snapshot.latencies[lcp::StatisticsOperation::DecryptData].count);
+    }
+
+    TEST(StatisticsTest, ScopesRecordInTheirOwnStatistics)
+    {
+        lcp::StatisticsSnapshot snapshot;
+        lcp::Statistics::Shared()->Read(snapshot, true);
+        lcp::Statistics first;
+        lcp::Statistics second;
+
+        {
+            lcp::Statistics::Scope firstScope(&first);
+            lcp::Statistics::Increment(lcp::StatisticsCounter::LicensesOpened);
+            {
+                lcp::Statistics::Scope secondScope(&second);
+                lcp::Statistics::Timer timer(lcp::StatisticsOperation::OpenLicense);
+                lcp::Statistics::Increment(lcp::StatisticsCounter::LicensesOpened, 2);
+            }
+            lcp::Statistics::Increment(lcp::StatisticsCounter::LicensesOpened);
+        }
+        lcp::Statistics::Increment(lcp::StatisticsCounter::LicensesOpened, 4);
+
+        {
+            lcp::WorkerPool workerPool(2, &second);
+            std::promise<void> done;
+            workerPool.Post(lcp::WorkerPool::Background, [&done]()
+            {
+                lcp::Statistics::Increment(lcp::StatisticsCounter::CrlChecks);
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+
+        first.Read(snapshot, false);
+        ASSERT_EQ(2, snapshot.counters[lcp::StatisticsCounter::LicensesOpened]);
+        ASSERT_EQ(0, snapshot.counters[lcp::StatisticsCounter::CrlChecks]);
+        ASSERT_EQ(0, snapshot.latencies[lcp::StatisticsOperation::OpenLicense].count);
+
+        second.Read(snapshot, false);
+        ASSERT_EQ(2, snapshot.counters[lcp::StatisticsCounter::LicensesOpened]);
+        ASSERT_EQ(1, snapshot.counters[lcp::StatisticsCounter::CrlChecks]);
+        ASSERT_EQ(1, snapshot.latencies[lcp::StatisticsOperation::OpenLicense].count);
+
+        lcp::Statistics::Shared()->Read(snapshot, false);
+        ASSERT_EQ(4, snapshot.counters[lcp::StatisticsCounter::LicensesOpened]);
+        ASSERT_EQ(0, snapshot.counters[lcp::StatisticsCounter::CrlChecks]);
+    }
+
+    TEST(StatisticsTest, ServicesReadTheirOwnStatistics)
+    {
+        lcp::LcpServiceCreator creator;
+        lcp::ILcpService * firstRaw = nullptr;
+        lcp::ILcpService * secondRaw = nullptr;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, creator.CreateLcpService("", nullptr, nullptr, nullptr, &firstRaw).Code);
+        std::unique_ptr<lcp::ILcpService> first(firstRaw);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, creator.CreateLcpService("", nullptr, nullptr, nullptr, &secondRaw).Code);
+        std::unique_ptr<lcp::ILcpService> second(secondRaw);
+
+        // Timed even when failing
+        EXPECT_ANY_THROW(first->DecryptLicense(nullptr, "passphrase"));
+        EXPECT_ANY_THROW(first->DecryptLicense(nullptr, "passphrase"));
+        EXPECT_ANY_THROW(second->DecryptLicense(nullptr, "passphrase"));
+
+        lcp::StatisticsSnapshot snapshot;
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, first->ReadStatistics(snapshot, true).Code);
+        ASSERT_EQ(2, snapshot.latencies[lcp::StatisticsOperation::DecryptLicense].count);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, second->ReadStatistics(snapshot, false).Code);
+        ASSERT_EQ(1, snapshot.latencies[lcp::StatisticsOperation::DecryptLicense].count);
+    }
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "TraceSpan.h"
+
+namespace lcptest
+{
+    class RecordingTraceSink : public lcp::ITraceSink
+    {
+    public:
+        struct Event
+        {
+            bool begin;
+            uint64_t spanId;
+            std::string name;
+            lcp::TraceAttributes attributes;
+        };
+
+        virtual void OnSpanBegin(uint64_t spanId, const char * name)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_events.push_back(Event{ true, spanId, name, lcp::TraceAttributes() });
+        }
+
+        virtual void OnSpanEnd(uint64_t spanId, const char * name, const lcp::TraceAttributes & attributes)
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            m_events.push_back(Event{ false, spanId, name, attributes });
+        }
+
+        std::vector<Event> Events()
+        {
+            std::unique_lock<std::mutex> locker(m_sync);
+            return m_events;
+        }
+
+    private:
+        std::mutex m_sync;
+        std::vector<Event> m_events;
+    };
+
+    TEST(TraceSpanTest, NestedSpansAreReportedWithTheirAttributes)
+    {
+        RecordingTraceSink sink;
+        {
+            lcp::TraceSpan outer(&sink, "outer");
+            {
+                lcp::TraceSpan inner(&sink, "inner");
+                inner.SetAttribute("length", static_cast<int64_t>(42));
+            }
+            outer.SetAttribute("cached", "true");
+        }
+
+        std::vector<RecordingTraceSink::Event> events = sink.Events();
+        ASSERT_EQ(4u, events.size());
+        ASSERT_TRUE(events[0].begin);
+        ASSERT_EQ("outer", events[0].name);
+        ASSERT_TRUE(events[1].begin);
+        ASSERT_EQ("inner", events[1].name);
+        ASSERT_NE(events[0].spanId, events[1].spanId);
+
+        ASSERT_FALSE(events[2].begin);
+        ASSERT_EQ(events[1].spanId, events[2].spanId);
+        ASSERT_EQ(1u, events[2].attributes.size());
+        ASSERT_EQ("length", events[2].attributes[0].first);
+        ASSERT_EQ("42", events[2].attributes[0].second);
+
+        ASSERT_FALSE(events[3].begin);
+        ASSERT_EQ(events[0].spanId, events[3].spanId);
+        ASSERT_EQ("cached", events[3].attributes[0].first);
+        ASSERT_EQ("true", events[3].attributes[0].second);
+    }
+
+    TEST(TraceSpanTest, SpanEndsOnce)
+    {
+        RecordingTraceSink sink;
+        {
+            lcp::TraceSpan span(&sink, "span");
+            span.End();
+            span.SetAttribute("ignored", "true");
+        }
+        ASSERT_EQ(2u, sink.Events().size());
+
+        lcp::TraceSpan disabled(nullptr, "disabled");
+        ASSERT_FALSE(disabled.Enabled());
+        disabled.SetAttribute("ignored", "true");
+        disabled.End();
+    }
+}
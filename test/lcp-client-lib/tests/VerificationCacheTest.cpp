@@ -0,0 +1,183 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include "public/lcp.h"
+#include "VerificationCache.h"
+#include "TestStorageProvider.h"
+
+namespace lcptest
+{
+    static const char * VerificationCachePath = "verification.cache";
+
+    static lcp::VerificationCache::Entry CreateCacheEntry()
+    {
+        lcp::VerificationCache::Entry entry;
+        entry.rootCertificateDigest = lcp::VerificationCache::Digest("root");
+        entry.providerCertificateDigest = lcp::VerificationCache::Digest("provider");
+        entry.crlVersion = "2016-01-01T00:00:00Z";
+        return entry;
+    }
+
+    static int CountLines(const char * path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return static_cast<int>(std::count(content.begin(), content.end(), '\n'));
+    }
+
+    TEST(VerificationCacheTest, EntriesAreReloaded)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::DefaultFileSystemProvider fsProvider;
+        std::string digest = lcp::VerificationCache::Digest("{\"id\":\"license\"}");
+        {
+            lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+            cache.Load();
+            cache.Store(digest, CreateCacheEntry());
+        }
+
+        lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+        cache.Load();
+        lcp::VerificationCache::Entry entry;
+        ASSERT_TRUE(cache.Find(digest, entry));
+        ASSERT_EQ(CreateCacheEntry().providerCertificateDigest, entry.providerCertificateDigest);
+        ASSERT_STREQ("2016-01-01T00:00:00Z", entry.crlVersion.c_str());
+        std::remove(VerificationCachePath);
+    }
+
+    TEST(VerificationCacheTest, SupersededEntriesAreCompacted)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::DefaultFileSystemProvider fsProvider;
+        std::string digest = lcp::VerificationCache::Digest("{\"id\":\"license\"}");
+        std::string otherDigest = lcp::VerificationCache::Digest("{\"id\":\"other\"}");
+        {
+            lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+            cache.Load();
+            lcp::VerificationCache::Entry entry = CreateCacheEntry();
+            cache.Store(digest, entry);
+            cache.Store(otherDigest, entry);
+            entry.crlVersion = "2017-01-01T00:00:00Z";
+            cache.Store(digest, entry);
+        }
+        ASSERT_EQ(3, CountLines(VerificationCachePath));
+
+        lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+        cache.Load();
+        lcp::VerificationCache::Entry entry;
+        ASSERT_TRUE(cache.Find(digest, entry));
+        ASSERT_STREQ("2017-01-01T00:00:00Z", entry.crlVersion.c_str());
+        ASSERT_TRUE(cache.Find(otherDigest, entry));
+        ASSERT_EQ(2, CountLines(VerificationCachePath));
+        std::remove(VerificationCachePath);
+    }
+
+    class FailingRenameFileSystemProvider : public lcp::DefaultFileSystemProvider
+    {
+    public:
+        virtual void RenameFile(const std::string & oldPath, const std::string & newPath)
+        {
+            throw std::runtime_error("rename failed");
+        }
+    };
+
+    TEST(VerificationCacheTest, InterruptedCompactionKeepsTheCache)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::DefaultFileSystemProvider fsProvider;
+        std::string digest = lcp::VerificationCache::Digest("{\"id\":\"license\"}");
+        {
+            lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+            cache.Load();
+            cache.Store(digest, CreateCacheEntry());
+            cache.Store(digest, CreateCacheEntry());
+        }
+
+        FailingRenameFileSystemProvider failingProvider;
+        {
+            lcp::VerificationCache cache(&storageProvider, &failingProvider, VerificationCachePath);
+            cache.Load();
+        }
+        ASSERT_EQ(2, CountLines(VerificationCachePath));
+
+        lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+        cache.Load();
+        lcp::VerificationCache::Entry entry;
+        ASSERT_TRUE(cache.Find(digest, entry));
+        ASSERT_EQ(1, CountLines(VerificationCachePath));
+        std::remove(VerificationCachePath);
+        std::remove((std::string(VerificationCachePath) + ".tmp").c_str());
+    }
+
+    TEST(VerificationCacheTest, TamperedCacheIsDiscarded)
+    {
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::DefaultFileSystemProvider fsProvider;
+        std::string digest = lcp::VerificationCache::Digest("{\"id\":\"license\"}");
+        {
+            lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+            cache.Load();
+            cache.Store(digest, CreateCacheEntry());
+        }
+        {
+            std::fstream cacheFile(VerificationCachePath, std::ios::in | std::ios::out | std::ios::binary);
+            cacheFile.seekp(-3, std::ios::end);
+            cacheFile.put('X');
+        }
+
+        lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+        cache.Load();
+        lcp::VerificationCache::Entry entry;
+        ASSERT_FALSE(cache.Find(digest, entry));
+        std::remove(VerificationCachePath);
+    }
+
+    TEST(VerificationCacheTest, CacheFromAnotherDeviceIsDiscarded)
+    {
+        lcp::DefaultFileSystemProvider fsProvider;
+        std::string digest = lcp::VerificationCache::Digest("{\"id\":\"license\"}");
+        {
+            TestStorageProvider otherDeviceStorage("storage.json", true);
+            lcp::VerificationCache cache(&otherDeviceStorage, &fsProvider, VerificationCachePath);
+            cache.Load();
+            cache.Store(digest, CreateCacheEntry());
+        }
+
+        TestStorageProvider storageProvider("storage.json", true);
+        lcp::VerificationCache cache(&storageProvider, &fsProvider, VerificationCachePath);
+        cache.Load();
+        lcp::VerificationCache::Entry entry;
+        ASSERT_FALSE(cache.Find(digest, entry));
+        std::remove(VerificationCachePath);
+    }
+}
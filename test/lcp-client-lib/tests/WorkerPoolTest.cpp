@@ -0,0 +1,205 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "WorkerPool.h"
+#include "public/lcp.h"
+
+namespace lcptest
+{
+    TEST(WorkerPoolTest, TasksSubmittedByTasksAreRun)
+    {
+        std::atomic<int> runs(0);
+        {
+            lcp::WorkerPool pool(3);
+            for (int i = 0; i < 100; ++i)
+            {
+                pool.Execute([&]()
+                {
+                    ++runs;
+                    pool.Execute([&]() { ++runs; });
+                });
+            }
+        }
+        // Destroying the pool ran every queued task
+        ASSERT_EQ(200, runs);
+    }
+
+    TEST(WorkerPoolTest, ThrowingTaskLeavesTheWorkerRunning)
+    {
+        std::atomic<int> runs(0);
+        {
+            lcp::WorkerPool pool(1);
+            pool.Post(lcp::WorkerPool::Background, []() { throw std::runtime_error("task failed"); });
+            pool.Post(lcp::WorkerPool::Background, [&]() { ++runs; });
+            pool.Execute([&]() { ++runs; });
+        }
+        ASSERT_EQ(2, runs);
+    }
+
+    TEST(WorkerPoolTest, IdleWorkersStealQueuedTasks)
+    {
+        lcp::WorkerPool pool(4);
+        std::mutex sync;
+        std::condition_variable condition;
+        std::vector<std::thread::id> threads;
+
+        // A single worker queues every task, blocked ones keep it busy
+        pool.Execute([&]()
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                pool.Execute([&]()
+                {
+                    std::unique_lock<std::mutex> locker(sync);
+                    threads.push_back(std::this_thread::get_id());
+                    condition.notify_all();
+                    condition.wait_for(locker, std::chrono::seconds(5), [&]() { return threads.size() == 4; });
+                });
+            }
+        });
+
+        std::unique_lock<std::mutex> locker(sync);
+        ASSERT_TRUE(condition.wait_for(locker, std::chrono::seconds(5), [&]() { return threads.size() == 4; }));
+    }
+
+    TEST(WorkerPoolTest, BackgroundTasksLeaveAWorkerToInteractiveTasks)
+    {
+        std::mutex sync;
+        std::condition_variable condition;
+        bool released = false;
+        std::atomic<int> backgroundRuns(0);
+        std::atomic<bool> interactiveRun(false);
+        {
+            lcp::WorkerPool pool(2);
+            for (int i = 0; i < 2; ++i)
+            {
+                pool.Post(lcp::WorkerPool::Background, [&]()
+                {
+                    ++backgroundRuns;
+                    std::unique_lock<std::mutex> locker(sync);
+                    condition.wait_for(locker, std::chrono::seconds(5), [&]() { return released; });
+                });
+            }
+            pool.Execute([&]()
+            {
+                std::unique_lock<std::mutex> locker(sync);
+                interactiveRun = true;
+                condition.notify_all();
+            });
+
+            // One background task blocks a worker, the other one waits
+            std::unique_lock<std::mutex> locker(sync);
+            ASSERT_TRUE(condition.wait_for(locker, std::chrono::seconds(5), [&]() { return interactiveRun.load(); }));
+            ASSERT_EQ(1, backgroundRuns);
+            released = true;
+            condition.notify_all();
+        }
+        ASSERT_EQ(2, backgroundRuns);
+    }
+
+    TEST(LcpServiceAsyncTest, CanceledOperationsEndInOrder)
+    {
+        lcp::InlineExecutor executor;
+        lcp::ILcpService * lcpServiceRaw = nullptr;
+        lcp::LcpServiceCreator creator;
+        lcp::Status res = creator.CreateLcpService("", nullptr, nullptr, nullptr, &lcpServiceRaw, "", "", nullptr, &executor);
+        std::unique_ptr<lcp::ILcpService> lcpService(lcpServiceRaw);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
+
+        lcp::CancellationToken cancellation;
+        cancellation.Cancel();
+        std::vector<int> order;
+        lcpService->OpenLicenseAsync("", "{}", [&](const lcp::Status & result, lcp::ILicense * license)
+        {
+            ASSERT_EQ(lcp::StatusCode::ErrorCommonOperationCanceled, result.Code);
+            ASSERT_EQ(nullptr, license);
+            order.push_back(1);
+        }, &cancellation);
+        lcpService->DecryptLicenseAsync(nullptr, "passphrase", [&](const lcp::Status & result)
+        {
+            ASSERT_EQ(lcp::StatusCode::ErrorCommonOperationCanceled, result.Code);
+            order.push_back(2);
+        }, &cancellation);
+        lcpService->DecryptFileAsync("{}", "in", "out", [&](const lcp::Status & result)
+        {
+            ASSERT_EQ(lcp::StatusCode::ErrorCommonOperationCanceled, result.Code);
+            order.push_back(3);
+        }, &cancellation);
+
+        ASSERT_EQ((std::vector<int>{ 1, 2, 3 }), order);
+    }
+
+    TEST(LcpServiceAsyncTest, ThrowingCallbackDoesNotBlockTheService)
+    {
+        lcp::InlineExecutor executor;
+        lcp::ILcpService * lcpServiceRaw = nullptr;
+        lcp::LcpServiceCreator creator;
+        lcp::Status res = creator.CreateLcpService("", nullptr, nullptr, nullptr, &lcpServiceRaw, "", "", nullptr, &executor);
+        std::unique_ptr<lcp::ILcpService> lcpService(lcpServiceRaw);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
+
+        ASSERT_ANY_THROW(lcpService->DecryptLicenseAsync(nullptr, "passphrase", [](const lcp::Status &)
+        {
+            throw std::runtime_error("callback error");
+        }));
+
+        // Would wait forever for the operation
+        lcpService.reset();
+    }
+
+    TEST(LcpServiceAsyncTest, FailuresAreReportedToTheCallback)
+    {
+        lcp::ILcpService * lcpServiceRaw = nullptr;
+        lcp::LcpServiceCreator creator;
+        lcp::Status res = creator.CreateLcpService("", nullptr, nullptr, nullptr, &lcpServiceRaw);
+        std::unique_ptr<lcp::ILcpService> lcpService(lcpServiceRaw);
+        ASSERT_EQ(lcp::StatusCode::ErrorCommonSuccess, res.Code);
+
+        std::mutex sync;
+        std::condition_variable condition;
+        std::unique_ptr<lcp::Status> result;
+        lcpService->DecryptLicenseAsync(nullptr, "passphrase", [&](const lcp::Status & status)
+        {
+            std::unique_lock<std::mutex> locker(sync);
+            result.reset(new lcp::Status(status));
+            condition.notify_all();
+        });
+
+        std::unique_lock<std::mutex> locker(sync);
+        ASSERT_TRUE(condition.wait_for(locker, std::chrono::seconds(5), [&]() { return result != nullptr; }));
+        ASSERT_FALSE(lcp::Status::IsSuccess(*result));
+    }
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2016 Mantano
+// Licensed to the Readium Foundation under one or more contributor license agreements.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation and/or
+//    other materials provided with the distribution.
+// 3. Neither the name of the organization nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "IncludeMacros.h"
+
+ZIPLIB_INCLUDE_START
+#include "ziplib/Source/ZipLib/ZipFile.h"
+ZIPLIB_INCLUDE_END
+
+namespace lcptest
+{
+    static const char * TestZipPath = "in_place_test.zip";
+    static const char * LicensePath = "META-INF/license.lcpl";
+
+    //
+    // Gives a few bytes, then fails like a read error on the source
+    //
+    class FailingStreamBuf : public std::streambuf
+    {
+    public:
+        FailingStreamBuf()
+            : m_data(512, 'f')
+        {
+            this->setg(&m_data[0], &m_data[0], &m_data[0] + m_data.size());
+        }
+
+    protected:
+        virtual int_type underflow()
+        {
+            throw std::runtime_error("read error");
+        }
+
+    private:
+        std::string m_data;
+    };
+
+    class ZipFileTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            std::remove(TestZipPath);
+            this->AddFile("mimetype", "application/epub+zip");
+            this->AddFile("OEBPS/content.opf", std::string(4096, 'x'));
+        }
+
+        virtual void TearDown()
+        {
+            std::remove(TestZipPath);
+        }
+
+        void AddFile(const std::string & name, const std::string & content)
+        {
+            std::stringstream stream(content);
+            ZipFile::AddFile(TestZipPath, stream, name);
+        }
+
+        bool AddFileInPlace(const std::string & name, const std::string & content)
+        {
+            std::stringstream stream(content);
+            return ZipFile::AddFileInPlace(TestZipPath, stream, name);
+        }
+
+        std::string ReadFile(const std::string & name)
+        {
+            ZipArchive::Ptr archive = ZipFile::Open(TestZipPath);
+            ZipArchiveEntry::Ptr entry = archive->GetEntry(name);
+            if (entry == nullptr)
+            {
+                return std::string();
+            }
+            std::istream * stream = entry->GetDecompressionStream();
+            return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+        }
+
+        size_t EntriesCount()
+        {
+            return ZipFile::Open(TestZipPath)->GetEntriesCount();
+        }
+
+        std::streamoff FileSize()
+        {
+            std::ifstream file(TestZipPath, std::ios::binary | std::ios::ate);
+            return file.tellg();
+        }
+
+        std::string FileContent()
+        {
+            std::ifstream file(TestZipPath, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        std::streamoff OffsetOfCentralDirectory()
+        {
+            // from the end block, when the archive has no comment
+            std::string content = this->FileContent();
+            const unsigned char * offset = reinterpret_cast<const unsigned char *>(content.data() + content.size() - 6);
+            return offset[0] | (offset[1] << 8) | (offset[2] << 16) | (static_cast<uint32_t>(offset[3]) << 24);
+        }
+
+        void WriteFileContent(const std::string & content)
+        {
+            std::ofstream file(TestZipPath, std::ios::binary | std::ios::trunc);
+            file.write(content.data(), content.size());
+        }
+    };
+
+    TEST_F(ZipFileTest, FileIsAddedInPlace)
+    {
+        std::streamoff offsetOfCentralDirectory = this->OffsetOfCentralDirectory();
+        std::string entries = this->FileContent().substr(0, static_cast<size_t>(offsetOfCentralDirectory));
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"1\"}"));
+
+        // Only the old central directory is overwritten
+        EXPECT_EQ(entries, this->FileContent().substr(0, entries.size()));
+
+        EXPECT_EQ(3, this->EntriesCount());
+        EXPECT_EQ("{\"id\":\"1\"}", this->ReadFile(LicensePath));
+        EXPECT_EQ("application/epub+zip", this->ReadFile("mimetype"));
+        EXPECT_EQ(std::string(4096, 'x'), this->ReadFile("OEBPS/content.opf"));
+    }
+
+    TEST_F(ZipFileTest, FileIsReplacedInPlace)
+    {
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, std::string(2048, 'a') + "0123456789"));
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"2\"}"));
+
+        EXPECT_EQ(3, this->EntriesCount());
+        EXPECT_EQ("{\"id\":\"2\"}", this->ReadFile(LicensePath));
+        EXPECT_EQ(std::string(4096, 'x'), this->ReadFile("OEBPS/content.opf"));
+        EXPECT_EQ("application/epub+zip", this->ReadFile("mimetype"));
+    }
+
+    TEST_F(ZipFileTest, ReplacedLastFileLeavesNothingBehind)
+    {
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"1\"}"));
+        std::streamoff fileSize = this->FileSize();
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"2\"}"));
+
+        EXPECT_EQ(fileSize, this->FileSize());
+
+        // Streaming readers stop at the first central directory header, every
+        // local header has to come before it
+        std::string content = this->FileContent();
+        size_t centralDirectory = content.find("PK\x01\x02");
+        ASSERT_NE(std::string::npos, centralDirectory);
+        EXPECT_EQ(std::string::npos, content.find("PK\x03\x04", centralDirectory));
+        EXPECT_EQ(static_cast<std::streamoff>(centralDirectory), this->OffsetOfCentralDirectory());
+        EXPECT_EQ("{\"id\":\"2\"}", this->ReadFile(LicensePath));
+    }
+
+    TEST_F(ZipFileTest, ReplacedFileFollowedByOthersIsNotWritten)
+    {
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"1\"}"));
+        ASSERT_TRUE(this->AddFileInPlace("OEBPS/toc.ncx", "ncx"));
+        std::string content = this->FileContent();
+
+        EXPECT_FALSE(this->AddFileInPlace(LicensePath, "{\"id\":\"2\"}"));
+        EXPECT_EQ(content, this->FileContent());
+    }
+
+    TEST_F(ZipFileTest, FailedAddRestoresTheArchive)
+    {
+        ASSERT_TRUE(this->AddFileInPlace(LicensePath, "{\"id\":\"1\"}"));
+        std::string content = this->FileContent();
+
+        FailingStreamBuf buffer;
+        std::istream stream(&buffer);
+        stream.exceptions(std::ios::badbit);
+        EXPECT_ANY_THROW(ZipFile::AddFileInPlace(TestZipPath, stream, LicensePath));
+
+        EXPECT_EQ(content, this->FileContent());
+        EXPECT_EQ("{\"id\":\"1\"}", this->ReadFile(LicensePath));
+    }
+
+    TEST_F(ZipFileTest, DataAfterTheArchiveIsKept)
+    {
+        std::string content = this->FileContent() + "trailing data";
+        this->WriteFileContent(content);
+
+        EXPECT_FALSE(this->AddFileInPlace(LicensePath, "{\"id\":\"1\"}"));
+        EXPECT_EQ(content, this->FileContent());
+    }
+}
@@ -28,6 +28,9 @@
 #ifndef __TEST_NET_PROVIDER_H__
 #define __TEST_NET_PROVIDER_H__
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <memory>
 #include <string>
 #include <sstream>
@@ -74,6 +77,40 @@ size_t CallbackWriteFile(void *ptr, size_t size, size_t nmemb, lcp::IWritableStr
 }
 
 
+size_t CallbackHeader(char * buffer, size_t size, size_t nitems, lcp::IConditionalDownloadRequest * request)
+{
+    size_t length = size * nitems;
+    std::string header(buffer, length);
+    size_t colon = header.find(':');
+    if (colon != std::string::npos)
+    {
+        std::string name = header.substr(0, colon);
+        std::string value = header.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "etag")
+        {
+            request->SetETag(value);
+        }
+        else if (name == "last-modified")
+        {
+            request->SetLastModified(value);
+        }
+        else if (name == "content-range")
+        {
+            // bytes <first>-<last>/<size>, the size may be unknown ("*")
+            lcp::IRangeDownloadRequest * range = dynamic_cast<lcp::IRangeDownloadRequest *>(request);
+            size_t slash = value.find('/');
+            if (range != nullptr && slash != std::string::npos && value.compare(slash + 1, std::string::npos, "*") != 0)
+            {
+                range->SetResourceSize(std::strtoll(value.c_str() + slash + 1, nullptr, 10));
+            }
+        }
+    }
+    return length;
+}
+
 struct NetworkInfo
 {
     lcp::INetRequest * request;
@@ -152,10 +189,55 @@ public:
             networkInfo->callback = callback;
             curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, networkInfo.get());
 
+            struct curl_slist * headers = nullptr;
+            lcp::IConditionalDownloadRequest * conditional = dynamic_cast<lcp::IConditionalDownloadRequest *>(request);
+            if (conditional != nullptr)
+            {
+                if (!conditional->IfNoneMatch().empty())
+                {
+                    headers = curl_slist_append(headers, ("If-None-Match: " + conditional->IfNoneMatch()).c_str());
+                }
+                if (!conditional->IfModifiedSince().empty())
+                {
+                    headers = curl_slist_append(headers, ("If-Modified-Since: " + conditional->IfModifiedSince()).c_str());
+                }
+                lcp::IRangeDownloadRequest * range = dynamic_cast<lcp::IRangeDownloadRequest *>(request);
+                if (range != nullptr && (range->RangeStart() > 0 || range->RangeEnd() != -1))
+                {
+                    std::stringstream bytes;
+                    bytes << range->RangeStart() << "-";
+                    if (range->RangeEnd() != -1)
+                    {
+                        bytes << (range->RangeEnd() - 1);
+                    }
+                    curl_easy_setopt(curl, CURLOPT_RANGE, bytes.str().c_str());
+                    if (!range->IfRange().empty())
+                    {
+                        headers = curl_slist_append(headers, ("If-Range: " + range->IfRange()).c_str());
+                    }
+                }
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+                curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, CallbackHeader);
+                curl_easy_setopt(curl, CURLOPT_HEADERDATA, conditional);
+            }
+
             callback->OnRequestStarted(request);
             res = curl_easy_perform(curl);
+            curl_slist_free_all(headers);
             if (res == CURLE_OK)
             {
+                long responseCode = 0;
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+                if (conditional != nullptr && responseCode == 304)
+                {
+                    conditional->SetNotModified(true);
+                }
+                lcp::IRangeDownloadRequest * range = dynamic_cast<lcp::IRangeDownloadRequest *>(request);
+                if (range != nullptr && responseCode != 206)
+                {
+                    // The body is the whole resource
+                    range->SetResourceSize(-1);
+                }
                 callback->OnRequestEnded(request, lcp::Status(lcp::StatusCode::ErrorCommonSuccess));
             }
             else
@@ -175,6 +175,18 @@ public:
         return new lcp::MapIterator<std::string>(*vaultPtr);
     }
 
+    virtual lcp::KvStringsIterator * EnumerateVaultWithPrefix(const std::string & vaultId, const std::string & keyPrefix)
+    {
+        StringsMap * vaultPtr = this->FindVault(vaultId);
+        auto begin = vaultPtr->lower_bound(keyPrefix);
+        auto end = begin;
+        while (end != vaultPtr->end() && end->first.compare(0, keyPrefix.size(), keyPrefix) == 0)
+        {
+            ++end;
+        }
+        return new lcp::MapRangeIterator<std::string>(begin, end);
+    }
+
 private:
     StringsMap * FindVault(const std::string & vaultId)
     {
@@ -187,6 +199,10 @@ private:
         {
             mapPtr = &m_licienseRightsVault;
         }
+        else if (vaultId == lcp::VerificationCacheVaultId)
+        {
+            mapPtr = &m_verificationCacheVault;
+        }
         else
         {
             throw std::runtime_error("Vault was not found");
@@ -197,6 +213,7 @@ private:
 private:
     StringsMap m_userKeysVault;
     StringsMap m_licienseRightsVault;
+    StringsMap m_verificationCacheVault;
     std::string m_fileName;
     bool m_flushed;
 };